@@ -31,6 +31,7 @@ distribution.
 #   include <stdlib.h>
 #   include <string.h>
 #   include <stdarg.h>
+#   include <stdint.h>
 #else
 #   include <cctype>
 #   include <climits>
@@ -38,6 +39,7 @@ distribution.
 #   include <cstdlib>
 #   include <cstring>
 #   include <cstdarg>
+#   include <stdint.h>
 #endif
 
 /*
@@ -101,6 +103,9 @@ static const int TIXML2_MAJOR_VERSION = 1;
 static const int TIXML2_MINOR_VERSION = 0;
 static const int TIXML2_PATCH_VERSION = 11;
 
+// Default for XMLDocument::SetMaxElementDepth()
+static const int TIXML2_DEFAULT_MAX_ELEMENT_DEPTH = 10000;
+
 namespace tinyxml2
 {
 class XMLDocument;
@@ -181,7 +186,8 @@ private:
 /*
 	A dynamic array of Plain Old Data. Doesn't support constructors, etc.
 	Has a small initial memory pool, so that low or no usage will not
-	cause a call to new/delete
+	cause a call to new/delete. Sizes are size_t so that printing to
+	memory works for documents larger than 2GB.
 */
 template <class T, int INIT>
 class DynArray
@@ -204,7 +210,7 @@ public:
         _mem[_size++] = t;
     }
 
-    T* PushArr( int count ) {
+    T* PushArr( size_t count ) {
         EnsureCapacity( _size+count );
         T* ret = &_mem[_size];
         _size += count;
@@ -215,7 +221,7 @@ public:
         return _mem[--_size];
     }
 
-    void PopArr( int count ) {
+    void PopArr( size_t count ) {
         TIXMLASSERT( _size >= count );
         _size -= count;
     }
@@ -224,21 +230,21 @@ public:
         return _size == 0;
     }
 
-    T& operator[](int i)				{
-        TIXMLASSERT( i>= 0 && i < _size );
+    T& operator[](size_t i)				{
+        TIXMLASSERT( i < _size );
         return _mem[i];
     }
 
-    const T& operator[](int i) const	{
-        TIXMLASSERT( i>= 0 && i < _size );
+    const T& operator[](size_t i) const	{
+        TIXMLASSERT( i < _size );
         return _mem[i];
     }
 
-    int Size() const					{
+    size_t Size() const					{
         return _size;
     }
 
-    int Capacity() const				{
+    size_t Capacity() const				{
         return _allocated;
     }
 
@@ -251,9 +257,9 @@ public:
     }
 
 private:
-    void EnsureCapacity( int cap ) {
+    void EnsureCapacity( size_t cap ) {
         if ( cap > _allocated ) {
-            int newAllocated = cap * 2;
+            size_t newAllocated = cap * 2;
             T* newMem = new T[newAllocated];
             memcpy( newMem, _mem, sizeof(T)*_size );	// warning: not using constructors, only works for PODs
             if ( _mem != _pool ) {
@@ -266,8 +272,8 @@ private:
 
     T*  _mem;
     T   _pool[INIT];
-    int _allocated;		// objects allocated
-    int _size;			// number objects in use
+    size_t _allocated;		// objects allocated
+    size_t _size;			// number objects in use
 };
 
 
@@ -298,7 +304,7 @@ public:
     MemPoolT() : _root(0), _currentAllocs(0), _nAllocs(0), _maxAllocs(0), _nUntracked(0)	{}
     ~MemPoolT() {
         // Delete the blocks.
-        for( int i=0; i<_blockPtrs.Size(); ++i ) {
+        for( size_t i=0; i<_blockPtrs.Size(); ++i ) {
             delete _blockPtrs[i];
         }
     }
@@ -306,7 +312,7 @@ public:
     virtual int ItemSize() const	{
         return SIZE;
     }
-    int CurrentAllocs() const		{
+    size_t CurrentAllocs() const		{
         return _currentAllocs;
     }
 
@@ -346,15 +352,17 @@ public:
         _root = chunk;
     }
     void Trace( const char* name ) {
-        printf( "Mempool %s watermark=%d [%dk] current=%d size=%d nAlloc=%d blocks=%d\n",
-                name, _maxAllocs, _maxAllocs*SIZE/1024, _currentAllocs, SIZE, _nAllocs, _blockPtrs.Size() );
+        printf( "Mempool %s watermark=%llu [%lluk] current=%llu size=%d nAlloc=%llu blocks=%llu\n",
+                name, (unsigned long long)_maxAllocs, (unsigned long long)(_maxAllocs*SIZE/1024),
+                (unsigned long long)_currentAllocs, SIZE, (unsigned long long)_nAllocs,
+                (unsigned long long)_blockPtrs.Size() );
     }
 
     void SetTracked() {
         _nUntracked--;
     }
 
-    int Untracked() const {
+    size_t Untracked() const {
         return _nUntracked;
     }
 
@@ -380,10 +388,10 @@ private:
     DynArray< Block*, 10 > _blockPtrs;
     Chunk* _root;
 
-    int _currentAllocs;
-    int _nAllocs;
-    int _maxAllocs;
-    int _nUntracked;
+    size_t _currentAllocs;
+    size_t _nAllocs;
+    size_t _maxAllocs;
+    size_t _nUntracked;
 };
 
 
@@ -457,35 +465,36 @@ class XMLUtil
 public:
     // Anything in the high order range of UTF-8 is assumed to not be whitespace. This isn't
     // correct, but simple, and usually works.
+    // The character classes are those of the "C" locale, whatever the current one is.
     static const char* SkipWhiteSpace( const char* p )	{
-        while( !IsUTF8Continuation(*p) && isspace( *reinterpret_cast<const unsigned char*>(p) ) ) {
+        // Single spaces, between attributes, are the common case. Longer
+        // runs are indentation, and are skipped a block at a time.
+        if ( IsWhiteSpace( *p ) ) {
             ++p;
+            if ( IsWhiteSpace( *p ) ) {
+                p = SkipWhiteSpaceRun( p );
+            }
         }
         return p;
     }
     static char* SkipWhiteSpace( char* p )				{
-        while( !IsUTF8Continuation(*p) && isspace( *reinterpret_cast<unsigned char*>(p) ) )		{
-            ++p;
-        }
-        return p;
+        return const_cast<char*>( SkipWhiteSpace( const_cast<const char*>( p ) ) );
     }
     static bool IsWhiteSpace( char p )					{
-        return !IsUTF8Continuation(p) && isspace( static_cast<unsigned char>(p) );
+        return ( CHAR_CLASSES[static_cast<unsigned char>( p )] & CHAR_CLASS_SPACE ) != 0;
     }
     
     inline static bool IsNameStartChar( unsigned char ch ) {
-        return ( ( ch < 128 ) ? isalpha( ch ) : 1 )
-               || ch == ':'
-               || ch == '_';
+        return ( CHAR_CLASSES[ch] & CHAR_CLASS_NAME_START ) != 0;
     }
     
     inline static bool IsNameChar( unsigned char ch ) {
-        return IsNameStartChar( ch )
-               || isdigit( ch )
-               || ch == '.'
-               || ch == '-';
+        return ( CHAR_CLASSES[ch] & CHAR_CLASS_NAME ) != 0;
     }
 
+    // Returns the first c in the string, or its terminating null
+    static char* FindChar( char* p, char c );
+
     inline static bool StringEqual( const char* p, const char* q, int nChar=INT_MAX )  {
         int n = 0;
         if ( p == q ) {
@@ -515,16 +524,54 @@ public:
     // converts primitive types to strings
     static void ToStr( int v, char* buffer, int bufferSize );
     static void ToStr( unsigned v, char* buffer, int bufferSize );
+    static void ToStr( int64_t v, char* buffer, int bufferSize );
     static void ToStr( bool v, char* buffer, int bufferSize );
     static void ToStr( float v, char* buffer, int bufferSize );
     static void ToStr( double v, char* buffer, int bufferSize );
 
-    // converts strings to primitive types
+    // converts strings to primitive types, the same way in every locale.
+    // Leading white space is skipped, and parsing stops after the number.
     static bool	ToInt( const char* str, int* value );
     static bool ToUnsigned( const char* str, unsigned* value );
+    static bool ToInt64( const char* str, int64_t* value );
     static bool	ToBool( const char* str, bool* value );
     static bool	ToFloat( const char* str, float* value );
     static bool ToDouble( const char* str, double* value );
+
+    /**
+    	Parses up to maxCount white space separated numbers from str
+    	into values and returns how many were read. Parsing stops at
+    	the end of the string or at the first item that isn't a number.
+    	If end is given it is set to where parsing stopped.
+    */
+    static size_t ToDoubleArray( const char* str, double* values, size_t maxCount, const char** end=0 );
+    static size_t ToFloatArray( const char* str, float* values, size_t maxCount, const char** end=0 );
+
+    /// The scanners that skip white space and find delimiters.
+    enum Scanner {
+        SCANNER_SCALAR,		///< a character at a time
+        SCANNER_SSE2,		///< 16 characters at a time
+        SCANNER_AVX2		///< 32 characters at a time
+    };
+    /**
+    	The parser uses the fastest scanner the build and the processor
+    	have. The others are there to compare against, e.g. in benchmarks.
+    	Returns false, leaving the scanner as it is, if the build or the
+    	processor lacks the given one. Not thread safe: only change it
+    	while nothing is being parsed.
+    */
+    static bool SetScanner( Scanner scanner );
+    static Scanner GetScanner();
+
+private:
+    enum {
+        CHAR_CLASS_SPACE		= 1,
+        CHAR_CLASS_NAME_START	= 2,
+        CHAR_CLASS_NAME			= 4
+    };
+    static const unsigned char CHAR_CLASSES[256];
+
+    static const char* SkipWhiteSpaceRun( const char* p );
 };
 
 
@@ -662,6 +709,15 @@ public:
         return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->FirstChildElement( value ));
     }
 
+    /** Get the first child element whose name has the given id,
+    	see XMLElement::NameId(). Compares ids, not names.
+    */
+    const XMLElement* FirstChildElementById( int nameId ) const;
+
+    XMLElement* FirstChildElementById( int nameId )	{
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->FirstChildElementById( nameId ));
+    }
+
     /// Get the last child node, or null if none exists.
     const XMLNode*	LastChild() const						{
         return _lastChild;
@@ -680,6 +736,13 @@ public:
         return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->LastChildElement(value) );
     }
 
+    /// Get the last child element whose name has the given id.
+    const XMLElement* LastChildElementById( int nameId ) const;
+
+    XMLElement* LastChildElementById( int nameId )	{
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->LastChildElementById( nameId ) );
+    }
+
     /// Get the previous (left) sibling node of this node.
     const XMLNode*	PreviousSibling() const					{
         return _prev;
@@ -712,6 +775,13 @@ public:
         return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->NextSiblingElement( value ) );
     }
 
+    /// Get the next (right) sibling element whose name has the given id.
+    const XMLElement*	NextSiblingElementById( int nameId ) const;
+
+    XMLElement*	NextSiblingElementById( int nameId )	{
+        return const_cast<XMLElement*>(const_cast<const XMLNode*>(this)->NextSiblingElementById( nameId ) );
+    }
+
     /**
     	Add a child node as the last (right) child.
     */
@@ -953,6 +1023,14 @@ protected:
 };
 
 
+/**
+	Maps an element or attribute name of the given length to a
+	small non-negative id, see XMLDocument::SetNameIdFunction()
+	and XMLDocument::SetAttributeNameIdFunction().
+*/
+typedef int (*XMLNameIdFunction)( const char* name, size_t length );
+
+
 enum XMLError {
     XML_NO_ERROR = 0,
     XML_SUCCESS = 0,
@@ -975,6 +1053,7 @@ enum XMLError {
     XML_ERROR_EMPTY_DOCUMENT,
     XML_ERROR_MISMATCHED_ELEMENT,
     XML_ERROR_PARSING,
+    XML_ERROR_ELEMENT_DEPTH,
 
     XML_CAN_NOT_CONVERT_TEXT,
     XML_NO_TEXT_NODE
@@ -999,7 +1078,18 @@ public:
     const char* Value() const {
         return _value.GetStr();
     }
-    /// The next attribute in the list.
+    /** The id the document's attribute name id function gave the
+    	attribute's name, or -1 if the document has none.
+    	See XMLDocument::SetAttributeNameIdFunction().
+    */
+    int NameId() const {
+        return _nameId;
+    }
+    /** The next attribute in the list. The list is in the order
+    	the attributes were read or added, so a reader can take all
+    	the attributes of an element in one pass, switching on
+    	NameId().
+    */
     const XMLAttribute* Next() const {
         return _next;
     }
@@ -1019,6 +1109,12 @@ public:
         QueryUnsignedValue( &i );
         return i;
     }
+    /// Query as a 64 bit integer. See IntAttribute()
+    int64_t Int64Value() const				{
+        int64_t i=0;
+        QueryInt64Value( &i );
+        return i;
+    }
     /// Query as a boolean. See IntAttribute()
     bool	 BoolValue() const				{
         bool b=false;
@@ -1046,6 +1142,8 @@ public:
     /// See QueryIntAttribute
     XMLError QueryUnsignedValue( unsigned int* value ) const;
     /// See QueryIntAttribute
+    XMLError QueryInt64Value( int64_t* value ) const;
+    /// See QueryIntAttribute
     XMLError QueryBoolValue( bool* value ) const;
     /// See QueryIntAttribute
     XMLError QueryDoubleValue( double* value ) const;
@@ -1059,6 +1157,8 @@ public:
     /// Set the attribute to value.
     void SetAttribute( unsigned value );
     /// Set the attribute to value.
+    void SetAttribute( int64_t value );
+    /// Set the attribute to value.
     void SetAttribute( bool value );
     /// Set the attribute to value.
     void SetAttribute( double value );
@@ -1068,17 +1168,18 @@ public:
 private:
     enum { BUF_SIZE = 200 };
 
-    XMLAttribute() : _next( 0 ) {}
+    XMLAttribute() : _nameId( -1 ), _next( 0 ) {}
     virtual ~XMLAttribute()	{}
 
     XMLAttribute( const XMLAttribute& );	// not supported
     void operator=( const XMLAttribute& );	// not supported
     void SetName( const char* name );
 
-    char* ParseDeep( char* p, bool processEntities );
+    char* ParseDeep( char* p, bool processEntities, XMLNameIdFunction nameIdFunc );
 
     mutable StrPair _name;
     mutable StrPair _value;
+    int             _nameId;
     XMLAttribute*   _next;
     MemPool*        _memPool;
 };
@@ -1098,8 +1199,14 @@ public:
         return Value();
     }
     /// Set the name of the element.
-    void SetName( const char* str, bool staticMem=false )	{
-        SetValue( str, staticMem );
+    void SetName( const char* str, bool staticMem=false );
+
+    /** The id the document's name id function gave the
+    	element's name, or -1 if the document has none.
+    	See XMLDocument::SetNameIdFunction().
+    */
+    int NameId() const				{
+        return _nameId;
     }
 
     virtual XMLElement* ToElement()				{
@@ -1152,6 +1259,12 @@ public:
         return i;
     }
     /// See IntAttribute()
+    int64_t Int64Attribute( const char* name ) const {
+        int64_t i=0;
+        QueryInt64Attribute( name, &i );
+        return i;
+    }
+    /// See IntAttribute()
     bool	 BoolAttribute( const char* name ) const	{
         bool b=false;
         QueryBoolAttribute( name, &b );
@@ -1199,6 +1312,14 @@ public:
         return a->QueryUnsignedValue( value );
     }
     /// See QueryIntAttribute()
+    XMLError QueryInt64Attribute( const char* name, int64_t* value ) const	{
+        const XMLAttribute* a = FindAttribute( name );
+        if ( !a ) {
+            return XML_NO_ATTRIBUTE;
+        }
+        return a->QueryInt64Value( value );
+    }
+    /// See QueryIntAttribute()
     XMLError QueryBoolAttribute( const char* name, bool* value ) const				{
         const XMLAttribute* a = FindAttribute( name );
         if ( !a ) {
@@ -1248,6 +1369,9 @@ public:
 	int QueryAttribute( const char* name, unsigned int* value ) const {
 		return QueryUnsignedAttribute( name, value );
 	}
+	int QueryAttribute( const char* name, int64_t* value ) const {
+		return QueryInt64Attribute( name, value );
+	}
 
 	int QueryAttribute( const char* name, bool* value ) const {
 		return QueryBoolAttribute( name, value );
@@ -1277,6 +1401,11 @@ public:
         a->SetAttribute( value );
     }
     /// Sets the named attribute to value.
+    void SetAttribute( const char* name, int64_t value )		{
+        XMLAttribute* a = FindOrCreateAttribute( name );
+        a->SetAttribute( value );
+    }
+    /// Sets the named attribute to value.
     void SetAttribute( const char* name, bool value )			{
         XMLAttribute* a = FindOrCreateAttribute( name );
         a->SetAttribute( value );
@@ -1298,6 +1427,10 @@ public:
     }
     /// Query a specific attribute in the list.
     const XMLAttribute* FindAttribute( const char* name ) const;
+    /** Query the attribute whose name has the given id, see
+    	XMLAttribute::NameId(). Compares ids, not names.
+    */
+    const XMLAttribute* FindAttributeById( int nameId ) const;
 
     /** Convenience function for easy access to the text inside an element. Although easy
     	and concise, GetText() is limited compared to getting the TiXmlText child
@@ -1386,10 +1519,12 @@ private:
 
     XMLAttribute* FindAttribute( const char* name );
     XMLAttribute* FindOrCreateAttribute( const char* name );
+    bool IsDuplicateAttribute( const XMLAttribute* attrib ) const;
     //void LinkAttribute( XMLAttribute* attrib );
     char* ParseAttributes( char* p );
 
     int _closingType;
+    int _nameId;
     // The attribute list is ordered; there is no 'lastAttribute'
     // because the list needs to be scanned for dupes before adding
     // a new attribute.
@@ -1435,6 +1570,23 @@ public:
     */
     XMLError Parse( const char* xml, size_t nBytes=(size_t)(-1) );
 
+    /**
+    	Parse an XML document in place, in a buffer the caller
+    	owns, without copying it. The parser writes to the buffer,
+    	and the document's names and values point into it. The
+    	buffer must have room for nBytes+1 chars; xml[nBytes] is
+    	set to null.
+
+    	The document never frees the buffer. The buffer must not
+    	be changed or freed while the document, or a string read
+    	from it, is in use, i.e. until the document is deleted,
+    	cleared or parses something else.
+
+    	Returns XML_NO_ERROR (0) on success, or
+    	an errorID.
+    */
+    XMLError ParseInPlace( char* xml, size_t nBytes );
+
     /**
     	Load an XML file from disk.
     	Returns XML_NO_ERROR (0) on success, or
@@ -1451,6 +1603,19 @@ public:
     */
     XMLError LoadFile( FILE* );
 
+    /**
+    	Load an XML file from disk by mapping it into memory
+    	instead of reading it into a buffer. The mapping is
+    	private, so the in place parsing only copies the pages
+    	it writes to, and parsing starts as soon as the first
+    	pages are read. Falls back to LoadFile() where files
+    	can't be mapped.
+
+    	Returns XML_NO_ERROR (0) on success, or
+    	an errorID.
+    */
+    XMLError LoadFileMapped( const char* filename );
+
     /**
     	Save the XML file to disk.
     	Returns XML_NO_ERROR (0) on success, or
@@ -1470,6 +1635,49 @@ public:
     bool ProcessEntities() const		{
         return _processEntities;
     }
+
+    /**
+    	Sets a function that maps element names to ids. Elements
+    	parsed or created after the call carry the id of their
+    	name, so callers can switch on XMLElement::NameId()
+    	instead of comparing names. The name is hashed once,
+    	while it is read.
+    */
+    void SetNameIdFunction( XMLNameIdFunction func )	{
+        _nameIdFunction = func;
+    }
+    XMLNameIdFunction NameIdFunction() const	{
+        return _nameIdFunction;
+    }
+
+    /**
+    	Like SetNameIdFunction(), for attribute names. Attributes
+    	parsed or created after the call carry the id of their
+    	name, see XMLAttribute::NameId() and
+    	XMLElement::FindAttributeById(). Attributes with
+    	different ids are never compared by name, which also
+    	speeds up the check for duplicate attributes.
+    */
+    void SetAttributeNameIdFunction( XMLNameIdFunction func )	{
+        _attributeNameIdFunction = func;
+    }
+    XMLNameIdFunction AttributeNameIdFunction() const	{
+        return _attributeNameIdFunction;
+    }
+
+    /**
+    	Sets how deep elements may be nested in the documents
+    	parsed after the call; deeper elements fail the parse with
+    	XML_ERROR_ELEMENT_DEPTH. Parsing, deleting and visiting
+    	don't recurse, so the limit protects the caller's own
+    	recursive code rather than tinyxml2.
+    */
+    void SetMaxElementDepth( int depth )	{
+        _maxElementDepth = depth;
+    }
+    int MaxElementDepth() const	{
+        return _maxElementDepth;
+    }
     Whitespace WhitespaceMode() const	{
         return _whitespace;
     }
@@ -1596,6 +1804,9 @@ private:
     XMLDocument( const XMLDocument& );	// not supported
     void operator=( const XMLDocument& );	// not supported
 
+    void ParseCharBuffer();
+    void FreeCharBuffer();
+
     bool        _writeBOM;
     bool        _processEntities;
     XMLError    _errorID;
@@ -1603,6 +1814,11 @@ private:
     const char* _errorStr1;
     const char* _errorStr2;
     char*       _charBuffer;
+    size_t      _charBufferMapSize;	// 0 unless _charBuffer is a mapping
+    bool        _charBufferIsCallers;	// given to ParseInPlace
+    XMLNameIdFunction _nameIdFunction;
+    XMLNameIdFunction _attributeNameIdFunction;
+    int         _maxElementDepth;
 
     MemPoolT< sizeof(XMLElement) >	 _elementPool;
     MemPoolT< sizeof(XMLAttribute) > _attributePool;
@@ -1815,6 +2031,304 @@ private:
 };
 
 
+class XMLCompactDocument;
+
+/**
+	An attribute of an XMLCompactDocument element. Like
+	XMLCompactNode it is a small handle, passed by value, that
+	tests false once past the last attribute.
+*/
+class XMLCompactAttribute
+{
+    friend class XMLCompactNode;
+public:
+    XMLCompactAttribute() : _document( 0 ), _index( 0 ), _end( 0 ) {}
+
+    /// Non-null for an attribute, null past the last one
+    operator const void*() const	{
+        return _document ? this : 0;
+    }
+    const XMLCompactAttribute* operator->() const	{
+        return this;
+    }
+
+    const char* Name() const;
+    const char* Value() const;
+    /// See XMLAttribute::NameId()
+    int NameId() const;
+    /// The next attribute of the element, in document order
+    XMLCompactAttribute Next() const;
+
+    /// See XMLAttribute::QueryIntValue()
+    XMLError QueryIntValue( int* value ) const;
+    XMLError QueryInt64Value( int64_t* value ) const;
+    XMLError QueryBoolValue( bool* value ) const;
+    XMLError QueryDoubleValue( double* value ) const;
+
+private:
+    XMLCompactAttribute( const XMLCompactDocument* doc, unsigned index, unsigned end ) :
+        _document( index < end ? doc : 0 ), _index( index ), _end( end ) {}
+
+    const XMLCompactDocument* _document;
+    unsigned _index;
+    unsigned _end;	// one past the element's last attribute
+};
+
+
+/**
+	A node of an XMLCompactDocument: the document itself, an
+	element, text, or a comment, declaration or unknown. It is
+	a small handle, passed by value, and tests false where
+	XMLNode would give a null pointer. The names of the read
+	functions are those of XMLNode and XMLElement, and the ->
+	operator works on the handle, so code can be written once
+	for both kinds of documents:
+
+	@verbatim
+	for( auto child = node->FirstChild(); child != 0; child = child->NextSibling() ) {
+		if ( child->ToElement() ) ...
+	}
+	@endverbatim
+
+	An element is its own ToElement(); there is no separate
+	element type.
+*/
+class XMLCompactNode
+{
+    friend class XMLCompactDocument;
+    friend class XMLCompactAttribute;
+public:
+    XMLCompactNode() : _document( 0 ), _index( 0 ) {}
+
+    /// Non-null for a node, null for no node
+    operator const void*() const	{
+        return _document ? this : 0;
+    }
+    const XMLCompactNode* operator->() const	{
+        return this;
+    }
+    bool operator==( const XMLCompactNode& node ) const	{
+        return _document == node._document && _index == node._index;
+    }
+    bool operator!=( const XMLCompactNode& node ) const	{
+        return !( *this == node );
+    }
+
+    /// This node if it is an element, else no node
+    XMLCompactNode ToElement() const;
+    /// This node if it is text, else no node
+    XMLCompactNode ToText() const;
+    /// This node if it is the document, else no node
+    XMLCompactNode ToDocument() const;
+    /// True for text read from a CDATA section
+    bool CData() const;
+
+    /// The name of an element, or the text of other nodes
+    const char* Value() const;
+    const char* Name() const	{
+        return Value();
+    }
+    /// See XMLElement::NameId()
+    int NameId() const;
+
+    XMLCompactNode Parent() const;
+    XMLCompactNode FirstChild() const;
+    XMLCompactNode LastChild() const;
+    /// Walks the parent's children, there are no back links
+    XMLCompactNode PreviousSibling() const;
+    XMLCompactNode NextSibling() const;
+    XMLCompactNode FirstChildElement( const char* value=0 ) const;
+    XMLCompactNode LastChildElement( const char* value=0 ) const;
+    XMLCompactNode NextSiblingElement( const char* value=0 ) const;
+    XMLCompactNode FirstChildElementById( int nameId ) const;
+    XMLCompactNode NextSiblingElementById( int nameId ) const;
+
+    /// The element's attributes, in document order
+    XMLCompactAttribute FirstAttribute() const;
+    XMLCompactAttribute FindAttribute( const char* name ) const;
+    XMLCompactAttribute FindAttributeById( int nameId ) const;
+    /// See XMLElement::Attribute()
+    const char* Attribute( const char* name, const char* value=0 ) const;
+    /// See XMLElement::GetText()
+    const char* GetText() const;
+
+    /// See XMLElement::QueryIntAttribute()
+    XMLError QueryIntAttribute( const char* name, int* value ) const	{
+        XMLCompactAttribute a = FindAttribute( name );
+        return a ? a.QueryIntValue( value ) : XML_NO_ATTRIBUTE;
+    }
+    XMLError QueryInt64Attribute( const char* name, int64_t* value ) const	{
+        XMLCompactAttribute a = FindAttribute( name );
+        return a ? a.QueryInt64Value( value ) : XML_NO_ATTRIBUTE;
+    }
+    XMLError QueryBoolAttribute( const char* name, bool* value ) const	{
+        XMLCompactAttribute a = FindAttribute( name );
+        return a ? a.QueryBoolValue( value ) : XML_NO_ATTRIBUTE;
+    }
+    XMLError QueryDoubleAttribute( const char* name, double* value ) const	{
+        XMLCompactAttribute a = FindAttribute( name );
+        return a ? a.QueryDoubleValue( value ) : XML_NO_ATTRIBUTE;
+    }
+    /// See XMLElement::IntAttribute()
+    int IntAttribute( const char* name ) const		{
+        int i=0;
+        QueryIntAttribute( name, &i );
+        return i;
+    }
+    bool BoolAttribute( const char* name ) const	{
+        bool b=false;
+        QueryBoolAttribute( name, &b );
+        return b;
+    }
+    double DoubleAttribute( const char* name ) const	{
+        double d=0;
+        QueryDoubleAttribute( name, &d );
+        return d;
+    }
+
+private:
+    XMLCompactNode( const XMLCompactDocument* doc, unsigned index );
+
+    const XMLCompactDocument* _document;
+    unsigned _index;
+};
+
+
+/**
+	A read-only document that takes a fraction of the memory of
+	XMLDocument. The nodes and attributes are kept in two arrays
+	and refer to each other by 32 bit index, and the names and
+	values are offsets into the parsed text, which is processed
+	in place like XMLDocument does. A node is 40 bytes and an
+	attribute 24, against about 100 and 80 for XMLDocument on a
+	64 bit build, and walking the tree reads memory front to back.
+	As with XMLDocument::LoadFile(), white space and a BOM before
+	the first node are skipped.
+
+	The document can't be changed, printed or visited; read it
+	through the XMLCompactNode handles, starting at Node().
+	The text offsets are size_t, so text of 4GB or more parses
+	on a 64 bit build; a document is limited to 4G nodes and 4G
+	attributes.
+*/
+class XMLCompactDocument
+{
+    friend class XMLCompactNode;
+    friend class XMLCompactAttribute;
+public:
+    XMLCompactDocument( bool processEntities = true, Whitespace = PRESERVE_WHITESPACE );
+    ~XMLCompactDocument();
+
+    /// See XMLDocument::Parse(), the text is copied
+    XMLError Parse( const char* xml, size_t nBytes=(size_t)(-1) );
+    /// See XMLDocument::ParseInPlace()
+    XMLError ParseInPlace( char* xml, size_t nBytes );
+    /// See XMLDocument::LoadFile()
+    XMLError LoadFile( const char* filename );
+    /// See XMLDocument::LoadFileMapped()
+    XMLError LoadFileMapped( const char* filename );
+
+    /// See XMLDocument::SetNameIdFunction()
+    void SetNameIdFunction( XMLNameIdFunction func )	{
+        _nameIdFunction = func;
+    }
+    /// See XMLDocument::SetAttributeNameIdFunction()
+    void SetAttributeNameIdFunction( XMLNameIdFunction func )	{
+        _attributeNameIdFunction = func;
+    }
+    /// See XMLDocument::SetMaxElementDepth()
+    void SetMaxElementDepth( int depth )	{
+        _maxElementDepth = depth;
+    }
+
+    /// The document node, the parent of the top level nodes
+    XMLCompactNode Node() const	{
+        return XMLCompactNode( this, 0 );
+    }
+    XMLCompactNode FirstChild() const	{
+        return Node().FirstChild();
+    }
+    XMLCompactNode FirstChildElement( const char* value=0 ) const	{
+        return Node().FirstChildElement( value );
+    }
+
+    /// Number of nodes, the document included, and of attributes
+    size_t NodeCount() const		{
+        return _nodes.Size();
+    }
+    size_t AttributeCount() const	{
+        return _attributes.Size();
+    }
+    /// Bytes used by the nodes and attributes, without the text
+    size_t MemoryUsed() const;
+
+    bool Error() const			{
+        return _errorID != XML_NO_ERROR;
+    }
+    XMLError ErrorID() const	{
+        return _errorID;
+    }
+
+    /// Frees the text and empties the nodes and attributes
+    void Clear();
+
+private:
+    XMLCompactDocument( const XMLCompactDocument& );	// not supported
+    void operator=( const XMLCompactDocument& );	// not supported
+
+    enum NodeType {
+        NODE_DOCUMENT,
+        NODE_ELEMENT,
+        NODE_TEXT,
+        NODE_CDATA,
+        NODE_COMMENT,
+        NODE_DECLARATION,
+        NODE_UNKNOWN
+    };
+    enum { NO_INDEX = 0xffffffff };
+
+    // Links are indices into _nodes, NO_INDEX for none. The
+    // attributes of a node run up to the next node's first one.
+    struct NodeEntry {
+        size_t		_value;
+        unsigned	_parent;
+        unsigned	_firstChild;
+        unsigned	_lastChild;
+        unsigned	_next;
+        unsigned	_firstAttribute;
+        int			_nameId;
+        unsigned	_type;
+    };
+    struct AttributeEntry {
+        size_t		_name;
+        size_t		_value;
+        int			_nameId;
+    };
+
+    void ParseCharBuffer( size_t nBytes );
+    char* ParseAttributes( char* p, bool* closed );
+    unsigned AddNode( unsigned parent, NodeType type );
+    size_t Offset( StrPair* str );
+    unsigned AttributeEnd( unsigned node ) const;
+    void SetError( XMLError error )	{
+        _errorID = error;
+    }
+
+    bool		_processEntities;
+    Whitespace	_whitespace;
+    XMLError	_errorID;
+    char*		_charBuffer;
+    bool		_charBufferIsCallers;
+    size_t		_charBufferMapSize;	// 0 unless _charBuffer is a mapping
+    XMLNameIdFunction _nameIdFunction;
+    XMLNameIdFunction _attributeNameIdFunction;
+    int			_maxElementDepth;
+
+    DynArray< NodeEntry, 16 >		_nodes;
+    DynArray< AttributeEntry, 16 >	_attributes;
+};
+
+
 /**
 	Printing functionality. The XMLPrinter gives you more
 	options than the XMLDocument::Print() method.
@@ -1879,6 +2393,7 @@ public:
     void PushAttribute( const char* name, const char* value );
     void PushAttribute( const char* name, int value );
     void PushAttribute( const char* name, unsigned value );
+    void PushAttribute( const char* name, int64_t value );
     void PushAttribute( const char* name, bool value );
     void PushAttribute( const char* name, double value );
     /// If streaming, close the Element.
@@ -1890,6 +2405,8 @@ public:
     void PushText( int value );
     /// Add a text node from an unsigned.
     void PushText( unsigned value );
+    /// Add a text node from a 64 bit integer.
+    void PushText( int64_t value );
     /// Add a text node from a bool.
     void PushText( bool value );
     /// Add a text node from a float.
@@ -1928,9 +2445,24 @@ public:
     	of the XML file in memory. (Note the size returned
     	includes the terminating null.)
     */
-    int CStrSize() const {
+    size_t CStrSize() const {
         return _buffer.Size();
     }
+    /**
+    	Number of bytes printed so far, to the FILE or to
+    	memory. Does not include the terminating null.
+    */
+    uint64_t BytesWritten() const {
+        return _bytesWritten;
+    }
+
+protected:
+    /**
+    	Write the '>' of the element opened last, if it has not been
+    	written yet. Afterwards BytesWritten() is where the next node
+    	starts.
+    */
+    void SealElementIfJustOpened();
 
 private:
     void SealElement();
@@ -1945,6 +2477,7 @@ private:
     int _textDepth;
     bool _processEntities;
     bool _compactMode;
+    uint64_t _bytesWritten;
 
     enum {
         ENTITY_RANGE = 64,
@@ -0,0 +1,104 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLASYNCIO_H
+#define SKPTOXML_COMMON_XMLASYNCIO_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Asynchronous output for the exported files. The printers keep writing to a
+// FILE*, but the stream collects what they print into large aligned chunks
+// and every full chunk is handed to the disk at its offset in the file while
+// printing goes on with the next one. On Linux the chunks are submitted
+// through io_uring when the kernel allows it; otherwise a small pool of
+// threads writes them with pwrite. Where neither is available the file is
+// written synchronously.
+
+enum XmlAsyncBackend {
+  XmlAsyncBackend_None = 0,
+  XmlAsyncBackend_Threads = 1,
+  XmlAsyncBackend_IoUring = 2
+};
+
+class CXmlIoUring;
+
+class CXmlAsyncFile {
+ public:
+  CXmlAsyncFile();
+  ~CXmlAsyncFile();
+
+  // The preferred backend, falling back to the next one down when it is not
+  // available. Defaults to XmlAsyncBackend_IoUring.
+  void set_backend(XmlAsyncBackend backend) { requested_backend_ = backend; }
+  // The backend in use once the file is open
+  XmlAsyncBackend backend() const { return backend_; }
+
+  // Creates the file and returns the stream to print to, or NULL. Space for
+  // estimated_size bytes is reserved up front; 0 if the size is not known.
+  FILE* Open(const std::string& filename, uint64_t estimated_size);
+
+  // Closes the stream and waits for all the chunks to be written. Returns
+  // false if anything failed to be written.
+  bool Close();
+
+ private:
+  struct Chunk {
+    char* data_;
+    size_t size_;
+    uint64_t offset_;
+    // How much of the chunk is on the disk, the io_uring backend resubmits
+    // short writes
+    size_t written_;
+  };
+
+  static void Preallocate(int fd, uint64_t size);
+
+  // Called by the stream with what was printed
+  bool Append(const char* data, size_t size);
+  int AcquireChunk();
+  void SubmitChunk(int index);
+  void ReleaseChunk(int index, bool ok);
+  void WaitForAllChunks();
+  void WriteChunks();
+  bool ReapChunk();
+
+  static bool WriteAll(int fd, const char* data, size_t size, uint64_t offset);
+
+#if defined(__linux__)
+  static ssize_t StreamWrite(void* cookie, const char* data, size_t size);
+  static int StreamClose(void* cookie);
+#elif defined(__APPLE__)
+  static int StreamWrite(void* cookie, const char* data, int size);
+  static int StreamClose(void* cookie);
+#endif
+
+  XmlAsyncBackend requested_backend_;
+  XmlAsyncBackend backend_;
+  int fd_;
+  FILE* stream_;
+  uint64_t offset_;
+  bool failed_;
+
+  std::vector<Chunk> chunks_;
+  std::vector<int> free_chunks_;
+  int current_chunk_;
+
+  // Thread pool backend
+  std::mutex mutex_;
+  std::condition_variable chunk_queued_;
+  std::condition_variable chunk_released_;
+  std::deque<int> queue_;
+  std::vector<std::thread> threads_;
+  bool stopping_;
+
+  // io_uring backend
+  CXmlIoUring* ring_;
+};
+
+#endif // SKPTOXML_COMMON_XMLASYNCIO_H
@@ -0,0 +1,52 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLBENCHMARK_H
+#define SKPTOXML_COMMON_XMLBENCHMARK_H
+
+#include <stdint.h>
+#include <string>
+
+// Stress tests and benchmarks that run without a SketchUp model, from the
+// command line options of the same names. Each prints what it measured and
+// returns false if something did not read back as it was written.
+
+namespace XmlBenchmark {
+
+// A little over 4GB, so 32-bit sizes and offsets wrap
+static const uint64_t kLargeDocumentBytes = (4ULL << 30) + (64ULL << 20);
+
+// Streams a document of at least min_bytes bytes into the file through an
+// XMLPrinter, as Face elements whose Triangles Count attributes lie above
+// 2^32, each followed by small Vertex elements. Prints the same document to
+// memory and compares it with the file, reads the file back through both
+// tinyxml2::XMLDocument and tinyxml2::XMLCompactDocument, and saves the
+// XMLDocument to a copy that must equal the file. Checks the byte counts,
+// every Count and Vertex and the first and last payloads. The print to
+// memory holds the whole document. The files are removed afterwards.
+bool StressLargeDocument(const std::string& filename,
+                         uint64_t min_bytes = kLargeDocumentBytes);
+
+// Times num_passes of tinyxml2::XMLDocument::Parse on the file, held in
+// memory, with each of the character scanners the build and the processor
+// have: scalar, SSE2 and AVX2. Checks that they all parse the same number
+// of elements.
+bool BenchmarkParse(const std::string& filename, int num_passes);
+
+// Writes a model of num_groups groups, each holding one face, nested inside
+// one another and then side by side, into the file through CXmlFile. Times
+// writing it, tinyxml2::XMLDocument::Parse and CXmlFile::GetModelInfo for
+// both, and checks that every group and face reads back. The nested file is
+// the larger one, as its indentation grows with the depth. The file is
+// removed afterwards.
+bool BenchmarkNesting(const std::string& filename, int num_groups);
+
+// Converts num_values generated decimal strings with tinyxml2::XMLUtil's
+// ToDouble, ToFloat, ToDoubleArray and ToFloatArray and checks that every
+// result is bit for bit the one strtod and strtof give. The strings are
+// printed doubles and floats, random digit strings of any length and
+// exponent, and numbers at the edges of the exact fast path.
+bool CheckNumbers(uint64_t num_values);
+
+} // namespace XmlBenchmark
+
+#endif // SKPTOXML_COMMON_XMLBENCHMARK_H
@@ -29,8 +29,11 @@ private:
   // Clean up slapi objects
   void ReleaseModelObjects();
 
-  // Write texture files to the destination directory
-  void WriteTextureFiles();
+  // Load the textures into the texture writer, returns their number
+  size_t LoadTextures();
+  // Write texture files to the destination directory, returns false on
+  // failure
+  bool WriteTextureFiles(const std::string& texture_directory);
 
   void WriteLayers();
   void WriteLayer(SULayerRef layer);
@@ -42,13 +45,38 @@ private:
   void WriteComponentDefinition(SUComponentDefinitionRef comp_def);
 
   void WriteGeometry();
+  struct EntitiesLevel;
   void WriteEntities(SUEntitiesRef entities);
+  void BeginEntities(SUEntitiesRef entities,
+                     std::vector<EntitiesLevel>& levels);
+  void PushEntitiesLevel(SUEntitiesRef entities,
+                         std::vector<EntitiesLevel>& levels);
+  // True for the groups of an entities collection at this depth, if
+  // max_group_depth leaves them out
+  bool IsGroupTooDeep(size_t depth) const;
+  // Quantized output: passes the bounds of the faces of a definition or of
+  // the model geometry to the file before they are written
+  void SetQuantizationBounds(SUEntitiesRef entities);
+  void AddFaceBounds(SUFaceRef face, XmlGeomUtils::CBoundingBox3d& bounds,
+                     XmlGeomUtils::CBoundingBox3d& uv_bounds);
+  void WriteComponentInstances(SUEntitiesRef entities);
+  void WriteLooseGeometry(SUEntitiesRef entities);
   void WriteFace(SUFaceRef face);
   void WriteEdge(SUEdgeRef edge);
   void WriteCurve(SUCurveRef curve);
 
   XmlEdgeInfo GetEdgeInfo(SUEdgeRef edge) const;
 
+  // Cut the written file into tiles
+  void WriteTiles(const std::string& xml_filename, int major_ver,
+                  int minor_ver, int build_no);
+
+  // Time spatial index queries on the written file against brute force
+  void BenchmarkSpatialIndex(const std::string& xml_filename);
+
+  // Time the decoding of the compressed meshes of the written file
+  void BenchmarkMeshDecoding(const std::string& xml_filename);
+
 private:
   CXmlOptions options_;
 
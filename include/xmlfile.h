@@ -11,6 +11,15 @@
 #include <slapi/transformation.h>
 
 #include "xmlgeomutils.h"
+#include "xmlindex.h"
+#include "xmlmanifest.h"
+#include "xmlmeshcompression.h"
+#include "xmloptions.h"
+#include "xmlprofile.h"
+#include "xmlprogressive.h"
+#include "xmlpullparser.h"
+#include "xmlquantization.h"
+#include "xmlscanner.h"
 
 // Forward declarations
 namespace tinyxml2 {
@@ -18,6 +27,8 @@ namespace tinyxml2 {
   class XMLNode;
   class XMLElement;
 }
+struct XmlRenderModel;
+class CXmlRenderBuilder;
 
 // Helper data transfer types storing model information.
 
@@ -72,6 +83,7 @@ struct XmlFaceInfo {
   XmlFaceInfo()
     : has_front_texture_(false),
       has_back_texture_(false),
+      has_normals_(true),
       has_single_loop_(false) {}
 
   std::string layer_name_;
@@ -79,6 +91,8 @@ struct XmlFaceInfo {
   std::string back_mat_name_;
   bool has_front_texture_;
   bool has_back_texture_;
+  // False if the normals were left out of the export
+  bool has_normals_;
   bool has_single_loop_;
   // if single loop, vertices_ are the points in the loop
   // if triangles, vertices_ are 3 per triangle
@@ -88,20 +102,29 @@ struct XmlFaceInfo {
 struct XmlEntitiesInfo;
 struct XmlComponentDefinitionInfo;
 
+// entities_ is never NULL: a moved from group is left with empty entities
 struct XmlGroupInfo {
   XmlGroupInfo();
   XmlGroupInfo(const XmlGroupInfo&);
+  // Takes the entities, the moved from group gets empty ones
+  XmlGroupInfo(XmlGroupInfo&&) noexcept;
   ~XmlGroupInfo();
   const XmlGroupInfo& operator = (const XmlGroupInfo&);
+  XmlGroupInfo& operator = (XmlGroupInfo&&) noexcept;
   
   XmlEntitiesInfo* entities_;
   SUTransformation transform_;
 };
 
 struct XmlComponentInstanceInfo {
+  XmlComponentInstanceInfo() : has_transform_(true) {}
+
   std::string definition_name_;
   std::string layer_name_;
   std::string material_name_;
+  // False if the transformation was left out of the export, transform_ is
+  // then the identity
+  bool has_transform_;
   SUTransformation transform_;
 };
 
@@ -125,19 +148,157 @@ struct XmlModelInfo {
   XmlEntitiesInfo entities_;
 };
 
+// The parts of the model CXmlFile::LoadModelInfo reads
+struct XmlModelQuery {
+  XmlModelQuery()
+    : layers_(false),
+      materials_(false),
+      all_definitions_(false),
+      geometry_(false),
+      write_index_(false),
+      num_threads_(1) {}
+
+  bool layers_;
+  bool materials_;
+  // All component definitions, or only the ones named here
+  bool all_definitions_;
+  std::vector<std::string> definition_names_;
+  bool geometry_;
+  // Write the section offsets found by scanning to the index sidecar, so
+  // the next load seeks straight to them. The whole file is scanned then.
+  bool write_index_;
+  // Component definitions and runs of geometry entities are parsed by this
+  // many threads, 0 for one per processor. The result does not depend on it.
+  int num_threads_;
+};
+
+// Receives the parts of a file read progressively, in file order. Geometry
+// entities are passed one at a time.
+class CXmlProgressiveListener {
+ public:
+  virtual ~CXmlProgressiveListener() {}
+
+  virtual void OnLayers(const std::vector<XmlLayerInfo>& /*layer_infos*/) {}
+  virtual void OnMaterials(
+      const std::vector<XmlMaterialInfo>& /*mat_infos*/) {}
+  virtual void OnCoarseModel(const XmlCoarseModelInfo& /*coarse_info*/) {}
+  virtual void OnComponentDefinition(
+      const XmlComponentDefinitionInfo& /*info*/) {}
+  virtual void OnGeometry(const XmlEntitiesInfo& /*entities*/) {}
+};
+
+// Receives the contents of a file read by CXmlFile::ReadStreaming one item
+// at a time, in file order. Entities belong to the innermost component
+// definition, geometry or group that has begun and not yet ended. A group's
+// transformation comes with its end. The items belong to the reader and
+// only live for the call; a listener that keeps one may move it out.
+class CXmlStreamListener {
+ public:
+  virtual ~CXmlStreamListener() {}
+
+  virtual void OnLayer(XmlLayerInfo& /*info*/) {}
+  virtual void OnMaterial(XmlMaterialInfo& /*info*/) {}
+  virtual void OnBeginComponentDefinition(const std::string& /*name*/) {}
+  virtual void OnEndComponentDefinition() {}
+  virtual void OnBeginGeometry() {}
+  virtual void OnEndGeometry() {}
+  virtual void OnBeginGroup() {}
+  virtual void OnEndGroup(const SUTransformation& /*transform*/) {}
+  virtual void OnComponentInstance(XmlComponentInstanceInfo& /*info*/) {}
+  virtual void OnFace(XmlFaceInfo& /*info*/) {}
+  virtual void OnEdge(XmlEdgeInfo& /*info*/) {}
+  virtual void OnCurve(XmlCurveInfo& /*info*/) {}
+};
+
 class CXmlFile {
  public:
   CXmlFile();
   ~CXmlFile();
 
   bool Open(const std::string& filename, bool create_new_file);
+  // Opens a file already in memory for reading, e.g. a network receive
+  // buffer, and parses it in place without copying it. The buffer must have
+  // room for length + 1 chars, is written to, and must stay valid until
+  // Close; see XMLDocument::ParseInPlace.
+  bool OpenBuffer(char* buffer, size_t length);
   void Close(bool cancelled);
 
   std::string GetTextureDirectory() const;
 
+  // Set the options controlling the written file, e.g. the index sidecar
+  void SetOptions(const CXmlOptions& options) { options_ = options; }
+
+  // Size of the compressed meshes written since the file was opened
+  const XmlMeshCompressionStats& compression_stats() const {
+    return compression_stats_;
+  }
+
+  // What a delta export wrote, see xmlmanifest.h
+  const XmlDeltaStats& delta_stats() const { return delta_stats_; }
+
+  // Size profile of the file written by Close, if enabled in the options
+  const CXmlProfile& profile() const { return profile_; }
+
   // Converts the XML DOM into XmlModelInfo
   bool GetModelInfo(XmlModelInfo& model_info) const;
 
+  // Times num_passes decodes of every face of the open file that holds a
+  // compressed mesh, each read through the same path as GetModelInfo.
+  // Returns false if a mesh does not decode.
+  bool BenchmarkMeshDecoding(size_t num_passes,
+                             XmlMeshDecodeBenchmarkInfo& info) const;
+
+  // Random access through the byte offset index sidecar. OpenIndexed loads
+  // only the index and the header; the ReadIndexed functions then seek to a
+  // single element of the file and parse just that element.
+  bool OpenIndexed(const std::string& filename);
+  const CXmlIndex& index() const { return index_; }
+  bool ReadIndexedLayers(std::vector<XmlLayerInfo>& layer_infos) const;
+  bool ReadIndexedMaterials(std::vector<XmlMaterialInfo>& mat_infos) const;
+  bool ReadIndexedComponentDefinition(const std::string& name,
+                                      XmlComponentDefinitionInfo& info) const;
+  bool ReadIndexedGroup(const std::string& path, XmlGroupInfo& info) const;
+
+  // Reads only the parts of the model the query asks for. The offsets come
+  // from the index sidecar if there is one. Otherwise the file is scanned
+  // for them by counting tag depth, without parsing the parts that are
+  // skipped, and scanning stops once everything asked for was found. Returns
+  // false if a named component definition is not in the file. The file need
+  // not be opened first.
+  bool LoadModelInfo(const std::string& filename, const XmlModelQuery& query,
+                     XmlModelInfo& model_info);
+
+  // Progressive reading. The file contents are given in pieces as they
+  // arrive and each section, component definition and geometry entity is
+  // passed to the listener as soon as it is complete. Only the incomplete
+  // part is kept in memory.
+  void BeginProgressiveRead(CXmlProgressiveListener* listener);
+  bool ReadProgressive(const char* data, size_t length);
+  // Returns false if the file ended in the middle of an element
+  bool EndProgressiveRead();
+
+  // Streaming reading, without a DOM. The file is read once, front to back
+  // in fixed size blocks, and each layer, material and entity is passed to
+  // the listener and dropped as soon as it is read, so memory use is bounded
+  // by the largest single entity whatever the file size. The file need not
+  // be opened first.
+  bool ReadStreaming(const std::string& filename,
+                     CXmlStreamListener* listener);
+  // Same as GetModelInfo, through ReadStreaming
+  bool GetModelInfoStreaming(const std::string& filename,
+                             XmlModelInfo& model_info);
+
+  // Same as GetModelInfo, through the compact read-only DOM, which takes a
+  // fraction of the memory of the usual one; see tinyxml2::XMLCompactDocument.
+  // The file need not be opened first.
+  bool GetModelInfoCompact(const std::string& filename,
+                           XmlModelInfo& model_info);
+
+  // Reads the faces straight into render-ready vertex and index buffers, one
+  // pass through the streaming reader without an XmlFaceInfo per face; see
+  // xmlrender.h. The file need not be opened first.
+  bool ReadRenderModel(const std::string& filename, XmlRenderModel& model);
+
   // XML modification functions
   void StartLayers();
   void StartGeometry();
@@ -147,48 +308,128 @@ class CXmlFile {
   void StartComponentDefinition(const std::string& name);
   void PopParentNode();
 
+  // Quantized output: the bounds of the face vertex positions and texture
+  // coordinates of the next component definition or model geometry, which
+  // set its dequantization parameters so that its faces are quantized as
+  // they are written. Call before StartComponentDefinition or StartGeometry.
+  // Vertices outside the bounds are clamped to them.
+  void SetQuantizationBounds(const XmlGeomUtils::CBoundingBox3d& bounds,
+                             const XmlGeomUtils::CBoundingBox3d& uv_bounds);
+
   void WriteHeader(int major_ver, int minor_ver, int build_no);
   void WriteLayerInfo(const XmlLayerInfo& info);
   void WriteMaterialInfo(const XmlMaterialInfo& info);
   void WriteEdgeInfo(const XmlEdgeInfo& info);
+  // Writes the edges as indexed line lists, one per layer and color
+  void WriteLineListInfo(const std::vector<XmlEdgeInfo>& edges);
   void WriteFaceInfo(const XmlFaceInfo& info);
   void WriteCurveInfo(const XmlCurveInfo& info);
   void WriteComponentInstanceInfo(const XmlComponentInstanceInfo& info);
   void WriteTransformation(const SUTransformation& transform);
 
  private:
+  void NewDocument(const std::string& filename, bool create_new_file);
+  // A tinyxml2::XMLDocument or tinyxml2::XMLCompactDocument
+  template <typename Document>
+  void PrepareDocument(Document& doc) const;
   tinyxml2::XMLElement* WriteStartTag(const char* tag);
   void WriteColor(const SUColor &color);
-
-  bool ReadHeader();
-  bool ReadColor(const tinyxml2::XMLNode* parent_node,
-                 const SUColor& color) const;
-
-  bool ReadLayers(const tinyxml2::XMLNode* parent_node,
+  void WriteText(const std::string& text);
+  void WriteEdgeStyle(const XmlEdgeInfo& info);
+  void WriteQuantizedVertices(const XmlFaceInfo& info,
+                              const XmlQuantizationInfo& quantization);
+  void WriteCoarseModel();
+  void WriteCoarseDefinition(const XmlCoarseDefinitionInfo& info,
+                             bool is_geometry);
+  void WriteBounds(const XmlGeomUtils::CBoundingBox3d& bounds);
+  void StartCoarseScope();
+  void StartQuantizationScope(bool is_geometry,
+                              const std::string& definition_name);
+  void FinishQuantizationScope();
+
+  // The readers take the nodes of either DOM: a const tinyxml2::XMLNode*, or
+  // a tinyxml2::XMLCompactNode, which has the same read functions
+  template <typename Node>
+  bool ReadHeader(Node node);
+  const XmlQuantizationInfo* FindQuantization(
+      bool is_geometry, const std::string& definition_name) const;
+  bool ReadIndexedElement(XmlIndexEntryType type, const std::string& name,
+                          tinyxml2::XMLDocument& doc) const;
+  bool ReadIndexedElement(const XmlIndexEntry& entry,
+                          tinyxml2::XMLDocument& doc) const;
+  bool ReadIndexedText(const XmlIndexEntry& entry,
+                       std::vector<char>& text) const;
+  bool ScanIndex(const XmlModelQuery& query);
+  bool ReadQueriedModelInfo(const XmlModelQuery& query,
+                            XmlModelInfo& model_info);
+  template <typename Node>
+  bool ReadColor(Node parent_node, const SUColor& color) const;
+  template <typename Node>
+  bool ReadModelInfo(Node doc_node, XmlModelInfo& model_info) const;
+
+  template <typename Node>
+  bool ReadLayers(Node parent_node,
                   std::vector<XmlLayerInfo>& layer_infos) const;
-  bool ReadLayerInfo(const tinyxml2::XMLNode* parent_node,
-                     XmlLayerInfo& info) const;
-  bool ReadMaterialInfo(const tinyxml2::XMLNode* parent_node,
-                        XmlMaterialInfo& info) const;
-  bool ReadMaterials(const tinyxml2::XMLNode* parent_node,
+  template <typename Node>
+  bool ReadLayerInfo(Node parent_node, XmlLayerInfo& info) const;
+  template <typename Node>
+  bool ReadMaterialInfo(Node parent_node, XmlMaterialInfo& info) const;
+  template <typename Node>
+  bool ReadMaterials(Node parent_node,
                      std::vector<XmlMaterialInfo>& mat_infos) const;
-  bool ReadComponentDefinitionInfo(const tinyxml2::XMLNode* parent_node,
+  template <typename Node>
+  bool ReadComponentDefinitionInfo(Node parent_node,
                                    bool readEntities,
                                    XmlComponentDefinitionInfo& info) const;
-  bool ReadComponentDefinitions(const tinyxml2::XMLNode* parent_node,
+  // The quantization is NULL unless the faces hold quantized vertices
+  template <typename Node>
+  bool ReadComponentDefinitions(Node parent_node,
                       std::vector<XmlComponentDefinitionInfo>& def_infos) const;
-  bool ReadEntities(const tinyxml2::XMLNode* parent_node,
+  template <typename Node>
+  bool ReadEntities(Node parent_node,
+                    const XmlQuantizationInfo* quantization,
                     XmlEntitiesInfo& entities) const;
-  bool ReadEdgeInfo(const tinyxml2::XMLNode* parent_node,
-                    XmlEdgeInfo& info) const;
-  bool ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
-                    XmlFaceInfo& info) const;
-  bool ReadCurveInfo(const tinyxml2::XMLNode* parent_node,
-                     XmlCurveInfo& info) const;
-  bool ReadTransformation(const tinyxml2::XMLNode* parent_node,
+  template <typename Node>
+  bool ReadEdgeInfo(Node parent_node, XmlEdgeInfo& info) const;
+  template <typename Node>
+  void ReadEdgeStyle(Node& child, XmlEdgeInfo& info) const;
+  template <typename Node>
+  bool ReadLineListInfo(Node parent_node,
+                        std::vector<XmlEdgeInfo>& edges) const;
+  // The face is an XmlFaceInfo, or an XmlRenderFace that passes the
+  // vertices on to a CXmlRenderBuilder as they are read
+  template <typename Node, typename Face>
+  bool ReadFaceInfo(Node parent_node,
+                    const XmlQuantizationInfo* quantization,
+                    Face& info) const;
+  template <typename Node, typename Face>
+  bool ReadQuantizedVertices(Node parent_node,
+                             const XmlQuantizationInfo& quantization,
+                             uint64_t num_vertices,
+                             Face& info) const;
+  template <typename Node>
+  bool ReadCurveInfo(Node parent_node, XmlCurveInfo& info) const;
+  template <typename Node>
+  bool ReadTransformation(Node parent_node,
                           SUTransformation& transform) const;
-  bool ReadComponentInstanceInfo(const tinyxml2::XMLNode* parent_node,
+  template <typename Node>
+  bool ReadComponentInstanceInfo(Node parent_node,
                                  XmlComponentInstanceInfo& info) const;
+  bool ReadCoarseModel(const tinyxml2::XMLNode* parent_node,
+                       XmlCoarseModelInfo& info) const;
+  bool ReadCoarseDefinition(const tinyxml2::XMLNode* parent_node,
+                            XmlCoarseDefinitionInfo& info) const;
+  bool ReadProgressiveChunk(uint64_t begin, uint64_t end);
+  // With a render builder, faces go to it instead of the listener and edges
+  // and curves are skipped
+  bool ReadStreaming(const std::string& filename,
+                     CXmlStreamListener* listener,
+                     CXmlRenderBuilder* render_builder);
+  bool ReadStreamingEntity(CXmlPullParser& parser,
+                           const XmlQuantizationInfo* quantization,
+                           tinyxml2::XMLDocument& doc,
+                           CXmlStreamListener* listener,
+                           CXmlRenderBuilder* render_builder) const;
 
  private:
   // Let TinyXML do the xml handling
@@ -198,6 +439,48 @@ class CXmlFile {
   // The path to the file to which we are writing
   std::string filename_;
   bool create_new_file_;
+
+  CXmlOptions options_;
+
+  // Byte offset index, written along with or read instead of the DOM
+  CXmlIndex index_;
+
+  // Quantized output: the bounds given for the next definition, and the
+  // dequantization parameters of the current one, which go in the header
+  // once it is finished if any face was written.
+  XmlGeomUtils::CBoundingBox3d quantization_bounds_;
+  XmlGeomUtils::CBoundingBox3d quantization_uv_bounds_;
+  tinyxml2::XMLNode* quantization_scope_;
+  bool quantization_scope_is_geometry_;
+  std::string quantization_scope_name_;
+  XmlQuantizationInfo quantization_;
+  bool quantization_has_uvs_;
+  bool quantization_has_faces_;
+
+  // Dequantization parameters read from the header, by definition name.
+  // The model geometry has its own entry.
+  bool has_quantization_;
+  std::map<std::string, XmlQuantizationInfo> definition_quantization_;
+  XmlQuantizationInfo geometry_quantization_;
+
+  XmlMeshCompressionStats compression_stats_;
+  XmlDeltaStats delta_stats_;
+  CXmlProfile profile_;
+
+  // Progressive output: the coarse model collected while writing, with the
+  // element of each open definition, geometry or group scope
+  CXmlCoarseBuilder coarse_builder_;
+  std::vector<tinyxml2::XMLNode*> coarse_scopes_;
+
+  // Progressive reading: the bytes from stream_offset_ on that may still be
+  // part of a chunk, and the chunk being read
+  CXmlProgressiveListener* listener_;
+  CXmlScanner scanner_;
+  std::string stream_buffer_;
+  uint64_t stream_offset_;
+  std::string stream_section_;
+  bool in_chunk_;
+  uint64_t chunk_offset_;
 };
 
 #endif // SKPTOXML_COMMON_XMLFILE_H
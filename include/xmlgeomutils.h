@@ -4,6 +4,7 @@
 #define SKPTOXML_COMMON_XMLGEOMUTILS_H
 
 #include <slapi/geometry.h>
+#include <slapi/transformation.h>
 
 // This module defines geometric classes that are useful in processing
 // the objects coming from SketchUp.
@@ -93,6 +94,41 @@ class CPoint3d {
   double z_;
 };
 
+// Bounding Box Class---------------------------------
+class CBoundingBox3d {
+ public:
+  CBoundingBox3d() : is_empty_(true) {}
+  ~CBoundingBox3d() {}
+
+  bool IsEmpty() const { return is_empty_; }
+  void Clear() { is_empty_ = true; }
+
+  void Add(const CPoint3d& pt);
+  void Add(const CBoundingBox3d& box);
+
+  const CPoint3d& min() const { return min_; }
+  const CPoint3d& max() const { return max_; }
+
+ protected:
+  bool is_empty_;
+  CPoint3d min_;
+  CPoint3d max_;
+};
+
+// Transformation Utilities---------------------------
+// SUTransformation values are column major, translation in values[12..14]
+CPoint3d TransformPoint(const SUTransformation& transform, const CPoint3d& pt);
+
+SUTransformation GetIdentityTransform();
+
+// Returns a * b, i.e. b is applied first
+SUTransformation MultiplyTransforms(const SUTransformation& a,
+                                    const SUTransformation& b);
+
+// Bounds of the transformed corners of the box
+CBoundingBox3d TransformBoundingBox(const SUTransformation& transform,
+                                    const CBoundingBox3d& box);
+
 } // end namespace XmlGeomUtils
 
 #endif // SKPTOXML_COMMON_XMLGEOMUTILS_H
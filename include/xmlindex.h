@@ -0,0 +1,83 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLINDEX_H
+#define SKPTOXML_COMMON_XMLINDEX_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "xmlprofile.h"
+
+// Forward declarations
+namespace tinyxml2 {
+  class XMLDocument;
+}
+
+// The byte offset index is a small sidecar file written next to the exported
+// xml file. It records where each top level section, component definition
+// and (optionally) group starts in the xml file and how long it is, so that
+// readers can seek straight to a single element instead of parsing the
+// whole file.
+
+enum XmlIndexEntryType {
+  XmlIndexEntryType_Section = 0,
+  XmlIndexEntryType_ComponentDefinition = 1,
+  XmlIndexEntryType_Group = 2
+};
+
+struct XmlIndexEntry {
+  XmlIndexEntry()
+    : type_(XmlIndexEntryType_Section), offset_(0), length_(0),
+      scope_type_(XmlIndexEntryType_Section) {}
+
+  XmlIndexEntryType type_;
+  // Section: the tag name, e.g. "Layers"
+  // Component definition: the definition name
+  // Group: the scope followed by the group ordinals, e.g. "Geometry/0/2" is
+  // the third group of the first group of the model geometry.
+  std::string name_;
+  // Byte range of the element in the xml file. The range may start with the
+  // indentation that precedes the element.
+  uint64_t offset_;
+  uint64_t length_;
+  // Group: what it belongs to, a component definition (the definition
+  // name) or the model geometry (a section, "Geometry"). Unused otherwise.
+  XmlIndexEntryType scope_type_;
+  std::string scope_name_;
+};
+
+class CXmlIndex {
+ public:
+  CXmlIndex() {}
+  ~CXmlIndex() {}
+
+  // Returns the sidecar file name for the given xml file name
+  static std::string GetIndexFilename(const std::string& xml_filename);
+
+  // Prints the document to the file while recording the byte ranges of its
+  // sections, component definitions and, if index_groups is set, groups.
+  // The size profile is recorded too if one is given.
+  bool PrintDocument(const tinyxml2::XMLDocument& doc, FILE* fp,
+                     bool index_groups, CXmlProfile* profile = NULL);
+
+  bool Read(const std::string& filename);
+  bool Write(const std::string& filename) const;
+  void Clear() { entries_.clear(); }
+
+  void AddEntry(const XmlIndexEntry& entry) { entries_.push_back(entry); }
+
+  // Returns NULL if there is no such entry
+  const XmlIndexEntry* FindEntry(XmlIndexEntryType type,
+                                 const std::string& name) const;
+
+  const std::vector<XmlIndexEntry>& entries() const { return entries_; }
+  bool empty() const { return entries_.empty(); }
+
+ private:
+  // Entries are kept sorted by offset
+  std::vector<XmlIndexEntry> entries_;
+};
+
+#endif // SKPTOXML_COMMON_XMLINDEX_H
@@ -0,0 +1,110 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLMANIFEST_H
+#define SKPTOXML_COMMON_XMLMANIFEST_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Forward declarations
+namespace tinyxml2 {
+  class XMLDocument;
+  class XMLElement;
+}
+
+// The manifest is a sidecar file written next to the exported xml file. It
+// holds a content hash of every layer, material, component definition and
+// model geometry group, so that the next export of the same model can write
+// a delta: only the items whose hash changed, plus deletion markers for the
+// items that are gone.
+//
+// In a delta file:
+//  - the header has delta="1" and keeps only the quantization parameters
+//    of the definitions written
+//  - Layers, Materials and ComponentDefinitions hold the new and changed
+//    items and <Deleted Name="..."/> for the removed ones
+//  - Geometry has Entities="1" if its own entities changed, in which case
+//    they are all written. Changed groups are written as direct children of
+//    Geometry with a Path attribute (see XmlIndexEntry for the group paths)
+//    and removed groups as <Deleted Path="..."/>. A group whose own entities
+//    are unchanged is not written; only its changed groups are.
+// ApplyDelta turns the previous full export and a delta into the new full
+// export.
+
+enum XmlManifestEntryType {
+  XmlManifestEntryType_Layer = 0,
+  XmlManifestEntryType_Material = 1,
+  XmlManifestEntryType_ComponentDefinition = 2,
+  XmlManifestEntryType_Geometry = 3,
+  XmlManifestEntryType_Group = 4
+};
+
+struct XmlManifestEntry {
+  XmlManifestEntry()
+    : type_(XmlManifestEntryType_Layer), hash_(0), own_hash_(0) {}
+
+  XmlManifestEntryType type_;
+  // Layer, material and definition name, group path, empty for the geometry
+  std::string name_;
+  // Hash of the whole element
+  uint64_t hash_;
+  // Geometry and groups: hash of the element without its groups. Otherwise
+  // the same as hash_.
+  uint64_t own_hash_;
+};
+
+struct XmlDeltaStats {
+  XmlDeltaStats() : changed_(0), deleted_(0), unchanged_(0) {}
+
+  size_t changed_;
+  size_t deleted_;
+  size_t unchanged_;
+};
+
+class CXmlManifest {
+ public:
+  CXmlManifest() {}
+  ~CXmlManifest() {}
+
+  // Returns the sidecar file name for the given xml file name
+  static std::string GetManifestFilename(const std::string& xml_filename);
+
+  // Hashes the items of a full export
+  void Build(const tinyxml2::XMLDocument& doc);
+
+  // Turns the full export the manifest was built from into a delta against
+  // the previous manifest
+  XmlDeltaStats PruneDocument(tinyxml2::XMLDocument& doc,
+                              const CXmlManifest& previous) const;
+
+  // Writes the new full export, given the previous full export and a delta
+  static bool ApplyDelta(const std::string& xml_filename,
+                         const std::string& delta_filename,
+                         const std::string& out_filename);
+
+  bool Read(const std::string& filename);
+  bool Write(const std::string& filename) const;
+  void Clear() { entries_.clear(); }
+
+  // Returns NULL if there is no such entry
+  const XmlManifestEntry* FindEntry(XmlManifestEntryType type,
+                                    const std::string& name) const;
+
+  const std::vector<XmlManifestEntry>& entries() const { return entries_; }
+  bool empty() const { return entries_.empty(); }
+
+ private:
+  uint64_t AddGroups(const tinyxml2::XMLElement* parent,
+                     const std::string& path, uint64_t seed);
+  void PruneGroups(tinyxml2::XMLElement* parent, const std::string& path,
+                   const CXmlManifest& previous,
+                   std::vector<tinyxml2::XMLElement*>& changed_groups,
+                   std::vector<std::string>& changed_paths,
+                   XmlDeltaStats& stats) const;
+
+  // Entries are kept sorted by type and name
+  std::vector<XmlManifestEntry> entries_;
+};
+
+#endif // SKPTOXML_COMMON_XMLMANIFEST_H
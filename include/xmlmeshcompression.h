@@ -0,0 +1,60 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLMESHCOMPRESSION_H
+#define SKPTOXML_COMMON_XMLMESHCOMPRESSION_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Compressed encoding of a quantized triangle list. The corners are merged
+// into unique vertices and the mesh is coded as:
+//  - connectivity: each corner is either the next new vertex or a zigzag
+//    delta from the previous corner's vertex
+//  - attributes: each new vertex as a zigzag delta from the previous new
+//    vertex, component by component
+// Both streams are varints, entropy coded with an adaptive binary range
+// coder using a separate model per stream and per attribute component.
+//
+// Payload layout: number of unique vertices (varint), then the range coded
+// data.
+
+namespace XmlMeshCompression {
+
+// Each corner is stride quantized values, e.g. 3 position and 2 normal
+// values. num_corners is a multiple of three.
+void Encode(const std::vector<uint32_t>& corners, size_t stride,
+            std::string& payload);
+bool Decode(const std::string& payload, size_t stride, uint64_t num_corners,
+            std::vector<uint32_t>& corners);
+
+} // end namespace XmlMeshCompression
+
+// Totals over the compressed meshes of a file
+struct XmlMeshCompressionStats {
+  XmlMeshCompressionStats() : triangles_(0), bytes_(0) {}
+
+  uint64_t triangles_;
+  uint64_t bytes_;
+};
+
+// Decode time of the compressed meshes of a file, see
+// CXmlFile::BenchmarkMeshDecoding
+struct XmlMeshDecodeBenchmarkInfo {
+  XmlMeshDecodeBenchmarkInfo()
+    : passes_(0), meshes_(0), triangles_(0), bytes_(0), seconds_(0.0),
+      failures_(0) {}
+
+  size_t passes_;
+  // Each pass decodes these meshes, holding this many triangles and bytes of
+  // base64 text
+  size_t meshes_;
+  uint64_t triangles_;
+  uint64_t bytes_;
+  // Of all the passes
+  double seconds_;
+  // Meshes that did not decode
+  size_t failures_;
+};
+
+#endif // SKPTOXML_COMMON_XMLMESHCOMPRESSION_H
@@ -3,15 +3,41 @@
 #ifndef SKPTOXML_COMMON_XMLOPTIONS_H
 #define SKPTOXML_COMMON_XMLOPTIONS_H
 
+#include <string>
+
 class CXmlOptions {
  public:
   CXmlOptions(void) {
    export_materials_ = true;
    export_faces_ = true;
    export_edges_ = true;
+   export_normals_ = true;
+   export_front_uvs_ = true;
+   export_back_uvs_ = true;
+   export_standalone_edges_ = true;
+   export_curves_ = true;
+   export_instance_transforms_ = true;
    export_materials_by_layer_ = false;
    export_layers_ = true;
    export_options_ = false;
+   export_index_ = false;
+   export_index_groups_ = false;
+   export_line_lists_ = false;
+   export_quantized_ = false;
+   export_quantized_binary_ = false;
+   export_compressed_ = false;
+   export_progressive_ = false;
+   export_tiles_ = false;
+   export_manifest_ = false;
+   export_profile_ = false;
+   async_output_ = true;
+   quantization_tolerance_ = 0.001;
+   tile_max_triangles_ = 65536;
+   profile_top_definitions_ = 10;
+   spatial_benchmark_queries_ = 0;
+   decode_benchmark_passes_ = 0;
+   max_group_depth_ = 0;
+   max_element_depth_ = 10000;
   }
 
   virtual ~CXmlOptions(void) {}
@@ -25,6 +51,35 @@ class CXmlOptions {
   inline bool export_edges() const { return export_edges_; }
   inline void set_export_edges(bool value) { export_edges_ = value; }
 
+  // Channels that can be left out of the export, in which case the SDK is
+  // not asked for them either. Stand-alone edges and curves also need
+  // export_edges.
+  inline bool export_normals() const { return export_normals_; }
+  inline void set_export_normals(bool value) { export_normals_ = value; }
+
+  inline bool export_front_uvs() const { return export_front_uvs_; }
+  inline void set_export_front_uvs(bool value) { export_front_uvs_ = value; }
+
+  inline bool export_back_uvs() const { return export_back_uvs_; }
+  inline void set_export_back_uvs(bool value) { export_back_uvs_ = value; }
+
+  inline bool export_standalone_edges() const {
+      return export_standalone_edges_;
+  }
+  inline void set_export_standalone_edges(bool value) {
+      export_standalone_edges_ = value;
+  }
+
+  inline bool export_curves() const { return export_curves_; }
+  inline void set_export_curves(bool value) { export_curves_ = value; }
+
+  inline bool export_instance_transforms() const {
+      return export_instance_transforms_;
+  }
+  inline void set_export_instance_transforms(bool value) {
+      export_instance_transforms_ = value;
+  }
+
   inline bool export_materials_by_layer() const {
       return export_materials_by_layer_;
   }
@@ -38,13 +93,142 @@ class CXmlOptions {
   inline bool export_options() const { return export_options_; }
   inline void set_export_options(bool value) { export_options_ = value; }
 
+  // Byte offset index sidecar, optionally including every group
+  inline bool export_index() const { return export_index_; }
+  inline void set_export_index(bool value) { export_index_ = value; }
+
+  inline bool export_index_groups() const { return export_index_groups_; }
+  inline void set_export_index_groups(bool value) {
+      export_index_groups_ = value;
+  }
+
+  // Write curves as polylines and stand-alone edges as indexed line lists
+  inline bool export_line_lists() const { return export_line_lists_; }
+  inline void set_export_line_lists(bool value) { export_line_lists_ = value; }
+
+  // Quantized face vertices, as text or base64 binary. Positions are kept
+  // within the tolerance (in inches).
+  inline bool export_quantized() const { return export_quantized_; }
+  inline void set_export_quantized(bool value) { export_quantized_ = value; }
+
+  inline bool export_quantized_binary() const {
+      return export_quantized_binary_;
+  }
+  inline void set_export_quantized_binary(bool value) {
+      export_quantized_binary_ = value;
+  }
+
+  // Quantized faces as entropy coded meshes
+  inline bool export_compressed() const { return export_compressed_; }
+  inline void set_export_compressed(bool value) { export_compressed_ = value; }
+
+  // Write a coarse model ahead of the full detail definitions and geometry
+  inline bool export_progressive() const { return export_progressive_; }
+  inline void set_export_progressive(bool value) {
+      export_progressive_ = value;
+  }
+
+  // Also write the world space geometry as an octree of tile files
+  inline bool export_tiles() const { return export_tiles_; }
+  inline void set_export_tiles(bool value) { export_tiles_ = value; }
+
+  inline int tile_max_triangles() const { return tile_max_triangles_; }
+  inline void set_tile_max_triangles(int value) {
+      tile_max_triangles_ = value;
+  }
+
+  // Content hash manifest sidecar. If the manifest of a previous export is
+  // given, only what changed since then is written.
+  inline bool export_manifest() const { return export_manifest_; }
+  inline void set_export_manifest(bool value) { export_manifest_ = value; }
+
+  inline const std::string& delta_manifest() const { return delta_manifest_; }
+  inline void set_delta_manifest(const std::string& value) {
+      delta_manifest_ = value;
+  }
+
+  // Output size report, listing the given number of largest definitions
+  inline bool export_profile() const { return export_profile_; }
+  inline void set_export_profile(bool value) { export_profile_ = value; }
+
+  inline int profile_top_definitions() const {
+      return profile_top_definitions_;
+  }
+  inline void set_profile_top_definitions(int value) {
+      profile_top_definitions_ = value;
+  }
+
+  // Time this many spatial index queries of each kind on the written file
+  // against brute force, 0 for none
+  inline int spatial_benchmark_queries() const {
+      return spatial_benchmark_queries_;
+  }
+  inline void set_spatial_benchmark_queries(int value) {
+      spatial_benchmark_queries_ = value;
+  }
+
+  // Time this many decodes of the compressed meshes of the written file,
+  // 0 for none
+  inline int decode_benchmark_passes() const {
+      return decode_benchmark_passes_;
+  }
+  inline void set_decode_benchmark_passes(int value) {
+      decode_benchmark_passes_ = value;
+  }
+
+  // Write the output files in the background while they are printed
+  inline bool async_output() const { return async_output_; }
+  inline void set_async_output(bool value) { async_output_ = value; }
+
+  // Groups nested deeper than this are left out of the export, 0 for no
+  // limit. The export does not recurse, so nothing is left out unless asked
+  // for; files nested deeper than max_element_depth fail to load instead.
+  inline int max_group_depth() const { return max_group_depth_; }
+  inline void set_max_group_depth(int value) { max_group_depth_ = value; }
+
+  // Files read with elements nested deeper than this fail to load
+  inline int max_element_depth() const { return max_element_depth_; }
+  inline void set_max_element_depth(int value) { max_element_depth_ = value; }
+
+  inline double quantization_tolerance() const {
+      return quantization_tolerance_;
+  }
+  inline void set_quantization_tolerance(double value) {
+      quantization_tolerance_ = value;
+  }
+
  private:
   bool export_materials_;
   bool export_faces_;
   bool export_edges_;
+  bool export_normals_;
+  bool export_front_uvs_;
+  bool export_back_uvs_;
+  bool export_standalone_edges_;
+  bool export_curves_;
+  bool export_instance_transforms_;
   bool export_materials_by_layer_;
   bool export_layers_;
   bool export_options_;
+  bool export_index_;
+  bool export_index_groups_;
+  bool export_line_lists_;
+  bool export_quantized_;
+  bool export_quantized_binary_;
+  bool export_compressed_;
+  bool export_progressive_;
+  bool export_tiles_;
+  bool export_manifest_;
+  std::string delta_manifest_;
+  bool export_profile_;
+  bool async_output_;
+  double quantization_tolerance_;
+  int tile_max_triangles_;
+  int profile_top_definitions_;
+  int spatial_benchmark_queries_;
+  int decode_benchmark_passes_;
+  int max_group_depth_;
+  int max_element_depth_;
 };
 
 #endif // SKPTOXML_COMMON_XMLOPTIONS_H
@@ -0,0 +1,92 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLPROFILE_H
+#define SKPTOXML_COMMON_XMLPROFILE_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <map>
+#include <string>
+#include <vector>
+
+// Forward declarations
+namespace tinyxml2 {
+  class XMLDocument;
+  class XMLElement;
+}
+
+// The size profile breaks the bytes of a written file down by tag name, by
+// top level section and by component definition, so that format decisions
+// can be based on where the bytes actually go. It is recorded while the
+// document is printed, from the printer's byte count, so it matches the
+// file exactly. An element's bytes include the indentation before it.
+
+struct XmlProfileCounts {
+  XmlProfileCounts() : bytes_(0), elements_(0), attributes_(0) {}
+
+  uint64_t bytes_;
+  uint64_t elements_;
+  uint64_t attributes_;
+};
+
+typedef std::map<std::string, XmlProfileCounts> XmlProfileCountsMap;
+
+class CXmlProfile {
+ public:
+  CXmlProfile() {}
+  ~CXmlProfile() {}
+
+  // Returns the report file name for the given xml file name
+  static std::string GetReportFilename(const std::string& xml_filename);
+
+  // Prints the document to the file while recording the profile
+  bool PrintDocument(const tinyxml2::XMLDocument& doc, FILE* fp);
+
+  // Called by the printers around each element, with the number of bytes
+  // printed so far
+  void BeginElement(const tinyxml2::XMLElement& element, uint64_t offset);
+  void EndElement(uint64_t offset);
+  // Called once the whole document is printed
+  void EndDocument(uint64_t offset);
+
+  // Writes a text report, listing the top_definitions largest definitions
+  bool WriteReport(const std::string& filename, size_t top_definitions) const;
+
+  void Clear();
+
+  // Per tag name, the bytes of the elements themselves, without their child
+  // elements, so the tag bytes add up to the file size
+  const XmlProfileCountsMap& tags() const { return tags_; }
+  // Per top level section and per component definition, including all the
+  // contents
+  const XmlProfileCountsMap& sections() const { return sections_; }
+  const XmlProfileCountsMap& definitions() const { return definitions_; }
+  const XmlProfileCounts& total() const { return total_; }
+
+  // The definitions sorted by decreasing size, at most count of them
+  void GetTopDefinitions(
+      size_t count,
+      std::vector<std::pair<std::string, XmlProfileCounts> >& top) const;
+
+ private:
+  struct OpenElement {
+    std::string tag_;
+    bool is_definition_;
+    std::string definition_name_;
+    uint64_t offset_;
+    uint64_t child_bytes_;
+    // Including the contents
+    uint64_t elements_;
+    uint64_t attributes_;
+    // Of the element itself
+    uint64_t own_attributes_;
+  };
+
+  std::vector<OpenElement> open_elements_;
+  XmlProfileCountsMap tags_;
+  XmlProfileCountsMap sections_;
+  XmlProfileCountsMap definitions_;
+  XmlProfileCounts total_;
+};
+
+#endif // SKPTOXML_COMMON_XMLPROFILE_H
@@ -0,0 +1,143 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLPROGRESSIVE_H
+#define SKPTOXML_COMMON_XMLPROGRESSIVE_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <slapi/transformation.h>
+
+#include "xmlgeomutils.h"
+
+// Progressive output writes a coarse representation of the whole model
+// ahead of the full detail component definitions and geometry: the bounds
+// of every definition, group and instance and a heavily simplified mesh of
+// every definition. Viewers can show the coarse model as soon as it has
+// arrived and then apply the definitions and geometry entities one by one.
+
+struct XmlCoarseMeshInfo {
+  std::vector<XmlGeomUtils::CPoint3d> points_;
+  // Three point indices per triangle
+  std::vector<uint32_t> indices_;
+};
+
+struct XmlCoarseInstanceInfo {
+  std::string definition_name_;
+  // Relative to the definition (or model) containing the instance, including
+  // the transformations of any groups in between
+  SUTransformation transform_;
+  // Bounds in the containing definition's coordinates
+  XmlGeomUtils::CBoundingBox3d bounds_;
+};
+
+// A component definition, or the model geometry when the name is empty
+struct XmlCoarseDefinitionInfo {
+  std::string name_;
+  // Includes the nested groups and instances
+  XmlGeomUtils::CBoundingBox3d bounds_;
+  // Faces of the definition and of its groups
+  XmlCoarseMeshInfo mesh_;
+  // Bounds of the groups directly in the definition
+  std::vector<XmlGeomUtils::CBoundingBox3d> group_bounds_;
+  // All the instances in the definition and its groups
+  std::vector<XmlCoarseInstanceInfo> instances_;
+};
+
+struct XmlCoarseModelInfo {
+  std::vector<XmlCoarseDefinitionInfo> definitions_;
+  XmlCoarseDefinitionInfo geometry_;
+};
+
+// Collects the coarse model while the full model is being written. Scopes
+// are the component definitions, the model geometry and the groups within
+// them; group faces are moved into the enclosing definition once the group
+// transformation is known.
+class CXmlCoarseBuilder {
+ public:
+  CXmlCoarseBuilder() {}
+  ~CXmlCoarseBuilder() {}
+
+  void BeginDefinition(const std::string& name);
+  void BeginGeometry();
+  void BeginGroup();
+  void EndScope();
+
+  void AddTriangle(const XmlGeomUtils::CPoint3d& pt1,
+                   const XmlGeomUtils::CPoint3d& pt2,
+                   const XmlGeomUtils::CPoint3d& pt3);
+  void AddPoint(const XmlGeomUtils::CPoint3d& pt);
+  void AddInstance(const std::string& definition_name,
+                   const SUTransformation& transform);
+  void SetGroupTransform(const SUTransformation& transform);
+
+  // Resolves the instance bounds, which may refer to definitions written
+  // after the instance
+  void GetCoarseModel(XmlCoarseModelInfo& info) const;
+
+  void Clear();
+
+  // Vertex clustering: vertices in the same cell of a grid with num_cells
+  // cells along the longest side of the bounds are merged into their average
+  // and triangles that lose a corner in the process are dropped
+  static void SimplifyMesh(
+      const std::vector<XmlGeomUtils::CPoint3d>& triangles,
+      const XmlGeomUtils::CBoundingBox3d& bounds, int num_cells,
+      XmlCoarseMeshInfo& mesh);
+
+ private:
+  struct Instance {
+    std::string definition_name_;
+    SUTransformation transform_;
+  };
+
+  // A group, flattened into its own coordinates
+  struct Group {
+    XmlGeomUtils::CBoundingBox3d bounds_;
+    std::vector<Instance> instances_;
+    SUTransformation transform_;
+  };
+
+  struct Scope {
+    Scope()
+      : is_group_(false), is_geometry_(false),
+        transform_(XmlGeomUtils::GetIdentityTransform()) {}
+
+    bool is_group_;
+    bool is_geometry_;
+    std::string name_;
+    XmlGeomUtils::CBoundingBox3d bounds_;
+    std::vector<XmlGeomUtils::CPoint3d> triangles_;
+    std::vector<Instance> instances_;
+    std::vector<Group> groups_;
+    SUTransformation transform_;
+  };
+
+  struct Definition {
+    XmlGeomUtils::CBoundingBox3d bounds_;
+    XmlCoarseMeshInfo mesh_;
+    std::vector<Instance> instances_;
+    std::vector<Group> groups_;
+  };
+
+  void BeginScope(bool is_group, bool is_geometry, const std::string& name);
+  XmlGeomUtils::CBoundingBox3d GetDefinitionBounds(
+      const std::string& name,
+      std::map<std::string, XmlGeomUtils::CBoundingBox3d>& resolved) const;
+  XmlGeomUtils::CBoundingBox3d GetInstanceBounds(
+      const Instance& instance,
+      std::map<std::string, XmlGeomUtils::CBoundingBox3d>& resolved) const;
+  void GetDefinitionInfo(
+      const Definition& definition,
+      std::map<std::string, XmlGeomUtils::CBoundingBox3d>& resolved,
+      XmlCoarseDefinitionInfo& info) const;
+
+  std::vector<Scope> scopes_;
+  std::map<std::string, Definition> definitions_;
+  std::vector<std::string> definition_order_;
+  Definition geometry_;
+};
+
+#endif // SKPTOXML_COMMON_XMLPROGRESSIVE_H
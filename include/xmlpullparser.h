@@ -0,0 +1,100 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLPULLPARSER_H
+#define SKPTOXML_COMMON_XMLPULLPARSER_H
+
+#include <stdint.h>
+#include <cstdio>
+#include <string>
+#include <utility>
+#include <vector>
+
+// The pull parser reads an xml file front to back in fixed size blocks and
+// reports its start and end tags one at a time, without building a DOM.
+// Text, comments, processing instructions, declarations and CDATA sections
+// are skipped. Only the open element names are kept, up to max_depth() of
+// them, so memory use does not depend on the file size.
+//
+// An element that has just started can instead be captured whole, its
+// text then stays in the buffer until the next call, or skipped.
+
+enum XmlPullEventType {
+  XmlPullEventType_Start = 0,
+  XmlPullEventType_End = 1
+};
+
+class CXmlPullParser {
+ public:
+  static const int kMaxDepth = 256;
+
+  explicit CXmlPullParser(size_t block_size = 64 * 1024);
+  ~CXmlPullParser();
+
+  bool Open(const std::string& filename);
+  void Close();
+
+  // Deeper elements are an error, kMaxDepth by default
+  int max_depth() const { return max_depth_; }
+  void set_max_depth(int depth) { max_depth_ = depth; }
+
+  // Moves to the next start or end tag. An empty element tag gives a start
+  // and an end event. Returns false at the end of the file or on an error.
+  bool Next();
+
+  // Of the current event
+  XmlPullEventType type() const { return type_; }
+  const std::string& name() const { return name_; }
+  // 0 for top level elements
+  int depth() const { return depth_; }
+  // Start events only, NULL if the element has no such attribute
+  const char* Attribute(const char* name) const;
+
+  // Consumes the element that just started, up to and including its end
+  // tag, and returns its text. The text is valid until the next call. The
+  // element's own events, including its end event, are not reported.
+  bool ReadElement(const char*& text, size_t& length);
+  // Consumes the element that just started, without keeping its text
+  bool SkipElement();
+
+  // True once the whole file was read with all its elements closed
+  bool at_end() const { return at_end_; }
+  bool error() const { return error_; }
+
+ private:
+  bool Fill(size_t count);
+  bool ParseTag();
+  bool ParseStartTag();
+  bool ParseEndTag();
+  bool SkipMarkup();
+  bool SkipUntil(const char* terminator);
+  bool SkipToElementEnd();
+  bool ParseName(std::string& name);
+  void SkipSpace();
+  static void Unescape(const std::string& text, std::string& value);
+
+  FILE* fp_;
+  size_t block_size_;
+  int max_depth_;
+  std::vector<char> buffer_;
+  // Parse position and end of the valid bytes in the buffer
+  size_t pos_;
+  size_t end_;
+  // Bytes from here on are kept when the buffer is refilled
+  size_t keep_;
+  bool pinned_;
+  bool eof_;
+
+  XmlPullEventType type_;
+  std::string name_;
+  int depth_;
+  std::vector<std::pair<std::string, std::string> > attributes_;
+  size_t num_attributes_;
+  // Where the current start tag begins, in the buffer
+  size_t tag_start_;
+  bool pending_end_;
+  std::vector<std::string> open_elements_;
+  bool at_end_;
+  bool error_;
+};
+
+#endif // SKPTOXML_COMMON_XMLPULLPARSER_H
@@ -0,0 +1,75 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLQUANTIZATION_H
+#define SKPTOXML_COMMON_XMLQUANTIZATION_H
+
+#include <stdint.h>
+#include <string>
+
+#include "xmlgeomutils.h"
+
+// Quantized encoding of the face vertex channels:
+//  - positions are 32-bit fixed point offsets from the minimum corner of the
+//    bounding box of their component definition (or of the model geometry),
+//    in steps of at most the user chosen tolerance
+//  - normals are octahedral encoded into two 16-bit values
+//  - texture coordinates are normalized to 16 bits over the range used by
+//    the definition
+// The dequantization parameters of each definition are written in the file
+// header so that a single definition can be decoded on its own.
+
+namespace XmlQuantization {
+
+const uint32_t kMaxPosition = 0xffffffff;
+const uint16_t kMaxUnit = 0xffff;
+
+// Returns the fixed point step covering the given extent with at most
+// kMaxPosition steps, but no coarser than needed for the tolerance
+double GetPositionStep(double extent, double tolerance);
+
+uint32_t QuantizePosition(double value, double origin, double step);
+double DequantizePosition(uint32_t value, double origin, double step);
+
+// Maps a value in [min, max] to [0, kMaxUnit] and back
+uint16_t QuantizeUnit(double value, double min, double max);
+double DequantizeUnit(uint16_t value, double min, double max);
+
+// Octahedral normal encoding
+void EncodeNormal(const XmlGeomUtils::CVector3d& normal,
+                  uint16_t& u, uint16_t& v);
+XmlGeomUtils::CVector3d DecodeNormal(uint16_t u, uint16_t v);
+
+// Base64 text for binary payloads
+std::string EncodeBase64(const std::string& data);
+bool DecodeBase64(const char* text, std::string& data);
+
+} // end namespace XmlQuantization
+
+// How the quantized channels are stored
+enum XmlQuantizationEncoding {
+  // Whitespace separated integers
+  XmlQuantizationEncoding_Text = 0,
+  // Base64 encoded little endian values
+  XmlQuantizationEncoding_Binary = 1,
+  // Base64 encoded compressed mesh, see xmlmeshcompression.h
+  XmlQuantizationEncoding_Compressed = 2
+};
+
+// Dequantization parameters of a component definition or of the model
+// geometry
+struct XmlQuantizationInfo {
+  XmlQuantizationInfo()
+    : encoding_(XmlQuantizationEncoding_Text), step_(0.0),
+      min_u_(0.0), min_v_(0.0), max_u_(0.0), max_v_(0.0) {}
+
+  XmlQuantizationEncoding encoding_;
+  XmlGeomUtils::CPoint3d origin_;
+  double step_;
+  // Texture coordinate range, shared by front and back
+  double min_u_;
+  double min_v_;
+  double max_u_;
+  double max_v_;
+};
+
+#endif // SKPTOXML_COMMON_XMLQUANTIZATION_H
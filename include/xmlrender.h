@@ -0,0 +1,159 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLRENDER_H
+#define SKPTOXML_COMMON_XMLRENDER_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <slapi/transformation.h>
+
+#include "xmlfile.h"
+
+// Render-ready model: the faces of every component definition, of the model
+// geometry and of every group as interleaved float vertex buffers with index
+// buffers, one pair per front material, ready to be uploaded as they are.
+// Edges are not part of it, and neither are faces given as a single loop,
+// which would need triangulating.
+
+struct XmlRenderVertex {
+  float position_[3];
+  // 0 if the normals were left out of the export
+  float normal_[3];
+  // Front texture coordinates, 0 without a front texture
+  float uv_[2];
+};
+
+// The triangles of a mesh drawn with one front material
+struct XmlRenderBatch {
+  // Empty for the default material
+  std::string material_name_;
+  std::vector<XmlRenderVertex> vertices_;
+  // Three vertex indices per triangle. Corners that are the same within a
+  // face share a vertex.
+  std::vector<uint32_t> indices_;
+};
+
+struct XmlRenderInstance {
+  std::string definition_name_;
+  // Relative to the mesh the instance is in
+  SUTransformation transform_;
+};
+
+enum XmlRenderMeshType {
+  XmlRenderMeshType_Definition = 0,
+  XmlRenderMeshType_Geometry = 1,
+  XmlRenderMeshType_Group = 2
+};
+
+struct XmlRenderMesh {
+  static const size_t kNoParent = static_cast<size_t>(-1);
+
+  XmlRenderMesh() : type_(XmlRenderMeshType_Geometry), parent_(kNoParent) {}
+
+  XmlRenderMeshType type_;
+  // Of a component definition
+  std::string definition_name_;
+  // A group is a mesh of its own, placed in its parent mesh by its
+  // transformation
+  size_t parent_;
+  SUTransformation transform_;
+  std::vector<XmlRenderBatch> batches_;
+  std::vector<XmlRenderInstance> instances_;
+};
+
+struct XmlRenderModel {
+  std::vector<XmlMaterialInfo> materials_;
+  // In file order; a group follows the mesh it is in
+  std::vector<XmlRenderMesh> meshes_;
+};
+
+class CXmlRenderBuilder;
+
+// Stands in for XmlFaceInfo when CXmlFile reads a face for rendering: the
+// vertices go straight into the batch of the face's front material instead
+// of being kept. Only the members the face reader uses are here.
+struct XmlRenderFace {
+  class Vertices {
+   public:
+    explicit Vertices(XmlRenderFace& face) : face_(face), count_(0) {}
+
+    // Batches grow by doubling, reserving a face at a time would not
+    void reserve(size_t /*count*/) {}
+    void push_back(const XmlFaceVertex& vertex);
+    size_t size() const { return count_; }
+
+   private:
+    XmlRenderFace& face_;
+    size_t count_;
+  };
+
+  explicit XmlRenderFace(CXmlRenderBuilder& builder)
+    : has_front_texture_(false),
+      has_back_texture_(false),
+      has_normals_(true),
+      has_single_loop_(false),
+      vertices_(*this),
+      builder_(builder) {}
+
+  std::string layer_name_;
+  std::string front_mat_name_;
+  std::string back_mat_name_;
+  bool has_front_texture_;
+  bool has_back_texture_;
+  bool has_normals_;
+  bool has_single_loop_;
+  Vertices vertices_;
+  CXmlRenderBuilder& builder_;
+};
+
+// Collects the render model from the streaming reader, see
+// CXmlFile::ReadRenderModel. Faces passed to OnFace are added as well.
+class CXmlRenderBuilder : public CXmlStreamListener {
+ public:
+  explicit CXmlRenderBuilder(XmlRenderModel& model);
+
+  virtual void OnMaterial(XmlMaterialInfo& info);
+  virtual void OnBeginComponentDefinition(const std::string& name);
+  virtual void OnEndComponentDefinition();
+  virtual void OnBeginGeometry();
+  virtual void OnEndGeometry();
+  virtual void OnBeginGroup();
+  virtual void OnEndGroup(const SUTransformation& transform);
+  virtual void OnComponentInstance(XmlComponentInstanceInfo& info);
+  virtual void OnFace(XmlFaceInfo& info);
+
+  // The corners of a face's triangles, three at a time, into the batch of
+  // the material in the open mesh
+  void BeginFace(const std::string& material_name);
+  void AddVertex(const XmlFaceVertex& vertex, bool has_normal,
+                 bool has_texture);
+
+ private:
+  struct VertexHash {
+    size_t operator()(const XmlRenderVertex& vertex) const;
+  };
+  struct VertexEqual {
+    bool operator()(const XmlRenderVertex& a, const XmlRenderVertex& b) const;
+  };
+
+  // A mesh being read and the index of each material's batch in it
+  struct OpenMesh {
+    size_t mesh_;
+    std::map<std::string, size_t> batches_;
+  };
+
+  void BeginMesh(XmlRenderMeshType type, const std::string& name);
+
+  XmlRenderModel& model_;
+  std::vector<OpenMesh> meshes_;
+  // The batch the face being read goes into, and its vertices so far
+  XmlRenderBatch* batch_;
+  std::unordered_map<XmlRenderVertex, uint32_t, VertexHash, VertexEqual>
+      face_vertices_;
+};
+
+#endif // SKPTOXML_COMMON_XMLRENDER_H
@@ -0,0 +1,85 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLSCANNER_H
+#define SKPTOXML_COMMON_XMLSCANNER_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// The scanner finds where elements start and end in xml text by counting
+// tag depth, without building a DOM. Comments, processing instructions,
+// CDATA sections and quoted attribute values are skipped, so a '<' or '>'
+// inside them is not mistaken for a tag.
+//
+// Scanning is resumable: the text may be given in pieces of any size, e.g.
+// as it arrives over the network, and offsets count from the first byte
+// ever given to the scanner.
+
+enum XmlScanEventType {
+  XmlScanEventType_Start = 0,
+  XmlScanEventType_End = 1
+};
+
+struct XmlScanEvent {
+  XmlScanEvent() : type_(XmlScanEventType_Start), depth_(0), offset_(0) {}
+
+  XmlScanEventType type_;
+  // 0 for top level elements
+  int depth_;
+  // Start: the offset of the '<' of the start tag
+  // End: the offset just past the '>' of the end tag (or of an empty tag)
+  uint64_t offset_;
+  // Element name, start events only
+  std::string name_;
+};
+
+class CXmlScanner {
+ public:
+  // Events are only reported for elements at depth max_depth or less
+  explicit CXmlScanner(int max_depth);
+  ~CXmlScanner() {}
+
+  // Appends the events found in the next piece of text. Returns false on
+  // unbalanced end tags; the scanner does not check tag names.
+  bool Scan(const char* data, size_t length,
+            std::vector<XmlScanEvent>& events);
+
+  void Reset();
+
+  // Depth of the next element to start, i.e. the number of open elements
+  int depth() const { return depth_; }
+  // Total number of bytes scanned
+  uint64_t offset() const { return offset_; }
+  // Offset of the first byte later events may refer to: the start of a tag
+  // that is still being scanned, or else offset()
+  uint64_t pending_offset() const {
+    return state_ == State_Text ? offset_ : tag_offset_;
+  }
+
+ private:
+  enum State {
+    State_Text,
+    State_TagOpen,
+    State_StartTagName,
+    State_StartTag,
+    State_EndTag,
+    State_Markup,      // <! not yet identified
+    State_Comment,     // <!-- until -->
+    State_CData,       // <![CDATA[ until ]]>
+    State_Declaration, // <! until >
+    State_Instruction  // <? until ?>
+  };
+
+  int max_depth_;
+  State state_;
+  int depth_;
+  uint64_t offset_;
+  uint64_t tag_offset_;
+  char quote_;
+  char previous_[2];
+  std::string markup_;
+  XmlScanEvent pending_;
+};
+
+#endif // SKPTOXML_COMMON_XMLSCANNER_H
@@ -0,0 +1,244 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLSPATIAL_H
+#define SKPTOXML_COMMON_XMLSPATIAL_H
+
+#include <stdint.h>
+#include <cfloat>
+#include <string>
+#include <vector>
+
+#include <slapi/transformation.h>
+
+#include "xmlfile.h"
+#include "xmlgeomutils.h"
+
+// The spatial index answers ray casts, box overlap and nearest point queries
+// against the faces of a model read by CXmlFile, in place of loops over
+// every triangle. It is a two level structure: every component definition,
+// the model geometry and every group is an object with a bounding volume
+// hierarchy over its own triangles, built with the surface area heuristic,
+// and one over its component instances and groups. A definition is held
+// once however often it is instanced; queries move into its space by the
+// inverse of the instance transformation.
+//
+// The index refers to the XmlModelInfo it was built from, which must stay
+// unchanged while the index is used. Queries start at the model geometry
+// and are answered in world coordinates. Faces given as a single loop are
+// not indexed, nor are instances of unknown definitions, instances of a
+// definition inside itself and instances with a singular transformation.
+
+enum XmlSpatialObjectType {
+  XmlSpatialObjectType_Definition = 0,
+  XmlSpatialObjectType_Geometry = 1,
+  XmlSpatialObjectType_Group = 2
+};
+
+// A component instance or group inside an object
+struct XmlSpatialInstance {
+  // Index into CXmlSpatialIndex::objects()
+  uint32_t object_;
+  // From the instanced object's coordinates to the containing object's
+  SUTransformation transform_;
+};
+
+struct XmlSpatialObject {
+  XmlSpatialObjectType type_;
+  // Of a component definition
+  std::string name_;
+  const XmlEntitiesInfo* entities_;
+  std::vector<XmlSpatialInstance> instances_;
+  // Of the triangles and the instances, in the object's coordinates
+  XmlGeomUtils::CBoundingBox3d bounds_;
+};
+
+// A triangle as it appears in the world
+struct XmlSpatialTriangle {
+  XmlSpatialTriangle() : object_(0), face_(0), triangle_(0) {}
+
+  // Index into CXmlSpatialIndex::objects()
+  uint32_t object_;
+  // Index into the object's faces_, and of the triangle in the face
+  uint32_t face_;
+  uint32_t triangle_;
+  // The instances leading from the model geometry to the object, each an
+  // index into the instances_ of the object before it
+  std::vector<uint32_t> instance_path_;
+};
+
+struct XmlSpatialRay {
+  XmlSpatialRay() : max_distance_(DBL_MAX) {}
+
+  XmlGeomUtils::CPoint3d origin_;
+  XmlGeomUtils::CVector3d direction_;
+  // Hits are at origin_ + distance * direction_, up to max_distance_
+  double max_distance_;
+};
+
+struct XmlSpatialHit {
+  XmlSpatialHit() : found_(false), distance_(0.0) {}
+
+  bool found_;
+  // Along the ray in units of its direction, or from the query point
+  double distance_;
+  XmlGeomUtils::CPoint3d point_;
+  XmlSpatialTriangle triangle_;
+};
+
+// Query times of the index against brute force loops over every world
+// space triangle, see CXmlSpatialIndex::Benchmark
+struct XmlSpatialBenchmarkInfo {
+  XmlSpatialBenchmarkInfo()
+    : queries_(0), triangles_(0), build_seconds_(0.0), ray_seconds_(0.0),
+      ray_brute_force_seconds_(0.0), overlap_seconds_(0.0),
+      overlap_brute_force_seconds_(0.0), nearest_seconds_(0.0),
+      nearest_brute_force_seconds_(0.0), mismatches_(0) {}
+
+  // Of each kind
+  size_t queries_;
+  // In the world, counting every instance
+  uint64_t triangles_;
+  double build_seconds_;
+  double ray_seconds_;
+  double ray_brute_force_seconds_;
+  double overlap_seconds_;
+  double overlap_brute_force_seconds_;
+  double nearest_seconds_;
+  double nearest_brute_force_seconds_;
+  // Queries whose answers differ from brute force
+  size_t mismatches_;
+};
+
+class CXmlSpatialIndex {
+ public:
+  CXmlSpatialIndex();
+  ~CXmlSpatialIndex() {}
+
+  // Builds and batch queries use this many threads, 0 for one per processor
+  void set_num_threads(int value) { num_threads_ = value; }
+
+  // Builds the hierarchies of all the objects, in parallel
+  void Build(const XmlModelInfo& model);
+  void Clear();
+
+  // The definitions in model order, then the model geometry, then the
+  // groups of each in turn
+  const std::vector<XmlSpatialObject>& objects() const { return objects_; }
+  // Of the model geometry
+  uint32_t root() const { return root_; }
+
+  // The nearest triangle the ray hits, from either side
+  bool CastRay(const XmlSpatialRay& ray, XmlSpatialHit& hit) const;
+  // Every triangle that touches the box
+  void FindOverlaps(const XmlGeomUtils::CBoundingBox3d& box,
+                    std::vector<XmlSpatialTriangle>& triangles) const;
+  // The nearest point on any triangle no further than max_distance
+  bool FindNearest(const XmlGeomUtils::CPoint3d& point, double max_distance,
+                   XmlSpatialHit& hit) const;
+
+  // The same for many queries at once, spread over the threads
+  void CastRays(const std::vector<XmlSpatialRay>& rays,
+                std::vector<XmlSpatialHit>& hits) const;
+  void FindOverlaps(const std::vector<XmlGeomUtils::CBoundingBox3d>& boxes,
+                    std::vector<std::vector<XmlSpatialTriangle> >& triangles)
+                    const;
+  void FindNearest(const std::vector<XmlGeomUtils::CPoint3d>& points,
+                   double max_distance,
+                   std::vector<XmlSpatialHit>& hits) const;
+
+  // The same answers from a loop over every world space triangle, for
+  // checking the index
+  bool CastRayBruteForce(const XmlSpatialRay& ray, XmlSpatialHit& hit) const;
+  void FindOverlapsBruteForce(const XmlGeomUtils::CBoundingBox3d& box,
+                              std::vector<XmlSpatialTriangle>& triangles)
+                              const;
+  bool FindNearestBruteForce(const XmlGeomUtils::CPoint3d& point,
+                             double max_distance, XmlSpatialHit& hit) const;
+
+  // Builds the index of the model and times num_queries random queries of
+  // each kind, in batches, against brute force, comparing the answers
+  void Benchmark(const XmlModelInfo& model, size_t num_queries,
+                 XmlSpatialBenchmarkInfo& info);
+
+ private:
+  // Bounding volume hierarchy node. Nodes are in depth first order, so an
+  // interior node's left child follows it; its right child is offset_
+  // nodes further on. A leaf holds count_ primitives from offset_ on.
+  struct Node {
+    double min_[3];
+    double max_[3];
+    uint32_t offset_;
+    uint32_t count_;
+  };
+
+  struct Triangle {
+    XmlGeomUtils::CPoint3d vertices_[3];
+    uint32_t face_;
+    uint32_t triangle_;
+  };
+
+  // The hierarchies of an object. The triangles and instance indices are in
+  // the order of the leaves.
+  struct Hierarchy {
+    std::vector<Triangle> triangles_;
+    std::vector<Node> triangle_nodes_;
+    std::vector<uint32_t> instances_;
+    std::vector<Node> instance_nodes_;
+    // Of the object's instances_ transformations
+    std::vector<SUTransformation> inverses_;
+  };
+
+  // Primitive bounds for building a hierarchy
+  struct BuildItem {
+    double min_[3];
+    double max_[3];
+    double centroid_[3];
+    uint32_t index_;
+  };
+
+  // An object reached through a chain of instances while querying
+  struct Frame {
+    uint32_t object_;
+    // The frame the instance is in, and its index there; -1 for the root
+    int parent_;
+    uint32_t instance_;
+    SUTransformation to_world_;
+    SUTransformation to_local_;
+    bool is_identity_;
+  };
+
+  void AddObjects(const XmlModelInfo& model);
+  void BuildTriangles(uint32_t object, int spawn_depth);
+  void BuildInstances();
+  // Splits below spawn_depth levels of the hierarchy build one side on
+  // another thread
+  static void BuildNodes(std::vector<BuildItem>& items, size_t begin,
+                         size_t end, int depth, int spawn_depth,
+                         std::vector<Node>& nodes);
+
+  size_t GetNumThreads(size_t num_tasks) const;
+  template <typename Function>
+  void RunParallel(size_t count, const Function& function) const;
+
+  Frame GetRootFrame() const;
+  Frame GetInstanceFrame(const std::vector<Frame>& frames, int parent,
+                         uint32_t instance) const;
+  void GetTriangle(const std::vector<Frame>& frames, int frame,
+                   const Triangle& triangle,
+                   XmlSpatialTriangle& result) const;
+  // Calls the function with every triangle in world coordinates, for the
+  // brute force queries
+  template <typename Function>
+  void ForEachWorldTriangle(const Function& function) const;
+  // The number of triangles ForEachWorldTriangle visits: each object's
+  // own, times the number of times it appears in the world
+  uint64_t CountWorldTriangles() const;
+
+  int num_threads_;
+  std::vector<XmlSpatialObject> objects_;
+  // Parallel to objects_
+  std::vector<Hierarchy> hierarchies_;
+  uint32_t root_;
+};
+
+#endif // SKPTOXML_COMMON_XMLSPATIAL_H
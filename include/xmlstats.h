@@ -13,6 +13,7 @@ class CXmlExportStats {
     edges_ = 0;
     layers_ = 0;
     options_ = 0;
+    skipped_groups_ = 0;
   }
 
   inline void set_textures(size_t num) { textures_ = num; }
@@ -20,12 +21,15 @@ class CXmlExportStats {
   inline void AddFace() { faces_++; }
   inline void AddLayer() { layers_++; }
   inline void AddOption() { options_++; }
+  // Groups left out for being nested too deep
+  inline void AddSkippedGroup() { skipped_groups_++; }
 
   size_t textures() const { return textures_; }
   size_t faces() const { return faces_; }
   size_t edges() const { return edges_; }
   size_t layers() const { return layers_; }
   size_t options() const { return options_; }
+  size_t skipped_groups() const { return skipped_groups_; }
 
  protected:
   size_t textures_;
@@ -33,6 +37,7 @@ class CXmlExportStats {
   size_t edges_;
   size_t layers_;
   size_t options_;
+  size_t skipped_groups_;
 };
 
 #endif // SKPTOXML_COMMON_XMLSTATS_H
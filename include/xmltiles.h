@@ -0,0 +1,128 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#ifndef SKPTOXML_COMMON_XMLTILES_H
+#define SKPTOXML_COMMON_XMLTILES_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "xmlfile.h"
+#include "xmlgeomutils.h"
+#include "xmloptions.h"
+
+// Tiled output cuts the model into an octree of tiles for out-of-core
+// streaming. Group and instance transforms are applied first, so every tile
+// is in world coordinates. Leaf tiles hold the full detail faces and edges
+// inside their cell; the other tiles hold a vertex clustered version of all
+// the faces below them, so a viewer can draw a tile and only load its
+// children where the tile's geometric error is too large on screen.
+//
+// Each tile is a complete xml file with just a Geometry section, referring
+// to the layers and materials of the main file. The tile set file lists the
+// tiles with their bounds and geometric error:
+//   out.xml.tiles          the tile set
+//   out.xml.tile.r.xml     the root tile
+//   out.xml.tile.r53.xml   child 3 of child 5 of the root
+
+struct XmlTileInfo {
+  XmlTileInfo() : geometric_error_(0.0), num_triangles_(0), parent_(-1) {}
+
+  // Relative to the directory of the tile set file
+  std::string filename_;
+  // Bounds of the tile and all its children, in world coordinates
+  XmlGeomUtils::CBoundingBox3d bounds_;
+  // How far the tile's faces may be from the full detail faces (in inches);
+  // 0 for leaves
+  double geometric_error_;
+  // Triangles in the tile's own file
+  uint64_t num_triangles_;
+  // Indices into XmlTileSetInfo::tiles_, -1 for the root
+  int parent_;
+  std::vector<int> children_;
+};
+
+struct XmlTileSetInfo {
+  // The root first, parents before their children
+  std::vector<XmlTileInfo> tiles_;
+};
+
+class CXmlTiler {
+ public:
+  CXmlTiler();
+  ~CXmlTiler() {}
+
+  // Tile files use the face and edge encoding of the options
+  void SetOptions(const CXmlOptions& options);
+  // SketchUp version written in the tile file headers
+  void SetVersion(int major_ver, int minor_ver, int build_no);
+
+  // Cells are split while they hold more than max_triangles triangles, down
+  // to max_depth levels below the root
+  void set_max_triangles(uint64_t value) { max_triangles_ = value; }
+  void set_max_depth(int value) { max_depth_ = value; }
+  // Tile files are written by this many threads, 0 for one per processor
+  void set_num_threads(int value) { num_threads_ = value; }
+
+  // Writes the tile set and tile files of the model next to xml_filename.
+  // Returns false if the tile set file could not be written.
+  bool Write(const XmlModelInfo& model, const std::string& xml_filename);
+
+  // The tile set of the last Write
+  const XmlTileSetInfo& tile_set() const { return tile_set_; }
+
+  static std::string GetTileSetFilename(const std::string& xml_filename);
+  static bool ReadTileSet(const std::string& filename, XmlTileSetInfo& info);
+
+ private:
+  // Triangle of a world space face
+  struct Triangle {
+    uint32_t face_;
+    uint32_t vertex_;
+  };
+
+  // Contents of a tile file: full detail triangles, edges and curves for
+  // leaves, the clustered mesh otherwise
+  struct TileContent {
+    std::vector<Triangle> triangles_;
+    std::vector<uint32_t> edges_;
+    std::vector<uint32_t> curves_;
+    XmlCoarseMeshInfo mesh_;
+  };
+
+  typedef std::map<std::string, const XmlComponentDefinitionInfo*>
+      DefinitionMap;
+
+  void AddEntities(const DefinitionMap& definitions,
+                   const XmlEntitiesInfo& entities,
+                   const SUTransformation& transform,
+                   const std::string& material_name,
+                   std::vector<std::string>& definition_stack);
+  void AddFace(const XmlFaceInfo& face, const SUTransformation& transform,
+               const std::string& material_name);
+  void AddTile(int parent, const std::string& prefix, const std::string& path,
+               const XmlGeomUtils::CBoundingBox3d& cell, int depth,
+               std::vector<Triangle>& triangles,
+               std::vector<uint32_t>& edges, std::vector<uint32_t>& curves);
+  void WriteTile(size_t index, const std::string& directory) const;
+
+  CXmlOptions options_;
+  int major_ver_;
+  int minor_ver_;
+  int build_no_;
+  uint64_t max_triangles_;
+  int max_depth_;
+  int num_threads_;
+
+  // The flattened model, in world coordinates
+  std::vector<XmlFaceInfo> faces_;
+  std::vector<XmlEdgeInfo> edges_;
+  std::vector<XmlCurveInfo> curves_;
+
+  XmlTileSetInfo tile_set_;
+  // Parallel to tile_set_.tiles_
+  std::vector<TileContent> contents_;
+};
+
+#endif // SKPTOXML_COMMON_XMLTILES_H
@@ -1,19 +1,139 @@
+#include "xmlbenchmark.h"
 #include "xmlexporter.h"
 #include <iostream>
+#include <cstdlib>
+#include <cstring>
 
 int main(int argc, char* argv[]) {
-  //Get Model Name
-	if (argc < 2){
+  //Get Options and Model Name
+	CXmlOptions options;
+	char* model_name = NULL;
+	char* stress_file = NULL;
+	char* parse_benchmark_file = NULL;
+	int parse_benchmark_passes = 0;
+	char* nesting_benchmark_file = NULL;
+	int nesting_benchmark_groups = 0;
+	long long number_check_values = 0;
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "--index") == 0) {
+			options.set_export_index(true);
+		} else if (strcmp(argv[i], "--index-groups") == 0) {
+			options.set_export_index(true);
+			options.set_export_index_groups(true);
+		} else if (strcmp(argv[i], "--line-lists") == 0) {
+			options.set_export_line_lists(true);
+		} else if ((strcmp(argv[i], "--quantize") == 0 ||
+		            strcmp(argv[i], "--quantize-binary") == 0) &&
+		           i + 1 < argc) {
+			options.set_export_quantized(true);
+			options.set_export_quantized_binary(
+			    strcmp(argv[i], "--quantize-binary") == 0);
+			options.set_quantization_tolerance(atof(argv[++i]));
+		} else if (strcmp(argv[i], "--progressive") == 0) {
+			options.set_export_progressive(true);
+		} else if (strcmp(argv[i], "--profile") == 0 && i + 1 < argc) {
+			options.set_export_profile(true);
+			options.set_profile_top_definitions(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--manifest") == 0) {
+			options.set_export_manifest(true);
+		} else if (strcmp(argv[i], "--delta") == 0 && i + 1 < argc) {
+			options.set_export_manifest(true);
+			options.set_delta_manifest(argv[++i]);
+		} else if (strcmp(argv[i], "--tiles") == 0 && i + 1 < argc) {
+			options.set_export_tiles(true);
+			options.set_tile_max_triangles(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--compress") == 0 && i + 1 < argc) {
+			options.set_export_quantized(true);
+			options.set_export_compressed(true);
+			options.set_quantization_tolerance(atof(argv[++i]));
+		} else if (strcmp(argv[i], "--spatial-benchmark") == 0 && i + 1 < argc) {
+			options.set_spatial_benchmark_queries(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--decode-benchmark") == 0 && i + 1 < argc) {
+			options.set_decode_benchmark_passes(atoi(argv[++i]));
+		} else if (strcmp(argv[i], "--parse-benchmark") == 0 && i + 2 < argc) {
+			parse_benchmark_passes = atoi(argv[++i]);
+			parse_benchmark_file = argv[++i];
+		} else if (strcmp(argv[i], "--nesting-benchmark") == 0 &&
+		           i + 2 < argc) {
+			nesting_benchmark_groups = atoi(argv[++i]);
+			nesting_benchmark_file = argv[++i];
+		} else if (strcmp(argv[i], "--number-check") == 0 && i + 1 < argc) {
+			number_check_values = atoll(argv[++i]);
+		} else if (strcmp(argv[i], "--stress-large-document") == 0 &&
+		           i + 1 < argc) {
+			stress_file = argv[++i];
+		} else if (strcmp(argv[i], "--no-normals") == 0) {
+			options.set_export_normals(false);
+		} else if (strcmp(argv[i], "--no-front-uvs") == 0) {
+			options.set_export_front_uvs(false);
+		} else if (strcmp(argv[i], "--no-back-uvs") == 0) {
+			options.set_export_back_uvs(false);
+		} else if (strcmp(argv[i], "--no-edges") == 0) {
+			options.set_export_standalone_edges(false);
+		} else if (strcmp(argv[i], "--no-curves") == 0) {
+			options.set_export_curves(false);
+		} else if (strcmp(argv[i], "--no-instance-transforms") == 0) {
+			options.set_export_instance_transforms(false);
+		} else if (strcmp(argv[i], "--sync-io") == 0) {
+			options.set_async_output(false);
+		} else if (strcmp(argv[i], "--max-group-depth") == 0 && i + 1 < argc) {
+			options.set_max_group_depth(atoi(argv[++i]));
+		} else if (model_name == NULL) {
+			model_name = argv[i];
+		}
+	}
+	// Stand-alone checks, no model is needed
+	if (stress_file != NULL)
+		return XmlBenchmark::StressLargeDocument(stress_file) ? 0 : 1;
+	if (parse_benchmark_file != NULL) {
+		return XmlBenchmark::BenchmarkParse(parse_benchmark_file,
+		                                    parse_benchmark_passes) ? 0 : 1;
+	}
+	if (number_check_values > 0) {
+		return XmlBenchmark::CheckNumbers(
+		    static_cast<uint64_t>(number_check_values)) ? 0 : 1;
+	}
+	if (nesting_benchmark_file != NULL) {
+		return XmlBenchmark::BenchmarkNesting(nesting_benchmark_file,
+		                                      nesting_benchmark_groups) ? 0 : 1;
+	}
+
+	if (model_name == NULL){
 		std::cout << "argc is " << argc << "\n";
-		std::cout<< "Usage: skp2xml input_file_name \n";
+		std::cout<< "Usage: skp2xml [options] input_file_name \n";
+		std::cout<< "  --index         write a byte offset index sidecar\n";
+		std::cout<< "  --index-groups  also index every group\n";
+		std::cout<< "  --line-lists    write edges and curves as point lists\n";
+		std::cout<< "  --quantize tol  write quantized face vertices as text\n";
+		std::cout<< "  --quantize-binary tol  as --quantize, base64 encoded\n";
+		std::cout<< "  --compress tol  write quantized faces as compressed meshes\n";
+		std::cout<< "  --progressive   write a coarse model ahead of the full detail\n";
+		std::cout<< "  --tiles n       also write an octree of tiles of at most n triangles\n";
+		std::cout<< "  --profile n     write an output size report with the n largest definitions\n";
+		std::cout<< "  --manifest      write a content hash manifest sidecar\n";
+		std::cout<< "  --delta file    write only the changes since the given manifest\n";
+		std::cout<< "  --spatial-benchmark n  time n spatial queries of each kind against brute force\n";
+		std::cout<< "  --decode-benchmark n  time n decodes of the compressed meshes\n";
+		std::cout<< "  --parse-benchmark n file  time n parses of the file with each scanner\n";
+		std::cout<< "  --nesting-benchmark n file  time n groups nested and side by side\n";
+		std::cout<< "  --number-check n  check n number conversions against strtod\n";
+		std::cout<< "  --stress-large-document file  write and read back a document over 4GB\n";
+		std::cout<< "  --no-normals    leave out the face vertex normals\n";
+		std::cout<< "  --no-front-uvs  leave out the front texture coordinates\n";
+		std::cout<< "  --no-back-uvs   leave out the back texture coordinates\n";
+		std::cout<< "  --no-edges      leave out the stand-alone edges\n";
+		std::cout<< "  --no-curves     leave out the curves\n";
+		std::cout<< "  --no-instance-transforms  leave out the component instance transformations\n";
+		std::cout<< "  --sync-io       write the output files without background I/O\n";
+		std::cout<< "  --max-group-depth n  leave out groups nested more than n deep, no limit by default\n";
 		return 1;
 	}
-	char* model_name = argv[1];
 
 	std::string in_file(model_name);
 	std::string out_file("tmp/out.xml");
 
 	CXmlExporter model = CXmlExporter();
+	model.SetOptions(options);
 	model.Convert(in_file, out_file);
 
 	return 0;
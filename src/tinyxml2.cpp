@@ -24,12 +24,39 @@ distribution.
 #include "tinyxml2.h"
 
 #include <new>		// yes, this one new style header, is in the Android SDK.
+#include <float.h>
 #   ifdef ANDROID_NDK
 #   include <stddef.h>
 #else
 #   include <cstddef>
 #endif
 
+#if defined(__linux__) || defined(__APPLE__)
+#   define TINYXML2_MMAP
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || ( defined(_M_IX86_FP) && _M_IX86_FP >= 2 )
+#   define TINYXML2_SSE2
+#   include <emmintrin.h>
+#   if defined(_MSC_VER)
+#       include <intrin.h>
+#   endif
+#   if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#       define TINYXML2_AVX2
+#       include <immintrin.h>
+#   endif
+#endif
+
+#if defined(__GNUC__)
+#   define TINYXML2_NO_SANITIZE_ADDRESS __attribute__(( no_sanitize_address ))
+#else
+#   define TINYXML2_NO_SANITIZE_ADDRESS
+#endif
+
 static const char LINE_FEED				= (char)0x0a;			// all line endings are normalized to LF
 static const char LF = LINE_FEED;
 static const char CARRIAGE_RETURN		= (char)0x0d;			// CR gets filtered out
@@ -80,6 +107,238 @@ static const Entity entities[NUM_ENTITIES] = {
 };
 
 
+// --------- Character scanning ---------- //
+//
+// Whitespace, names and the end of text are found with a table lookup
+// per character. Runs of whitespace and searches for a delimiter go a
+// block of 16 (SSE2) or 32 (AVX2, when the processor has it) characters
+// at a time. The blocks are aligned, so they never cross into a page
+// past the terminating null, but they may read past the end of the
+// string's allocation; the address sanitizer is told so.
+
+const unsigned char XMLUtil::CHAR_CLASSES[256] = {
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0,	// 0x00
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	// 0x10
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 4, 4, 0,	// 0x20
+    4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 6, 0, 0, 0, 0, 0,	// 0x30
+    0, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0x40
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 0, 0, 0, 0, 6,	// 0x50
+    0, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0x60
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 0, 0, 0, 0, 0,	// 0x70
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0x80
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0x90
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0xA0
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0xB0
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0xC0
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0xD0
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0xE0
+    6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6,	// 0xF0
+};
+
+#if defined(TINYXML2_SSE2)
+
+static inline int CountTrailingZeros( unsigned mask )
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward( &index, mask );
+    return (int)index;
+#else
+    return __builtin_ctz( mask );
+#endif
+}
+
+// Bits set for the characters that aren't white space: ' ' and \t to \r
+static inline unsigned NonSpaceMask16( __m128i block )
+{
+    __m128i space = _mm_cmpeq_epi8( block, _mm_set1_epi8( ' ' ) );
+    __m128i control = _mm_sub_epi8( block, _mm_set1_epi8( '\t' ) );
+    control = _mm_cmpeq_epi8( _mm_min_epu8( control, _mm_set1_epi8( '\r' - '\t' ) ), control );
+    return ~(unsigned)_mm_movemask_epi8( _mm_or_si128( space, control ) ) & 0xffffU;
+}
+
+TINYXML2_NO_SANITIZE_ADDRESS
+static const char* SkipWhiteSpaceSSE2( const char* p )
+{
+    const __m128i* block = (const __m128i*)( (uintptr_t)p & ~(uintptr_t)15 );
+    unsigned mask = NonSpaceMask16( _mm_load_si128( block ) ) >> ( p - (const char*)block );
+    if ( mask ) {
+        return p + CountTrailingZeros( mask );
+    }
+    // The null is not white space, so this stops in its block at the latest
+    for ( ;; ) {
+        mask = NonSpaceMask16( _mm_load_si128( ++block ) );
+        if ( mask ) {
+            return (const char*)block + CountTrailingZeros( mask );
+        }
+    }
+}
+
+TINYXML2_NO_SANITIZE_ADDRESS
+static char* FindCharSSE2( char* p, char c )
+{
+    const __m128i* block = (const __m128i*)( (uintptr_t)p & ~(uintptr_t)15 );
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i wanted = _mm_set1_epi8( c );
+    __m128i value = _mm_load_si128( block );
+    unsigned mask = (unsigned)_mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( value, zero ),
+                                                               _mm_cmpeq_epi8( value, wanted ) ) );
+    mask >>= ( p - (const char*)block );
+    if ( mask ) {
+        return p + CountTrailingZeros( mask );
+    }
+    for ( ;; ) {
+        value = _mm_load_si128( ++block );
+        mask = (unsigned)_mm_movemask_epi8( _mm_or_si128( _mm_cmpeq_epi8( value, zero ),
+                                                          _mm_cmpeq_epi8( value, wanted ) ) );
+        if ( mask ) {
+            return (char*)block + CountTrailingZeros( mask );
+        }
+    }
+}
+
+#endif	// TINYXML2_SSE2
+
+#if defined(TINYXML2_AVX2)
+
+__attribute__(( target( "avx2" ) ))
+static inline unsigned NonSpaceMask32( __m256i block )
+{
+    __m256i space = _mm256_cmpeq_epi8( block, _mm256_set1_epi8( ' ' ) );
+    __m256i control = _mm256_sub_epi8( block, _mm256_set1_epi8( '\t' ) );
+    control = _mm256_cmpeq_epi8( _mm256_min_epu8( control, _mm256_set1_epi8( '\r' - '\t' ) ), control );
+    return ~(unsigned)_mm256_movemask_epi8( _mm256_or_si256( space, control ) );
+}
+
+TINYXML2_NO_SANITIZE_ADDRESS __attribute__(( target( "avx2" ) ))
+static const char* SkipWhiteSpaceAVX2( const char* p )
+{
+    const __m256i* block = (const __m256i*)( (uintptr_t)p & ~(uintptr_t)31 );
+    unsigned mask = NonSpaceMask32( _mm256_load_si256( block ) ) >> ( p - (const char*)block );
+    if ( mask ) {
+        return p + CountTrailingZeros( mask );
+    }
+    for ( ;; ) {
+        mask = NonSpaceMask32( _mm256_load_si256( ++block ) );
+        if ( mask ) {
+            return (const char*)block + CountTrailingZeros( mask );
+        }
+    }
+}
+
+TINYXML2_NO_SANITIZE_ADDRESS __attribute__(( target( "avx2" ) ))
+static char* FindCharAVX2( char* p, char c )
+{
+    const __m256i* block = (const __m256i*)( (uintptr_t)p & ~(uintptr_t)31 );
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i wanted = _mm256_set1_epi8( c );
+    __m256i value = _mm256_load_si256( block );
+    unsigned mask = (unsigned)_mm256_movemask_epi8( _mm256_or_si256( _mm256_cmpeq_epi8( value, zero ),
+                                                                     _mm256_cmpeq_epi8( value, wanted ) ) );
+    mask >>= ( p - (const char*)block );
+    if ( mask ) {
+        return p + CountTrailingZeros( mask );
+    }
+    for ( ;; ) {
+        value = _mm256_load_si256( ++block );
+        mask = (unsigned)_mm256_movemask_epi8( _mm256_or_si256( _mm256_cmpeq_epi8( value, zero ),
+                                                                _mm256_cmpeq_epi8( value, wanted ) ) );
+        if ( mask ) {
+            return (char*)block + CountTrailingZeros( mask );
+        }
+    }
+}
+
+static bool HasAVX2()
+{
+    static const bool hasAVX2 = ( __builtin_cpu_init(), __builtin_cpu_supports( "avx2" ) != 0 );
+    return hasAVX2;
+}
+
+#endif	// TINYXML2_AVX2
+
+
+static XMLUtil::Scanner GetBestScanner()
+{
+#if defined(TINYXML2_AVX2)
+    if ( HasAVX2() ) {
+        return XMLUtil::SCANNER_AVX2;
+    }
+#endif
+#if defined(TINYXML2_SSE2)
+    return XMLUtil::SCANNER_SSE2;
+#else
+    return XMLUtil::SCANNER_SCALAR;
+#endif
+}
+
+
+static XMLUtil::Scanner& CurrentScanner()
+{
+    static XMLUtil::Scanner scanner = GetBestScanner();
+    return scanner;
+}
+
+
+bool XMLUtil::SetScanner( Scanner scanner )
+{
+    // Anything up to the best one is there too
+    if ( scanner > GetBestScanner() ) {
+        return false;
+    }
+    CurrentScanner() = scanner;
+    return true;
+}
+
+
+XMLUtil::Scanner XMLUtil::GetScanner()
+{
+    return CurrentScanner();
+}
+
+
+const char* XMLUtil::SkipWhiteSpaceRun( const char* p )
+{
+    switch ( CurrentScanner() ) {
+#if defined(TINYXML2_AVX2)
+        case SCANNER_AVX2:
+            return SkipWhiteSpaceAVX2( p );
+#endif
+#if defined(TINYXML2_SSE2)
+        case SCANNER_SSE2:
+            return SkipWhiteSpaceSSE2( p );
+#endif
+        default:
+            break;
+    }
+    while ( IsWhiteSpace( *p ) ) {
+        ++p;
+    }
+    return p;
+}
+
+
+char* XMLUtil::FindChar( char* p, char c )
+{
+    switch ( CurrentScanner() ) {
+#if defined(TINYXML2_AVX2)
+        case SCANNER_AVX2:
+            return FindCharAVX2( p, c );
+#endif
+#if defined(TINYXML2_SSE2)
+        case SCANNER_SSE2:
+            return FindCharSSE2( p, c );
+#endif
+        default:
+            break;
+    }
+    while ( *p && *p != c ) {
+        ++p;
+    }
+    return p;
+}
+
+
 StrPair::~StrPair()
 {
     Reset();
@@ -117,12 +376,11 @@ char* StrPair::ParseText( char* p, const char* endTag, int strFlags )
     size_t length = strlen( endTag );
 
     // Inner loop of text parsing.
-    while ( *p ) {
-        if ( *p == endChar && strncmp( p, endTag, length ) == 0 ) {
+    for ( p = XMLUtil::FindChar( p, endChar ); *p; p = XMLUtil::FindChar( p + 1, endChar ) ) {
+        if ( strncmp( p, endTag, length ) == 0 ) {
             Set( start, p, strFlags );
             return p + length;
         }
-        ++p;
     }
     return 0;
 }
@@ -136,8 +394,11 @@ char* StrPair::ParseName( char* p )
         return 0;
     }
 
-    while( *p && ( p == start ? XMLUtil::IsNameStartChar( *p ) : XMLUtil::IsNameChar( *p ) )) {
+    if ( XMLUtil::IsNameStartChar( *p ) ) {
         ++p;
+        while( XMLUtil::IsNameChar( *p ) ) {
+            ++p;
+        }
     }
 
     if ( p > start ) {
@@ -417,6 +678,12 @@ void XMLUtil::ToStr( unsigned v, char* buffer, int bufferSize )
 }
 
 
+void XMLUtil::ToStr( int64_t v, char* buffer, int bufferSize )
+{
+    TIXML_SNPRINTF( buffer, bufferSize, "%lld", (long long)v );
+}
+
+
 void XMLUtil::ToStr( bool v, char* buffer, int bufferSize )
 {
     TIXML_SNPRINTF( buffer, bufferSize, "%d", v ? 1 : 0 );
@@ -435,20 +702,305 @@ void XMLUtil::ToStr( double v, char* buffer, int bufferSize )
 }
 
 
+// --------- Number parsing ---------- //
+//
+// The string to number conversions don't depend on the C locale.
+// Decimals whose significant digits fit the mantissa of the type and
+// whose exponent is small are converted exactly, with one
+// multiplication or division. Anything else is written out again
+// without a decimal point, which strtod reads the same way in every
+// locale, and left to the C library, which rounds correctly.
+
+static const int MAX_MANTISSA_DIGITS = 19;	// 10^19 - 1 fits in 64 bits
+
+static const double DOUBLE_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+static const float FLOAT_POWERS_OF_TEN[] = {
+    1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f
+};
+
+struct DecimalNumber {
+    bool        negative;
+    uint64_t    mantissa;			// the first significant digits
+    int         significantDigits;
+    int         exponent;			// of the mantissa's last digit
+    bool        truncated;			// more significant digits than fit
+    const char* digits;				// the digits, with the decimal point
+    const char* digitsEnd;
+    int         fractionDigits;
+    int         explicitExponent;	// the e+nn part
+};
+
+
+inline static bool IsDigit( char c )
+{
+    return c >= '0' && c <= '9';
+}
+
+
+// Eight digits at once, with the multiplications done within a
+// 64 bit word
+inline static uint32_t EightDigitsValue( const char* p )
+{
+    uint64_t v = 0;
+    for( int i=0; i<8; ++i ) {
+        v |= (uint64_t)(unsigned char)p[i] << (8*i);
+    }
+    v -= 0x3030303030303030ULL;
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+         (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    return (uint32_t)v;
+}
+
+
+static const char* ScanDigits( const char* p, bool fraction, DecimalNumber* number )
+{
+    const char* end = p;
+    while ( IsDigit( *end ) ) {
+        ++end;
+    }
+    if ( fraction ) {
+        number->fractionDigits += (int)(end - p);
+    }
+    if ( number->significantDigits == 0 ) {
+        // Leading zeros only move the decimal point
+        while ( p < end && *p == '0' ) {
+            ++p;
+            if ( fraction ) {
+                --number->exponent;
+            }
+        }
+    }
+    while ( end - p >= 8 && number->significantDigits + 8 <= MAX_MANTISSA_DIGITS ) {
+        number->mantissa = number->mantissa * 100000000 + EightDigitsValue( p );
+        number->significantDigits += 8;
+        if ( fraction ) {
+            number->exponent -= 8;
+        }
+        p += 8;
+    }
+    for( ; p < end; ++p ) {
+        if ( number->significantDigits < MAX_MANTISSA_DIGITS ) {
+            number->mantissa = number->mantissa * 10 + (*p - '0');
+            ++number->significantDigits;
+            if ( fraction ) {
+                --number->exponent;
+            }
+        }
+        else {
+            number->truncated = true;
+            if ( !fraction ) {
+                ++number->exponent;
+            }
+        }
+    }
+    return end;
+}
+
+
+// Reads a decimal number, after optional white space. Returns where
+// it ends, or 0 if there is none.
+static const char* ScanDecimal( const char* p, DecimalNumber* number )
+{
+    memset( number, 0, sizeof( *number ) );
+    p = XMLUtil::SkipWhiteSpace( p );
+    if ( *p == '-' || *p == '+' ) {
+        number->negative = *p == '-';
+        ++p;
+    }
+    number->digits = p;
+    p = ScanDigits( p, false, number );
+    bool hasDigits = p != number->digits;
+    if ( *p == '.' ) {
+        const char* fraction = ++p;
+        p = ScanDigits( p, true, number );
+        hasDigits = hasDigits || p != fraction;
+    }
+    if ( !hasDigits ) {
+        return 0;
+    }
+    number->digitsEnd = p;
+
+    if ( *p == 'e' || *p == 'E' ) {
+        const char* q = p + 1;
+        bool negativeExponent = false;
+        if ( *q == '-' || *q == '+' ) {
+            negativeExponent = *q == '-';
+            ++q;
+        }
+        if ( IsDigit( *q ) ) {
+            int exponent = 0;
+            for( ; IsDigit( *q ); ++q ) {
+                if ( exponent < 100000 ) {
+                    exponent = exponent * 10 + (*q - '0');
+                }
+            }
+            number->explicitExponent = negativeExponent ? -exponent : exponent;
+            number->exponent += number->explicitExponent;
+            p = q;
+        }
+    }
+    return p;
+}
+
+
+// Infinities and NaNs, which strtod reads the same way in every locale
+static const char* ScanSpecialValue( const char* p, double* value )
+{
+    p = XMLUtil::SkipWhiteSpace( p );
+    const char* name = ( *p == '-' || *p == '+' ) ? p + 1 : p;
+    char c = (char)tolower( (unsigned char)*name );
+    if ( c != 'i' && c != 'n' ) {
+        return 0;
+    }
+    char* end = 0;
+    *value = strtod( p, &end );
+    return end != p ? end : 0;
+}
+
+
+// The digits as an integer, with the exponent adjusted to match
+static double SlowDecimalToDouble( const DecimalNumber& number, bool isFloat )
+{
+    char stackBuffer[128];
+    size_t length = (size_t)(number.digitsEnd - number.digits) + 16;
+    char* buffer = length <= sizeof( stackBuffer ) ? stackBuffer : new char[length];
+    char* q = buffer;
+    if ( number.negative ) {
+        *q++ = '-';
+    }
+    for( const char* p = number.digits; p < number.digitsEnd; ++p ) {
+        if ( *p != '.' ) {
+            *q++ = *p;
+        }
+    }
+    TIXML_SNPRINTF( q, 16, "e%d", number.explicitExponent - number.fractionDigits );
+    double value = isFloat ? (double)strtof( buffer, 0 ) : strtod( buffer, 0 );
+    if ( buffer != stackBuffer ) {
+        delete [] buffer;
+    }
+    return value;
+}
+
+
+static const char* ParseDouble( const char* p, double* value )
+{
+    DecimalNumber number;
+    const char* end = ScanDecimal( p, &number );
+    if ( !end ) {
+        return ScanSpecialValue( p, value );
+    }
+    if ( !number.truncated && number.mantissa == 0 ) {
+        *value = number.negative ? -0.0 : 0.0;
+        return end;
+    }
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    if ( !number.truncated && number.mantissa <= (1ULL << 53) &&
+         number.exponent >= -22 && number.exponent <= 22 ) {
+        double d = (double)number.mantissa;
+        d = number.exponent < 0 ? d / DOUBLE_POWERS_OF_TEN[-number.exponent]
+                                : d * DOUBLE_POWERS_OF_TEN[number.exponent];
+        *value = number.negative ? -d : d;
+        return end;
+    }
+#endif
+    *value = SlowDecimalToDouble( number, false );
+    return end;
+}
+
+
+static const char* ParseFloat( const char* p, float* value )
+{
+    DecimalNumber number;
+    const char* end = ScanDecimal( p, &number );
+    if ( !end ) {
+        double d = 0;
+        end = ScanSpecialValue( p, &d );
+        *value = (float)d;
+        return end;
+    }
+    if ( !number.truncated && number.mantissa == 0 ) {
+        *value = number.negative ? -0.0f : 0.0f;
+        return end;
+    }
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD == 0
+    if ( !number.truncated && number.mantissa <= (1ULL << 24) &&
+         number.exponent >= -10 && number.exponent <= 10 ) {
+        float f = (float)number.mantissa;
+        f = number.exponent < 0 ? f / FLOAT_POWERS_OF_TEN[-number.exponent]
+                                : f * FLOAT_POWERS_OF_TEN[number.exponent];
+        *value = number.negative ? -f : f;
+        return end;
+    }
+#endif
+    *value = (float)SlowDecimalToDouble( number, true );
+    return end;
+}
+
+
+// Reads a decimal integer, after optional white space. Returns
+// where it ends, or 0 if there is none or it doesn't fit 64 bits.
+static const char* ScanInteger( const char* p, bool* negative, uint64_t* magnitude )
+{
+    p = XMLUtil::SkipWhiteSpace( p );
+    *negative = false;
+    if ( *p == '-' || *p == '+' ) {
+        *negative = *p == '-';
+        ++p;
+    }
+    if ( !IsDigit( *p ) ) {
+        return 0;
+    }
+    uint64_t value = 0;
+    for( ; IsDigit( *p ); ++p ) {
+        unsigned digit = (unsigned)(*p - '0');
+        if ( value > (UINT64_MAX - digit) / 10 ) {
+            return 0;
+        }
+        value = value * 10 + digit;
+    }
+    *magnitude = value;
+    return p;
+}
+
+
 bool XMLUtil::ToInt( const char* str, int* value )
 {
-    if ( TIXML_SSCANF( str, "%d", value ) == 1 ) {
-        return true;
+    bool negative = false;
+    uint64_t magnitude = 0;
+    if ( !ScanInteger( str, &negative, &magnitude ) ||
+         magnitude > (negative ? (uint64_t)INT_MAX + 1 : (uint64_t)INT_MAX) ) {
+        return false;
     }
-    return false;
+    *value = negative ? (int)(0 - (int64_t)magnitude) : (int)magnitude;
+    return true;
 }
 
 bool XMLUtil::ToUnsigned( const char* str, unsigned *value )
 {
-    if ( TIXML_SSCANF( str, "%u", value ) == 1 ) {
-        return true;
+    bool negative = false;
+    uint64_t magnitude = 0;
+    if ( !ScanInteger( str, &negative, &magnitude ) || magnitude > UINT_MAX ) {
+        return false;
     }
-    return false;
+    // Negative values wrap around, as with strtoul
+    *value = negative ? 0U - (unsigned)magnitude : (unsigned)magnitude;
+    return true;
+}
+
+bool XMLUtil::ToInt64( const char* str, int64_t* value )
+{
+    bool negative = false;
+    uint64_t magnitude = 0;
+    if ( !ScanInteger( str, &negative, &magnitude ) ||
+         magnitude > (negative ? (uint64_t)INT64_MAX + 1 : (uint64_t)INT64_MAX) ) {
+        return false;
+    }
+    *value = negative ? (int64_t)(0 - magnitude) : (int64_t)magnitude;
+    return true;
 }
 
 bool XMLUtil::ToBool( const char* str, bool* value )
@@ -472,18 +1024,55 @@ bool XMLUtil::ToBool( const char* str, bool* value )
 
 bool XMLUtil::ToFloat( const char* str, float* value )
 {
-    if ( TIXML_SSCANF( str, "%f", value ) == 1 ) {
-        return true;
-    }
-    return false;
+    return ParseFloat( str, value ) != 0;
 }
 
 bool XMLUtil::ToDouble( const char* str, double* value )
 {
-    if ( TIXML_SSCANF( str, "%lf", value ) == 1 ) {
-        return true;
+    return ParseDouble( str, value ) != 0;
+}
+
+
+// A number in an array must be followed by white space or the end
+inline static bool IsArrayNumberEnd( const char* p )
+{
+    return *p == 0 || XMLUtil::IsWhiteSpace( *p );
+}
+
+size_t XMLUtil::ToDoubleArray( const char* str, double* values, size_t maxCount, const char** end )
+{
+    size_t count = 0;
+    const char* p = str;
+    while ( count < maxCount ) {
+        const char* next = ParseDouble( p, &values[count] );
+        if ( !next || !IsArrayNumberEnd( next ) ) {
+            break;
+        }
+        p = next;
+        ++count;
     }
-    return false;
+    if ( end ) {
+        *end = p;
+    }
+    return count;
+}
+
+size_t XMLUtil::ToFloatArray( const char* str, float* values, size_t maxCount, const char** end )
+{
+    size_t count = 0;
+    const char* p = str;
+    while ( count < maxCount ) {
+        const char* next = ParseFloat( p, &values[count] );
+        if ( !next || !IsArrayNumberEnd( next ) ) {
+            break;
+        }
+        p = next;
+        ++count;
+    }
+    if ( end ) {
+        *end = p;
+    }
+    return count;
 }
 
 
@@ -562,16 +1151,49 @@ char* XMLDocument::Identify( char* p, XMLNode** node )
 }
 
 
-bool XMLDocument::Accept( XMLVisitor* visitor ) const
+// Visits an element or document and everything in it, in the same
+// order and with the same early exits as calling Accept on every level,
+// but walking the tree rather than recursing.
+static bool AcceptTree( const XMLNode* root, XMLVisitor* visitor )
 {
-    if ( visitor->VisitEnter( *this ) ) {
-        for ( const XMLNode* node=FirstChild(); node; node=node->NextSibling() ) {
-            if ( !node->Accept( visitor ) ) {
+    const XMLNode* node = root;
+    for( ;; ) {
+        bool result = false;
+        const XMLElement* element = node->ToElement();
+        const XMLDocument* document = node->ToDocument();
+        if ( element || document ) {
+            bool enter = element ? visitor->VisitEnter( *element, element->FirstAttribute() )
+                                 : visitor->VisitEnter( *document );
+            if ( enter && node->FirstChild() ) {
+                node = node->FirstChild();
+                continue;
+            }
+            result = element ? visitor->VisitExit( *element ) : visitor->VisitExit( *document );
+        }
+        else {
+            result = node->Accept( visitor );
+        }
+
+        // Move on to the next sibling, or finish the parents
+        for( ;; ) {
+            if ( node == root ) {
+                return result;
+            }
+            if ( result && node->NextSibling() ) {
+                node = node->NextSibling();
                 break;
             }
+            node = node->Parent();
+            element = node->ToElement();
+            result = element ? visitor->VisitExit( *element ) : visitor->VisitExit( *node->ToDocument() );
         }
     }
-    return visitor->VisitExit( *this );
+}
+
+
+bool XMLDocument::Accept( XMLVisitor* visitor ) const
+{
+    return AcceptTree( this, visitor );
 }
 
 
@@ -608,8 +1230,25 @@ void XMLNode::SetValue( const char* str, bool staticMem )
 
 void XMLNode::DeleteChildren()
 {
+    // A child's own children are moved up to this node before the child is
+    // deleted, so deleting a deep tree doesn't recurse.
     while( _firstChild ) {
         XMLNode* node = _firstChild;
+        if ( node->_firstChild ) {
+            for( XMLNode* child = node->_firstChild; child; child = child->_next ) {
+                child->_parent = this;
+            }
+            node->_lastChild->_next = node->_next;
+            if ( node->_next ) {
+                node->_next->_prev = node->_lastChild;
+            }
+            else {
+                _lastChild = node->_lastChild;
+            }
+            node->_next = node->_firstChild;
+            node->_firstChild->_prev = node;
+            node->_firstChild = node->_lastChild = 0;
+        }
         Unlink( node );
 
         DELETE_NODE( node );
@@ -757,11 +1396,47 @@ const XMLElement* XMLNode::NextSiblingElement( const char* value ) const
 }
 
 
-const XMLElement* XMLNode::PreviousSiblingElement( const char* value ) const
+const XMLElement* XMLNode::FirstChildElementById( int nameId ) const
 {
-    for( XMLNode* element=_prev; element; element = element->_prev ) {
-        if (    element->ToElement()
-                && (!value || XMLUtil::StringEqual( value, element->Value() ))) {
+    for( XMLNode* node=_firstChild; node; node=node->_next ) {
+        XMLElement* element = node->ToElement();
+        if ( element && element->NameId() == nameId ) {
+            return element;
+        }
+    }
+    return 0;
+}
+
+
+const XMLElement* XMLNode::LastChildElementById( int nameId ) const
+{
+    for( XMLNode* node=_lastChild; node; node=node->_prev ) {
+        XMLElement* element = node->ToElement();
+        if ( element && element->NameId() == nameId ) {
+            return element;
+        }
+    }
+    return 0;
+}
+
+
+const XMLElement* XMLNode::NextSiblingElementById( int nameId ) const
+{
+    for( XMLNode* node=_next; node; node=node->_next ) {
+        XMLElement* element = node->ToElement();
+        if ( element && element->NameId() == nameId ) {
+            return element;
+        }
+    }
+    return 0;
+}
+
+
+const XMLElement* XMLNode::PreviousSiblingElement( const char* value ) const
+{
+    for( XMLNode* element=_prev; element; element = element->_prev ) {
+        if (    element->ToElement()
+                && (!value || XMLUtil::StringEqual( value, element->Value() ))) {
             return element->ToElement();
         }
     }
@@ -771,78 +1446,92 @@ const XMLElement* XMLNode::PreviousSiblingElement( const char* value ) const
 
 char* XMLNode::ParseDeep( char* p, StrPair* parentEnd )
 {
-    // This is a recursive method, but thinking about it "at the current level"
-    // it is a pretty simple flat list:
-    //		<foo/>
-    //		<!-- comment -->
-    //
-    // With a special case:
+    // The children are read as a flat list of start tags, end tags and
+    // other nodes:
     //		<foo>
+    //		<bar/>
     //		</foo>
     //		<!-- comment -->
     //
-    // Where the closing element (/foo) *must* be the next thing after the opening
-    // element, and the names must match. BUT the tricky bit is that the closing
-    // element will be read by the child.
+    // An element that isn't closed by its own start tag is the parent of
+    // what follows, until its end tag, which *must* have the same name.
+    // The open elements make up the stack, so nesting doesn't recurse.
     //
-    // 'endTag' is the end tag for this node, it is returned by a call to a child.
-    // 'parentEnd' is the end tag for the parent, which is filled in and returned.
+    // An end tag with no open element is the end tag of this node's parent;
+    // it is filled in 'parentEnd' and returned.
 
+    XMLNode* parent = this;
+    int depth = 0;	// of the open elements, below this node
+    bool atOpenTag = false;
     while( p && *p ) {
         XMLNode* node = 0;
+        atOpenTag = false;
 
         p = _document->Identify( p, &node );
         if ( p == 0 || node == 0 ) {
             break;
         }
 
-        StrPair endTag;
-        p = node->ParseDeep( p, &endTag );
+        p = node->ParseDeep( p, 0 );
         if ( !p ) {
             DELETE_NODE( node );
             node = 0;
-            if ( !_document->Error() ) {
-                _document->SetError( XML_ERROR_PARSING, 0, 0 );
-            }
             break;
         }
 
-        // We read the end tag. Return it to the parent.
-        if ( node->ToElement() && node->ToElement()->ClosingType() == XMLElement::CLOSING ) {
-            if ( parentEnd ) {
-                *parentEnd = static_cast<XMLElement*>(node)->_value;
+        XMLElement* ele = node->ToElement();
+        if ( ele && ele->ClosingType() == XMLElement::CLOSING ) {
+            bool matches = parent != this && XMLUtil::StringEqual( ele->Name(), parent->Value() );
+            if ( parent == this && parentEnd ) {
+                *parentEnd = ele->_value;
             }
-			node->_memPool->SetTracked();	// created and then immediately deleted.
+            node->_memPool->SetTracked();	// created and then immediately deleted.
             DELETE_NODE( node );
-            return p;
+            if ( parent == this ) {
+                // The end tag of this node's parent.
+                return p;
+            }
+            if ( !matches ) {
+                _document->SetError( XML_ERROR_MISMATCHED_ELEMENT, parent->Value(), 0 );
+                p = 0;
+                break;
+            }
+            parent = parent->_parent;
+            --depth;
+            continue;
         }
 
-        // Handle an end tag returned to this level.
-        // And handle a bunch of annoying errors.
-        XMLElement* ele = node->ToElement();
-        if ( ele ) {
-            if ( endTag.Empty() && ele->ClosingType() == XMLElement::OPEN ) {
-                _document->SetError( XML_ERROR_MISMATCHED_ELEMENT, node->Value(), 0 );
+        parent->InsertEndChild( node );
+        if ( ele && ele->ClosingType() == XMLElement::OPEN ) {
+            if ( depth >= _document->MaxElementDepth() ) {
+                _document->SetError( XML_ERROR_ELEMENT_DEPTH, ele->Name(), 0 );
                 p = 0;
+                break;
             }
-            else if ( !endTag.Empty() && ele->ClosingType() != XMLElement::OPEN ) {
-                _document->SetError( XML_ERROR_MISMATCHED_ELEMENT, node->Value(), 0 );
-                p = 0;
+            parent = ele;
+            ++depth;
+            atOpenTag = true;
+        }
+    }
+
+    if ( depth > 0 ) {
+        // The text ended, or was wrong, inside an element. The outermost
+        // open element is left out, along with everything in it.
+        if ( !_document->Error() ) {
+            if ( p && atOpenTag ) {
+                _document->SetError( XML_ERROR_MISMATCHED_ELEMENT, parent->Value(), 0 );
             }
-            else if ( !endTag.Empty() ) {
-                if ( !XMLUtil::StringEqual( endTag.GetStr(), node->Value() )) {
-                    _document->SetError( XML_ERROR_MISMATCHED_ELEMENT, node->Value(), 0 );
-                    p = 0;
-                }
+            else {
+                _document->SetError( XML_ERROR_PARSING, 0, 0 );
             }
         }
-        if ( p == 0 ) {
-            DELETE_NODE( node );
-            node = 0;
-        }
-        if ( node ) {
-            this->InsertEndChild( node );
+        while( parent->_parent != this ) {
+            parent = parent->_parent;
         }
+        DeleteChild( parent );
+    }
+    else if ( !p && !_document->Error() ) {
+        _document->SetError( XML_ERROR_PARSING, 0, 0 );
     }
     return 0;
 }
@@ -1039,13 +1728,17 @@ bool XMLUnknown::Accept( XMLVisitor* visitor ) const
 }
 
 // --------- XMLAttribute ---------- //
-char* XMLAttribute::ParseDeep( char* p, bool processEntities )
+char* XMLAttribute::ParseDeep( char* p, bool processEntities, XMLNameIdFunction nameIdFunc )
 {
     // Parse using the name rules: bug fix, was using ParseText before
+    char* name = p;
     p = _name.ParseName( p );
     if ( !p || !*p ) {
         return 0;
     }
+    if ( nameIdFunc ) {
+        _nameId = nameIdFunc( name, p - name );
+    }
 
     // Skip white space before =
     p = XMLUtil::SkipWhiteSpace( p );
@@ -1091,6 +1784,15 @@ XMLError XMLAttribute::QueryUnsignedValue( unsigned int* value ) const
 }
 
 
+XMLError XMLAttribute::QueryInt64Value( int64_t* value ) const
+{
+    if ( XMLUtil::ToInt64( Value(), value )) {
+        return XML_NO_ERROR;
+    }
+    return XML_WRONG_ATTRIBUTE_TYPE;
+}
+
+
 XMLError XMLAttribute::QueryBoolValue( bool* value ) const
 {
     if ( XMLUtil::ToBool( Value(), value )) {
@@ -1140,6 +1842,14 @@ void XMLAttribute::SetAttribute( unsigned v )
 }
 
 
+void XMLAttribute::SetAttribute( int64_t v )
+{
+    char buf[BUF_SIZE];
+    XMLUtil::ToStr( v, buf, BUF_SIZE );
+    _value.SetStr( buf );
+}
+
+
 void XMLAttribute::SetAttribute( bool v )
 {
     char buf[BUF_SIZE];
@@ -1165,11 +1875,20 @@ void XMLAttribute::SetAttribute( float v )
 // --------- XMLElement ---------- //
 XMLElement::XMLElement( XMLDocument* doc ) : XMLNode( doc ),
     _closingType( 0 ),
+    _nameId( -1 ),
     _rootAttribute( 0 )
 {
 }
 
 
+void XMLElement::SetName( const char* str, bool staticMem )
+{
+    SetValue( str, staticMem );
+    XMLNameIdFunction func = _document->NameIdFunction();
+    _nameId = func ? func( str, strlen( str ) ) : -1;
+}
+
+
 XMLElement::~XMLElement()
 {
     while( _rootAttribute ) {
@@ -1204,6 +1923,17 @@ const XMLAttribute* XMLElement::FindAttribute( const char* name ) const
 }
 
 
+const XMLAttribute* XMLElement::FindAttributeById( int nameId ) const
+{
+    for( const XMLAttribute* a=_rootAttribute; a; a = a->_next ) {
+        if ( a->_nameId == nameId ) {
+            return a;
+        }
+    }
+    return 0;
+}
+
+
 const char* XMLElement::Attribute( const char* name, const char* value ) const
 {
     const XMLAttribute* a = FindAttribute( name );
@@ -1313,6 +2043,8 @@ XMLAttribute* XMLElement::FindOrCreateAttribute( const char* name )
             _rootAttribute = attrib;
         }
         attrib->SetName( name );
+        XMLNameIdFunction func = _document->AttributeNameIdFunction();
+        attrib->_nameId = func ? func( name, strlen( name ) ) : -1;
         attrib->_memPool->SetTracked(); // always created and linked.
     }
     return attrib;
@@ -1338,6 +2070,18 @@ void XMLElement::DeleteAttribute( const char* name )
 }
 
 
+bool XMLElement::IsDuplicateAttribute( const XMLAttribute* attrib ) const
+{
+    // Names with different ids differ, only same ids are compared
+    for( const XMLAttribute* a=_rootAttribute; a; a = a->_next ) {
+        if ( a->_nameId == attrib->_nameId && XMLUtil::StringEqual( a->Name(), attrib->Name() ) ) {
+            return true;
+        }
+    }
+    return false;
+}
+
+
 char* XMLElement::ParseAttributes( char* p )
 {
     const char* start = p;
@@ -1357,8 +2101,8 @@ char* XMLElement::ParseAttributes( char* p )
             attrib->_memPool = &_document->_attributePool;
 			attrib->_memPool->SetTracked();
 
-            p = attrib->ParseDeep( p, _document->ProcessEntities() );
-            if ( !p || Attribute( attrib->Name() ) ) {
+            p = attrib->ParseDeep( p, _document->ProcessEntities(), _document->AttributeNameIdFunction() );
+            if ( !p || IsDuplicateAttribute( attrib ) ) {
                 DELETE_ATTRIBUTE( attrib );
                 _document->SetError( XML_ERROR_PARSING_ATTRIBUTE, start, p );
                 return 0;
@@ -1396,10 +2140,10 @@ char* XMLElement::ParseAttributes( char* p )
 
 
 //
-//	<ele></ele>
-//	<ele>foo<b>bar</b></ele>
+//	<ele>
+//	</ele>
 //
-char* XMLElement::ParseDeep( char* p, StrPair* strPair )
+char* XMLElement::ParseDeep( char* p, StrPair* )
 {
     // Read the element name.
     p = XMLUtil::SkipWhiteSpace( p );
@@ -1415,17 +2159,19 @@ char* XMLElement::ParseDeep( char* p, StrPair* strPair )
         ++p;
     }
 
+    char* name = p;
     p = _value.ParseName( p );
     if ( _value.Empty() ) {
         return 0;
     }
-
-    p = ParseAttributes( p );
-    if ( !p || !*p || _closingType ) {
-        return p;
+    XMLNameIdFunction func = _document->NameIdFunction();
+    if ( func ) {
+        _nameId = func( name, p - name );
     }
 
-    p = XMLNode::ParseDeep( p, strPair );
+    // The children are read by the parent's XMLNode::ParseDeep, which
+    // keeps the open elements.
+    p = ParseAttributes( p );
     return p;
 }
 
@@ -1471,14 +2217,7 @@ bool XMLElement::ShallowEqual( const XMLNode* compare ) const
 
 bool XMLElement::Accept( XMLVisitor* visitor ) const
 {
-    if ( visitor->VisitEnter( *this, _rootAttribute ) ) {
-        for ( const XMLNode* node=FirstChild(); node; node=node->NextSibling() ) {
-            if ( !node->Accept( visitor ) ) {
-                break;
-            }
-        }
-    }
-    return visitor->VisitExit( *this );
+    return AcceptTree( this, visitor );
 }
 
 
@@ -1491,7 +2230,12 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespace ) :
     _whitespace( whitespace ),
     _errorStr1( 0 ),
     _errorStr2( 0 ),
-    _charBuffer( 0 )
+    _charBuffer( 0 ),
+    _charBufferMapSize( 0 ),
+    _charBufferIsCallers( false ),
+    _nameIdFunction( 0 ),
+    _attributeNameIdFunction( 0 ),
+    _maxElementDepth( TIXML2_DEFAULT_MAX_ELEMENT_DEPTH )
 {
     _document = this;	// avoid warning about 'this' in initializer list
 }
@@ -1500,7 +2244,7 @@ XMLDocument::XMLDocument( bool processEntities, Whitespace whitespace ) :
 XMLDocument::~XMLDocument()
 {
     DeleteChildren();
-    delete [] _charBuffer;
+    FreeCharBuffer();
 
 #if 0
     _textPool.Trace( "text" );
@@ -1528,6 +2272,25 @@ void XMLDocument::Clear()
     _errorStr1 = 0;
     _errorStr2 = 0;
 
+    FreeCharBuffer();
+}
+
+
+void XMLDocument::FreeCharBuffer()
+{
+    if ( _charBufferIsCallers ) {
+        _charBuffer = 0;
+        _charBufferIsCallers = false;
+        return;
+    }
+#if defined(TINYXML2_MMAP)
+    if ( _charBufferMapSize ) {
+        munmap( _charBuffer, _charBufferMapSize );
+        _charBuffer = 0;
+        _charBufferMapSize = 0;
+        return;
+    }
+#endif
     delete [] _charBuffer;
     _charBuffer = 0;
 }
@@ -1603,9 +2366,21 @@ XMLError XMLDocument::LoadFile( FILE* fp )
 {
     Clear();
 
-    fseek( fp, 0, SEEK_END );
-    size_t size = ftell( fp );
-    fseek( fp, 0, SEEK_SET );
+    // 64 bit file positions; ftell() is 32 bit on some platforms.
+#if defined(_MSC_VER)
+    _fseeki64( fp, 0, SEEK_END );
+    long long filelength = _ftelli64( fp );
+    _fseeki64( fp, 0, SEEK_SET );
+#else
+    fseeko( fp, 0, SEEK_END );
+    long long filelength = ftello( fp );
+    fseeko( fp, 0, SEEK_SET );
+#endif
+    if ( filelength < 0 || (unsigned long long)filelength >= (size_t)(-1) ) {
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    size_t size = (size_t)filelength;
 
     if ( size == 0 ) {
         return _errorID;
@@ -1620,16 +2395,94 @@ XMLError XMLDocument::LoadFile( FILE* fp )
 
     _charBuffer[size] = 0;
 
+    ParseCharBuffer();
+    return _errorID;
+}
+
+
+#if defined(TINYXML2_MMAP)
+// Maps size bytes of the file privately for in place parsing, over
+// anonymous memory one page longer, so there is always a null after
+// the last byte. Returns 0 if the file can't be mapped.
+static char* MapFile( int fd, size_t size, size_t* mapSize )
+{
+    size_t page = (size_t)sysconf( _SC_PAGESIZE );
+    *mapSize = ( size / page + 1 ) * page;
+    void* mem = mmap( 0, *mapSize, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANON, -1, 0 );
+    if ( mem == MAP_FAILED ) {
+        return 0;
+    }
+    if ( mmap( mem, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED,
+               fd, 0 ) == MAP_FAILED ) {
+        munmap( mem, *mapSize );
+        return 0;
+    }
+
+    // The parser reads front to back; read ahead of it, starting right now
+    // with the first pages
+    static const size_t WILLNEED_SIZE = 4 << 20;
+    madvise( mem, size, MADV_SEQUENTIAL );
+    madvise( mem, size < WILLNEED_SIZE ? size : WILLNEED_SIZE, MADV_WILLNEED );
+    return (char*)mem;
+}
+#endif
+
+
+XMLError XMLDocument::LoadFileMapped( const char* filename )
+{
+#if defined(TINYXML2_MMAP)
+    Clear();
+    int fd = open( filename, O_RDONLY );
+    if ( fd < 0 ) {
+        SetError( XML_ERROR_FILE_NOT_FOUND, filename, 0 );
+        return _errorID;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) ) {
+        // Pipes and the like can't be mapped
+        close( fd );
+        return LoadFile( filename );
+    }
+    if ( (unsigned long long)st.st_size >= (size_t)(-1) / 2 ) {
+        close( fd );
+        SetError( XML_ERROR_FILE_READ_ERROR, 0, 0 );
+        return _errorID;
+    }
+    size_t size = (size_t)st.st_size;
+    if ( size == 0 ) {
+        close( fd );
+        return _errorID;
+    }
+
+    size_t mapSize = 0;
+    char* mem = MapFile( fd, size, &mapSize );
+    close( fd );
+    if ( !mem ) {
+        return LoadFile( filename );
+    }
+
+    _charBuffer = mem;
+    _charBufferMapSize = mapSize;
+    ParseCharBuffer();
+    return _errorID;
+#else
+    return LoadFile( filename );
+#endif
+}
+
+
+void XMLDocument::ParseCharBuffer()
+{
     const char* p = _charBuffer;
     p = XMLUtil::SkipWhiteSpace( p );
     p = XMLUtil::ReadBOM( p, &_writeBOM );
     if ( !p || !*p ) {
         SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
-        return _errorID;
+        return;
     }
 
     ParseDeep( _charBuffer + (p-_charBuffer), 0 );
-    return _errorID;
 }
 
 
@@ -1687,6 +2540,23 @@ XMLError XMLDocument::Parse( const char* p, size_t len )
 }
 
 
+XMLError XMLDocument::ParseInPlace( char* xml, size_t nBytes )
+{
+    Clear();
+
+    if ( !xml ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT, 0, 0 );
+        return _errorID;
+    }
+    xml[nBytes] = 0;
+    _charBuffer = xml;
+    _charBufferIsCallers = true;
+
+    ParseCharBuffer();
+    return _errorID;
+}
+
+
 void XMLDocument::Print( XMLPrinter* streamer )
 {
     XMLPrinter stdStreamer( stdout );
@@ -1732,7 +2602,8 @@ XMLPrinter::XMLPrinter( FILE* file, bool compact ) :
     _depth( 0 ),
     _textDepth( -1 ),
     _processEntities( true ),
-    _compactMode( compact )
+    _compactMode( compact ),
+    _bytesWritten( 0 )
 {
     for( int i=0; i<ENTITY_RANGE; ++i ) {
         _entityFlag[i] = false;
@@ -1757,7 +2628,10 @@ void XMLPrinter::Print( const char* format, ... )
     va_start( va, format );
 
     if ( _fp ) {
-        vfprintf( _fp, format, va );
+        int len = vfprintf( _fp, format, va );
+        if ( len > 0 ) {
+            _bytesWritten += len;
+        }
     }
     else {
         // This seems brutally complex. Haven't figured out a better
@@ -1774,6 +2648,7 @@ void XMLPrinter::Print( const char* format, ... )
         }
         char* p = _buffer.PushArr( len ) - 1;
         memcpy( p, _accumulator.Mem(), len+1 );
+        _bytesWritten += len;
 #else
         int len = vsnprintf( 0, 0, format, va );
         // Close out and re-start the va-args
@@ -1781,6 +2656,7 @@ void XMLPrinter::Print( const char* format, ... )
         va_start( va, format );
         char* p = _buffer.PushArr( len ) - 1;
         vsnprintf( p, len+1, format, va );
+        _bytesWritten += len;
 #endif
     }
     va_end( va );
@@ -1889,6 +2765,14 @@ void XMLPrinter::PushAttribute( const char* name, unsigned v )
 }
 
 
+void XMLPrinter::PushAttribute( const char* name, int64_t v )
+{
+    char buf[BUF_SIZE];
+    XMLUtil::ToStr( v, buf, BUF_SIZE );
+    PushAttribute( name, buf );
+}
+
+
 void XMLPrinter::PushAttribute( const char* name, bool v )
 {
     char buf[BUF_SIZE];
@@ -1938,6 +2822,14 @@ void XMLPrinter::SealElement()
 }
 
 
+void XMLPrinter::SealElementIfJustOpened()
+{
+    if ( _elementJustOpened ) {
+        SealElement();
+    }
+}
+
+
 void XMLPrinter::PushText( const char* text, bool cdata )
 {
     _textDepth = _depth-1;
@@ -1971,6 +2863,14 @@ void XMLPrinter::PushText( unsigned value )
 }
 
 
+void XMLPrinter::PushText( int64_t value )
+{
+    char buf[BUF_SIZE];
+    XMLUtil::ToStr( value, buf, BUF_SIZE );
+    PushText( buf, false );
+}
+
+
 void XMLPrinter::PushText( bool value )
 {
     char buf[BUF_SIZE];
@@ -2091,5 +2991,725 @@ bool XMLPrinter::Visit( const XMLUnknown& unknown )
     return true;
 }
 
+// --------- XMLCompactDocument ---------- //
+
+XMLCompactDocument::XMLCompactDocument( bool processEntities, Whitespace whitespace ) :
+    _processEntities( processEntities ),
+    _whitespace( whitespace ),
+    _errorID( XML_NO_ERROR ),
+    _charBuffer( 0 ),
+    _charBufferIsCallers( false ),
+    _charBufferMapSize( 0 ),
+    _nameIdFunction( 0 ),
+    _attributeNameIdFunction( 0 ),
+    _maxElementDepth( TIXML2_DEFAULT_MAX_ELEMENT_DEPTH )
+{
+}
+
+
+XMLCompactDocument::~XMLCompactDocument()
+{
+    Clear();
+}
+
+
+void XMLCompactDocument::Clear()
+{
+    _nodes.PopArr( _nodes.Size() );
+    _attributes.PopArr( _attributes.Size() );
+    _errorID = XML_NO_ERROR;
+#if defined(TINYXML2_MMAP)
+    if ( _charBufferMapSize ) {
+        munmap( _charBuffer, _charBufferMapSize );
+        _charBuffer = 0;
+        _charBufferMapSize = 0;
+    }
+#endif
+    if ( !_charBufferIsCallers ) {
+        delete [] _charBuffer;
+    }
+    _charBuffer = 0;
+    _charBufferIsCallers = false;
+}
+
+
+size_t XMLCompactDocument::MemoryUsed() const
+{
+    return _nodes.Capacity() * sizeof( NodeEntry ) + _attributes.Capacity() * sizeof( AttributeEntry );
+}
+
+
+XMLError XMLCompactDocument::Parse( const char* xml, size_t nBytes )
+{
+    Clear();
+
+    if ( !xml || !*xml ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT );
+        return _errorID;
+    }
+    if ( nBytes == (size_t)(-1) ) {
+        nBytes = strlen( xml );
+    }
+    _charBuffer = new char[ nBytes+1 ];
+    memcpy( _charBuffer, xml, nBytes );
+    ParseCharBuffer( nBytes );
+    return _errorID;
+}
+
+
+XMLError XMLCompactDocument::ParseInPlace( char* xml, size_t nBytes )
+{
+    Clear();
+
+    if ( !xml ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT );
+        return _errorID;
+    }
+    _charBuffer = xml;
+    _charBufferIsCallers = true;
+    ParseCharBuffer( nBytes );
+    return _errorID;
+}
+
+
+XMLError XMLCompactDocument::LoadFile( const char* filename )
+{
+    Clear();
+    FILE* fp = 0;
+
+#if defined(_MSC_VER) && (_MSC_VER >= 1400 )
+    errno_t err = fopen_s(&fp, filename, "rb" );
+    if ( !fp || err) {
+#else
+    fp = fopen( filename, "rb" );
+    if ( !fp) {
+#endif
+        SetError( XML_ERROR_FILE_NOT_FOUND );
+        return _errorID;
+    }
+
+#if defined(_MSC_VER)
+    _fseeki64( fp, 0, SEEK_END );
+    long long filelength = _ftelli64( fp );
+    _fseeki64( fp, 0, SEEK_SET );
+#else
+    fseeko( fp, 0, SEEK_END );
+    long long filelength = ftello( fp );
+    fseeko( fp, 0, SEEK_SET );
+#endif
+    if ( filelength < 0 || (unsigned long long)filelength >= (size_t)(-1) ) {
+        fclose( fp );
+        SetError( XML_ERROR_FILE_READ_ERROR );
+        return _errorID;
+    }
+    size_t size = (size_t)filelength;
+
+    _charBuffer = new char[size+1];
+    size_t read = fread( _charBuffer, 1, size, fp );
+    fclose( fp );
+    if ( read != size ) {
+        SetError( XML_ERROR_FILE_READ_ERROR );
+        return _errorID;
+    }
+
+    ParseCharBuffer( size );
+    return _errorID;
+}
+
+
+XMLError XMLCompactDocument::LoadFileMapped( const char* filename )
+{
+#if defined(TINYXML2_MMAP)
+    // See XMLDocument::LoadFileMapped()
+    Clear();
+    int fd = open( filename, O_RDONLY );
+    if ( fd < 0 ) {
+        SetError( XML_ERROR_FILE_NOT_FOUND );
+        return _errorID;
+    }
+    struct stat st;
+    if ( fstat( fd, &st ) != 0 || !S_ISREG( st.st_mode ) || st.st_size == 0 ) {
+        close( fd );
+        return LoadFile( filename );
+    }
+    if ( (unsigned long long)st.st_size >= (size_t)(-1) / 2 ) {
+        close( fd );
+        SetError( XML_ERROR_FILE_READ_ERROR );
+        return _errorID;
+    }
+    size_t size = (size_t)st.st_size;
+    size_t mapSize = 0;
+    char* mem = MapFile( fd, size, &mapSize );
+    close( fd );
+    if ( !mem ) {
+        return LoadFile( filename );
+    }
+
+    _charBuffer = mem;
+    _charBufferMapSize = mapSize;
+    ParseCharBuffer( size );
+    return _errorID;
+#else
+    return LoadFile( filename );
+#endif
+}
+
+
+unsigned XMLCompactDocument::AddNode( unsigned parent, NodeType type )
+{
+    unsigned index = (unsigned)_nodes.Size();
+    NodeEntry* node = _nodes.PushArr( 1 );
+    node->_value = 0;
+    node->_parent = parent;
+    node->_firstChild = NO_INDEX;
+    node->_lastChild = NO_INDEX;
+    node->_next = NO_INDEX;
+    node->_firstAttribute = (unsigned)_attributes.Size();
+    node->_nameId = -1;
+    node->_type = type;
+
+    if ( parent != NO_INDEX ) {
+        NodeEntry& parentNode = _nodes[parent];
+        if ( parentNode._lastChild != NO_INDEX ) {
+            _nodes[parentNode._lastChild]._next = index;
+        }
+        else {
+            parentNode._firstChild = index;
+        }
+        parentNode._lastChild = index;
+    }
+    return index;
+}
+
+
+size_t XMLCompactDocument::Offset( StrPair* str )
+{
+    // Entities and new lines are processed in place, and the string
+    // is terminated where the text after it was; it must have been
+    // read past already.
+    return (size_t)( str->GetStr() - _charBuffer );
+}
+
+
+unsigned XMLCompactDocument::AttributeEnd( unsigned node ) const
+{
+    // The attributes are added along with their node, in document order
+    if ( node + 1 < _nodes.Size() ) {
+        return _nodes[node + 1]._firstAttribute;
+    }
+    return (unsigned)_attributes.Size();
+}
+
+
+char* XMLCompactDocument::ParseAttributes( char* p, bool* closed )
+{
+    unsigned first = (unsigned)_attributes.Size();
+    for( ;; ) {
+        p = XMLUtil::SkipWhiteSpace( p );
+        if ( XMLUtil::IsNameStartChar( *p ) ) {
+            // See XMLAttribute::ParseDeep()
+            char* nameStart = p;
+            StrPair name;
+            p = name.ParseName( p );
+            if ( !p || !*p ) {
+                SetError( XML_ERROR_PARSING_ATTRIBUTE );
+                return 0;
+            }
+            int nameId = _attributeNameIdFunction ? _attributeNameIdFunction( nameStart, p - nameStart ) : -1;
+            p = XMLUtil::SkipWhiteSpace( p );
+            if ( *p != '=' ) {
+                SetError( XML_ERROR_PARSING_ATTRIBUTE );
+                return 0;
+            }
+            ++p;
+            p = XMLUtil::SkipWhiteSpace( p );
+            if ( *p != '\"' && *p != '\'' ) {
+                SetError( XML_ERROR_PARSING_ATTRIBUTE );
+                return 0;
+            }
+            char endTag[2] = { *p, 0 };
+            ++p;
+            StrPair value;
+            p = value.ParseText( p, endTag, _processEntities ? StrPair::ATTRIBUTE_VALUE : StrPair::ATTRIBUTE_VALUE_LEAVE_ENTITIES );
+            if ( !p ) {
+                SetError( XML_ERROR_PARSING_ATTRIBUTE );
+                return 0;
+            }
+
+            if ( _attributes.Size() >= NO_INDEX - 1 ) {
+                SetError( XML_ERROR_PARSING_ATTRIBUTE );
+                return 0;
+            }
+
+            // Both the name and the value have been read past
+            AttributeEntry* attribute = _attributes.PushArr( 1 );
+            attribute->_name = Offset( &name );
+            attribute->_value = Offset( &value );
+            attribute->_nameId = nameId;
+
+            const char* attributeName = _charBuffer + attribute->_name;
+            for( unsigned i = first; i + 1 < _attributes.Size(); ++i ) {
+                if ( _attributes[i]._nameId == nameId && XMLUtil::StringEqual( _charBuffer + _attributes[i]._name, attributeName ) ) {
+                    SetError( XML_ERROR_PARSING_ATTRIBUTE );
+                    return 0;
+                }
+            }
+        }
+        else if ( *p == '/' && *(p+1) == '>' ) {
+            *closed = true;
+            return p+2;
+        }
+        else if ( *p == '>' ) {
+            *closed = false;
+            return p+1;
+        }
+        else {
+            SetError( XML_ERROR_PARSING_ELEMENT );
+            return 0;
+        }
+    }
+}
+
+
+void XMLCompactDocument::ParseCharBuffer( size_t nBytes )
+{
+    _charBuffer[nBytes] = 0;
+    AddNode( NO_INDEX, NODE_DOCUMENT );
+
+    bool hasBOM = false;
+    const char* begin = XMLUtil::SkipWhiteSpace( _charBuffer );
+    begin = XMLUtil::ReadBOM( begin, &hasBOM );
+    if ( !*begin ) {
+        SetError( XML_ERROR_EMPTY_DOCUMENT );
+        return;
+    }
+
+    // The same node kinds as XMLDocument::Identify() gives, read with
+    // the same StrPair rules. The open elements are a chain of parents,
+    // so nesting doesn't recurse.
+    char* p = _charBuffer + ( begin - _charBuffer );
+    unsigned parent = 0;
+    int depth = 0;
+    // Text ends at the '<' of the next tag, so the string is finished
+    // once that is read past
+    StrPair text;
+    unsigned textNode = NO_INDEX;
+    bool atOpenTag = false;
+    while( *p ) {
+        atOpenTag = false;
+        char* start = p;
+        p = XMLUtil::SkipWhiteSpace( p );
+        if ( !*p ) {
+            break;
+        }
+        // The links between nodes are 32 bit
+        if ( _nodes.Size() >= NO_INDEX - 1 ) {
+            SetError( XML_ERROR_PARSING );
+            break;
+        }
+
+        if ( *p != '<' ) {
+            // All the text counts, the white space before it too
+            int flags = _processEntities ? StrPair::TEXT_ELEMENT : StrPair::TEXT_ELEMENT_LEAVE_ENTITIES;
+            if ( _whitespace == COLLAPSE_WHITESPACE ) {
+                flags |= StrPair::COLLAPSE_WHITESPACE;
+            }
+            p = text.ParseText( start, "<", flags );
+            if ( !p || !*p ) {
+                SetError( p ? XML_ERROR_PARSING : XML_ERROR_PARSING_TEXT );
+                break;
+            }
+            textNode = AddNode( parent, NODE_TEXT );
+            --p;
+            continue;
+        }
+
+        NodeType type = NODE_ELEMENT;
+        const char* endTag = 0;
+        int flags = StrPair::NEEDS_NEWLINE_NORMALIZATION;
+        XMLError error = XML_NO_ERROR;
+        if ( XMLUtil::StringEqual( p, "<?", 2 ) ) {
+            type = NODE_DECLARATION;
+            endTag = "?>";
+            error = XML_ERROR_PARSING_DECLARATION;
+            p += 2;
+        }
+        else if ( XMLUtil::StringEqual( p, "<!--", 4 ) ) {
+            type = NODE_COMMENT;
+            endTag = "-->";
+            flags = StrPair::COMMENT;
+            error = XML_ERROR_PARSING_COMMENT;
+            p += 4;
+        }
+        else if ( XMLUtil::StringEqual( p, "<![CDATA[", 9 ) ) {
+            type = NODE_CDATA;
+            endTag = "]]>";
+            error = XML_ERROR_PARSING_CDATA;
+            p += 9;
+        }
+        else if ( XMLUtil::StringEqual( p, "<!", 2 ) ) {
+            type = NODE_UNKNOWN;
+            endTag = ">";
+            error = XML_ERROR_PARSING_UNKNOWN;
+            p += 2;
+        }
+        else {
+            ++p;
+        }
+        if ( textNode != NO_INDEX ) {
+            _nodes[textNode]._value = Offset( &text );
+            textNode = NO_INDEX;
+        }
+
+        if ( type != NODE_ELEMENT ) {
+            StrPair value;
+            p = value.ParseText( p, endTag, flags );
+            if ( !p ) {
+                SetError( error );
+                break;
+            }
+            unsigned node = AddNode( parent, type );
+            _nodes[node]._value = Offset( &value );
+            continue;
+        }
+
+        // A start or end tag, see XMLElement::ParseDeep(). As there, an
+        // end tag is read like a start tag, attributes and all, and one
+        // that ends in "/>" is an empty element.
+        p = XMLUtil::SkipWhiteSpace( p );
+        bool closing = *p == '/';
+        if ( closing ) {
+            ++p;
+        }
+        char* nameStart = p;
+        StrPair name;
+        p = name.ParseName( p );
+        if ( !p ) {
+            SetError( XML_ERROR_PARSING );
+            break;
+        }
+
+        unsigned lastChild = _nodes[parent]._lastChild;
+        unsigned node = AddNode( parent, NODE_ELEMENT );
+        if ( _nameIdFunction ) {
+            _nodes[node]._nameId = _nameIdFunction( nameStart, p - nameStart );
+        }
+        bool closed = false;
+        p = ParseAttributes( p, &closed );
+        if ( !p ) {
+            break;
+        }
+        _nodes[node]._value = Offset( &name );
+
+        if ( closing && !closed ) {
+            bool matches = depth > 0 && XMLUtil::StringEqual( _charBuffer + _nodes[node]._value, _charBuffer + _nodes[parent]._value );
+            _attributes.PopArr( _attributes.Size() - _nodes[node]._firstAttribute );
+            _nodes.PopArr( 1 );
+            _nodes[parent]._lastChild = lastChild;
+            if ( lastChild != NO_INDEX ) {
+                _nodes[lastChild]._next = NO_INDEX;
+            }
+            else {
+                _nodes[parent]._firstChild = NO_INDEX;
+            }
+            if ( depth == 0 ) {
+                // XMLDocument stops at an end tag with no open element too
+                break;
+            }
+            if ( !matches ) {
+                SetError( XML_ERROR_MISMATCHED_ELEMENT );
+                break;
+            }
+            parent = _nodes[parent]._parent;
+            --depth;
+            continue;
+        }
+        if ( !closed ) {
+            if ( depth >= _maxElementDepth ) {
+                SetError( XML_ERROR_ELEMENT_DEPTH );
+                break;
+            }
+            parent = node;
+            ++depth;
+            atOpenTag = true;
+        }
+    }
+
+    if ( !Error() && depth > 0 ) {
+        // The text ended inside an element, with the same error codes
+        // as XMLNode::ParseDeep()
+        SetError( atOpenTag ? XML_ERROR_MISMATCHED_ELEMENT : XML_ERROR_PARSING );
+    }
+    if ( Error() ) {
+        // Nothing of a document that failed is kept
+        _nodes.PopArr( _nodes.Size() - 1 );
+        _attributes.PopArr( _attributes.Size() );
+        _nodes[0]._firstChild = NO_INDEX;
+        _nodes[0]._lastChild = NO_INDEX;
+    }
+}
+
+
+// --------- XMLCompactNode ---------- //
+
+XMLCompactNode::XMLCompactNode( const XMLCompactDocument* doc, unsigned index ) :
+    _document( index != XMLCompactDocument::NO_INDEX ? doc : 0 ),
+    _index( index != XMLCompactDocument::NO_INDEX ? index : 0 )
+{
+}
+
+
+XMLCompactNode XMLCompactNode::ToElement() const
+{
+    if ( _document->_nodes[_index]._type == XMLCompactDocument::NODE_ELEMENT ) {
+        return *this;
+    }
+    return XMLCompactNode();
+}
+
+
+XMLCompactNode XMLCompactNode::ToText() const
+{
+    unsigned type = _document->_nodes[_index]._type;
+    if ( type == XMLCompactDocument::NODE_TEXT || type == XMLCompactDocument::NODE_CDATA ) {
+        return *this;
+    }
+    return XMLCompactNode();
+}
+
+
+XMLCompactNode XMLCompactNode::ToDocument() const
+{
+    return _index == 0 ? *this : XMLCompactNode();
+}
+
+
+bool XMLCompactNode::CData() const
+{
+    return _document->_nodes[_index]._type == XMLCompactDocument::NODE_CDATA;
+}
+
+
+const char* XMLCompactNode::Value() const
+{
+    if ( _index == 0 ) {
+        return "";
+    }
+    return _document->_charBuffer + _document->_nodes[_index]._value;
+}
+
+
+int XMLCompactNode::NameId() const
+{
+    return _document->_nodes[_index]._nameId;
+}
+
+
+XMLCompactNode XMLCompactNode::Parent() const
+{
+    return XMLCompactNode( _document, _document->_nodes[_index]._parent );
+}
+
+
+XMLCompactNode XMLCompactNode::FirstChild() const
+{
+    return XMLCompactNode( _document, _document->_nodes[_index]._firstChild );
+}
+
+
+XMLCompactNode XMLCompactNode::LastChild() const
+{
+    return XMLCompactNode( _document, _document->_nodes[_index]._lastChild );
+}
+
+
+XMLCompactNode XMLCompactNode::PreviousSibling() const
+{
+    unsigned parent = _document->_nodes[_index]._parent;
+    if ( parent == XMLCompactDocument::NO_INDEX ) {
+        return XMLCompactNode();
+    }
+    unsigned previous = XMLCompactDocument::NO_INDEX;
+    for( unsigned i = _document->_nodes[parent]._firstChild; i != _index; i = _document->_nodes[i]._next ) {
+        previous = i;
+    }
+    return XMLCompactNode( _document, previous );
+}
+
+
+XMLCompactNode XMLCompactNode::NextSibling() const
+{
+    return XMLCompactNode( _document, _document->_nodes[_index]._next );
+}
+
+
+XMLCompactNode XMLCompactNode::FirstChildElement( const char* value ) const
+{
+    for( XMLCompactNode node = FirstChild(); node; node = node.NextSibling() ) {
+        if ( node.ToElement() && ( !value || XMLUtil::StringEqual( node.Value(), value ) ) ) {
+            return node;
+        }
+    }
+    return XMLCompactNode();
+}
+
+
+XMLCompactNode XMLCompactNode::LastChildElement( const char* value ) const
+{
+    XMLCompactNode found;
+    for( XMLCompactNode node = FirstChild(); node; node = node.NextSibling() ) {
+        if ( node.ToElement() && ( !value || XMLUtil::StringEqual( node.Value(), value ) ) ) {
+            found = node;
+        }
+    }
+    return found;
+}
+
+
+XMLCompactNode XMLCompactNode::NextSiblingElement( const char* value ) const
+{
+    for( XMLCompactNode node = NextSibling(); node; node = node.NextSibling() ) {
+        if ( node.ToElement() && ( !value || XMLUtil::StringEqual( node.Value(), value ) ) ) {
+            return node;
+        }
+    }
+    return XMLCompactNode();
+}
+
+
+XMLCompactNode XMLCompactNode::FirstChildElementById( int nameId ) const
+{
+    for( XMLCompactNode node = FirstChild(); node; node = node.NextSibling() ) {
+        if ( node.ToElement() && node.NameId() == nameId ) {
+            return node;
+        }
+    }
+    return XMLCompactNode();
+}
+
+
+XMLCompactNode XMLCompactNode::NextSiblingElementById( int nameId ) const
+{
+    for( XMLCompactNode node = NextSibling(); node; node = node.NextSibling() ) {
+        if ( node.ToElement() && node.NameId() == nameId ) {
+            return node;
+        }
+    }
+    return XMLCompactNode();
+}
+
+
+XMLCompactAttribute XMLCompactNode::FirstAttribute() const
+{
+    return XMLCompactAttribute( _document, _document->_nodes[_index]._firstAttribute, _document->AttributeEnd( _index ) );
+}
+
+
+XMLCompactAttribute XMLCompactNode::FindAttribute( const char* name ) const
+{
+    for( XMLCompactAttribute a = FirstAttribute(); a; a = a.Next() ) {
+        if ( XMLUtil::StringEqual( a.Name(), name ) ) {
+            return a;
+        }
+    }
+    return XMLCompactAttribute();
+}
+
+
+XMLCompactAttribute XMLCompactNode::FindAttributeById( int nameId ) const
+{
+    for( XMLCompactAttribute a = FirstAttribute(); a; a = a.Next() ) {
+        if ( a.NameId() == nameId ) {
+            return a;
+        }
+    }
+    return XMLCompactAttribute();
+}
+
+
+const char* XMLCompactNode::Attribute( const char* name, const char* value ) const
+{
+    XMLCompactAttribute a = FindAttribute( name );
+    if ( !a ) {
+        return 0;
+    }
+    if ( !value || XMLUtil::StringEqual( a.Value(), value ) ) {
+        return a.Value();
+    }
+    return 0;
+}
+
+
+const char* XMLCompactNode::GetText() const
+{
+    XMLCompactNode child = FirstChild();
+    if ( child && child.ToText() ) {
+        return child.Value();
+    }
+    return 0;
+}
+
+
+// --------- XMLCompactAttribute ---------- //
+
+const char* XMLCompactAttribute::Name() const
+{
+    return _document->_charBuffer + _document->_attributes[_index]._name;
+}
+
+
+const char* XMLCompactAttribute::Value() const
+{
+    return _document->_charBuffer + _document->_attributes[_index]._value;
+}
+
+
+int XMLCompactAttribute::NameId() const
+{
+    return _document->_attributes[_index]._nameId;
+}
+
+
+XMLCompactAttribute XMLCompactAttribute::Next() const
+{
+    return XMLCompactAttribute( _document, _index + 1, _end );
+}
+
+
+XMLError XMLCompactAttribute::QueryIntValue( int* value ) const
+{
+    if ( XMLUtil::ToInt( Value(), value ) ) {
+        return XML_NO_ERROR;
+    }
+    return XML_WRONG_ATTRIBUTE_TYPE;
+}
+
+
+XMLError XMLCompactAttribute::QueryInt64Value( int64_t* value ) const
+{
+    if ( XMLUtil::ToInt64( Value(), value ) ) {
+        return XML_NO_ERROR;
+    }
+    return XML_WRONG_ATTRIBUTE_TYPE;
+}
+
+
+XMLError XMLCompactAttribute::QueryBoolValue( bool* value ) const
+{
+    if ( XMLUtil::ToBool( Value(), value ) ) {
+        return XML_NO_ERROR;
+    }
+    return XML_WRONG_ATTRIBUTE_TYPE;
+}
+
+
+XMLError XMLCompactAttribute::QueryDoubleValue( double* value ) const
+{
+    if ( XMLUtil::ToDouble( Value(), value ) ) {
+        return XML_NO_ERROR;
+    }
+    return XML_WRONG_ATTRIBUTE_TYPE;
+}
+
 }   // namespace tinyxml2
 
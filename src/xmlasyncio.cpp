@@ -0,0 +1,518 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+
+#include "xmlasyncio.h"
+
+#if defined(__linux__) || defined(__APPLE__)
+#define SKPTOXML_ASYNC_STREAMS 1
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define SKPTOXML_IO_URING 1
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <linux/io_uring.h>
+#endif
+#endif
+
+// Chunks are a multiple of the page size and start at multiples of their
+// size in the file, which keeps the writes aligned
+static const size_t kChunkSize = 1 << 20;
+static const size_t kChunkAlignment = 4096;
+static const int kNumChunks = 4;
+static const int kNumThreads = 2;
+// The stream's own buffer, copied into the chunks
+static const size_t kStreamBufferSize = 64 * 1024;
+
+//------------------------------------------------------------------------------
+
+#if defined(SKPTOXML_IO_URING)
+
+// A minimal io_uring submission and completion ring, set up with the raw
+// system calls so that no library is needed
+class CXmlIoUring {
+ public:
+  CXmlIoUring()
+    : fd_(-1), sq_ring_(NULL), cq_ring_(NULL), sqes_(NULL), sq_ring_size_(0),
+      cq_ring_size_(0), sqes_size_(0) {}
+
+  ~CXmlIoUring() {
+    if (sqes_ != NULL)
+      munmap(sqes_, sqes_size_);
+    if (cq_ring_ != NULL && cq_ring_ != sq_ring_)
+      munmap(cq_ring_, cq_ring_size_);
+    if (sq_ring_ != NULL)
+      munmap(sq_ring_, sq_ring_size_);
+    if (fd_ >= 0)
+      close(fd_);
+  }
+
+  bool Init(unsigned entries) {
+    io_uring_params params;
+    memset(&params, 0, sizeof(params));
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+    if (fd_ < 0)
+      return false;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes +
+                    params.cq_entries * sizeof(io_uring_cqe);
+    bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap && cq_ring_size_ > sq_ring_size_)
+      sq_ring_size_ = cq_ring_size_;
+    sq_ring_ = Map(sq_ring_size_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == NULL)
+      return false;
+    cq_ring_ = single_mmap ? sq_ring_ : Map(cq_ring_size_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == NULL)
+      return false;
+    sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+    sqes_ = static_cast<io_uring_sqe*>(
+        static_cast<void*>(Map(sqes_size_, IORING_OFF_SQES)));
+    if (sqes_ == NULL)
+      return false;
+
+    sq_tail_ = Field(sq_ring_, params.sq_off.tail);
+    sq_mask_ = *Field(sq_ring_, params.sq_off.ring_mask);
+    sq_array_ = Field(sq_ring_, params.sq_off.array);
+    cq_head_ = Field(cq_ring_, params.cq_off.head);
+    cq_tail_ = Field(cq_ring_, params.cq_off.tail);
+    cq_mask_ = *Field(cq_ring_, params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq_ring_ + params.cq_off.cqes);
+    iovecs_.resize(entries);
+    return true;
+  }
+
+  // The iovec is kept per user_data, which must be below the ring size
+  bool SubmitWrite(int fd, const char* data, size_t size, uint64_t offset,
+                   uint64_t user_data) {
+    iovec& iov = iovecs_[user_data];
+    iov.iov_base = const_cast<char*>(data);
+    iov.iov_len = size;
+
+    unsigned tail = *sq_tail_;
+    unsigned index = tail & sq_mask_;
+    io_uring_sqe& sqe = sqes_[index];
+    memset(&sqe, 0, sizeof(sqe));
+    sqe.opcode = IORING_OP_WRITEV;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<uint64_t>(&iov);
+    sqe.len = 1;
+    sqe.off = offset;
+    sqe.user_data = user_data;
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+
+    int submitted;
+    do {
+      submitted = Enter(1, 0, 0);
+    } while (submitted < 0 && errno == EINTR);
+    if (submitted != 1) {
+      // Take the entry back, so that it is not submitted later on
+      __atomic_store_n(sq_tail_, tail, __ATOMIC_RELEASE);
+      return false;
+    }
+    return true;
+  }
+
+  // Waits for the next completion
+  bool WaitCompletion(uint64_t& user_data, int& result) {
+    unsigned head = *cq_head_;
+    while (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+      if (Enter(0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+        return false;
+    }
+    const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+    user_data = cqe.user_data;
+    result = cqe.res;
+    __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+    return true;
+  }
+
+ private:
+  char* Map(size_t size, off_t offset) {
+    void* p = mmap(NULL, size, PROT_READ | PROT_WRITE,
+                   MAP_SHARED | MAP_POPULATE, fd_, offset);
+    return p != MAP_FAILED ? static_cast<char*>(p) : NULL;
+  }
+
+  static unsigned* Field(char* ring, unsigned offset) {
+    return reinterpret_cast<unsigned*>(ring + offset);
+  }
+
+  int Enter(unsigned to_submit, unsigned min_complete, unsigned flags) {
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd_, to_submit,
+                                    min_complete, flags, NULL, 0));
+  }
+
+  int fd_;
+  char* sq_ring_;
+  char* cq_ring_;
+  io_uring_sqe* sqes_;
+  size_t sq_ring_size_;
+  size_t cq_ring_size_;
+  size_t sqes_size_;
+
+  unsigned* sq_tail_;
+  unsigned sq_mask_;
+  unsigned* sq_array_;
+  unsigned* cq_head_;
+  unsigned* cq_tail_;
+  unsigned cq_mask_;
+  io_uring_cqe* cqes_;
+  std::vector<iovec> iovecs_;
+};
+
+#else
+
+class CXmlIoUring {
+ public:
+  bool Init(unsigned /*entries*/) { return false; }
+  bool SubmitWrite(int /*fd*/, const char* /*data*/, size_t /*size*/,
+                   uint64_t /*offset*/, uint64_t /*user_data*/) {
+    return false;
+  }
+  bool WaitCompletion(uint64_t& /*user_data*/, int& /*result*/) {
+    return false;
+  }
+};
+
+#endif
+
+//------------------------------------------------------------------------------
+
+CXmlAsyncFile::CXmlAsyncFile()
+  : requested_backend_(XmlAsyncBackend_IoUring),
+    backend_(XmlAsyncBackend_None),
+    fd_(-1),
+    stream_(NULL),
+    offset_(0),
+    failed_(false),
+    current_chunk_(-1),
+    stopping_(false),
+    ring_(NULL) {
+}
+
+CXmlAsyncFile::~CXmlAsyncFile() {
+  Close();
+  for (size_t i = 0; i < chunks_.size(); ++i)
+    free(chunks_[i].data_);
+}
+
+void CXmlAsyncFile::Preallocate(int fd, uint64_t size) {
+  // The reservation is only a hint, so failures are ignored. The file size
+  // is left alone, so no trimming is needed if the estimate was too large.
+  if (fd < 0 || size == 0)
+    return;
+#if defined(__linux__)
+  fallocate(fd, FALLOC_FL_KEEP_SIZE, 0, static_cast<off_t>(size));
+#elif defined(__APPLE__)
+  fstore_t store;
+  memset(&store, 0, sizeof(store));
+  store.fst_flags = F_ALLOCATECONTIG | F_ALLOCATEALL;
+  store.fst_posmode = F_PEOFPOSMODE;
+  store.fst_length = static_cast<off_t>(size);
+  if (fcntl(fd, F_PREALLOCATE, &store) == -1) {
+    store.fst_flags = F_ALLOCATEALL;
+    fcntl(fd, F_PREALLOCATE, &store);
+  }
+#endif
+}
+
+FILE* CXmlAsyncFile::Open(const std::string& filename,
+                          uint64_t estimated_size) {
+  Close();
+  failed_ = false;
+  offset_ = 0;
+
+#if defined(SKPTOXML_ASYNC_STREAMS)
+  if (requested_backend_ != XmlAsyncBackend_None) {
+    fd_ = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+    if (fd_ < 0)
+      return NULL;
+    Preallocate(fd_, estimated_size);
+
+    if (chunks_.empty()) {
+      for (int i = 0; i < kNumChunks; ++i) {
+        Chunk chunk;
+        void* data = NULL;
+        if (posix_memalign(&data, kChunkAlignment, kChunkSize) != 0)
+          break;
+        chunk.data_ = static_cast<char*>(data);
+        chunk.size_ = 0;
+        chunk.offset_ = 0;
+        chunk.written_ = 0;
+        chunks_.push_back(chunk);
+      }
+    }
+    free_chunks_.clear();
+    for (size_t i = 0; i < chunks_.size(); ++i)
+      free_chunks_.push_back(static_cast<int>(i));
+
+    if (requested_backend_ == XmlAsyncBackend_IoUring) {
+      ring_ = new CXmlIoUring;
+      if (ring_->Init(kNumChunks)) {
+        backend_ = XmlAsyncBackend_IoUring;
+      } else {
+        delete ring_;
+        ring_ = NULL;
+      }
+    }
+    if (backend_ == XmlAsyncBackend_None) {
+      stopping_ = false;
+      for (int i = 0; i < kNumThreads; ++i)
+        threads_.push_back(std::thread(&CXmlAsyncFile::WriteChunks, this));
+      backend_ = XmlAsyncBackend_Threads;
+    }
+
+#if defined(__linux__)
+    cookie_io_functions_t functions;
+    memset(&functions, 0, sizeof(functions));
+    functions.write = StreamWrite;
+    functions.close = StreamClose;
+    stream_ = fopencookie(this, "w", functions);
+#else
+    stream_ = funopen(this, NULL, StreamWrite, NULL, StreamClose);
+#endif
+    if (stream_ == NULL || chunks_.empty()) {
+      Close();
+      return NULL;
+    }
+    setvbuf(stream_, NULL, _IOFBF, kStreamBufferSize);
+    return stream_;
+  }
+#endif
+
+  // Binary mode, so the byte counts of the printers match the file
+  stream_ = fopen(filename.c_str(), "wb");
+#if defined(SKPTOXML_ASYNC_STREAMS)
+  if (stream_ != NULL)
+    Preallocate(fileno(stream_), estimated_size);
+#endif
+  return stream_;
+}
+
+bool CXmlAsyncFile::Close() {
+  bool ok = true;
+  if (stream_ != NULL) {
+    // Flushes the last of the printed bytes into the chunks
+    ok = fclose(stream_) == 0;
+    stream_ = NULL;
+  }
+
+  if (backend_ != XmlAsyncBackend_None) {
+    if (current_chunk_ >= 0) {
+      if (chunks_[current_chunk_].size_ > 0)
+        SubmitChunk(current_chunk_);
+      else
+        ReleaseChunk(current_chunk_, true);
+      current_chunk_ = -1;
+    }
+    WaitForAllChunks();
+
+    if (backend_ == XmlAsyncBackend_Threads) {
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+      }
+      chunk_queued_.notify_all();
+      for (size_t i = 0; i < threads_.size(); ++i)
+        threads_[i].join();
+      threads_.clear();
+    }
+    delete ring_;
+    ring_ = NULL;
+    backend_ = XmlAsyncBackend_None;
+  }
+
+#if defined(SKPTOXML_ASYNC_STREAMS)
+  if (fd_ >= 0) {
+    ok &= close(fd_) == 0;
+    fd_ = -1;
+  }
+#endif
+  return ok && !failed_;
+}
+
+bool CXmlAsyncFile::Append(const char* data, size_t size) {
+  while (size > 0) {
+    if (current_chunk_ < 0) {
+      current_chunk_ = AcquireChunk();
+      if (current_chunk_ < 0)
+        return false;
+    }
+    Chunk& chunk = chunks_[current_chunk_];
+    size_t count = kChunkSize - chunk.size_;
+    if (count > size)
+      count = size;
+    memcpy(chunk.data_ + chunk.size_, data, count);
+    chunk.size_ += count;
+    data += count;
+    size -= count;
+    if (chunk.size_ == kChunkSize) {
+      SubmitChunk(current_chunk_);
+      current_chunk_ = -1;
+    }
+  }
+  return true;
+}
+
+int CXmlAsyncFile::AcquireChunk() {
+  if (backend_ == XmlAsyncBackend_IoUring) {
+    while (free_chunks_.empty() && !failed_) {
+      if (!ReapChunk())
+        failed_ = true;
+    }
+  } else {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (free_chunks_.empty() && !failed_)
+      chunk_released_.wait(lock);
+  }
+  // Once a write failed the rest is dropped
+  if (failed_ || free_chunks_.empty())
+    return -1;
+  int index = free_chunks_.back();
+  free_chunks_.pop_back();
+  chunks_[index].size_ = 0;
+  return index;
+}
+
+void CXmlAsyncFile::SubmitChunk(int index) {
+  Chunk& chunk = chunks_[index];
+  chunk.offset_ = offset_;
+  chunk.written_ = 0;
+  offset_ += chunk.size_;
+
+  if (backend_ == XmlAsyncBackend_IoUring) {
+    if (!ring_->SubmitWrite(fd_, chunk.data_, chunk.size_, chunk.offset_,
+                            index)) {
+      ReleaseChunk(index, WriteAll(fd_, chunk.data_, chunk.size_,
+                                   chunk.offset_));
+    }
+  } else {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      queue_.push_back(index);
+    }
+    chunk_queued_.notify_one();
+  }
+}
+
+void CXmlAsyncFile::ReleaseChunk(int index, bool ok) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!ok)
+      failed_ = true;
+    free_chunks_.push_back(index);
+  }
+  chunk_released_.notify_all();
+}
+
+void CXmlAsyncFile::WaitForAllChunks() {
+  if (backend_ == XmlAsyncBackend_IoUring) {
+    // The chunks in flight must complete before their memory can be reused,
+    // even after a failure
+    while (free_chunks_.size() < chunks_.size()) {
+      if (!ReapChunk()) {
+        failed_ = true;
+        break;
+      }
+    }
+  } else {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (free_chunks_.size() < chunks_.size())
+      chunk_released_.wait(lock);
+  }
+}
+
+void CXmlAsyncFile::WriteChunks() {
+  for (;;) {
+    int index;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      while (queue_.empty() && !stopping_)
+        chunk_queued_.wait(lock);
+      if (queue_.empty())
+        return;
+      index = queue_.front();
+      queue_.pop_front();
+    }
+    const Chunk& chunk = chunks_[index];
+    ReleaseChunk(index, WriteAll(fd_, chunk.data_, chunk.size_,
+                                 chunk.offset_));
+  }
+}
+
+bool CXmlAsyncFile::ReapChunk() {
+  uint64_t user_data = 0;
+  int result = 0;
+  if (!ring_->WaitCompletion(user_data, result))
+    return false;
+
+  int index = static_cast<int>(user_data);
+  Chunk& chunk = chunks_[index];
+  if (result <= 0) {
+    ReleaseChunk(index, false);
+    return true;
+  }
+  chunk.written_ += static_cast<size_t>(result);
+  if (chunk.written_ < chunk.size_) {
+    // Short write, submit the rest
+    const char* data = chunk.data_ + chunk.written_;
+    size_t size = chunk.size_ - chunk.written_;
+    uint64_t offset = chunk.offset_ + chunk.written_;
+    if (!ring_->SubmitWrite(fd_, data, size, offset, index))
+      ReleaseChunk(index, WriteAll(fd_, data, size, offset));
+    return true;
+  }
+  ReleaseChunk(index, true);
+  return true;
+}
+
+bool CXmlAsyncFile::WriteAll(int fd, const char* data, size_t size,
+                             uint64_t offset) {
+#if defined(SKPTOXML_ASYNC_STREAMS)
+  while (size > 0) {
+    ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+    if (written < 0 && errno == EINTR)
+      continue;
+    if (written <= 0)
+      return false;
+    data += written;
+    size -= static_cast<size_t>(written);
+    offset += static_cast<uint64_t>(written);
+  }
+  return true;
+#else
+  return false;
+#endif
+}
+
+#if defined(__linux__)
+ssize_t CXmlAsyncFile::StreamWrite(void* cookie, const char* data,
+                                   size_t size) {
+  CXmlAsyncFile* file = static_cast<CXmlAsyncFile*>(cookie);
+  return file->Append(data, size) ? static_cast<ssize_t>(size) : -1;
+}
+
+int CXmlAsyncFile::StreamClose(void* /*cookie*/) {
+  // The file descriptor is closed once the chunks are written
+  return 0;
+}
+#elif defined(__APPLE__)
+int CXmlAsyncFile::StreamWrite(void* cookie, const char* data, int size) {
+  CXmlAsyncFile* file = static_cast<CXmlAsyncFile*>(cookie);
+  return file->Append(data, static_cast<size_t>(size)) ? size : -1;
+}
+
+int CXmlAsyncFile::StreamClose(void* /*cookie*/) {
+  return 0;
+}
+#endif
@@ -0,0 +1,676 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <vector>
+
+#include "xmlbenchmark.h"
+#include "tinyxml2.h"
+#include "xmlfile.h"
+
+static const char* kSkpToXMLTag = "SkpToXML";
+static const char* kGeometryTag = "Geometry";
+static const char* kFaceTag = "Face";
+static const char* kTrianglesTag = "Triangles";
+static const char* kCountTag = "Count";
+static const char* kVertexTag = "Vertex";
+static const char* kIndexTag = "Index";
+
+// Triangle counts written to the large document start here
+static const int64_t kLargeCountBase = 1LL << 32;
+
+// Text of each face of the large document, and the small elements after it,
+// so that the DOM holds millions of nodes
+static const size_t kLargePayloadBytes = 64 << 10;
+static const int kLargeVerticesPerFace = 32;
+
+static double GetSeconds() {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// 64-bit safe position of the end of the file
+static int64_t GetFileEnd(FILE* fp) {
+#if defined(_MSC_VER)
+  if (_fseeki64(fp, 0, SEEK_END) != 0)
+    return -1;
+  return _ftelli64(fp);
+#else
+  if (fseeko(fp, 0, SEEK_END) != 0)
+    return -1;
+  return ftello(fp);
+#endif
+}
+
+static double GetMegabytes(uint64_t bytes) {
+  return static_cast<double>(bytes) / (1 << 20);
+}
+
+static bool ReadFile(const std::string& filename, std::vector<char>& data) {
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL)
+    return false;
+  char buf[1 << 16];
+  size_t count = 0;
+  while ((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    data.insert(data.end(), buf, buf + count);
+  }
+  bool ok = ferror(fp) == 0;
+  fclose(fp);
+  return ok;
+}
+
+// Walks the tree without recursing, so deep nesting is fine
+static uint64_t CountElements(const tinyxml2::XMLNode* root) {
+  uint64_t count = 0;
+  const tinyxml2::XMLNode* node = root->FirstChild();
+  while (node != NULL) {
+    if (node->ToElement() != NULL)
+      ++count;
+    if (node->FirstChild() != NULL) {
+      node = node->FirstChild();
+      continue;
+    }
+    while (node != root && node->NextSibling() == NULL) {
+      node = node->Parent();
+    }
+    node = node != root ? node->NextSibling() : NULL;
+  }
+  return count;
+}
+
+//------------------------------------------------------------------------------
+// Large document
+
+// Prints faces until the printer has written min_bytes, returns their number
+static int64_t PrintLargeDocument(tinyxml2::XMLPrinter& printer,
+                                  const std::string& payload,
+                                  uint64_t min_bytes) {
+  printer.PushHeader(false, true);
+  printer.OpenElement(kSkpToXMLTag);
+  printer.OpenElement(kGeometryTag);
+  int64_t num_faces = 0;
+  while (printer.BytesWritten() < min_bytes) {
+    printer.OpenElement(kFaceTag);
+    printer.OpenElement(kTrianglesTag);
+    printer.PushAttribute(kCountTag, kLargeCountBase + num_faces);
+    printer.PushText(payload.c_str());
+    printer.CloseElement(); // Triangles
+    for (int i = 0; i < kLargeVerticesPerFace; ++i) {
+      printer.OpenElement(kVertexTag);
+      printer.PushAttribute(kIndexTag, i);
+      printer.CloseElement(); // Vertex
+    }
+    printer.CloseElement(); // Face
+    ++num_faces;
+  }
+  printer.CloseElement(); // Geometry
+  printer.CloseElement(); // SkpToXML
+  return num_faces;
+}
+
+// Reads the file in blocks, passing each to the function until it returns
+// false. Returns false if the file could not be read to the end.
+template <typename Function>
+static bool ReadFileBlocks(const std::string& filename,
+                           const Function& function) {
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL)
+    return false;
+  std::vector<char> buf(1 << 20);
+  bool ok = true;
+  size_t count = 0;
+  while (ok && (count = fread(&buf[0], 1, buf.size(), fp)) > 0) {
+    ok = function(&buf[0], count);
+  }
+  ok = ok && ferror(fp) == 0;
+  fclose(fp);
+  return ok;
+}
+
+static bool IsFileEqual(const std::string& filename, const char* data,
+                        uint64_t size) {
+  uint64_t offset = 0;
+  bool ok = ReadFileBlocks(filename, [data, size, &offset](const char* block,
+                                                          size_t count) {
+    if (offset + count > size || memcmp(block, data + offset, count) != 0)
+      return false;
+    offset += count;
+    return true;
+  });
+  return ok && offset == size;
+}
+
+static bool AreFilesEqual(const std::string& filename,
+                          const std::string& other_filename) {
+  FILE* other = fopen(other_filename.c_str(), "rb");
+  if (other == NULL)
+    return false;
+  std::vector<char> other_buf(1 << 20);
+  bool ok = ReadFileBlocks(filename, [other, &other_buf](const char* block,
+                                                        size_t count) {
+    return fread(&other_buf[0], 1, count, other) == count &&
+           memcmp(block, &other_buf[0], count) == 0;
+  });
+  // And the other file ends there too
+  ok = ok && fread(&other_buf[0], 1, 1, other) == 0 && ferror(other) == 0;
+  fclose(other);
+  return ok;
+}
+
+// The element is a const tinyxml2::XMLElement* or a tinyxml2::XMLCompactNode,
+// which read the same way
+template <typename Element>
+static bool CheckLargeDocument(const char* what, Element root,
+                               const std::string& payload, int64_t num_faces,
+                               uint64_t bytes, double seconds) {
+  Element geometry = root ? root->FirstChildElement(kGeometryTag) : Element();
+  if (!geometry)
+    return false;
+
+  int64_t num_read = 0;
+  size_t mismatches = 0;
+  for (Element face = geometry->FirstChildElement(kFaceTag); face;
+       face = face->NextSiblingElement(kFaceTag)) {
+    Element triangles = face->FirstChildElement(kTrianglesTag);
+    int64_t count = 0;
+    int num_vertices = 0;
+    for (Element vertex = face->FirstChildElement(kVertexTag); vertex;
+         vertex = vertex->NextSiblingElement(kVertexTag)) {
+      if (vertex->IntAttribute(kIndexTag) == num_vertices)
+        ++num_vertices;
+    }
+    if (!triangles ||
+        triangles->QueryInt64Attribute(kCountTag, &count) !=
+            tinyxml2::XML_NO_ERROR ||
+        count != kLargeCountBase + num_read ||
+        num_vertices != kLargeVerticesPerFace) {
+      ++mismatches;
+    } else if (num_read == 0 || num_read == num_faces - 1) {
+      // The last one lies beyond 4GB
+      const char* text = triangles->GetText();
+      if (text == NULL || payload != text)
+        ++mismatches;
+    }
+    ++num_read;
+  }
+  std::cout << what << " " << num_read << " faces in " << seconds << " s ("
+            << GetMegabytes(bytes) / seconds << " MB/s)" << "\n";
+  if (num_read != num_faces || mismatches > 0) {
+    std::cout << mismatches << " faces differ from the ones written" << "\n";
+    return false;
+  }
+  return true;
+}
+
+bool XmlBenchmark::StressLargeDocument(const std::string& filename,
+                                       uint64_t min_bytes) {
+  // Lines of plain text, nothing the printer escapes or the parser rewrites
+  std::string payload;
+  payload.reserve(kLargePayloadBytes);
+  while (payload.size() + 64 <= kLargePayloadBytes) {
+    for (int i = 0; i < 63; ++i)
+      payload.push_back(static_cast<char>('a' + (payload.size() + i) % 26));
+    payload.push_back('\n');
+  }
+
+  FILE* fp = fopen(filename.c_str(), "wb");
+  if (fp == NULL) {
+    std::cout << "Could not create " << filename << "\n";
+    return false;
+  }
+
+  // Streamed, the printer holds no more than the open elements
+  double start = GetSeconds();
+  tinyxml2::XMLPrinter printer(fp);
+  int64_t num_faces = PrintLargeDocument(printer, payload, min_bytes);
+  uint64_t bytes_written = printer.BytesWritten();
+  bool ok = fflush(fp) == 0 && ferror(fp) == 0;
+  int64_t file_size = ok ? GetFileEnd(fp) : -1;
+  ok &= fclose(fp) == 0;
+  double write_seconds = GetSeconds() - start;
+  std::cout << "Wrote " << num_faces << " faces, " << bytes_written
+            << " bytes in " << write_seconds << " s ("
+            << GetMegabytes(bytes_written) / write_seconds << " MB/s)"
+            << "\n";
+  if (!ok || file_size < 0 ||
+      static_cast<uint64_t>(file_size) != bytes_written) {
+    std::cout << "The file holds " << file_size << " bytes" << "\n";
+    remove(filename.c_str());
+    return false;
+  }
+
+  // The same document printed to memory, so the printer's buffer grows past
+  // 4GB, holding the terminating null too
+  try {
+    start = GetSeconds();
+    tinyxml2::XMLPrinter memory_printer;
+    ok = PrintLargeDocument(memory_printer, payload, min_bytes) == num_faces &&
+         memory_printer.BytesWritten() == bytes_written &&
+         memory_printer.CStrSize() == bytes_written + 1 &&
+         memory_printer.CStr()[bytes_written] == 0;
+    double print_seconds = GetSeconds() - start;
+    ok = ok && IsFileEqual(filename, memory_printer.CStr(), bytes_written);
+    std::cout << "Printed " << memory_printer.CStrSize()
+              << " bytes to memory in " << print_seconds << " s" << "\n";
+    if (!ok)
+      std::cout << "The memory print differs from the file" << "\n";
+  } catch (const std::bad_alloc&) {
+    std::cout << "Not enough memory to print the document to memory" << "\n";
+    ok = false;
+  }
+  if (!ok) {
+    remove(filename.c_str());
+    return false;
+  }
+
+  // Mapped, the parser only writes to the pages of the texts it terminates,
+  // so the document does not need the file size in memory
+  start = GetSeconds();
+  tinyxml2::XMLDocument doc;
+  ok = doc.LoadFileMapped(filename.c_str()) == tinyxml2::XML_NO_ERROR;
+  double read_seconds = GetSeconds() - start;
+  ok = ok && CheckLargeDocument("Read", doc.FirstChildElement(kSkpToXMLTag),
+                                payload, num_faces, bytes_written,
+                                read_seconds);
+
+  // The DOM printed back out reproduces the file
+  std::string copy_filename = filename + ".copy";
+  if (ok) {
+    start = GetSeconds();
+    ok = doc.SaveFile(copy_filename.c_str()) == tinyxml2::XML_NO_ERROR &&
+         AreFilesEqual(filename, copy_filename);
+    std::cout << "Saved the DOM in " << GetSeconds() - start << " s" << "\n";
+    remove(copy_filename.c_str());
+  }
+  doc.Clear();
+
+  // The compact DOM has its own offsets into the text
+  if (ok) {
+    start = GetSeconds();
+    tinyxml2::XMLCompactDocument compact;
+    ok = compact.LoadFileMapped(filename.c_str()) == tinyxml2::XML_NO_ERROR;
+    read_seconds = GetSeconds() - start;
+    ok = ok && CheckLargeDocument("Read compact",
+                                  compact.FirstChildElement(kSkpToXMLTag),
+                                  payload, num_faces, bytes_written,
+                                  read_seconds);
+  }
+
+  if (!ok)
+    std::cout << "Could not read back " << filename << "\n";
+  remove(filename.c_str());
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Parse throughput
+
+bool XmlBenchmark::BenchmarkParse(const std::string& filename,
+                                  int num_passes) {
+  std::vector<char> data;
+  if (!ReadFile(filename, data) || data.empty()) {
+    std::cout << "Could not read " << filename << "\n";
+    return false;
+  }
+
+  static const tinyxml2::XMLUtil::Scanner kScanners[] = {
+    tinyxml2::XMLUtil::SCANNER_SCALAR,
+    tinyxml2::XMLUtil::SCANNER_SSE2,
+    tinyxml2::XMLUtil::SCANNER_AVX2
+  };
+  static const char* kScannerNames[] = { "scalar", "SSE2", "AVX2" };
+
+  tinyxml2::XMLUtil::Scanner best = tinyxml2::XMLUtil::GetScanner();
+  bool ok = true;
+  uint64_t num_elements = 0;
+  for (int i = 0; i < 3; ++i) {
+    if (!tinyxml2::XMLUtil::SetScanner(kScanners[i])) {
+      std::cout << kScannerNames[i] << ": not available" << "\n";
+      continue;
+    }
+
+    tinyxml2::XMLDocument doc;
+    double start = GetSeconds();
+    for (int pass = 0; pass < num_passes; ++pass) {
+      ok &= doc.Parse(&data[0], data.size()) == tinyxml2::XML_NO_ERROR;
+    }
+    double seconds = GetSeconds() - start;
+
+    // Every scanner reads the same document
+    uint64_t count = CountElements(&doc);
+    if (num_elements == 0)
+      num_elements = count;
+    ok &= count == num_elements;
+
+    std::cout << kScannerNames[i] << ": " << num_passes << " parses of "
+              << data.size() << " bytes, " << count << " elements in "
+              << seconds << " s";
+    if (seconds > 0.0) {
+      std::cout << " (" << GetMegabytes(data.size()) * num_passes / seconds
+                << " MB/s)";
+    }
+    std::cout << "\n";
+  }
+  tinyxml2::XMLUtil::SetScanner(best);
+
+  if (!ok)
+    std::cout << "The scanners do not parse the same document" << "\n";
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Deep nesting
+
+struct NestingTimes {
+  NestingTimes() : bytes_(0), write_(0.0), parse_(0.0), read_(0.0) {}
+
+  uint64_t bytes_;
+  double write_;
+  double parse_;
+  double read_;
+};
+
+// The groups of the file are nested inside one another, or side by side
+static bool WriteNestedModel(const std::string& filename,
+                             const CXmlOptions& options, int num_groups,
+                             bool nested) {
+  XmlFaceInfo face;
+  for (int i = 0; i < 3; ++i) {
+    XmlFaceVertex vertex;
+    vertex.vertex_ = XmlGeomUtils::CPoint3d(i == 1 ? 1.0 : 0.0,
+                                            i == 2 ? 1.0 : 0.0, 0.0);
+    vertex.normal_ = XmlGeomUtils::CVector3d(0.0, 0.0, 1.0);
+    face.vertices_.push_back(vertex);
+  }
+  SUTransformation transform = XmlGeomUtils::GetIdentityTransform();
+
+  CXmlFile file;
+  file.SetOptions(options);
+  if (!file.Open(filename, true))
+    return false;
+  file.WriteHeader(1, 0, 0);
+  file.StartGeometry();
+  for (int i = 0; i < num_groups; ++i) {
+    file.StartGroup();
+    file.WriteFaceInfo(face);
+    if (!nested) {
+      file.WriteTransformation(transform);
+      file.PopParentNode();
+    }
+  }
+  if (nested) {
+    for (int i = 0; i < num_groups; ++i) {
+      file.WriteTransformation(transform);
+      file.PopParentNode();
+    }
+  }
+  file.PopParentNode(); // Geometry
+  file.Close(false);
+  return true;
+}
+
+// Counts the groups and faces without recursing
+static void CountEntities(const XmlEntitiesInfo& entities, size_t& num_groups,
+                          size_t& num_faces) {
+  std::vector<const XmlEntitiesInfo*> pending(1, &entities);
+  while (!pending.empty()) {
+    const XmlEntitiesInfo* current = pending.back();
+    pending.pop_back();
+    num_faces += current->faces_.size();
+    num_groups += current->groups_.size();
+    for (size_t i = 0; i < current->groups_.size(); ++i) {
+      if (current->groups_[i].entities_ != NULL)
+        pending.push_back(current->groups_[i].entities_);
+    }
+  }
+}
+
+static bool TimeNestedModel(const std::string& filename, int num_groups,
+                            bool nested, NestingTimes& times) {
+  // Room for the groups and the elements around and inside them
+  CXmlOptions options;
+  options.set_max_element_depth(num_groups + 16);
+
+  double start = GetSeconds();
+  bool ok = WriteNestedModel(filename, options, num_groups, nested);
+  times.write_ = GetSeconds() - start;
+
+  std::vector<char> data;
+  ok = ok && ReadFile(filename, data) && !data.empty();
+  if (ok) {
+    times.bytes_ = data.size();
+    tinyxml2::XMLDocument doc;
+    doc.SetMaxElementDepth(options.max_element_depth());
+    start = GetSeconds();
+    ok = doc.Parse(&data[0], data.size()) == tinyxml2::XML_NO_ERROR;
+    times.parse_ = GetSeconds() - start;
+  }
+
+  if (ok) {
+    XmlModelInfo model_info;
+    CXmlFile file;
+    file.SetOptions(options);
+    start = GetSeconds();
+    ok = file.Open(filename, false) && file.GetModelInfo(model_info);
+    file.Close(true);
+    times.read_ = GetSeconds() - start;
+
+    size_t num_read_groups = 0;
+    size_t num_read_faces = 0;
+    CountEntities(model_info.entities_, num_read_groups, num_read_faces);
+    ok = ok && num_read_groups == static_cast<size_t>(num_groups) &&
+         num_read_faces == static_cast<size_t>(num_groups);
+  }
+  remove(filename.c_str());
+  return ok;
+}
+
+static void PrintNestingTimes(const char* name, const NestingTimes& times) {
+  // In MB/s too, to compare the flat model with other builds
+  std::cout << name << ": " << times.bytes_ << " bytes, write "
+            << times.write_ << " s, parse " << times.parse_ << " s";
+  if (times.parse_ > 0.0)
+    std::cout << " (" << GetMegabytes(times.bytes_) / times.parse_ << " MB/s)";
+  std::cout << ", read " << times.read_ << " s";
+  if (times.read_ > 0.0)
+    std::cout << " (" << GetMegabytes(times.bytes_) / times.read_ << " MB/s)";
+  std::cout << "\n";
+}
+
+bool XmlBenchmark::BenchmarkNesting(const std::string& filename,
+                                    int num_groups) {
+  if (num_groups <= 0)
+    return false;
+
+  NestingTimes nested;
+  NestingTimes flat;
+  bool nested_ok = TimeNestedModel(filename, num_groups, true, nested);
+  bool flat_ok = TimeNestedModel(filename, num_groups, false, flat);
+  std::cout << num_groups << " groups" << "\n";
+  PrintNestingTimes("nested", nested);
+  PrintNestingTimes("flat", flat);
+  if (!nested_ok || !flat_ok) {
+    std::cout << "The " << (nested_ok ? "flat" : "nested")
+              << " model did not read back" << "\n";
+  }
+  return nested_ok && flat_ok;
+}
+
+//------------------------------------------------------------------------------
+// Number conversion
+
+static uint64_t GetRandomBits(uint64_t& state) {
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  uint64_t bits = state;
+  bits ^= bits >> 33;
+  bits *= 0xff51afd7ed558ccdULL;
+  bits ^= bits >> 33;
+  return bits;
+}
+
+static int GetRandomInt(int count, uint64_t& state) {
+  return static_cast<int>(GetRandomBits(state) % count);
+}
+
+// A decimal string of one of several kinds, chosen by kind
+static std::string GetRandomNumber(int kind, uint64_t& state) {
+  char buf[512];
+  uint64_t bits = GetRandomBits(state);
+  switch (kind) {
+    case 0: {
+      // Any double, NaNs and infinities too, printed to round trip
+      double d;
+      memcpy(&d, &bits, sizeof(d));
+      snprintf(buf, sizeof(buf), "%.17g", d);
+      break;
+    }
+    case 1: {
+      // Any double, to fewer digits
+      double d;
+      memcpy(&d, &bits, sizeof(d));
+      snprintf(buf, sizeof(buf), "%.*g", 1 + GetRandomInt(17, state), d);
+      break;
+    }
+    case 2: {
+      // Any float, printed to round trip
+      uint32_t float_bits = static_cast<uint32_t>(bits);
+      float f;
+      memcpy(&f, &float_bits, sizeof(f));
+      snprintf(buf, sizeof(buf), "%.9g", f);
+      break;
+    }
+    case 3: {
+      // Up to 40 digits, with the decimal point anywhere and any exponent
+      std::string number;
+      if (bits & 1)
+        number.push_back('-');
+      int num_digits = 1 + GetRandomInt(40, state);
+      // No decimal point for -1, a trailing one for num_digits
+      int point = GetRandomInt(num_digits + 2, state) - 1;
+      int leading_zeros = GetRandomInt(4, state) == 0 ? GetRandomInt(20, state)
+                                                      : 0;
+      for (int i = 0; i < num_digits; ++i) {
+        if (i == point)
+          number.push_back('.');
+        char digit = i < leading_zeros ? '0'
+                                       : static_cast<char>('0' +
+                                             GetRandomInt(10, state));
+        number.push_back(digit);
+      }
+      if (point == num_digits)
+        number.push_back('.');
+      if (GetRandomInt(2, state) == 0) {
+        snprintf(buf, sizeof(buf), "%s%d", GetRandomInt(2, state) ? "e" : "E",
+                 GetRandomInt(700, state) - 350);
+        number += buf;
+      }
+      return number;
+    }
+    case 4: {
+      // Mantissas around 2^53 and 2^24 with exponents around +-22 and +-10,
+      // where the exact conversion stops
+      int shift = GetRandomInt(2, state) ? 53 : 24;
+      int range = shift == 53 ? 23 : 11;
+      long long mantissa = (1LL << shift) + GetRandomInt(9, state) - 4;
+      snprintf(buf, sizeof(buf), "%llde%d", mantissa,
+               GetRandomInt(2 * range + 1, state) - range);
+      break;
+    }
+    default: {
+      // Plain decimals, as the exporter writes them
+      double d = static_cast<double>(static_cast<int64_t>(bits)) /
+                 std::pow(10.0, GetRandomInt(30, state));
+      snprintf(buf, sizeof(buf), "%.*f", GetRandomInt(26, state), d);
+      break;
+    }
+  }
+  return buf;
+}
+
+static bool IsSameBits(double a, double b) {
+  if (std::isnan(a) || std::isnan(b))
+    return std::isnan(a) && std::isnan(b);
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+static bool IsSameBits(float a, float b) {
+  if (std::isnan(a) || std::isnan(b))
+    return std::isnan(a) && std::isnan(b);
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+bool XmlBenchmark::CheckNumbers(uint64_t num_values) {
+  // The C library is the reference; the program runs in the "C" locale
+  static const size_t kArraySize = 64;
+  static const int kNumKinds = 6;
+  static const size_t kMaxReported = 10;
+
+  uint64_t state = 1;
+  uint64_t mismatches = 0;
+  std::string array;
+  std::vector<double> expected_doubles;
+  std::vector<float> expected_floats;
+  std::vector<double> doubles(kArraySize);
+  std::vector<float> floats(kArraySize);
+  double start = GetSeconds();
+  for (uint64_t i = 0; i < num_values; ++i) {
+    std::string number = GetRandomNumber(static_cast<int>(i % kNumKinds),
+                                         state);
+    double expected_double = strtod(number.c_str(), NULL);
+    float expected_float = strtof(number.c_str(), NULL);
+    double d = 0.0;
+    float f = 0.0f;
+    bool ok = tinyxml2::XMLUtil::ToDouble(number.c_str(), &d) &&
+              IsSameBits(d, expected_double) &&
+              tinyxml2::XMLUtil::ToFloat(number.c_str(), &f) &&
+              IsSameBits(f, expected_float);
+    if (!ok) {
+      if (mismatches < kMaxReported) {
+        std::streamsize precision = std::cout.precision(17);
+        std::cout << "\"" << number << "\": " << d << " and " << f
+                  << ", strtod and strtof give " << expected_double << " and "
+                  << expected_float << "\n";
+        std::cout.precision(precision);
+      }
+      ++mismatches;
+    }
+
+    // The same numbers through the array functions, separated by any white
+    // space
+    array += number;
+    array.push_back(" \t\n"[i % 3]);
+    expected_doubles.push_back(expected_double);
+    expected_floats.push_back(expected_float);
+    if (expected_doubles.size() < kArraySize && i + 1 < num_values)
+      continue;
+    size_t count = expected_doubles.size();
+    bool array_ok =
+        tinyxml2::XMLUtil::ToDoubleArray(array.c_str(), &doubles[0],
+                                         kArraySize) == count &&
+        tinyxml2::XMLUtil::ToFloatArray(array.c_str(), &floats[0],
+                                        kArraySize) == count;
+    for (size_t j = 0; array_ok && j < count; ++j) {
+      array_ok = IsSameBits(doubles[j], expected_doubles[j]) &&
+                 IsSameBits(floats[j], expected_floats[j]);
+    }
+    if (!array_ok) {
+      if (mismatches < kMaxReported)
+        std::cout << "The arrays differ: " << array << "\n";
+      ++mismatches;
+    }
+    array.clear();
+    expected_doubles.clear();
+    expected_floats.clear();
+  }
+  double seconds = GetSeconds() - start;
+
+  std::cout << "Checked " << num_values << " numbers in " << seconds
+            << " s, " << mismatches << " mismatches" << "\n";
+  return mismatches == 0;
+}
@@ -1,12 +1,16 @@
 // Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
 
+#include <algorithm>
 #include <string>
 #include <vector>
 #include <cassert>
+#include <future>
 #include <iostream>
 
 #include "xmlexporter.h"
+#include "xmlspatial.h"
 #include "xmltexturehelper.h"
+#include "xmltiles.h"
 #include "xmlgeomutils.h"
 #include "utils.h"
 
@@ -87,6 +91,13 @@ static std::string GetComponentDefinitionName(
   return name.utf8();
 }
 
+// Utility function to tell whether a material has a texture
+static bool HasTexture(SUMaterialRef material) {
+  SUTextureRef texture_ref = SU_INVALID;
+  return !SUIsInvalid(material) &&
+         SUMaterialGetTexture(material, &texture_ref) == SU_ERROR_NONE;
+}
+
 CXmlExporter::CXmlExporter() {
   SUSetInvalid(model_);
   SUSetInvalid(texture_writer_);
@@ -126,14 +137,14 @@ bool CXmlExporter::Convert(const std::string& src_file,
     SU_CALL(SUTextureWriterCreate(&texture_writer_));
 
     // Open the xml file for creation
+    file_.SetOptions(options_);
     if (!file_.Open(dst_file, true)) {
       ReleaseModelObjects();
       return exported;
     }
 
-    // Write textures
-		std::cout <<  "Writing Texture Files..." << "\n";
-    WriteTextureFiles();
+    // Load textures, the files are written while the xml file is printed
+    size_t texture_count = LoadTextures();
 
     // Write file header
     int major_ver = 0, minor_ver = 0, build_no = 0;
@@ -156,8 +167,70 @@ bool CXmlExporter::Convert(const std::string& src_file,
     std::cout << "Writing Geometry" << "\n";;
     WriteGeometry();
 
+    // The texture writer is not used by anything else from here on, so the
+    // texture files are written while the xml file is printed
+    std::future<bool> textures_written;
+    if (texture_count > 0) {
+      std::cout <<  "Writing Texture Files..." << "\n";
+      textures_written = std::async(std::launch::async,
+                                    &CXmlExporter::WriteTextureFiles, this,
+                                    file_.GetTextureDirectory());
+    }
+
     file_.Close(false);
 
+    if (textures_written.valid() && !textures_written.get())
+      throw std::exception();
+
+    if (options_.export_compressed()) {
+      const XmlMeshCompressionStats& compression = file_.compression_stats();
+      std::cout << "Compressed " << compression.triangles_ << " triangles into "
+                << compression.bytes_ << " bytes";
+      if (compression.triangles_ > 0) {
+        std::cout << " (" << static_cast<double>(compression.bytes_) /
+                             compression.triangles_ << " bytes/triangle)";
+      }
+      std::cout << "\n";
+    }
+
+    if (options_.export_profile()) {
+      const XmlProfileCounts& total = file_.profile().total();
+      std::cout << "Wrote " << total.bytes_ << " bytes in " << total.elements_
+                << " elements, see "
+                << CXmlProfile::GetReportFilename(dst_file) << "\n";
+    }
+
+    if (stats_.skipped_groups() > 0) {
+      std::cout << "Left out " << stats_.skipped_groups()
+                << " groups nested more than " << options_.max_group_depth()
+                << " deep" << "\n";
+    }
+
+    if (!options_.delta_manifest().empty()) {
+      const XmlDeltaStats& delta = file_.delta_stats();
+      std::cout << "Delta: " << delta.changed_ << " changed, "
+                << delta.deleted_ << " deleted, " << delta.unchanged_
+                << " unchanged" << "\n";
+    }
+
+    // Tiles are cut from the full model, which a delta file does not hold
+    if (options_.export_tiles() && options_.delta_manifest().empty()) {
+      std::cout << "Writing Tiles" << "\n";
+      WriteTiles(dst_file, major_ver, minor_ver, build_no);
+    }
+
+    if (options_.spatial_benchmark_queries() > 0 &&
+        options_.delta_manifest().empty()) {
+      std::cout << "Benchmarking Spatial Index" << "\n";
+      BenchmarkSpatialIndex(dst_file);
+    }
+
+    if (options_.decode_benchmark_passes() > 0 &&
+        options_.export_compressed()) {
+      std::cout << "Benchmarking Mesh Decoding" << "\n";
+      BenchmarkMeshDecoding(dst_file);
+    }
+
     std::cout << "Export Compl" << "\n";
     exported = true;
   } catch(...) {
@@ -169,22 +242,105 @@ bool CXmlExporter::Convert(const std::string& src_file,
   return exported;
 }
 
-void CXmlExporter::WriteTextureFiles() {
+void CXmlExporter::WriteTiles(const std::string& xml_filename, int major_ver,
+                              int minor_ver, int build_no) {
+  // The model is read back from the written file, which already holds every
+  // definition and transformation in a form the tiler can flatten
+  CXmlFile file;
+  XmlModelInfo model_info;
+  if (!file.Open(xml_filename, false) || !file.GetModelInfo(model_info)) {
+    file.Close(true);
+    throw std::exception();
+  }
+  file.Close(true);
+
+  CXmlTiler tiler;
+  tiler.SetOptions(options_);
+  tiler.SetVersion(major_ver, minor_ver, build_no);
+  tiler.set_max_triangles(std::max(1, options_.tile_max_triangles()));
+  if (!tiler.Write(model_info, xml_filename))
+    throw std::exception();
+  std::cout << "Wrote " << tiler.tile_set().tiles_.size() << " tiles" << "\n";
+}
+
+void CXmlExporter::BenchmarkSpatialIndex(const std::string& xml_filename) {
+  CXmlFile file;
+  XmlModelInfo model_info;
+  if (!file.Open(xml_filename, false) || !file.GetModelInfo(model_info)) {
+    file.Close(true);
+    throw std::exception();
+  }
+  file.Close(true);
+
+  CXmlSpatialIndex index;
+  XmlSpatialBenchmarkInfo info;
+  index.Benchmark(model_info, options_.spatial_benchmark_queries(), info);
+  std::cout << "Spatial index of " << info.triangles_ << " triangles built in "
+            << info.build_seconds_ << " s" << "\n";
+  std::cout << info.queries_ << " ray casts: " << info.ray_seconds_
+            << " s, brute force " << info.ray_brute_force_seconds_ << " s"
+            << "\n";
+  std::cout << info.queries_ << " box overlaps: " << info.overlap_seconds_
+            << " s, brute force " << info.overlap_brute_force_seconds_ << " s"
+            << "\n";
+  std::cout << info.queries_ << " nearest points: " << info.nearest_seconds_
+            << " s, brute force " << info.nearest_brute_force_seconds_ << " s"
+            << "\n";
+  if (info.mismatches_ > 0) {
+    std::cout << info.mismatches_ << " queries differ from brute force"
+              << "\n";
+  }
+}
+
+void CXmlExporter::BenchmarkMeshDecoding(const std::string& xml_filename) {
+  CXmlFile file;
+  if (!file.Open(xml_filename, false)) {
+    file.Close(true);
+    throw std::exception();
+  }
+  XmlMeshDecodeBenchmarkInfo info;
+  bool ok = file.BenchmarkMeshDecoding(options_.decode_benchmark_passes(),
+                                       info);
+  file.Close(true);
+
+  double megabytes = static_cast<double>(info.bytes_) * info.passes_ /
+                     (1 << 20);
+  std::cout << info.passes_ << " decodes of " << info.meshes_
+            << " meshes, " << info.triangles_ << " triangles, "
+            << info.bytes_ << " bytes: " << info.seconds_ << " s";
+  if (info.seconds_ > 0.0) {
+    std::cout << " (" << megabytes / info.seconds_ << " MB/s, "
+              << info.triangles_ * info.passes_ / info.seconds_
+              << " triangles/s)";
+  }
+  std::cout << "\n";
+  if (!ok)
+    std::cout << info.failures_ << " meshes do not decode" << "\n";
+}
+
+size_t CXmlExporter::LoadTextures() {
+  size_t texture_count = 0;
   if (options_.export_materials()) {
     // Load the textures into the texture writer
     CXmlTextureHelper texture_helper;
-    size_t texture_count = texture_helper.LoadAllTextures(model_,
+    texture_count = texture_helper.LoadAllTextures(model_,
         texture_writer_,
         options_.export_materials_by_layer());
     stats_.set_textures(texture_count);
+  }
+  return texture_count;
+}
 
-    // Write out all the textures to a the export folder  
-    if (texture_count > 0) {
-      std::string texture_directory = file_.GetTextureDirectory();
-      SU_CALL(SUTextureWriterWriteAllTextures(texture_writer_,
-                                              texture_directory.c_str()));
-    }
+bool CXmlExporter::WriteTextureFiles(const std::string& texture_directory) {
+  // Runs on its own thread, where an exception would not be caught
+  try {
+    // Write out all the textures to a the export folder
+    SU_CALL(SUTextureWriterWriteAllTextures(texture_writer_,
+                                            texture_directory.c_str()));
+  } catch(...) {
+    return false;
   }
+  return true;
 }
 
 void CXmlExporter::WriteLayers() {
@@ -342,6 +498,8 @@ void CXmlExporter::WriteGeometry() {
     // Write entities
     SUEntitiesRef model_entities;
     SU_CALL(SUModelGetEntities(model_, &model_entities));
+    if (options_.export_quantized())
+      SetQuantizationBounds(model_entities);
     file_.StartGeometry();
     WriteEntities(model_entities);
     file_.PopParentNode();
@@ -368,16 +526,184 @@ void CXmlExporter::WriteComponentDefinitions() {
 
 void CXmlExporter::WriteComponentDefinition(SUComponentDefinitionRef comp_def) {
   std::string name = GetComponentDefinitionName(comp_def);
-  file_.StartComponentDefinition(name);
-
   SUEntitiesRef entities = SU_INVALID;
   SUComponentDefinitionGetEntities(comp_def, &entities);
+  if (options_.export_quantized())
+    SetQuantizationBounds(entities);
+
+  file_.StartComponentDefinition(name);
   WriteEntities(entities);
 
   file_.PopParentNode();
 }
 
+// An entities collection that is being written, with its groups
+struct CXmlExporter::EntitiesLevel {
+  SUEntitiesRef entities_;
+  std::vector<SUGroupRef> groups_;
+  size_t next_group_;
+};
+
 void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
+  // Groups are written with a stack of the open ones rather than by
+  // recursing, so deeply nested groups can't run out of call stack. Each
+  // group's entities come before its transformation.
+  std::vector<EntitiesLevel> levels;
+  BeginEntities(entities, levels);
+  while (!levels.empty()) {
+    EntitiesLevel& level = levels.back();
+    if (level.next_group_ < level.groups_.size()) {
+      SUGroupRef group = level.groups_[level.next_group_++];
+      if (IsGroupTooDeep(levels.size())) {
+        stats_.AddSkippedGroup();
+        continue;
+      }
+      SUEntitiesRef group_entities = SU_INVALID;
+      SU_CALL(SUGroupGetEntities(group, &group_entities));
+      inheritance_manager_.PushElement(group);
+      file_.StartGroup();
+
+      // Write entities
+      BeginEntities(group_entities, levels);
+      continue;
+    }
+
+    WriteLooseGeometry(level.entities_);
+    levels.pop_back();
+    if (!levels.empty()) {
+      // The group whose entities these were is done
+      const EntitiesLevel& parent = levels.back();
+      SUGroupRef group = parent.groups_[parent.next_group_ - 1];
+
+      // Write transformation
+      SUTransformation transform;
+      SU_CALL(SUGroupGetTransform(group, &transform));
+      file_.WriteTransformation(transform);
+
+      file_.PopParentNode();
+      inheritance_manager_.PopElement();
+    }
+  }
+}
+
+bool CXmlExporter::IsGroupTooDeep(size_t depth) const {
+  return options_.max_group_depth() > 0 &&
+         depth > static_cast<size_t>(options_.max_group_depth());
+}
+
+void CXmlExporter::BeginEntities(SUEntitiesRef entities,
+                                 std::vector<EntitiesLevel>& levels) {
+  WriteComponentInstances(entities);
+  PushEntitiesLevel(entities, levels);
+}
+
+void CXmlExporter::PushEntitiesLevel(SUEntitiesRef entities,
+                                     std::vector<EntitiesLevel>& levels) {
+  levels.push_back(EntitiesLevel());
+  EntitiesLevel& level = levels.back();
+  level.entities_ = entities;
+  level.next_group_ = 0;
+  size_t num_groups = 0;
+  SU_CALL(SUEntitiesGetNumGroups(entities, &num_groups));
+  if (num_groups > 0) {
+    level.groups_.resize(num_groups);
+    SU_CALL(SUEntitiesGetGroups(entities, num_groups, &level.groups_[0],
+                                &num_groups));
+    level.groups_.resize(num_groups);
+  }
+}
+
+void CXmlExporter::SetQuantizationBounds(SUEntitiesRef entities) {
+  // The faces WriteEntities writes, visited the same way but not meshed:
+  // the mesh vertices are the face vertices
+  CBoundingBox3d bounds;
+  CBoundingBox3d uv_bounds;
+  std::vector<EntitiesLevel> levels;
+  PushEntitiesLevel(entities, levels);
+  while (!levels.empty()) {
+    EntitiesLevel& level = levels.back();
+    if (level.next_group_ < level.groups_.size()) {
+      SUGroupRef group = level.groups_[level.next_group_++];
+      if (IsGroupTooDeep(levels.size()))
+        continue;
+      SUEntitiesRef group_entities = SU_INVALID;
+      SU_CALL(SUGroupGetEntities(group, &group_entities));
+      inheritance_manager_.PushElement(group);
+      PushEntitiesLevel(group_entities, levels);
+      continue;
+    }
+
+    if (options_.export_faces()) {
+      size_t num_faces = 0;
+      SU_CALL(SUEntitiesGetNumFaces(level.entities_, &num_faces));
+      if (num_faces > 0) {
+        std::vector<SUFaceRef> faces(num_faces);
+        SU_CALL(SUEntitiesGetFaces(level.entities_, num_faces, &faces[0],
+                                   &num_faces));
+        for (size_t i = 0; i < num_faces; i++) {
+          inheritance_manager_.PushElement(faces[i]);
+          AddFaceBounds(faces[i], bounds, uv_bounds);
+          inheritance_manager_.PopElement();
+        }
+      }
+    }
+    levels.pop_back();
+    if (!levels.empty())
+      inheritance_manager_.PopElement();
+  }
+  file_.SetQuantizationBounds(bounds, uv_bounds);
+}
+
+void CXmlExporter::AddFaceBounds(SUFaceRef face, CBoundingBox3d& bounds,
+                                 CBoundingBox3d& uv_bounds) {
+  if (SUIsInvalid(face))
+    return;
+
+  // Textured as in WriteFace
+  bool has_front_texture = false;
+  bool has_back_texture = false;
+  if (options_.export_materials()) {
+    has_front_texture = options_.export_front_uvs() &&
+        HasTexture(inheritance_manager_.GetCurrentFrontMaterial());
+    has_back_texture = options_.export_back_uvs() &&
+        HasTexture(inheritance_manager_.GetCurrentBackMaterial());
+  }
+  SUUVHelperRef uv_helper = SU_INVALID;
+  if (has_front_texture || has_back_texture) {
+    SUFaceGetUVHelper(face, has_front_texture, has_back_texture,
+                      texture_writer_, &uv_helper);
+  }
+
+  size_t num_vertices = 0;
+  SU_CALL(SUFaceGetNumVertices(face, &num_vertices));
+  if (num_vertices > 0) {
+    std::vector<SUVertexRef> vertices(num_vertices);
+    SU_CALL(SUFaceGetVertices(face, num_vertices, &vertices[0],
+                              &num_vertices));
+    for (size_t i = 0; i < num_vertices; i++) {
+      SUPoint3D su_point;
+      SU_CALL(SUVertexGetPosition(vertices[i], &su_point));
+      bounds.Add(CPoint3d(su_point));
+
+      SUUVQ uvq;
+      if (has_front_texture &&
+          SUUVHelperGetFrontUVQ(uv_helper, &su_point, &uvq) ==
+              SU_ERROR_NONE) {
+        uv_bounds.Add(CPoint3d(uvq.u, uvq.v, 0));
+      }
+      if (has_back_texture &&
+          SUUVHelperGetBackUVQ(uv_helper, &su_point, &uvq) ==
+              SU_ERROR_NONE) {
+        uv_bounds.Add(CPoint3d(uvq.u, uvq.v, 0));
+      }
+    }
+  }
+
+  if (!SUIsInvalid(uv_helper))
+    SU_CALL(SUUVHelperRelease(&uv_helper));
+}
+
+void CXmlExporter::WriteComponentInstances(SUEntitiesRef entities) {
   // Component instances
   size_t num_instances = 0;
   SU_CALL(SUEntitiesGetNumInstances(entities, &num_instances));
@@ -407,39 +733,19 @@ void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
         instance_info.material_name_ = GetMaterialName(material);
 
       instance_info.definition_name_ = GetComponentDefinitionName(definition);
-      SU_CALL(SUComponentInstanceGetTransform(instance,
-                                              &instance_info.transform_));
+      if (options_.export_instance_transforms()) {
+        SU_CALL(SUComponentInstanceGetTransform(instance,
+                                                &instance_info.transform_));
+      } else {
+        instance_info.has_transform_ = false;
+        instance_info.transform_ = XmlGeomUtils::GetIdentityTransform();
+      }
       file_.WriteComponentInstanceInfo(instance_info);
     }
   }
+}
 
-  // Groups
-  size_t num_groups = 0;
-  SU_CALL(SUEntitiesGetNumGroups(entities, &num_groups));
-  if (num_groups > 0) {
-    std::vector<SUGroupRef> groups(num_groups);
-    SU_CALL(SUEntitiesGetGroups(entities, num_groups, &groups[0], &num_groups));
-    for (size_t g = 0; g < num_groups; g++) {
-      SUGroupRef group = groups[g];
-      SUComponentDefinitionRef group_component = SU_INVALID;
-      SUEntitiesRef group_entities = SU_INVALID;
-      SU_CALL(SUGroupGetEntities(group, &group_entities));
-      inheritance_manager_.PushElement(group);
-      file_.StartGroup();
-
-      // Write entities
-      WriteEntities(group_entities);
-
-      // Write transformation
-      SUTransformation transform;
-      SU_CALL(SUGroupGetTransform(group, &transform));
-      file_.WriteTransformation(transform);
-
-      file_.PopParentNode();
-      inheritance_manager_.PopElement();
-    }
-  }
-
+void CXmlExporter::WriteLooseGeometry(SUEntitiesRef entities) {
   // Faces
   if (options_.export_faces()) {
     size_t num_faces = 0;
@@ -456,7 +762,7 @@ void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
   }
 
   // Edges
-  if (options_.export_edges()) {
+  if (options_.export_edges() && options_.export_standalone_edges()) {
     size_t num_edges = 0;
     bool standAloneOnly = true; // Write only edges not connected to faces.
     SU_CALL(SUEntitiesGetNumEdges(entities, standAloneOnly, &num_edges));
@@ -464,16 +770,30 @@ void CXmlExporter::WriteEntities(SUEntitiesRef entities) {
       std::vector<SUEdgeRef> edges(num_edges);
       SU_CALL(SUEntitiesGetEdges(entities, standAloneOnly, num_edges,
                                  &edges[0], &num_edges));
-      for (size_t i = 0; i < num_edges; i++) {
-        inheritance_manager_.PushElement(edges[i]);
-        WriteEdge(edges[i]);
-        inheritance_manager_.PopElement();
+      if (options_.export_line_lists()) {
+        // All the stand-alone edges go into shared line lists
+        std::vector<XmlEdgeInfo> infos;
+        for (size_t i = 0; i < num_edges; i++) {
+          if (SUIsInvalid(edges[i]))
+            continue;
+          inheritance_manager_.PushElement(edges[i]);
+          infos.push_back(GetEdgeInfo(edges[i]));
+          stats_.AddEdge();
+          inheritance_manager_.PopElement();
+        }
+        file_.WriteLineListInfo(infos);
+      } else {
+        for (size_t i = 0; i < num_edges; i++) {
+          inheritance_manager_.PushElement(edges[i]);
+          WriteEdge(edges[i]);
+          inheritance_manager_.PopElement();
+        }
       }
     }
   }
 
   // Curves
-  if (options_.export_edges()) {
+  if (options_.export_edges() && options_.export_curves()) {
     size_t num_curves = 0;
     SU_CALL(SUEntitiesGetNumCurves(entities, &num_curves));
     if (num_curves > 0) {
@@ -507,10 +827,9 @@ void CXmlExporter::WriteFace(SUFaceRef face) {
       // Material name
       info.front_mat_name_ = GetMaterialName(front_material);
 
-      // Has texture ?
-      SUTextureRef texture_ref = SU_INVALID;
-      info.has_front_texture_ =
-          SUMaterialGetTexture(front_material, &texture_ref) == SU_ERROR_NONE;
+      // Has texture ? Not if its coordinates are left out.
+      info.has_front_texture_ = options_.export_front_uvs() &&
+                                HasTexture(front_material);
     }
     SUMaterialRef back_material =
         inheritance_manager_.GetCurrentBackMaterial();
@@ -518,18 +837,19 @@ void CXmlExporter::WriteFace(SUFaceRef face) {
       // Material name
       info.back_mat_name_ = GetMaterialName(back_material);
 
-      // Has texture ?
-      SUTextureRef texture_ref = SU_INVALID;
-      info.has_back_texture_ =
-          SUMaterialGetTexture(back_material, &texture_ref) == SU_ERROR_NONE;
+      // Has texture ? Not if its coordinates are left out.
+      info.has_back_texture_ = options_.export_back_uvs() &&
+                                HasTexture(back_material);
     }
   }
   bool has_texture = info.has_front_texture_ || info.has_back_texture_;
 
   // Get a uv helper
   SUUVHelperRef uv_helper = SU_INVALID;
-  SUFaceGetUVHelper(face, info.has_front_texture_, info.has_back_texture_,
-                    texture_writer_, &uv_helper);
+  if (has_texture) {
+    SUFaceGetUVHelper(face, info.has_front_texture_, info.has_back_texture_,
+                      texture_writer_, &uv_helper);
+  }
 
   // Find out how many loops the face has
   size_t num_loops = 0;
@@ -560,9 +880,13 @@ void CXmlExporter::WriteFace(SUFaceRef face) {
 																	&vertices[0], &num_vertices));
 
 	//Get the normals
-	std::vector<SUVector3D> normals(num_vertices);
-	SU_CALL(SUMeshHelperGetNormals(mesh_ref, num_vertices,
-																	&normals[0], &num_vertices));
+	info.has_normals_ = options_.export_normals();
+	std::vector<SUVector3D> normals;
+	if (info.has_normals_) {
+		normals.resize(num_vertices);
+		SU_CALL(SUMeshHelperGetNormals(mesh_ref, num_vertices,
+																		&normals[0], &num_vertices));
+	}
 	// Get triangle indices.
 	size_t num_triangles = 0;
 	SU_CALL(SUMeshHelperGetNumTriangles(mesh_ref, &num_triangles));
@@ -574,15 +898,17 @@ void CXmlExporter::WriteFace(SUFaceRef face) {
 																			 &indices[0], &num_retrieved));
 
 	// Get UV coords.
-	std::vector<SUPoint3D> front_stq(num_vertices);
-	std::vector<SUPoint3D> back_stq(num_vertices);
+	std::vector<SUPoint3D> front_stq;
+	std::vector<SUPoint3D> back_stq;
 	size_t count;
 	if (info.has_front_texture_) {
+		front_stq.resize(num_vertices);
 		SU_CALL(SUMeshHelperGetFrontSTQCoords(mesh_ref, num_vertices,
 																					&front_stq[0], &count));
 	}
 
 	if (info.has_back_texture_) {
+		back_stq.resize(num_vertices);
 		SU_CALL(SUMeshHelperGetBackSTQCoords(mesh_ref, num_vertices,
 																				 &back_stq[0], &count));
 	}
@@ -598,9 +924,11 @@ void CXmlExporter::WriteFace(SUFaceRef face) {
 																			vertices[index].y,
 																			vertices[index].z);
 
-			vertex_info.normal_.SetDirection(normals[index].x,
-																			 normals[index].y,
-																			 normals[index].z);
+			if (info.has_normals_) {
+				vertex_info.normal_.SetDirection(normals[index].x,
+																				 normals[index].y,
+																				 normals[index].z);
+			}
 			if (info.has_front_texture_) {
 				SUPoint3D stq = front_stq[index];
 				vertex_info.front_texture_coord_ = CPoint3d(stq.x, stq.y, 0);
@@ -616,7 +944,8 @@ void CXmlExporter::WriteFace(SUFaceRef face) {
 
 	stats_.AddFace();
 	file_.WriteFaceInfo(info);
-	SU_CALL(SUUVHelperRelease(&uv_helper));
+	if (!SUIsInvalid(uv_helper))
+		SU_CALL(SUUVHelperRelease(&uv_helper));
 }
 
 
@@ -1,9 +1,21 @@
 // Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
 
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <iterator>
+#include <map>
+#include <set>
+#include <thread>
+#include <utility>
 #include <vector>
 #include <sstream>
 
 #include "xmlfile.h"
+#include "xmlasyncio.h"
+#include "xmlrender.h"
 #include "tinyxml2.h"
 
 // XML tags
@@ -36,6 +48,7 @@ static const std::string kEdgeTag("Edge");
 static const std::string kFrontMaterialTag("FrontMaterial");
 static const std::string kBackMaterialTag("BackMaterial");
 static const std::string kHasTextureTag("HasTexture");
+static const std::string kHasNormalsTag("HasNormals");
 static const std::string kTrianglesTag("Triangles");
 static const std::string kPointTag("Point");
 static const std::string kNormalTag("Normal");
@@ -53,6 +66,216 @@ static const std::string kUTag("u");
 static const std::string kVTag("v");
 static const std::string kStartTag("Start");
 static const std::string kEndTag("End");
+static const std::string kPolylineTag("Polyline");
+static const std::string kLinesTag("Lines");
+static const std::string kPointsTag("Points");
+static const std::string kIndicesTag("Indices");
+static const std::string kQuantizationTag("Quantization");
+static const std::string kQuantizationModeTag("quantization");
+static const std::string kQuantizationText("text");
+static const std::string kQuantizationBinary("binary");
+static const std::string kToleranceTag("tolerance");
+static const std::string kDefinitionTag("Definition");
+static const std::string kStepTag("Step");
+static const std::string kMinUTag("MinU");
+static const std::string kMinVTag("MinV");
+static const std::string kMaxUTag("MaxU");
+static const std::string kMaxVTag("MaxV");
+static const std::string kPositionsTag("Positions");
+static const std::string kNormalsTag("Normals");
+static const std::string kFrontUVsTag("FrontUVs");
+static const std::string kBackUVsTag("BackUVs");
+static const std::string kMeshTag("Mesh");
+static const std::string kQuantizationCompressed("compressed");
+static const std::string kCoarseTag("Coarse");
+static const std::string kMinTag("Min");
+static const std::string kMaxTag("Max");
+static const std::string kSimplifiedMeshTag("SimplifiedMesh");
+static const std::string kGroupBoundsTag("GroupBounds");
+static const std::string kInstanceTag("Instance");
+
+// Ids of the element tags, so the readers can switch on a tag instead of
+// comparing it against each tag in turn
+enum XmlTagId {
+  XmlTagId_Unknown = 0,
+  XmlTagId_SkpToXML,
+  XmlTagId_Layers,
+  XmlTagId_Layer,
+  XmlTagId_ComponentDefinitions,
+  XmlTagId_ComponentDefinition,
+  XmlTagId_Transformation,
+  XmlTagId_Materials,
+  XmlTagId_Material,
+  XmlTagId_Geometry,
+  XmlTagId_ComponentInstance,
+  XmlTagId_Curve,
+  XmlTagId_Group,
+  XmlTagId_Texture,
+  XmlTagId_Face,
+  XmlTagId_Edge,
+  XmlTagId_FrontMaterial,
+  XmlTagId_BackMaterial,
+  XmlTagId_Triangles,
+  XmlTagId_Point,
+  XmlTagId_Normal,
+  XmlTagId_FrontTextureCoords,
+  XmlTagId_BackTextureCoords,
+  XmlTagId_Loop,
+  XmlTagId_Vertex,
+  XmlTagId_Start,
+  XmlTagId_End,
+  XmlTagId_Polyline,
+  XmlTagId_Lines,
+  XmlTagId_Points,
+  XmlTagId_Indices,
+  XmlTagId_Quantization,
+  XmlTagId_Positions,
+  XmlTagId_Normals,
+  XmlTagId_FrontUVs,
+  XmlTagId_BackUVs,
+  XmlTagId_Mesh,
+  XmlTagId_Coarse,
+  XmlTagId_Min,
+  XmlTagId_Max,
+  XmlTagId_SimplifiedMesh,
+  XmlTagId_GroupBounds,
+  XmlTagId_Instance
+};
+
+static const std::string* const kTagNames[] = {
+  NULL,
+  &kSkpToXMLTag, &kLayersTag, &kLayerTag, &kCompDefsTag, &kCompDefTag,
+  &kTransformTag, &kMaterialsTag, &kMaterialTag, &kGeometryTag,
+  &kComponentInstanceTag, &kCurveTag, &kGroupTag, &kTextureTag, &kFaceTag,
+  &kEdgeTag, &kFrontMaterialTag, &kBackMaterialTag, &kTrianglesTag, &kPointTag,
+  &kNormalTag, &kFrontTextureCoordsTag, &kBackTextureCoordsTag, &kLoopTag,
+  &kVertexTag, &kStartTag, &kEndTag, &kPolylineTag, &kLinesTag, &kPointsTag,
+  &kIndicesTag, &kQuantizationTag, &kPositionsTag, &kNormalsTag, &kFrontUVsTag,
+  &kBackUVsTag, &kMeshTag, &kCoarseTag, &kMinTag, &kMaxTag,
+  &kSimplifiedMeshTag, &kGroupBoundsTag, &kInstanceTag
+};
+
+// Perfect hash of the tag names, a tag id by (length + 22 * first character +
+// 33 * last character) & 127
+static const unsigned char kTagIdTable[128] = {
+   0,  0,  0,  5,  0,  0, 35,  0,  0,  0, 36,  0,  0, 14, 33, 12,
+  22,  0,  8,  0, 18,  0,  0,  0, 40, 39,  0, 25,  0,  0,  0,  0,
+  30,  0,  0,  0, 17,  0, 20,  0,  0,  4,  0,  0,  0,  0,  0,  0,
+  31,  0,  0,  0,  0,  0,  0,  0,  0, 29,  0,  9, 32,  0,  0,  3,
+   0,  0,  0,  0, 13,  0,  0,  0,  0,  0,  0,  0, 11, 37,  0, 38,
+   0,  0,  0, 42,  0, 26,  0,  0, 10, 19,  0,  0,  0,  0,  0, 34,
+  28,  2, 24,  0,  0,  0,  0,  0,  0, 21,  0,  0,  0, 27,  0,  0,
+   0,  0,  0,  0,  6,  0,  1, 15, 41,  0,  7,  0, 23, 16,  0,  0
+};
+
+// The name id function of the documents read, see
+// tinyxml2::XMLDocument::SetNameIdFunction
+static int HashTagName(const char* name, size_t length) {
+  if (length == 0)
+    return XmlTagId_Unknown;
+  unsigned hash = static_cast<unsigned>(length) +
+                  22 * static_cast<unsigned char>(name[0]) +
+                  33 * static_cast<unsigned char>(name[length - 1]);
+  int id = kTagIdTable[hash & 127];
+  if (id != XmlTagId_Unknown) {
+    // Other names can land on a tag's slot
+    const std::string& tag = *kTagNames[id];
+    if (tag.size() != length || memcmp(tag.data(), name, length) != 0)
+      id = XmlTagId_Unknown;
+  }
+  return id;
+}
+
+// XmlTagId_Unknown for anything but an element, or no node. Elements of
+// documents without the name id function are hashed here.
+template <typename Node>
+static XmlTagId GetTagId(Node node) {
+  if (node == NULL)
+    return XmlTagId_Unknown;
+  auto elem = node->ToElement();
+  if (elem == NULL)
+    return XmlTagId_Unknown;
+  int id = elem->NameId();
+  if (id < 0) {
+    const char* name = elem->Name();
+    id = HashTagName(name, strlen(name));
+  }
+  return static_cast<XmlTagId>(id);
+}
+
+// Ids of the attributes read for every point, normal, texture coordinate and
+// transformation. Each group of coordinates has consecutive ids, the matrix
+// entry m<row><col> is XmlAttribId_M00 + 4 * row + col.
+enum XmlAttribId {
+  XmlAttribId_Unknown = 0,
+  XmlAttribId_X,
+  XmlAttribId_Y,
+  XmlAttribId_Z,
+  XmlAttribId_Nx,
+  XmlAttribId_Ny,
+  XmlAttribId_Nz,
+  XmlAttribId_U,
+  XmlAttribId_V,
+  XmlAttribId_M00
+};
+
+// The attribute name id function of the documents read, see
+// tinyxml2::XMLDocument::SetAttributeNameIdFunction
+static int HashAttributeName(const char* name, size_t length) {
+  switch (length) {
+    case 1:
+      switch (name[0]) {
+        case 'x': return XmlAttribId_X;
+        case 'y': return XmlAttribId_Y;
+        case 'z': return XmlAttribId_Z;
+        case 'u': return XmlAttribId_U;
+        case 'v': return XmlAttribId_V;
+      }
+      break;
+    case 2:
+      if (name[0] == 'n' && name[1] >= 'x' && name[1] <= 'z')
+        return XmlAttribId_Nx + (name[1] - 'x');
+      break;
+    case 3:
+      if (name[0] == 'm' && name[1] >= '0' && name[1] <= '3' &&
+          name[2] >= '0' && name[2] <= '3')
+        return XmlAttribId_M00 + 4 * (name[1] - '0') + (name[2] - '0');
+      break;
+  }
+  return XmlAttribId_Unknown;
+}
+
+// Reads the attributes with ids first_id to first_id + count - 1 into values
+// in one pass over the element's attributes. Returns true if all of them were
+// there as numbers; the missing ones are left as they were. Attributes of
+// documents without the attribute name id function are hashed here.
+template <typename Element>
+static bool ReadDoubleAttributes(Element elem, int first_id, int count,
+                                 double* values) {
+  unsigned found = 0;
+  for (auto attribute = elem->FirstAttribute(); attribute != NULL;
+       attribute = attribute->Next()) {
+    int id = attribute->NameId();
+    if (id < 0) {
+      const char* name = attribute->Name();
+      id = HashAttributeName(name, strlen(name));
+    }
+    int index = id - first_id;
+    if (index >= 0 && index < count &&
+        attribute->QueryDoubleValue(&values[index]) ==
+        tinyxml2::XML_NO_ERROR) {
+      found |= 1u << index;
+    }
+  }
+  return found == (1u << count) - 1;
+}
+
+// The readers are templates on the node type, see xmlfile.h. The nodes of an
+// XMLDocument are all passed to them as const XMLNode*, so they are compiled
+// once for it.
+static const tinyxml2::XMLNode* ConstNode(const tinyxml2::XMLNode* node) {
+  return node;
+}
 
 using namespace XmlGeomUtils;
 
@@ -67,12 +290,44 @@ XmlGroupInfo::XmlGroupInfo(const XmlGroupInfo& info) {
   transform_ = info.transform_;
 }
 
+XmlGroupInfo::XmlGroupInfo(XmlGroupInfo&& info) noexcept {
+  // The moved from group is given empty entities in place of its own. Only
+  // an empty XmlEntitiesInfo is allocated, so the vectors of groups are
+  // still moved rather than deep copied when they grow.
+  entities_ = new XmlEntitiesInfo;
+  std::swap(entities_, info.entities_);
+  transform_ = info.transform_;
+}
+
 XmlGroupInfo::~XmlGroupInfo() {
-  delete entities_;
+  // The nested groups give up their entities before these are deleted, so
+  // deleting deeply nested groups doesn't recurse. This is the only place
+  // entities_ is NULL.
+  std::vector<XmlEntitiesInfo*> pending;
+  if (entities_ != NULL)
+    pending.push_back(entities_);
+  while (!pending.empty()) {
+    XmlEntitiesInfo* entities = pending.back();
+    pending.pop_back();
+    for (size_t i = 0; i < entities->groups_.size(); ++i) {
+      XmlGroupInfo& group = entities->groups_[i];
+      if (group.entities_ != NULL)
+        pending.push_back(group.entities_);
+      group.entities_ = NULL;
+    }
+    delete entities;
+  }
 }
 
 const XmlGroupInfo& XmlGroupInfo::operator = (const XmlGroupInfo& info) {
-  *entities_ = *info.entities_;
+  if (this != &info)
+    *entities_ = *info.entities_;
+  transform_ = info.transform_;
+  return *this;
+}
+
+XmlGroupInfo& XmlGroupInfo::operator = (XmlGroupInfo&& info) noexcept {
+  std::swap(entities_, info.entities_);
   transform_ = info.transform_;
   return *this;
 }
@@ -81,7 +336,17 @@ const XmlGroupInfo& XmlGroupInfo::operator = (const XmlGroupInfo& info) {
 
 CXmlFile::CXmlFile()
   : xml_doc_(NULL),
-    create_new_file_(false) {
+    create_new_file_(false),
+    quantization_scope_(NULL),
+    quantization_scope_is_geometry_(false),
+    quantization_has_uvs_(false),
+    quantization_has_faces_(false),
+    has_quantization_(false),
+    listener_(NULL),
+    scanner_(1),
+    stream_offset_(0),
+    in_chunk_(false),
+    chunk_offset_(0) {
 }
 
 CXmlFile::~CXmlFile() {
@@ -97,28 +362,142 @@ bool CXmlFile::Open(const std::string& filename, bool create_new_file) {
     return true;
   }
 
-  filename_ = filename;
-  create_new_file_ = create_new_file;
-
-  xml_doc_ = new tinyxml2::XMLDocument;
-  parent_node_ = xml_doc_;
+  NewDocument(filename, create_new_file);
 
   bool ok = true;
 
   if (!create_new_file) {
-    ok = xml_doc_->LoadFile(filename.c_str()) == tinyxml2::XML_NO_ERROR &&
-         ReadHeader(); // Check for valid header
+    PrepareDocument(*xml_doc_);
+    // Mapped rather than read, so large files are not copied before parsing.
+    // Check for valid header.
+    ok = xml_doc_->LoadFileMapped(filename.c_str()) ==
+         tinyxml2::XML_NO_ERROR &&
+         ReadHeader(ConstNode(xml_doc_->FirstChild()));
   }
 
   return ok;
 }
 
+bool CXmlFile::OpenBuffer(char* buffer, size_t length) {
+  if (buffer == NULL || length == 0)
+    return false;
+
+  if (xml_doc_) {
+    printf("Warning! opening already open file\n");
+    return true;
+  }
+
+  NewDocument(std::string(), false);
+  PrepareDocument(*xml_doc_);
+  // Check for valid header
+  return xml_doc_->ParseInPlace(buffer, length) == tinyxml2::XML_NO_ERROR &&
+         ReadHeader(ConstNode(xml_doc_->FirstChild()));
+}
+
+// Sets up a document that the file, or a part of it, is read into
+template <typename Document>
+void CXmlFile::PrepareDocument(Document& doc) const {
+  doc.SetNameIdFunction(HashTagName);
+  doc.SetAttributeNameIdFunction(HashAttributeName);
+  doc.SetMaxElementDepth(options_.max_element_depth());
+}
+
+void CXmlFile::NewDocument(const std::string& filename, bool create_new_file) {
+  filename_ = filename;
+  create_new_file_ = create_new_file;
+  compression_stats_ = XmlMeshCompressionStats();
+  delta_stats_ = XmlDeltaStats();
+  profile_.Clear();
+
+  xml_doc_ = new tinyxml2::XMLDocument;
+  parent_node_ = xml_doc_;
+}
+
+// The size of the printed document, close enough to reserve the file space
+// up front. The indentation is 4 spaces per level.
+static uint64_t EstimatePrintedSize(const tinyxml2::XMLNode* node, int depth) {
+  uint64_t size = 0;
+  const tinyxml2::XMLElement* elem = node->ToElement();
+  if (elem != NULL) {
+    size_t name_length = strlen(elem->Name());
+    size += 4 * depth + 2 * name_length + 6;
+    for (const tinyxml2::XMLAttribute* attribute = elem->FirstAttribute();
+         attribute != NULL; attribute = attribute->Next()) {
+      size += strlen(attribute->Name()) + strlen(attribute->Value()) + 4;
+    }
+  } else if (node->ToText() != NULL) {
+    size += strlen(node->Value());
+  } else if (node->ToDocument() == NULL) {
+    size += 4 * depth + strlen(node->Value()) + 8;
+  }
+  for (const tinyxml2::XMLNode* child = node->FirstChild(); child != NULL;
+       child = child->NextSibling()) {
+    size += EstimatePrintedSize(child, depth + 1);
+  }
+  return size;
+}
+
 void CXmlFile::Close(bool cancelled) {
-  if (create_new_file_ && !cancelled)
-    xml_doc_->SaveFile(filename_.c_str());
+  if (create_new_file_ && !cancelled) {
+    // Dequantization parameters of an unfinished definition
+    if (quantization_scope_ != NULL)
+      FinishQuantizationScope();
+
+    if (options_.export_progressive())
+      WriteCoarseModel();
+
+    // The manifest always describes the full model, so that it can be the
+    // base of the next delta
+    if (options_.export_manifest()) {
+      CXmlManifest manifest;
+      manifest.Build(*xml_doc_);
+      if (!options_.delta_manifest().empty()) {
+        CXmlManifest previous;
+        if (previous.Read(options_.delta_manifest())) {
+          delta_stats_ = manifest.PruneDocument(*xml_doc_, previous);
+        } else {
+          printf("Warning! could not read %s, writing the full model\n",
+                 options_.delta_manifest().c_str());
+        }
+      }
+      manifest.Write(CXmlManifest::GetManifestFilename(filename_));
+    }
+
+    CXmlProfile* profile = options_.export_profile() ? &profile_ : NULL;
+    CXmlAsyncFile output;
+    if (!options_.async_output())
+      output.set_backend(XmlAsyncBackend_None);
+    FILE* fp = output.Open(filename_, EstimatePrintedSize(xml_doc_, -1));
+    if (fp != NULL) {
+      bool ok = true;
+      if (options_.export_index()) {
+        ok = index_.PrintDocument(*xml_doc_, fp,
+                                  options_.export_index_groups(), profile);
+      } else if (profile != NULL) {
+        ok = profile->PrintDocument(*xml_doc_, fp);
+      } else {
+        ok = xml_doc_->SaveFile(fp) == tinyxml2::XML_NO_ERROR;
+      }
+      ok &= output.Close();
+      if (ok && options_.export_index())
+        index_.Write(CXmlIndex::GetIndexFilename(filename_));
+    }
+    if (profile != NULL) {
+      profile->WriteReport(CXmlProfile::GetReportFilename(filename_),
+                           options_.profile_top_definitions());
+    }
+  }
   delete xml_doc_;
   xml_doc_ = NULL;
   parent_node_ = NULL;
+  index_.Clear();
+  quantization_scope_ = NULL;
+  quantization_bounds_.Clear();
+  quantization_uv_bounds_.Clear();
+  coarse_builder_.Clear();
+  coarse_scopes_.clear();
+  has_quantization_ = false;
+  definition_quantization_.clear();
 }
 
 static size_t FindLastSlash(const std::string& filename) {
@@ -136,11 +515,13 @@ std::string CXmlFile::GetTextureDirectory() const {
   return folder;
 }
 
-bool CXmlFile::ReadHeader() {
-  const tinyxml2::XMLNode* node = xml_doc_->FirstChild();
-  const tinyxml2::XMLElement* elem = node->ToElement();
+template <typename Node>
+static bool IsValidHeader(Node node) {
+  if (node == NULL)
+    return false;
+  auto elem = node->ToElement();
   bool ok = false;
-  if (elem->Value() == kSkpToXMLTag) {
+  if (elem != NULL && elem->Value() == kSkpToXMLTag) {
     int version = 0;
     ok = (elem->QueryIntAttribute(kXMLVersionTag.c_str(), &version) ==
           tinyxml2::XML_NO_ERROR) && (version == 3);
@@ -148,6 +529,87 @@ bool CXmlFile::ReadHeader() {
   return ok;
 }
 
+// Doubles written with %g lose digits, which the dequantization parameters
+// cannot afford
+static void SetExactAttribute(tinyxml2::XMLElement* elem, const char* name,
+                              double value) {
+  char buf[32];
+  TIXML_SNPRINTF(buf, sizeof(buf), "%.17g", value);
+  elem->SetAttribute(name, buf);
+}
+
+template <typename Element>
+static bool ReadQuantizationInfo(Element elem, XmlQuantizationInfo& info) {
+  double x, y, z;
+  bool ok = elem->QueryDoubleAttribute(kXTag.c_str(), &x) ==
+            tinyxml2::XML_NO_ERROR &&
+            elem->QueryDoubleAttribute(kYTag.c_str(), &y) ==
+            tinyxml2::XML_NO_ERROR &&
+            elem->QueryDoubleAttribute(kZTag.c_str(), &z) ==
+            tinyxml2::XML_NO_ERROR &&
+            elem->QueryDoubleAttribute(kStepTag.c_str(), &info.step_) ==
+            tinyxml2::XML_NO_ERROR;
+  info.origin_.SetLocation(x, y, z);
+
+  // Texture coordinate range (optional)
+  elem->QueryDoubleAttribute(kMinUTag.c_str(), &info.min_u_);
+  elem->QueryDoubleAttribute(kMinVTag.c_str(), &info.min_v_);
+  elem->QueryDoubleAttribute(kMaxUTag.c_str(), &info.max_u_);
+  elem->QueryDoubleAttribute(kMaxVTag.c_str(), &info.max_v_);
+  return ok;
+}
+
+template <typename Node>
+bool CXmlFile::ReadHeader(Node node) {
+  has_quantization_ = false;
+  definition_quantization_.clear();
+  geometry_quantization_ = XmlQuantizationInfo();
+  if (!IsValidHeader(node))
+    return false;
+
+  // Quantization mode (optional)
+  auto header = node->ToElement();
+  const char* mode = header->Attribute(kQuantizationModeTag.c_str());
+  if (mode == NULL)
+    return true;
+  has_quantization_ = true;
+  XmlQuantizationEncoding encoding = XmlQuantizationEncoding_Text;
+  if (mode == kQuantizationBinary)
+    encoding = XmlQuantizationEncoding_Binary;
+  else if (mode == kQuantizationCompressed)
+    encoding = XmlQuantizationEncoding_Compressed;
+  else if (mode != kQuantizationText)
+    return false;
+
+  // Dequantization parameters of each definition and of the geometry
+  bool ok = true;
+  auto elem = header->FirstChildElement(kQuantizationTag.c_str());
+  for (; elem != NULL;
+       elem = elem->NextSiblingElement(kQuantizationTag.c_str())) {
+    XmlQuantizationInfo info;
+    info.encoding_ = encoding;
+    ok &= ReadQuantizationInfo(elem, info);
+    const char* definition_name = elem->Attribute(kDefinitionTag.c_str());
+    if (definition_name != NULL)
+      definition_quantization_[definition_name] = info;
+    else
+      geometry_quantization_ = info;
+  }
+  geometry_quantization_.encoding_ = encoding;
+  return ok;
+}
+
+const XmlQuantizationInfo* CXmlFile::FindQuantization(
+    bool is_geometry, const std::string& definition_name) const {
+  if (!has_quantization_)
+    return NULL;
+  if (is_geometry)
+    return &geometry_quantization_;
+  std::map<std::string, XmlQuantizationInfo>::const_iterator it =
+      definition_quantization_.find(definition_name);
+  return it != definition_quantization_.end() ? &it->second : NULL;
+}
+
 void CXmlFile::WriteHeader(int major_ver, int minor_ver, int build_no) {
   tinyxml2::XMLElement* elem = xml_doc_->NewElement(kSkpToXMLTag.c_str());
   tinyxml2::XMLNode* node = xml_doc_->InsertFirstChild(elem);
@@ -158,6 +620,18 @@ void CXmlFile::WriteHeader(int major_ver, int minor_ver, int build_no) {
   ss << major_ver << '.' << minor_ver << '.' << build_no;
   elem->SetAttribute(kSkpVersionTag.c_str(), ss.str().c_str());
   elem->SetAttribute("units", "inches");
+
+  // The dequantization parameters are added as each definition is finished
+  if (options_.export_quantized()) {
+    const std::string* mode = &kQuantizationText;
+    if (options_.export_compressed())
+      mode = &kQuantizationCompressed;
+    else if (options_.export_quantized_binary())
+      mode = &kQuantizationBinary;
+    elem->SetAttribute(kQuantizationModeTag.c_str(), mode->c_str());
+    SetExactAttribute(elem, kToleranceTag.c_str(),
+                      options_.quantization_tolerance());
+  }
 }
 
 tinyxml2::XMLElement* CXmlFile::WriteStartTag(const char* tag) {
@@ -172,10 +646,24 @@ void CXmlFile::StartLayers() {
 
 void CXmlFile::StartGeometry() {
   WriteStartTag(kGeometryTag.c_str());
+  if (options_.export_quantized())
+    StartQuantizationScope(true, std::string());
+  if (options_.export_progressive()) {
+    coarse_builder_.BeginGeometry();
+    StartCoarseScope();
+  }
 }
 
 void CXmlFile::StartGroup() {
   WriteStartTag(kGroupTag.c_str());
+  if (options_.export_progressive()) {
+    coarse_builder_.BeginGroup();
+    StartCoarseScope();
+  }
+}
+
+void CXmlFile::StartCoarseScope() {
+  coarse_scopes_.push_back(parent_node_);
 }
 
 void CXmlFile::StartMaterials() {
@@ -187,12 +675,91 @@ void CXmlFile::StartComponentDefinitions() {
 }
 
 void CXmlFile::StartComponentDefinition(const std::string& name) {
+  // Instances refer to their definition with the same tag
+  tinyxml2::XMLElement* parent = parent_node_->ToElement();
+  bool is_definition = parent != NULL && parent->Value() == kCompDefsTag;
+
   tinyxml2::XMLElement* elem = WriteStartTag(kCompDefTag.c_str());
   elem->SetAttribute(kNameTag.c_str(), name.c_str());
+  if (is_definition && options_.export_quantized())
+    StartQuantizationScope(false, name);
+  if (is_definition && options_.export_progressive()) {
+    coarse_builder_.BeginDefinition(name);
+    StartCoarseScope();
+  }
+}
+
+void CXmlFile::SetQuantizationBounds(const CBoundingBox3d& bounds,
+                                     const CBoundingBox3d& uv_bounds) {
+  quantization_bounds_ = bounds;
+  quantization_uv_bounds_ = uv_bounds;
 }
 
+void CXmlFile::StartQuantizationScope(bool is_geometry,
+                                      const std::string& definition_name) {
+  if (quantization_scope_ != NULL)
+    FinishQuantizationScope();
+  quantization_scope_ = parent_node_;
+  quantization_scope_is_geometry_ = is_geometry;
+  quantization_scope_name_ = definition_name;
+  quantization_has_faces_ = false;
+
+  // Dequantization parameters from the bounds given ahead of the scope
+  quantization_ = XmlQuantizationInfo();
+  if (options_.export_compressed())
+    quantization_.encoding_ = XmlQuantizationEncoding_Compressed;
+  else if (options_.export_quantized_binary())
+    quantization_.encoding_ = XmlQuantizationEncoding_Binary;
+  if (!quantization_bounds_.IsEmpty()) {
+    CVector3d extent = quantization_bounds_.max() - quantization_bounds_.min();
+    double max_extent = extent.x();
+    if (extent.y() > max_extent) max_extent = extent.y();
+    if (extent.z() > max_extent) max_extent = extent.z();
+    quantization_.origin_ = quantization_bounds_.min();
+    quantization_.step_ =
+        XmlQuantization::GetPositionStep(max_extent,
+                                         options_.quantization_tolerance());
+  }
+  quantization_has_uvs_ = !quantization_uv_bounds_.IsEmpty();
+  if (quantization_has_uvs_) {
+    quantization_.min_u_ = quantization_uv_bounds_.min().x();
+    quantization_.min_v_ = quantization_uv_bounds_.min().y();
+    quantization_.max_u_ = quantization_uv_bounds_.max().x();
+    quantization_.max_v_ = quantization_uv_bounds_.max().y();
+  }
+  quantization_bounds_.Clear();
+  quantization_uv_bounds_.Clear();
+}
+
+void CXmlFile::FinishQuantizationScope() {
+  // Dequantization parameters go in the header
+  tinyxml2::XMLElement* header =
+      xml_doc_->FirstChildElement(kSkpToXMLTag.c_str());
+  if (header != NULL && quantization_has_faces_) {
+    tinyxml2::XMLElement* elem = xml_doc_->NewElement(kQuantizationTag.c_str());
+    if (!quantization_scope_is_geometry_) {
+      elem->SetAttribute(kDefinitionTag.c_str(),
+                         quantization_scope_name_.c_str());
+    }
+    SetExactAttribute(elem, kXTag.c_str(), quantization_.origin_.x());
+    SetExactAttribute(elem, kYTag.c_str(), quantization_.origin_.y());
+    SetExactAttribute(elem, kZTag.c_str(), quantization_.origin_.z());
+    SetExactAttribute(elem, kStepTag.c_str(), quantization_.step_);
+    if (quantization_has_uvs_) {
+      SetExactAttribute(elem, kMinUTag.c_str(), quantization_.min_u_);
+      SetExactAttribute(elem, kMinVTag.c_str(), quantization_.min_v_);
+      SetExactAttribute(elem, kMaxUTag.c_str(), quantization_.max_u_);
+      SetExactAttribute(elem, kMaxVTag.c_str(), quantization_.max_v_);
+    }
+    header->InsertEndChild(elem);
+  }
+
+  quantization_scope_ = NULL;
+}
+
+template <typename Node>
 bool CXmlFile::ReadComponentDefinitionInfo(
-    const tinyxml2::XMLNode* parent_node,
+    Node parent_node,
     bool readEntities,
     XmlComponentDefinitionInfo& info) const {
   const char* name = parent_node->ToElement()->Attribute(kNameTag.c_str());
@@ -200,17 +767,25 @@ bool CXmlFile::ReadComponentDefinitionInfo(
     return false;
   info.name_ = name;
   
-  return !readEntities || ReadEntities(parent_node, info.entities_);
+  return !readEntities ||
+         ReadEntities(parent_node, FindQuantization(false, info.name_),
+                      info.entities_);
 }
 
 void CXmlFile::PopParentNode() {
+  if (parent_node_ == quantization_scope_)
+    FinishQuantizationScope();
+  if (!coarse_scopes_.empty() && parent_node_ == coarse_scopes_.back()) {
+    coarse_builder_.EndScope();
+    coarse_scopes_.pop_back();
+  }
   parent_node_ = parent_node_->Parent();
 }
 
-bool CXmlFile::ReadLayerInfo(const tinyxml2::XMLNode* parent_node,
-                             XmlLayerInfo& info) const {
-  const tinyxml2::XMLElement* elem = parent_node->ToElement();
-  if (elem->Value() != kLayerTag)
+template <typename Node>
+bool CXmlFile::ReadLayerInfo(Node parent_node, XmlLayerInfo& info) const {
+  auto elem = parent_node->ToElement();
+  if (GetTagId(elem) != XmlTagId_Layer)
     return false;
 
   bool ok = true;
@@ -227,8 +802,9 @@ bool CXmlFile::ReadLayerInfo(const tinyxml2::XMLNode* parent_node,
   info.is_visible_ = elem->BoolAttribute(kVisibleTag.c_str());
 
   // Material info (optional)
-  const tinyxml2::XMLNode* child = parent_node->FirstChild();
-  info.has_material_info_ = ReadMaterialInfo(child, info.material_info_);
+  Node child = parent_node->FirstChild();
+  info.has_material_info_ = child != NULL &&
+                            ReadMaterialInfo(child, info.material_info_);
 
   return ok;
 }
@@ -244,8 +820,8 @@ void CXmlFile::WriteLayerInfo(const XmlLayerInfo& info) {
   PopParentNode();
 }
 
-bool CXmlFile::ReadColor(const tinyxml2::XMLNode* parent_node,
-                         const SUColor& color) const {
+template <typename Node>
+bool CXmlFile::ReadColor(Node parent_node, const SUColor& color) const {
   const char* attrib = parent_node->ToElement()->Attribute(kColorTag.c_str());
   if (attrib != NULL) {
     sscanf(attrib, kColorFormat.c_str(), &color.red, &color.green, &color.blue);
@@ -254,16 +830,21 @@ bool CXmlFile::ReadColor(const tinyxml2::XMLNode* parent_node,
   return false;
 }
 
+void CXmlFile::WriteText(const std::string& text) {
+  parent_node_->InsertEndChild(xml_doc_->NewText(text.c_str()));
+}
+
 void CXmlFile::WriteColor(const SUColor& color) {
   char buf[10] = { 0 };
   sprintf(buf, kColorFormat.c_str(), color.red, color.green, color.blue);
   parent_node_->ToElement()->SetAttribute(kColorTag.c_str(), buf);
 }
 
-bool CXmlFile::ReadMaterialInfo(const tinyxml2::XMLNode* parent_node,
+template <typename Node>
+bool CXmlFile::ReadMaterialInfo(Node parent_node,
                                 XmlMaterialInfo& info) const {
-  const tinyxml2::XMLElement* elem = parent_node->ToElement();
-  if (elem->Value() != kMaterialTag)
+  auto elem = parent_node->ToElement();
+  if (GetTagId(elem) != XmlTagId_Material)
     return false;
 
   bool ok = true;
@@ -284,10 +865,10 @@ bool CXmlFile::ReadMaterialInfo(const tinyxml2::XMLNode* parent_node,
                     == tinyxml2::XML_NO_ERROR;
 
   // Texture (optional)
-  const tinyxml2::XMLNode* child = parent_node->FirstChild();
+  Node child = parent_node->FirstChild();
   if (child != NULL) {
-    const tinyxml2::XMLElement* child_elem = child->ToElement();
-    if (child_elem->Value() == kTextureTag) {
+    auto child_elem = child->ToElement();
+    if (GetTagId(child_elem) == XmlTagId_Texture) {
       info.has_texture_ = true;
       const char* str_path = child_elem->Attribute(kPathTag.c_str());
       if (str_path != NULL) {
@@ -329,30 +910,23 @@ void CXmlFile::WriteMaterialInfo(const XmlMaterialInfo& info) {
   PopParentNode();
 }
 
-static bool ReadPoint(const tinyxml2::XMLNode* parent_node,
-                      CPoint3d& point) {
-  const tinyxml2::XMLElement* elem = parent_node->ToElement();
-  double x, y, z;
-  if (elem->QueryDoubleAttribute(kXTag.c_str(), &x) ==
-      tinyxml2::XML_NO_ERROR &&
-      elem->QueryDoubleAttribute(kYTag.c_str(), &y) ==
-      tinyxml2::XML_NO_ERROR &&
-      elem->QueryDoubleAttribute(kZTag.c_str(), &z) ==
-      tinyxml2::XML_NO_ERROR) {
-    point.SetLocation(x, y, z);
+template <typename Node>
+static bool ReadPoint(Node parent_node, CPoint3d& point) {
+  double xyz[3];
+  if (ReadDoubleAttributes(parent_node->ToElement(), XmlAttribId_X, 3, xyz)) {
+    point.SetLocation(xyz[0], xyz[1], xyz[2]);
     return true;
   }
   return false;
 }
 
-bool CXmlFile::ReadEdgeInfo(const tinyxml2::XMLNode* parent_node,
-                            XmlEdgeInfo& info) const {
+// Reads the optional Layer and Material children shared by edges, curves and
+// line lists, leaving child at the first node after them.
+template <typename Node>
+void CXmlFile::ReadEdgeStyle(Node& child, XmlEdgeInfo& info) const {
   // Layer (optional)
-  const tinyxml2::XMLNode* child = parent_node->FirstChild();
-  if (child == NULL)
-    return false;
-  if (child->Value() == kLayerTag) {
-    const tinyxml2::XMLElement* elem = child->ToElement();
+  if (child != NULL && GetTagId(child) == XmlTagId_Layer) {
+    auto elem = child->ToElement();
     const char* layer_name = elem->Attribute(kNameTag.c_str());
     if (layer_name != NULL) {
       info.has_layer_ = true;
@@ -363,23 +937,172 @@ bool CXmlFile::ReadEdgeInfo(const tinyxml2::XMLNode* parent_node,
     child = child->NextSibling();
   }
 
-  if (child == NULL)
-    return false;
-
   // Color (optional)
-  if (child->Value() == kMaterialTag) {
+  if (child != NULL && GetTagId(child) == XmlTagId_Material) {
     info.has_color_ = ReadColor(child, info.color_);
     child = child->NextSibling();
   }
+}
+
+void CXmlFile::WriteEdgeStyle(const XmlEdgeInfo& info) {
+  // Layer (optional)
+  if (info.has_layer_) {
+    tinyxml2::XMLElement* elem = WriteStartTag(kLayerTag.c_str());
+    elem->SetAttribute(kNameTag.c_str(), info.layer_name_.c_str());
+    PopParentNode();
+  }
+
+  // Color (optional)
+  if (info.has_color_) {
+    WriteStartTag(kMaterialTag.c_str());
+    WriteColor(info.color_);
+    PopParentNode();
+  }
+}
+
+// Whitespace separated number lists, used by the line list and polyline
+// encodings.
+
+static void AppendPointList(const std::vector<CPoint3d>& points,
+                            std::string& text) {
+  char buf[64];
+  for (size_t i = 0; i < points.size(); ++i) {
+    const double coords[3] = { points[i].x(), points[i].y(), points[i].z() };
+    for (int c = 0; c < 3; ++c) {
+      tinyxml2::XMLUtil::ToStr(coords[c], buf, sizeof(buf));
+      if (!text.empty())
+        text += ' ';
+      text += buf;
+    }
+  }
+}
+
+static void AppendIndexList(const std::vector<uint64_t>& indices,
+                            std::string& text) {
+  char buf[32];
+  for (size_t i = 0; i < indices.size(); ++i) {
+    tinyxml2::XMLUtil::ToStr(static_cast<int64_t>(indices[i]), buf,
+                             sizeof(buf));
+    if (!text.empty())
+      text += ' ';
+    text += buf;
+  }
+}
+
+static bool ParsePointList(const char* text, std::vector<CPoint3d>& points) {
+  if (text == NULL)
+    return true; // Empty list
+  // A batch of points at a time
+  const size_t kBatchSize = 3 * 256;
+  double values[kBatchSize];
+  const char* p = text;
+  size_t count = kBatchSize;
+  while (count == kBatchSize) {
+    count = tinyxml2::XMLUtil::ToDoubleArray(p, values, kBatchSize, &p);
+    if (count % 3 != 0)
+      return false;
+    for (size_t i = 0; i < count; i += 3) {
+      points.push_back(CPoint3d(values[i], values[i + 1], values[i + 2]));
+    }
+  }
+  // Anything left is not a number
+  return *tinyxml2::XMLUtil::SkipWhiteSpace(p) == 0;
+}
+
+static bool ParseIndexList(const char* text, std::vector<uint64_t>& indices) {
+  if (text == NULL)
+    return true; // Empty list
+  const char* p = text;
+  while (true) {
+    while (tinyxml2::XMLUtil::IsWhiteSpace(*p))
+      ++p;
+    if (*p == 0)
+      break;
+    char* end = NULL;
+    unsigned long long value = strtoull(p, &end, 10);
+    if (end == p)
+      return false;
+    indices.push_back(value);
+    p = end;
+  }
+  return true;
+}
+
+// Exact point comparison, for sharing the end points of connected edges
+struct PointKey {
+  explicit PointKey(const CPoint3d& pt) : x_(pt.x()), y_(pt.y()), z_(pt.z()) {}
+  bool operator<(const PointKey& key) const {
+    if (x_ != key.x_) return x_ < key.x_;
+    if (y_ != key.y_) return y_ < key.y_;
+    return z_ < key.z_;
+  }
+  double x_, y_, z_;
+};
+
+static bool SamePoint(const CPoint3d& a, const CPoint3d& b) {
+  return a.x() == b.x() && a.y() == b.y() && a.z() == b.z();
+}
+
+// Edges with the same key share their Layer and Material tags
+static std::string GetEdgeStyleKey(const XmlEdgeInfo& info) {
+  std::string key;
+  key += info.has_layer_ ? 'L' : '-';
+  key += info.has_color_ ? 'C' : '-';
+  if (info.has_color_) {
+    key += static_cast<char>(info.color_.red);
+    key += static_cast<char>(info.color_.green);
+    key += static_cast<char>(info.color_.blue);
+    key += static_cast<char>(info.color_.alpha);
+  }
+  if (info.has_layer_)
+    key += info.layer_name_;
+  return key;
+}
+
+// Chains the curve's edges into a single polyline. Returns false if the edges
+// are not connected end to end or do not share a layer and color.
+static bool GetPolyline(const XmlCurveInfo& info,
+                        std::vector<CPoint3d>& points) {
+  if (info.edges_.empty())
+    return false;
+  const XmlEdgeInfo& first = info.edges_.front();
+  std::string style = GetEdgeStyleKey(first);
+  points.push_back(first.start_);
+  points.push_back(first.end_);
+  for (size_t i = 1; i < info.edges_.size(); ++i) {
+    const XmlEdgeInfo& edge_info = info.edges_[i];
+    if (GetEdgeStyleKey(edge_info) != style)
+      return false;
+    if (i == 1 && !SamePoint(points.back(), edge_info.start_) &&
+        !SamePoint(points.back(), edge_info.end_)) {
+      // The first edge may run against the curve direction
+      std::swap(points[0], points[1]);
+    }
+    if (SamePoint(points.back(), edge_info.start_)) {
+      points.push_back(edge_info.end_);
+    } else if (SamePoint(points.back(), edge_info.end_)) {
+      points.push_back(edge_info.start_);
+    } else {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <typename Node>
+bool CXmlFile::ReadEdgeInfo(Node parent_node, XmlEdgeInfo& info) const {
+  // Layer and color (optional)
+  Node child = parent_node->FirstChild();
+  ReadEdgeStyle(child, info);
 
   bool ok = true;
 
   // End points
-  if (child != NULL && child->Value() == kStartTag) {
+  if (child != NULL && GetTagId(child) == XmlTagId_Start) {
     ok &= ReadPoint(child, info.start_);
 
     child = child->NextSibling();
-    if (child != NULL && child->Value() == kEndTag) {
+    if (child != NULL && GetTagId(child) == XmlTagId_End) {
       ok &= ReadPoint(child, info.end_);
     } else {
       ok = false;
@@ -392,21 +1115,13 @@ bool CXmlFile::ReadEdgeInfo(const tinyxml2::XMLNode* parent_node,
 }
 
 void CXmlFile::WriteEdgeInfo(const XmlEdgeInfo& info) {
-  WriteStartTag(kEdgeTag.c_str());
+  coarse_builder_.AddPoint(info.start_);
+  coarse_builder_.AddPoint(info.end_);
 
-  // Layer (optional)
-  if (info.has_layer_) {
-    tinyxml2::XMLElement* elem = WriteStartTag(kLayerTag.c_str());
-    elem->SetAttribute(kNameTag.c_str(), info.layer_name_.c_str());
-    PopParentNode();
-  }
+  WriteStartTag(kEdgeTag.c_str());
 
-  // Color (optional)
-  if (info.has_color_) {
-    WriteStartTag(kMaterialTag.c_str());
-    WriteColor(info.color_);
-    PopParentNode();
-  }
+  // Layer and color (optional)
+  WriteEdgeStyle(info);
 
   // End points
   {
@@ -427,123 +1142,460 @@ void CXmlFile::WriteEdgeInfo(const XmlEdgeInfo& info) {
   PopParentNode();
 }
 
-bool CXmlFile::ReadFaceInfo(const tinyxml2::XMLNode* parent_node,
-                            XmlFaceInfo& info) const {
-  // Front material (optional)
-  const tinyxml2::XMLNode* child = parent_node->FirstChild();
-  if (child->Value() == kFrontMaterialTag) {
-    const tinyxml2::XMLElement* elem = child->ToElement();
-    const char* mat_name = elem->Attribute(kNameTag.c_str());
-    if (mat_name != NULL)
-      info.front_mat_name_ = mat_name;
-    else
-      info.front_mat_name_.clear();
-    elem->QueryBoolAttribute(kHasTextureTag.c_str(), &info.has_front_texture_);
-    child = child->NextSibling();
+// Quantized vertex channels, as whitespace separated integers or base64
+// encoded little endian values
+
+static std::string FormatChannel(const std::vector<uint32_t>& values,
+                                 size_t value_size, bool is_binary) {
+  std::string data;
+  if (is_binary) {
+    for (size_t i = 0; i < values.size(); ++i) {
+      for (size_t b = 0; b < value_size; ++b) {
+        data += static_cast<char>((values[i] >> (8 * b)) & 0xff);
+      }
+    }
+    return XmlQuantization::EncodeBase64(data);
   }
 
-  // Back material (optional)
-  if (child->Value() == kBackMaterialTag) {
-    const tinyxml2::XMLElement* elem = child->ToElement();
-    const char* mat_name = elem->Attribute(kNameTag.c_str());
-    if (mat_name != NULL)
-      info.back_mat_name_ = mat_name;
-    else
-      info.back_mat_name_.clear();
-    elem->QueryBoolAttribute(kHasTextureTag.c_str(), &info.has_back_texture_);
-    child = child->NextSibling();
+  char buf[16];
+  for (size_t i = 0; i < values.size(); ++i) {
+    tinyxml2::XMLUtil::ToStr(static_cast<int64_t>(values[i]), buf,
+                             sizeof(buf));
+    if (!data.empty())
+      data += ' ';
+    data += buf;
   }
+  return data;
+}
 
-  // Layer (optional)
-  if (child->Value() == kLayerTag) {
-    const tinyxml2::XMLElement* elem = child->ToElement();
-    const char* layer_name = elem->Attribute(kNameTag.c_str());
-    if (layer_name != NULL) {
-      info.layer_name_ = layer_name;
+template <typename Node>
+static bool ReadChannel(Node node, const std::string& tag,
+                        bool is_binary, size_t value_size, uint64_t count,
+                        std::vector<uint32_t>& values) {
+  if (node == NULL || node->Value() != tag)
+    return false;
+  const char* text = node->ToElement()->GetText();
+  if (is_binary) {
+    std::string data;
+    if (!XmlQuantization::DecodeBase64(text, data) ||
+        data.size() != count * value_size)
+      return false;
+    values.resize(static_cast<size_t>(count));
+    for (size_t i = 0; i < values.size(); ++i) {
+      uint32_t value = 0;
+      for (size_t b = 0; b < value_size; ++b) {
+        value |= static_cast<uint32_t>(
+            static_cast<unsigned char>(data[i * value_size + b])) << (8 * b);
+      }
+      values[i] = value;
     }
-    child = child->NextSibling();
+    return true;
   }
 
-  // Loop or Triangles
-  bool ok = false;
-  int triangle_count = 0;
-  if (child->Value() == kLoopTag) {
-    info.has_single_loop_ = true;
-    ok = true;
-  } else if (child->Value() == kTrianglesTag) {
-    info.has_single_loop_ = false;
-    const tinyxml2::XMLElement* elem = child->ToElement();
-    ok = elem->QueryIntAttribute(kCountTag.c_str(), &triangle_count) == 
-         tinyxml2::XML_NO_ERROR;
+  std::vector<uint64_t> parsed;
+  if (!ParseIndexList(text, parsed) || parsed.size() != count)
+    return false;
+  uint64_t max_value = (static_cast<uint64_t>(1) << (8 * value_size)) - 1;
+  values.resize(parsed.size());
+  for (size_t i = 0; i < parsed.size(); ++i) {
+    if (parsed[i] > max_value)
+      return false;
+    values[i] = static_cast<uint32_t>(parsed[i]);
   }
-  if (ok) {
-    const tinyxml2::XMLNode* vertex_node = child->FirstChild();
-    while (ok && vertex_node != NULL && vertex_node->Value() == kVertexTag) {
-      // Vertex position
-      const tinyxml2::XMLNode* pt_node = vertex_node->FirstChild();
-      if (pt_node != NULL) {
-        const tinyxml2::XMLElement* elem = pt_node->ToElement();
-        XmlFaceVertex vertex;
-        if (ReadPoint(pt_node, vertex.vertex_)) {
-          // Front texture coords
-          const tinyxml2::XMLNode* node = pt_node;
-          if (info.has_front_texture_) {
-            node = node->NextSibling();
-            if (node != NULL && node->Value() == kFrontTextureCoordsTag) {
-              elem = node->ToElement();
-              double u, v;
-              if (elem->QueryDoubleAttribute(kUTag.c_str(), &u) ==
-                  tinyxml2::XML_NO_ERROR &&
-                  elem->QueryDoubleAttribute(kVTag.c_str(), &v) ==
-                  tinyxml2::XML_NO_ERROR) {
-                vertex.front_texture_coord_.SetLocation(u, v, 0);
-              } else {
-                ok = false;
-              }
-            } else {
-              ok = false;
-            }
-          }
-          // Back texture coords
-          if (info.has_back_texture_) {
-            node = node->NextSibling();
-            if (node != NULL && node->Value() == kBackTextureCoordsTag) {
-              elem = node->ToElement();
-              double u, v;
-              if (elem->QueryDoubleAttribute(kUTag.c_str(), &u) ==
-                  tinyxml2::XML_NO_ERROR &&
-                  elem->QueryDoubleAttribute(kVTag.c_str(), &v) ==
-                  tinyxml2::XML_NO_ERROR) {
-                vertex.back_texture_coord_.SetLocation(u, v, 0);
-              } else {
-                ok = false;
-              }
-            } else {
-              ok = false;
-            }
-          }
-          
-          info.vertices_.push_back(vertex);
-        } else {
-          ok = false;
-        }
-      } else {
-        ok = false;
-      }
-      
-      vertex_node = vertex_node->NextSibling();
-    } // Vertex loop
-
-    // If a mesh is given, check the number of vertices
-    if (!info.has_single_loop_) {
-      ok &= (info.vertices_.size() == triangle_count * 3);
-    }
-  } // if (ok)
+  return true;
+}
 
-  return ok;
+// Number of values per vertex in the compressed mesh corners
+static size_t GetCornerStride(bool has_normals, bool has_front_texture,
+                              bool has_back_texture) {
+  return 3 + (has_normals ? 2 : 0) + (has_front_texture ? 2 : 0) +
+         (has_back_texture ? 2 : 0);
+}
+
+// The quantized values of a face, one channel per vertex attribute
+struct QuantizedChannels {
+  std::vector<uint32_t> positions_;
+  std::vector<uint32_t> normals_;
+  std::vector<uint32_t> front_uvs_;
+  std::vector<uint32_t> back_uvs_;
+};
+
+static void QuantizeVertices(const XmlFaceInfo& info,
+                             const XmlQuantizationInfo& quantization,
+                             QuantizedChannels& channels) {
+  using namespace XmlQuantization;
+  const CPoint3d& origin = quantization.origin_;
+  double step = quantization.step_;
+  for (size_t i = 0; i < info.vertices_.size(); ++i) {
+    const XmlFaceVertex& vertex_info = info.vertices_[i];
+    const CPoint3d& pt = vertex_info.vertex_;
+    channels.positions_.push_back(QuantizePosition(pt.x(), origin.x(), step));
+    channels.positions_.push_back(QuantizePosition(pt.y(), origin.y(), step));
+    channels.positions_.push_back(QuantizePosition(pt.z(), origin.z(), step));
+
+    if (info.has_normals_) {
+      uint16_t u, v;
+      EncodeNormal(vertex_info.normal_, u, v);
+      channels.normals_.push_back(u);
+      channels.normals_.push_back(v);
+    }
+
+    if (info.has_front_texture_) {
+      const CPoint3d& uv = vertex_info.front_texture_coord_;
+      channels.front_uvs_.push_back(
+          QuantizeUnit(uv.x(), quantization.min_u_, quantization.max_u_));
+      channels.front_uvs_.push_back(
+          QuantizeUnit(uv.y(), quantization.min_v_, quantization.max_v_));
+    }
+    if (info.has_back_texture_) {
+      const CPoint3d& uv = vertex_info.back_texture_coord_;
+      channels.back_uvs_.push_back(
+          QuantizeUnit(uv.x(), quantization.min_u_, quantization.max_u_));
+      channels.back_uvs_.push_back(
+          QuantizeUnit(uv.y(), quantization.min_v_, quantization.max_v_));
+    }
+  }
+}
+
+// The face is an XmlFaceInfo or an XmlRenderFace
+template <typename Face>
+static void DequantizeVertices(const QuantizedChannels& channels,
+                               const XmlQuantizationInfo& quantization,
+                               uint64_t num_vertices, Face& info) {
+  using namespace XmlQuantization;
+  const CPoint3d& origin = quantization.origin_;
+  double step = quantization.step_;
+  const std::vector<uint32_t>& positions = channels.positions_;
+  const std::vector<uint32_t>& normals = channels.normals_;
+  const std::vector<uint32_t>& front_uvs = channels.front_uvs_;
+  const std::vector<uint32_t>& back_uvs = channels.back_uvs_;
+  info.vertices_.reserve(info.vertices_.size() +
+                         static_cast<size_t>(num_vertices));
+  for (size_t i = 0; i < num_vertices; ++i) {
+    XmlFaceVertex vertex;
+    vertex.vertex_.SetLocation(
+        DequantizePosition(positions[i * 3], origin.x(), step),
+        DequantizePosition(positions[i * 3 + 1], origin.y(), step),
+        DequantizePosition(positions[i * 3 + 2], origin.z(), step));
+    if (info.has_normals_) {
+      vertex.normal_ = DecodeNormal(static_cast<uint16_t>(normals[i * 2]),
+                                    static_cast<uint16_t>(normals[i * 2 + 1]));
+    }
+    if (info.has_front_texture_) {
+      vertex.front_texture_coord_.SetLocation(
+          DequantizeUnit(static_cast<uint16_t>(front_uvs[i * 2]),
+                         quantization.min_u_, quantization.max_u_),
+          DequantizeUnit(static_cast<uint16_t>(front_uvs[i * 2 + 1]),
+                         quantization.min_v_, quantization.max_v_), 0);
+    }
+    if (info.has_back_texture_) {
+      vertex.back_texture_coord_.SetLocation(
+          DequantizeUnit(static_cast<uint16_t>(back_uvs[i * 2]),
+                         quantization.min_u_, quantization.max_u_),
+          DequantizeUnit(static_cast<uint16_t>(back_uvs[i * 2 + 1]),
+                         quantization.min_v_, quantization.max_v_), 0);
+    }
+    info.vertices_.push_back(vertex);
+  }
+}
+
+// Interleaves the channels into the corners of a compressed mesh
+static void GetMeshCorners(const QuantizedChannels& channels, size_t stride,
+                           std::vector<uint32_t>& corners) {
+  size_t num_vertices = channels.positions_.size() / 3;
+  corners.reserve(num_vertices * stride);
+  for (size_t i = 0; i < num_vertices; ++i) {
+    corners.insert(corners.end(), &channels.positions_[i * 3],
+                   &channels.positions_[i * 3] + 3);
+    if (!channels.normals_.empty()) {
+      corners.insert(corners.end(), &channels.normals_[i * 2],
+                     &channels.normals_[i * 2] + 2);
+    }
+    if (!channels.front_uvs_.empty()) {
+      corners.insert(corners.end(), &channels.front_uvs_[i * 2],
+                     &channels.front_uvs_[i * 2] + 2);
+    }
+    if (!channels.back_uvs_.empty()) {
+      corners.insert(corners.end(), &channels.back_uvs_[i * 2],
+                     &channels.back_uvs_[i * 2] + 2);
+    }
+  }
+}
+
+template <typename Node>
+static bool ReadMeshCorners(Node node, bool has_normals,
+                            bool has_front_texture, bool has_back_texture,
+                            uint64_t num_vertices,
+                            QuantizedChannels& channels) {
+  if (node == NULL || GetTagId(node) != XmlTagId_Mesh)
+    return false;
+  std::string payload;
+  if (!XmlQuantization::DecodeBase64(node->ToElement()->GetText(), payload))
+    return false;
+
+  size_t stride = GetCornerStride(has_normals, has_front_texture,
+                                  has_back_texture);
+  std::vector<uint32_t> corners;
+  if (!XmlMeshCompression::Decode(payload, stride, num_vertices, corners))
+    return false;
+
+  for (size_t i = 0; i < corners.size(); i += stride) {
+    const uint32_t* values = &corners[i];
+    channels.positions_.insert(channels.positions_.end(), values, values + 3);
+    values += 3;
+    if (has_normals) {
+      channels.normals_.insert(channels.normals_.end(), values, values + 2);
+      values += 2;
+    }
+    if (has_front_texture) {
+      channels.front_uvs_.insert(channels.front_uvs_.end(), values,
+                                 values + 2);
+      values += 2;
+    }
+    if (has_back_texture) {
+      channels.back_uvs_.insert(channels.back_uvs_.end(), values, values + 2);
+    }
+  }
+  return true;
+}
+
+template <typename Node, typename Face>
+bool CXmlFile::ReadQuantizedVertices(Node parent_node,
+                                     const XmlQuantizationInfo& quantization,
+                                     uint64_t num_vertices,
+                                     Face& info) const {
+  QuantizedChannels channels;
+  Node child = parent_node->FirstChild();
+  bool ok = true;
+  if (quantization.encoding_ == XmlQuantizationEncoding_Compressed) {
+    ok = ReadMeshCorners(child, info.has_normals_, info.has_front_texture_,
+                         info.has_back_texture_, num_vertices, channels);
+  } else {
+    bool is_binary = quantization.encoding_ == XmlQuantizationEncoding_Binary;
+    ok = ReadChannel(child, kPositionsTag, is_binary, 4,
+                     num_vertices * 3, channels.positions_);
+    if (ok && info.has_normals_) {
+      child = child->NextSibling();
+      ok = ReadChannel(child, kNormalsTag, is_binary, 2,
+                       num_vertices * 2, channels.normals_);
+    }
+    if (ok && info.has_front_texture_) {
+      child = child->NextSibling();
+      ok = ReadChannel(child, kFrontUVsTag, is_binary, 2,
+                       num_vertices * 2, channels.front_uvs_);
+    }
+    if (ok && info.has_back_texture_) {
+      child = child->NextSibling();
+      ok = ReadChannel(child, kBackUVsTag, is_binary, 2,
+                       num_vertices * 2, channels.back_uvs_);
+    }
+  }
+
+  if (ok)
+    DequantizeVertices(channels, quantization, num_vertices, info);
+  return ok;
+}
+
+void CXmlFile::WriteQuantizedVertices(
+    const XmlFaceInfo& info,
+    const XmlQuantizationInfo& quantization) {
+  QuantizedChannels channels;
+  QuantizeVertices(info, quantization, channels);
+
+  if (quantization.encoding_ == XmlQuantizationEncoding_Compressed) {
+    size_t stride = GetCornerStride(info.has_normals_, info.has_front_texture_,
+                                    info.has_back_texture_);
+    std::vector<uint32_t> corners;
+    GetMeshCorners(channels, stride, corners);
+    std::string payload;
+    XmlMeshCompression::Encode(corners, stride, payload);
+    std::string text = XmlQuantization::EncodeBase64(payload);
+    compression_stats_.triangles_ += info.vertices_.size() / 3;
+    compression_stats_.bytes_ += text.size();
+
+    WriteStartTag(kMeshTag.c_str());
+    WriteText(text);
+    PopParentNode();
+    return;
+  }
+
+  bool is_binary = quantization.encoding_ == XmlQuantizationEncoding_Binary;
+  const std::vector<uint32_t>* values[4] = {
+    &channels.positions_, &channels.normals_,
+    &channels.front_uvs_, &channels.back_uvs_
+  };
+  const std::string* tags[4] = {
+    &kPositionsTag, &kNormalsTag, &kFrontUVsTag, &kBackUVsTag
+  };
+  bool has_channel[4] = {
+    true, info.has_normals_, info.has_front_texture_, info.has_back_texture_
+  };
+  for (int i = 0; i < 4; ++i) {
+    if (!has_channel[i])
+      continue;
+    WriteStartTag(tags[i]->c_str());
+    WriteText(FormatChannel(*values[i], i == 0 ? 4 : 2, is_binary));
+    PopParentNode();
+  }
+}
+
+template <typename Node>
+static bool ReadNormal(Node parent_node, CVector3d& normal) {
+  double xyz[3];
+  if (ReadDoubleAttributes(parent_node->ToElement(), XmlAttribId_Nx, 3, xyz)) {
+    normal.SetDirection(xyz[0], xyz[1], xyz[2]);
+    return true;
+  }
+  return false;
+}
+
+template <typename Node, typename Face>
+bool CXmlFile::ReadFaceInfo(Node parent_node,
+                            const XmlQuantizationInfo* quantization,
+                            Face& info) const {
+  // Front material (optional)
+  Node child = parent_node->FirstChild();
+  if (GetTagId(child) == XmlTagId_FrontMaterial) {
+    auto elem = child->ToElement();
+    const char* mat_name = elem->Attribute(kNameTag.c_str());
+    if (mat_name != NULL)
+      info.front_mat_name_ = mat_name;
+    else
+      info.front_mat_name_.clear();
+    elem->QueryBoolAttribute(kHasTextureTag.c_str(), &info.has_front_texture_);
+    child = child->NextSibling();
+  }
+
+  // Back material (optional)
+  if (GetTagId(child) == XmlTagId_BackMaterial) {
+    auto elem = child->ToElement();
+    const char* mat_name = elem->Attribute(kNameTag.c_str());
+    if (mat_name != NULL)
+      info.back_mat_name_ = mat_name;
+    else
+      info.back_mat_name_.clear();
+    elem->QueryBoolAttribute(kHasTextureTag.c_str(), &info.has_back_texture_);
+    child = child->NextSibling();
+  }
+
+  // Layer (optional)
+  if (GetTagId(child) == XmlTagId_Layer) {
+    auto elem = child->ToElement();
+    const char* layer_name = elem->Attribute(kNameTag.c_str());
+    if (layer_name != NULL) {
+      info.layer_name_ = layer_name;
+    }
+    child = child->NextSibling();
+  }
+
+  // Loop or Triangles
+  bool ok = false;
+  int64_t triangle_count = 0;
+  switch (GetTagId(child)) {
+    case XmlTagId_Loop:
+      info.has_single_loop_ = true;
+      ok = true;
+      break;
+    case XmlTagId_Triangles: {
+      info.has_single_loop_ = false;
+      auto elem = child->ToElement();
+      ok = elem->QueryInt64Attribute(kCountTag.c_str(), &triangle_count) ==
+           tinyxml2::XML_NO_ERROR && triangle_count >= 0;
+      info.has_normals_ = true;
+      elem->QueryBoolAttribute(kHasNormalsTag.c_str(), &info.has_normals_);
+      break;
+    }
+    default:
+      break;
+  }
+  if (ok) {
+    Node vertex_node = child->FirstChild();
+    XmlTagId vertex_tag = GetTagId(vertex_node);
+    bool is_quantized = false;
+    if (quantization != NULL && !info.has_single_loop_ &&
+        (vertex_tag == XmlTagId_Positions || vertex_tag == XmlTagId_Mesh)) {
+      // Quantized vertex channels
+      ok = ReadQuantizedVertices(child, *quantization,
+                                 static_cast<uint64_t>(triangle_count) * 3,
+                                 info);
+      is_quantized = true;
+    }
+    while (ok && !is_quantized && vertex_node != NULL &&
+           GetTagId(vertex_node) == XmlTagId_Vertex) {
+      // Vertex position
+      Node pt_node = vertex_node->FirstChild();
+      if (pt_node != NULL) {
+        XmlFaceVertex vertex;
+        if (ReadPoint(pt_node, vertex.vertex_)) {
+          // Normal (optional)
+          Node node = pt_node;
+          if (node->NextSibling() != NULL &&
+              GetTagId(node->NextSibling()) == XmlTagId_Normal) {
+            node = node->NextSibling();
+            ok &= ReadNormal(node, vertex.normal_);
+          }
+
+          // Front texture coords
+          if (info.has_front_texture_) {
+            node = node->NextSibling();
+            if (node != NULL &&
+                GetTagId(node) == XmlTagId_FrontTextureCoords) {
+              double uv[2];
+              if (ReadDoubleAttributes(node->ToElement(), XmlAttribId_U, 2,
+                                       uv)) {
+                vertex.front_texture_coord_.SetLocation(uv[0], uv[1], 0);
+              } else {
+                ok = false;
+              }
+            } else {
+              ok = false;
+            }
+          }
+          // Back texture coords
+          if (info.has_back_texture_) {
+            node = node->NextSibling();
+            if (node != NULL &&
+                GetTagId(node) == XmlTagId_BackTextureCoords) {
+              double uv[2];
+              if (ReadDoubleAttributes(node->ToElement(), XmlAttribId_U, 2,
+                                       uv)) {
+                vertex.back_texture_coord_.SetLocation(uv[0], uv[1], 0);
+              } else {
+                ok = false;
+              }
+            } else {
+              ok = false;
+            }
+          }
+          
+          info.vertices_.push_back(vertex);
+        } else {
+          ok = false;
+        }
+      } else {
+        ok = false;
+      }
+      
+      vertex_node = vertex_node->NextSibling();
+    } // Vertex loop
+
+    // If a mesh is given, check the number of vertices
+    if (!info.has_single_loop_) {
+      ok &= (info.vertices_.size() ==
+             static_cast<uint64_t>(triangle_count) * 3);
+    }
+  } // if (ok)
+
+  return ok;
 }
 
 void CXmlFile::WriteFaceInfo(const XmlFaceInfo& info) {
+  for (size_t i = 0; i + 2 < info.vertices_.size(); i += 3) {
+    coarse_builder_.AddTriangle(info.vertices_[i].vertex_,
+                                info.vertices_[i + 1].vertex_,
+                                info.vertices_[i + 2].vertex_);
+  }
+
   WriteStartTag(kFaceTag.c_str());
 
   // Front material (optional)
@@ -581,8 +1633,20 @@ void CXmlFile::WriteFaceInfo(const XmlFaceInfo& info) {
 	*/
 
 	tinyxml2::XMLElement* elem = WriteStartTag(kTrianglesTag.c_str());
-	elem->SetAttribute(kCountTag.c_str(), static_cast<unsigned>(count / 3));
-  
+	elem->SetAttribute(kCountTag.c_str(), static_cast<int64_t>(count / 3));
+  // Normals are written unless they were left out of the export
+  if (!info.has_normals_)
+    elem->SetAttribute(kHasNormalsTag.c_str(), false);
+
+  // Quantized vertices, against the bounds of the whole definition
+  if (options_.export_quantized() && quantization_scope_ != NULL) {
+    WriteQuantizedVertices(info, quantization_);
+    quantization_has_faces_ = true;
+    PopParentNode(); // Triangles
+    PopParentNode(); // Face
+    return;
+  }
+
 	// Vertices
   for (size_t i = 0; i < count; i++) {
     WriteStartTag(kVertexTag.c_str());
@@ -594,8 +1658,8 @@ void CXmlFile::WriteFaceInfo(const XmlFaceInfo& info) {
       elem->SetAttribute(kZTag.c_str(), vertex_info.vertex_.z());
       PopParentNode();
     }
-		
-		{
+
+    if (info.has_normals_) {
       tinyxml2::XMLElement* elem = WriteStartTag(kNormalTag.c_str());
       elem->SetAttribute(kNxTag.c_str(), vertex_info.normal_.x());
       elem->SetAttribute(kNyTag.c_str(), vertex_info.normal_.y());
@@ -623,10 +1687,30 @@ void CXmlFile::WriteFaceInfo(const XmlFaceInfo& info) {
   PopParentNode(); // Face
 }
 
-bool CXmlFile::ReadCurveInfo(const tinyxml2::XMLNode* parent_node,
-                             XmlCurveInfo& info) const {
+template <typename Node>
+bool CXmlFile::ReadCurveInfo(Node parent_node, XmlCurveInfo& info) const {
+  // Polyline form: the style, then the points shared by consecutive edges
+  XmlEdgeInfo style;
+  Node child = parent_node->FirstChild();
+  ReadEdgeStyle(child, style);
+  if (child != NULL && GetTagId(child) == XmlTagId_Polyline) {
+    std::vector<CPoint3d> points;
+    int64_t count = 0;
+    bool ok = child->ToElement()->QueryInt64Attribute(kCountTag.c_str(),
+                                                      &count) ==
+              tinyxml2::XML_NO_ERROR;
+    ok = ok && ParsePointList(child->ToElement()->GetText(), points) &&
+         points.size() == static_cast<uint64_t>(count);
+    for (size_t i = 1; ok && i < points.size(); ++i) {
+      XmlEdgeInfo edge_info = style;
+      edge_info.start_ = points[i - 1];
+      edge_info.end_ = points[i];
+      info.edges_.push_back(edge_info);
+    }
+    return ok;
+  }
+
   bool ok = true;
-  const tinyxml2::XMLNode* child = parent_node->FirstChild();
   while (child != NULL) {
     XmlEdgeInfo edge_info;
     if (ReadEdgeInfo(child, edge_info)) {
@@ -640,39 +1724,167 @@ bool CXmlFile::ReadCurveInfo(const tinyxml2::XMLNode* parent_node,
 }
 
 void CXmlFile::WriteCurveInfo(const XmlCurveInfo& info) {
+  for (size_t i = 0; i < info.edges_.size(); ++i) {
+    coarse_builder_.AddPoint(info.edges_[i].start_);
+    coarse_builder_.AddPoint(info.edges_[i].end_);
+  }
+
   WriteStartTag(kCurveTag.c_str());
-  
-  for (std::vector<XmlEdgeInfo>::const_iterator it = info.edges_.begin();
-       it != info.edges_.end(); ++it) {
-    WriteEdgeInfo(*it);
+
+  std::vector<CPoint3d> points;
+  if (options_.export_line_lists() && GetPolyline(info, points)) {
+    // Each point once, shared by consecutive edges
+    WriteEdgeStyle(info.edges_.front());
+    tinyxml2::XMLElement* elem = WriteStartTag(kPolylineTag.c_str());
+    elem->SetAttribute(kCountTag.c_str(), static_cast<int64_t>(points.size()));
+    std::string text;
+    AppendPointList(points, text);
+    WriteText(text);
+    PopParentNode();
+  } else {
+    for (std::vector<XmlEdgeInfo>::const_iterator it = info.edges_.begin();
+         it != info.edges_.end(); ++it) {
+      WriteEdgeInfo(*it);
+    }
   }
 
   PopParentNode();
 }
 
+template <typename Node>
+bool CXmlFile::ReadLineListInfo(Node parent_node,
+                                std::vector<XmlEdgeInfo>& edges) const {
+  int64_t count = 0;
+  bool ok = parent_node->ToElement()->QueryInt64Attribute(kCountTag.c_str(),
+                                                          &count) ==
+            tinyxml2::XML_NO_ERROR && count >= 0;
+
+  // Layer and color shared by all the lines
+  XmlEdgeInfo style;
+  Node child = parent_node->FirstChild();
+  ReadEdgeStyle(child, style);
+
+  // Points
+  std::vector<CPoint3d> points;
+  if (ok && child != NULL && GetTagId(child) == XmlTagId_Points) {
+    ok = ParsePointList(child->ToElement()->GetText(), points);
+    child = child->NextSibling();
+  } else {
+    ok = false;
+  }
+
+  // Two point indices per line
+  std::vector<uint64_t> indices;
+  if (ok && child != NULL && GetTagId(child) == XmlTagId_Indices) {
+    ok = ParseIndexList(child->ToElement()->GetText(), indices) &&
+         indices.size() == static_cast<uint64_t>(count) * 2;
+  } else {
+    ok = false;
+  }
+
+  for (size_t i = 0; ok && i + 1 < indices.size(); i += 2) {
+    if (indices[i] >= points.size() || indices[i + 1] >= points.size()) {
+      ok = false;
+      break;
+    }
+    XmlEdgeInfo edge_info = style;
+    edge_info.start_ = points[static_cast<size_t>(indices[i])];
+    edge_info.end_ = points[static_cast<size_t>(indices[i + 1])];
+    edges.push_back(edge_info);
+  }
+  return ok;
+}
+
+void CXmlFile::WriteLineListInfo(const std::vector<XmlEdgeInfo>& edges) {
+  for (size_t i = 0; i < edges.size(); ++i) {
+    coarse_builder_.AddPoint(edges[i].start_);
+    coarse_builder_.AddPoint(edges[i].end_);
+  }
+
+  // Group the edges by layer and color, in order of first use
+  std::vector<std::vector<size_t> > groups;
+  std::map<std::string, size_t> group_index;
+  for (size_t i = 0; i < edges.size(); ++i) {
+    std::string key = GetEdgeStyleKey(edges[i]);
+    std::map<std::string, size_t>::iterator it = group_index.find(key);
+    if (it == group_index.end()) {
+      it = group_index.insert(std::make_pair(key, groups.size())).first;
+      groups.push_back(std::vector<size_t>());
+    }
+    groups[it->second].push_back(i);
+  }
+
+  for (size_t g = 0; g < groups.size(); ++g) {
+    const std::vector<size_t>& group = groups[g];
+    tinyxml2::XMLElement* elem = WriteStartTag(kLinesTag.c_str());
+    elem->SetAttribute(kCountTag.c_str(), static_cast<int64_t>(group.size()));
+    WriteEdgeStyle(edges[group.front()]);
+
+    // End points are written once and referenced by index
+    std::vector<CPoint3d> points;
+    std::vector<uint64_t> indices;
+    std::map<PointKey, uint64_t> point_index;
+    for (size_t i = 0; i < group.size(); ++i) {
+      const XmlEdgeInfo& edge_info = edges[group[i]];
+      const CPoint3d* ends[2] = { &edge_info.start_, &edge_info.end_ };
+      for (int e = 0; e < 2; ++e) {
+        PointKey key(*ends[e]);
+        std::map<PointKey, uint64_t>::iterator it = point_index.find(key);
+        if (it == point_index.end()) {
+          it = point_index.insert(std::make_pair(key, points.size())).first;
+          points.push_back(*ends[e]);
+        }
+        indices.push_back(it->second);
+      }
+    }
+
+    std::string text;
+    elem = WriteStartTag(kPointsTag.c_str());
+    elem->SetAttribute(kCountTag.c_str(), static_cast<int64_t>(points.size()));
+    AppendPointList(points, text);
+    WriteText(text);
+    PopParentNode();
+
+    text.clear();
+    WriteStartTag(kIndicesTag.c_str());
+    AppendIndexList(indices, text);
+    WriteText(text);
+    PopParentNode();
+
+    PopParentNode(); // Lines
+  }
+}
+
 static std::string MakeMatrixAttribName(int row, int col) {
   std::stringstream ss;
   ss << 'm' << row << col;
   return ss.str();
 }
 
-bool CXmlFile::ReadTransformation(const tinyxml2::XMLNode* parent_node,
+template <typename Node>
+bool CXmlFile::ReadTransformation(Node parent_node,
                                   SUTransformation& transform) const {
-  const tinyxml2::XMLElement* elem = parent_node->LastChildElement();
-  if (elem == NULL || elem->Value() != kTransformTag)
+  auto elem = parent_node->LastChildElement();
+  if (elem == NULL || GetTagId(elem) != XmlTagId_Transformation)
     return false;
 
+  // Missing entries are 0, by row in the attributes but by column in the
+  // transformation
+  double by_row[16] = { 0 };
+  ReadDoubleAttributes(elem, XmlAttribId_M00, 16, by_row);
   for (int col = 0; col < 4; ++col) {
-    for (int row = 0; row < 4; ++row) {
-      std::string tag = MakeMatrixAttribName(row, col);
-      transform.values[col * 4 + row] = elem->DoubleAttribute(tag.c_str());
-    }
+    for (int row = 0; row < 4; ++row)
+      transform.values[col * 4 + row] = by_row[row * 4 + col];
   }
 
   return true;
 }
 
 void CXmlFile::WriteTransformation(const SUTransformation& transform) {
+  // Only groups have their transformation directly inside the scope
+  if (!coarse_scopes_.empty() && parent_node_ == coarse_scopes_.back())
+    coarse_builder_.SetGroupTransform(transform);
+
   tinyxml2::XMLElement* elem = WriteStartTag(kTransformTag.c_str());
   for (int col = 0; col < 4; ++col) {
     for (int row = 0; row < 4; ++row) {
@@ -686,21 +1898,108 @@ void CXmlFile::WriteTransformation(const SUTransformation& transform) {
 bool CXmlFile::GetModelInfo(XmlModelInfo& model_info) const {
   // Clear out the given model info
   model_info = XmlModelInfo();
+  return ReadModelInfo(ConstNode(xml_doc_), model_info);
+}
+
+static double GetSeconds() {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool CXmlFile::BenchmarkMeshDecoding(size_t num_passes,
+                                     XmlMeshDecodeBenchmarkInfo& info) const {
+  info = XmlMeshDecodeBenchmarkInfo();
+  if (xml_doc_ == NULL)
+    return false;
+
+  // The definitions and the geometry, with their dequantization parameters
+  typedef std::pair<const tinyxml2::XMLNode*, const XmlQuantizationInfo*>
+      ScopedNode;
+  std::vector<ScopedNode> levels;
+  for (const tinyxml2::XMLNode* child = xml_doc_->FirstChild(); child != NULL;
+       child = child->NextSibling()) {
+    XmlTagId tag = GetTagId(child);
+    if (tag == XmlTagId_Geometry) {
+      levels.push_back(
+          ScopedNode(child, FindQuantization(true, std::string())));
+    } else if (tag == XmlTagId_ComponentDefinitions) {
+      for (const tinyxml2::XMLElement* def = child->FirstChildElement();
+           def != NULL; def = def->NextSiblingElement()) {
+        const char* name = def->Attribute(kNameTag.c_str());
+        if (name != NULL)
+          levels.push_back(ScopedNode(def, FindQuantization(false, name)));
+      }
+    }
+  }
+
+  // Their faces with a compressed mesh, groups included
+  std::vector<ScopedNode> faces;
+  while (!levels.empty()) {
+    ScopedNode level = levels.back();
+    levels.pop_back();
+    if (level.second == NULL ||
+        level.second->encoding_ != XmlQuantizationEncoding_Compressed)
+      continue;
+    for (const tinyxml2::XMLNode* child = level.first->FirstChild();
+         child != NULL; child = child->NextSibling()) {
+      XmlTagId tag = GetTagId(child);
+      if (tag == XmlTagId_Group) {
+        levels.push_back(ScopedNode(child, level.second));
+      } else if (tag == XmlTagId_Face) {
+        const tinyxml2::XMLElement* triangles =
+            child->FirstChildElement(kTrianglesTag.c_str());
+        const tinyxml2::XMLElement* mesh = triangles != NULL ?
+            triangles->FirstChildElement(kMeshTag.c_str()) : NULL;
+        const char* text = mesh != NULL ? mesh->GetText() : NULL;
+        if (text != NULL) {
+          info.bytes_ += strlen(text);
+          faces.push_back(ScopedNode(child, level.second));
+        }
+      }
+    }
+  }
+  info.meshes_ = faces.size();
+  info.passes_ = num_passes;
+
+  double start = GetSeconds();
+  for (size_t pass = 0; pass < num_passes; ++pass) {
+    for (size_t i = 0; i < faces.size(); ++i) {
+      XmlFaceInfo face_info;
+      bool ok = ReadFaceInfo(faces[i].first, faces[i].second, face_info);
+      if (pass == 0) {
+        info.triangles_ += face_info.vertices_.size() / 3;
+        if (!ok)
+          ++info.failures_;
+      }
+    }
+  }
+  info.seconds_ = GetSeconds() - start;
+  return info.failures_ == 0;
+}
 
+template <typename Node>
+bool CXmlFile::ReadModelInfo(Node doc_node, XmlModelInfo& model_info) const {
   bool ok = true;
 
   // Loop through top level tags of the file
-  tinyxml2::XMLNode* child = xml_doc_->FirstChild();
+  Node child = doc_node->FirstChild();
   while (child != NULL) {
-    const char* tag = child->ToElement()->Value();
-    if (tag == kLayersTag) {
-      ok &= ReadLayers(child, model_info.layers_);
-    } else if (tag == kMaterialsTag) {
-      ok &= ReadMaterials(child, model_info.materials_);
-    } else if (tag == kCompDefsTag) {
-      ok &= ReadComponentDefinitions(child, model_info.definitions_);
-    } else if (tag == kGeometryTag) {
-      ok &= ReadEntities(child, model_info.entities_);
+    switch (GetTagId(child)) {
+      case XmlTagId_Layers:
+        ok &= ReadLayers(child, model_info.layers_);
+        break;
+      case XmlTagId_Materials:
+        ok &= ReadMaterials(child, model_info.materials_);
+        break;
+      case XmlTagId_ComponentDefinitions:
+        ok &= ReadComponentDefinitions(child, model_info.definitions_);
+        break;
+      case XmlTagId_Geometry:
+        ok &= ReadEntities(child, FindQuantization(true, std::string()),
+                           model_info.entities_);
+        break;
+      default:
+        break;
     }
     child = child->NextSibling();
   }
@@ -708,14 +2007,15 @@ bool CXmlFile::GetModelInfo(XmlModelInfo& model_info) const {
   return ok;
 }
 
-bool CXmlFile::ReadLayers(const tinyxml2::XMLNode* parent_node,
+template <typename Node>
+bool CXmlFile::ReadLayers(Node parent_node,
                           std::vector<XmlLayerInfo>& layer_infos) const {
   bool ok = true;
-  const tinyxml2::XMLNode* child = parent_node->FirstChild();
+  Node child = parent_node->FirstChild();
   while (child != NULL) {
     XmlLayerInfo info;
     if (ReadLayerInfo(child, info)) {
-      layer_infos.push_back(info);
+      layer_infos.push_back(std::move(info));
     } else {
       ok = false;
     }
@@ -724,14 +2024,15 @@ bool CXmlFile::ReadLayers(const tinyxml2::XMLNode* parent_node,
   return ok;
 }
 
-bool CXmlFile::ReadMaterials(const tinyxml2::XMLNode* parent_node,
+template <typename Node>
+bool CXmlFile::ReadMaterials(Node parent_node,
                              std::vector<XmlMaterialInfo>& mat_infos) const {
   bool ok = true;
-  const tinyxml2::XMLNode* child = parent_node->FirstChild();
+  Node child = parent_node->FirstChild();
   while (child != NULL) {
     XmlMaterialInfo info;
     if (ReadMaterialInfo(child, info)) {
-      mat_infos.push_back(info);
+      mat_infos.push_back(std::move(info));
     } else {
       ok = false;
     }
@@ -740,14 +2041,15 @@ bool CXmlFile::ReadMaterials(const tinyxml2::XMLNode* parent_node,
   return ok;
 }
 
-bool CXmlFile::ReadComponentDefinitions(const tinyxml2::XMLNode* parent_node,
+template <typename Node>
+bool CXmlFile::ReadComponentDefinitions(Node parent_node,
     std::vector<XmlComponentDefinitionInfo>& def_infos) const {
   bool ok = true;
-  const tinyxml2::XMLNode* child = parent_node->FirstChild();
+  Node child = parent_node->FirstChild();
   while (child != NULL) {
     XmlComponentDefinitionInfo info;
     if (ReadComponentDefinitionInfo(child, true, info)) {
-      def_infos.push_back(info);
+      def_infos.push_back(std::move(info));
     } else {
       ok = false;
     }
@@ -759,6 +2061,8 @@ bool CXmlFile::ReadComponentDefinitions(const tinyxml2::XMLNode* parent_node,
 
 void CXmlFile::WriteComponentInstanceInfo(
     const XmlComponentInstanceInfo& info) {
+  coarse_builder_.AddInstance(info.definition_name_, info.transform_);
+
   tinyxml2::XMLElement* elem = WriteStartTag(kComponentInstanceTag.c_str());
   
   // Definition name
@@ -779,34 +2083,36 @@ void CXmlFile::WriteComponentInstanceInfo(
     PopParentNode();
   }
 
-  // Transformation
-  WriteTransformation(info.transform_);
+  // Transformation (optional)
+  if (info.has_transform_)
+    WriteTransformation(info.transform_);
   PopParentNode();
 }
 
-bool CXmlFile::ReadComponentInstanceInfo(const tinyxml2::XMLNode* parent_node,
+template <typename Node>
+bool CXmlFile::ReadComponentInstanceInfo(Node parent_node,
                                          XmlComponentInstanceInfo& info) const {
   bool ok = true;
 
   // Definition name
   XmlComponentDefinitionInfo comp_def;
-  const tinyxml2::XMLNode* child = parent_node->FirstChild();
+  Node child = parent_node->FirstChild();
   ok &= ReadComponentDefinitionInfo(child, false, comp_def);
-  info.definition_name_ = comp_def.name_;
+  info.definition_name_.swap(comp_def.name_);
 
   // Material (optional)
   child = child->NextSibling();
-  if (child != NULL && child->Value() == kMaterialTag) {
+  if (child != NULL && GetTagId(child) == XmlTagId_Material) {
     info.material_name_ = child->ToElement()->Attribute(kNameTag.c_str());
   }
 
   if (child != NULL) {
     bool foundLayer = false;
-    if (child->Value() == kLayerTag) {
+    if (GetTagId(child) == XmlTagId_Layer) {
       foundLayer = true;
     } else {
       child = child->NextSibling();
-      if (child != NULL && child->Value() == kLayerTag) {
+      if (child != NULL && GetTagId(child) == XmlTagId_Layer) {
         foundLayer = true;
       }
     }
@@ -815,48 +2121,1113 @@ bool CXmlFile::ReadComponentInstanceInfo(const tinyxml2::XMLNode* parent_node,
     }
   }
 
-  // Transformation
-  ok &= ReadTransformation(parent_node, info.transform_);
+  // Transformation (optional), the identity if it was left out
+  info.has_transform_ = ReadTransformation(parent_node, info.transform_);
+  if (!info.has_transform_)
+    info.transform_ = XmlGeomUtils::GetIdentityTransform();
   return ok;
 }
 
-bool CXmlFile::ReadEntities(const tinyxml2::XMLNode* parent_node,
+template <typename Node>
+bool CXmlFile::ReadEntities(Node parent_node,
+                            const XmlQuantizationInfo* quantization,
                             XmlEntitiesInfo& entities) const {
 
   bool ok = true;
 
+  // Groups are read with a stack of the open ones rather than by recursing,
+  // so deeply nested groups can't run out of call stack. Each level is the
+  // next element to read and the entities it goes into.
+  std::vector<std::pair<Node, XmlEntitiesInfo*> > levels;
+  levels.push_back(std::make_pair(parent_node->FirstChild(), &entities));
+  while (!levels.empty()) {
+    Node child = levels.back().first;
+    if (child == NULL) {
+      levels.pop_back();
+      continue;
+    }
+    levels.back().first = child->NextSibling();
+    XmlEntitiesInfo& current = *levels.back().second;
+
+    switch (GetTagId(child)) {
+      // Each entity is read in place, at the end of its list
+      case XmlTagId_ComponentInstance: {
+        current.component_instances_.push_back(XmlComponentInstanceInfo());
+        ReadComponentInstanceInfo(child, current.component_instances_.back());
+        break;
+      }
+      case XmlTagId_Group: {
+        current.groups_.push_back(XmlGroupInfo());
+        XmlGroupInfo& group = current.groups_.back();
+        // Read the transformation, then go into the group entities
+        ok &= ReadTransformation(child, group.transform_);
+        levels.push_back(std::make_pair(child->FirstChild(), group.entities_));
+        break;
+      }
+      case XmlTagId_Face: {
+        // Read faces
+        current.faces_.push_back(XmlFaceInfo());
+        ok &= ReadFaceInfo(child, quantization, current.faces_.back());
+        break;
+      }
+      case XmlTagId_Edge: {
+        // Read edges
+        current.edges_.push_back(XmlEdgeInfo());
+        ok &= ReadEdgeInfo(child, current.edges_.back());
+        break;
+      }
+      case XmlTagId_Lines:
+        // Read line lists
+        ok &= ReadLineListInfo(child, current.edges_);
+        break;
+      case XmlTagId_Curve: {
+        // Read curves
+        current.curves_.push_back(XmlCurveInfo());
+        ok &= ReadCurveInfo(child, current.curves_.back());
+        break;
+      }
+      default:
+        break;
+    }
+  }
+
+  return ok;
+}
+
+// 64-bit safe seek, indexed elements may lie beyond 2GB
+static bool SeekFile(FILE* fp, uint64_t offset) {
+#if defined(_MSC_VER)
+  return _fseeki64(fp, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+  return fseeko(fp, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif
+}
+
+// 64-bit safe file size
+static bool GetFileSize(FILE* fp, uint64_t& size) {
+#if defined(_MSC_VER)
+  if (_fseeki64(fp, 0, SEEK_END) != 0)
+    return false;
+  __int64 length = _ftelli64(fp);
+#else
+  if (fseeko(fp, 0, SEEK_END) != 0)
+    return false;
+  off_t length = ftello(fp);
+#endif
+  if (length < 0)
+    return false;
+  size = static_cast<uint64_t>(length);
+  return true;
+}
+
+bool CXmlFile::OpenIndexed(const std::string& filename) {
+  if (filename.empty())
+    return false;
+
+  if (xml_doc_) {
+    printf("Warning! opening already open file\n");
+    return true;
+  }
+
+  filename_ = filename;
+  create_new_file_ = false;
+
+  if (!index_.Read(CXmlIndex::GetIndexFilename(filename)))
+    return false;
+
+  // Check for valid header
+  tinyxml2::XMLDocument doc;
+  return ReadIndexedElement(XmlIndexEntryType_Section, kSkpToXMLTag, doc) &&
+         ReadHeader(ConstNode(doc.FirstChild()));
+}
+
+bool CXmlFile::ReadIndexedElement(XmlIndexEntryType type,
+                                  const std::string& name,
+                                  tinyxml2::XMLDocument& doc) const {
+  const XmlIndexEntry* entry = index_.FindEntry(type, name);
+  return entry != NULL && ReadIndexedElement(*entry, doc);
+}
+
+bool CXmlFile::ReadIndexedText(const XmlIndexEntry& entry,
+                               std::vector<char>& text) const {
+  if (entry.length_ == 0)
+    return false;
+  FILE* fp = fopen(filename_.c_str(), "rb");
+  if (fp == NULL)
+    return false;
+
+  // A corrupt or stale index may point past the end of the file, check
+  // before allocating for it
+  uint64_t file_size = 0;
+  if (!GetFileSize(fp, file_size) || entry.offset_ > file_size ||
+      entry.length_ > file_size - entry.offset_ ||
+      entry.length_ > static_cast<uint64_t>(SIZE_MAX)) {
+    fclose(fp);
+    return false;
+  }
+
+  size_t length = static_cast<size_t>(entry.length_);
+  text.resize(length);
+  bool ok = SeekFile(fp, entry.offset_) &&
+            fread(&text[0], 1, length, fp) == length;
+  fclose(fp);
+  return ok;
+}
+
+bool CXmlFile::ReadIndexedElement(const XmlIndexEntry& entry,
+                                  tinyxml2::XMLDocument& doc) const {
+  std::vector<char> buffer;
+  bool ok = ReadIndexedText(entry, buffer);
+
+  PrepareDocument(doc);
+  ok = ok && doc.Parse(&buffer[0], buffer.size()) == tinyxml2::XML_NO_ERROR;
+  const tinyxml2::XMLElement* elem = doc.FirstChildElement();
+  if (!ok || elem == NULL)
+    return false;
+
+  // An index older than the file points at something else
+  switch (entry.type_) {
+    case XmlIndexEntryType_Section:
+      return entry.name_ == elem->Name();
+    case XmlIndexEntryType_ComponentDefinition: {
+      const char* name = elem->Attribute(kNameTag.c_str());
+      return name != NULL && entry.name_ == name;
+    }
+    default:
+      return GetTagId(elem) == XmlTagId_Group;
+  }
+}
+
+bool CXmlFile::ReadIndexedLayers(std::vector<XmlLayerInfo>& layer_infos) const {
+  tinyxml2::XMLDocument doc;
+  return ReadIndexedElement(XmlIndexEntryType_Section, kLayersTag, doc) &&
+         ReadLayers(ConstNode(doc.FirstChildElement()), layer_infos);
+}
+
+bool CXmlFile::ReadIndexedMaterials(
+    std::vector<XmlMaterialInfo>& mat_infos) const {
+  tinyxml2::XMLDocument doc;
+  return ReadIndexedElement(XmlIndexEntryType_Section, kMaterialsTag, doc) &&
+         ReadMaterials(ConstNode(doc.FirstChildElement()), mat_infos);
+}
+
+bool CXmlFile::ReadIndexedComponentDefinition(
+    const std::string& name,
+    XmlComponentDefinitionInfo& info) const {
+  tinyxml2::XMLDocument doc;
+  return ReadIndexedElement(XmlIndexEntryType_ComponentDefinition, name,
+                            doc) &&
+         ReadComponentDefinitionInfo(ConstNode(doc.FirstChildElement()), true,
+                                     info);
+}
+
+bool CXmlFile::ReadIndexedGroup(const std::string& path,
+                                XmlGroupInfo& info) const {
+  const XmlIndexEntry* entry = index_.FindEntry(XmlIndexEntryType_Group, path);
+  tinyxml2::XMLDocument doc;
+  if (entry == NULL || !ReadIndexedElement(*entry, doc))
+    return false;
+  // Quantized against the definition or geometry the group is in
+  const XmlQuantizationInfo* quantization =
+      FindQuantization(entry->scope_type_ == XmlIndexEntryType_Section,
+                       entry->scope_name_);
+
+  const tinyxml2::XMLNode* elem = doc.FirstChildElement();
+  bool ok = ReadEntities(elem, quantization, *info.entities_);
+  ok &= ReadTransformation(elem, info.transform_);
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Lazy loading
+
+// The file is scanned in blocks of this size
+static const size_t kScanBlockSize = 1 << 20;
+
+// The geometry is split into about this many runs of entities per thread
+static const size_t kChunksPerThread = 4;
+
+static bool LessOffset(const XmlIndexEntry& a, const XmlIndexEntry& b) {
+  return a.offset_ < b.offset_;
+}
+
+// A run of top level geometry entities, parsed on its own
+struct EntitiesChunk {
+  EntitiesChunk() : begin_(0), end_(0), ok_(false) {}
+
+  size_t begin_;
+  size_t end_;
+  XmlEntitiesInfo entities_;
+  bool ok_;
+};
+
+// Splits the children of the element that is the text into runs of about the
+// same size. Returns false if the element is not the one named.
+static bool SplitChildren(const std::vector<char>& text,
+                          const std::string& name, size_t num_chunks,
+                          std::vector<EntitiesChunk>& chunks) {
+  CXmlScanner scanner(1);
+  std::vector<XmlScanEvent> events;
+  if (!scanner.Scan(&text[0], text.size(), events) || scanner.depth() != 0 ||
+      events.empty() || events[0].name_ != name)
+    return false;
+
+  size_t chunk_size = text.size() / std::max<size_t>(1, num_chunks) + 1;
+  EntitiesChunk chunk;
+  bool is_open = false;
+  for (size_t i = 0; i < events.size(); ++i) {
+    const XmlScanEvent& event = events[i];
+    if (event.depth_ != 1)
+      continue;
+    size_t offset = static_cast<size_t>(event.offset_);
+    if (event.type_ == XmlScanEventType_Start) {
+      if (!is_open)
+        chunk.begin_ = offset;
+      is_open = true;
+    } else {
+      chunk.end_ = offset;
+      if (chunk.end_ - chunk.begin_ >= chunk_size) {
+        chunks.push_back(chunk);
+        is_open = false;
+      }
+    }
+  }
+  if (is_open)
+    chunks.push_back(chunk);
+  return true;
+}
+
+// Moves the entities to the end of the given ones
+static void AppendEntities(XmlEntitiesInfo& from, XmlEntitiesInfo& to) {
+  to.component_instances_.insert(
+      to.component_instances_.end(),
+      std::make_move_iterator(from.component_instances_.begin()),
+      std::make_move_iterator(from.component_instances_.end()));
+  to.faces_.insert(to.faces_.end(),
+                   std::make_move_iterator(from.faces_.begin()),
+                   std::make_move_iterator(from.faces_.end()));
+  to.edges_.insert(to.edges_.end(),
+                   std::make_move_iterator(from.edges_.begin()),
+                   std::make_move_iterator(from.edges_.end()));
+  to.curves_.insert(to.curves_.end(),
+                    std::make_move_iterator(from.curves_.begin()),
+                    std::make_move_iterator(from.curves_.end()));
+
+  to.groups_.insert(to.groups_.end(),
+                    std::make_move_iterator(from.groups_.begin()),
+                    std::make_move_iterator(from.groups_.end()));
+}
+
+// Runs task(0) to task(count - 1) on up to num_threads threads, the calling
+// thread included
+template <typename Task>
+static void RunTasks(size_t count, size_t num_threads, const Task& task) {
+  num_threads = std::max<size_t>(1, std::min(num_threads, count));
+  std::atomic<size_t> next_task(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.push_back(std::thread([&next_task, &task, count] {
+      for (size_t j = next_task++; j < count; j = next_task++)
+        task(j);
+    }));
+  }
+  for (size_t j = next_task++; j < count; j = next_task++)
+    task(j);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+// The Name attribute of the start tag at the offset
+static bool ReadStartTagName(FILE* fp, uint64_t offset, std::string& name) {
+  if (!SeekFile(fp, offset))
+    return false;
+
+  // Up to the '>' that is not in a quoted value
+  std::string tag;
+  char quote = 0;
+  bool is_complete = false;
+  int c = 0;
+  while (!is_complete && (c = fgetc(fp)) != EOF) {
+    tag += static_cast<char>(c);
+    if (quote != 0) {
+      if (c == quote)
+        quote = 0;
+    } else if (c == '"' || c == '\'') {
+      quote = static_cast<char>(c);
+    } else {
+      is_complete = c == '>';
+    }
+  }
+  if (!is_complete || tag.size() < 2)
+    return false;
+
+  // Parsed as an empty element
+  if (tag[tag.size() - 2] != '/')
+    tag.insert(tag.size() - 1, "/");
+  tinyxml2::XMLDocument doc;
+  if (doc.Parse(tag.c_str(), tag.size()) != tinyxml2::XML_NO_ERROR ||
+      doc.FirstChildElement() == NULL)
+    return false;
+  const char* value = doc.FirstChildElement()->Attribute(kNameTag.c_str());
+  if (value == NULL)
+    return false;
+  name = value;
+  return true;
+}
+
+bool CXmlFile::ScanIndex(const XmlModelQuery& query) {
+  index_.Clear();
+  FILE* fp = fopen(filename_.c_str(), "rb");
+  if (fp == NULL)
+    return false;
+  // Definition names are read from their start tags through a second stream
+  FILE* tag_fp = fopen(filename_.c_str(), "rb");
+  if (tag_fp == NULL) {
+    fclose(fp);
+    return false;
+  }
+
+  // What is still to be found before scanning can stop
+  bool need_header = true;
+  bool need_layers = query.layers_;
+  bool need_materials = query.materials_;
+  bool need_definitions = query.all_definitions_;
+  bool need_geometry = query.geometry_;
+  std::set<std::string> needed_definitions(query.definition_names_.begin(),
+                                           query.definition_names_.end());
+
+  CXmlScanner scanner(1);
+  std::vector<XmlScanEvent> events;
+  std::vector<char> block(kScanBlockSize);
+  std::vector<XmlIndexEntry> entries;
+  XmlIndexEntry section;
+  XmlIndexEntry definition;
+  definition.type_ = XmlIndexEntryType_ComponentDefinition;
+  bool ok = true;
+  bool is_done = false;
+  size_t count = 0;
+  while (ok && !is_done &&
+         (count = fread(&block[0], 1, block.size(), fp)) > 0) {
+    events.clear();
+    ok = scanner.Scan(&block[0], count, events);
+    for (size_t i = 0; ok && i < events.size(); ++i) {
+      const XmlScanEvent& event = events[i];
+      if (event.depth_ == 0) {
+        // Sections
+        if (event.type_ == XmlScanEventType_Start) {
+          section.name_ = event.name_;
+          section.offset_ = event.offset_;
+          continue;
+        }
+        section.length_ = event.offset_ - section.offset_;
+        entries.push_back(section);
+        if (section.name_ == kSkpToXMLTag)
+          need_header = false;
+        else if (section.name_ == kLayersTag)
+          need_layers = false;
+        else if (section.name_ == kMaterialsTag)
+          need_materials = false;
+        else if (section.name_ == kCompDefsTag)
+          need_definitions = false;
+        else if (section.name_ == kGeometryTag)
+          need_geometry = false;
+      } else if (section.name_ == kCompDefsTag) {
+        // Component definitions
+        if (event.type_ == XmlScanEventType_Start) {
+          definition.offset_ = event.offset_;
+          continue;
+        }
+        definition.length_ = event.offset_ - definition.offset_;
+        ok = ReadStartTagName(tag_fp, definition.offset_, definition.name_);
+        entries.push_back(definition);
+        needed_definitions.erase(definition.name_);
+      }
+    }
+    is_done = !query.write_index_ && !need_header && !need_layers &&
+              !need_materials && !need_definitions && !need_geometry &&
+              needed_definitions.empty();
+  }
+  ok = ok && ferror(fp) == 0;
+  fclose(fp);
+  fclose(tag_fp);
+
+  // Definitions end before their section
+  std::stable_sort(entries.begin(), entries.end(), LessOffset);
+  for (size_t i = 0; i < entries.size(); ++i)
+    index_.AddEntry(entries[i]);
+
+  if (ok && query.write_index_)
+    ok = index_.Write(CXmlIndex::GetIndexFilename(filename_));
+  return ok;
+}
+
+bool CXmlFile::ReadQueriedModelInfo(const XmlModelQuery& query,
+                                    XmlModelInfo& model_info) {
+  model_info = XmlModelInfo();
+
+  // The header holds the quantization of the definitions and geometry
+  tinyxml2::XMLDocument header_doc;
+  if (!ReadIndexedElement(XmlIndexEntryType_Section, kSkpToXMLTag,
+                          header_doc) ||
+      !ReadHeader(ConstNode(header_doc.FirstChild())))
+    return false;
+
+  // Sections missing from the file are left empty, as in GetModelInfo
+  bool ok = true;
+  if (query.layers_ &&
+      index_.FindEntry(XmlIndexEntryType_Section, kLayersTag) != NULL) {
+    ok &= ReadIndexedLayers(model_info.layers_);
+  }
+  if (query.materials_ &&
+      index_.FindEntry(XmlIndexEntryType_Section, kMaterialsTag) != NULL) {
+    ok &= ReadIndexedMaterials(model_info.materials_);
+  }
+
+  std::vector<const XmlIndexEntry*> definitions;
+  if (query.all_definitions_) {
+    const std::vector<XmlIndexEntry>& entries = index_.entries();
+    for (size_t i = 0; i < entries.size(); ++i) {
+      if (entries[i].type_ == XmlIndexEntryType_ComponentDefinition)
+        definitions.push_back(&entries[i]);
+    }
+  } else {
+    for (size_t i = 0; i < query.definition_names_.size(); ++i) {
+      const XmlIndexEntry* entry = index_.FindEntry(
+          XmlIndexEntryType_ComponentDefinition, query.definition_names_[i]);
+      if (entry != NULL)
+        definitions.push_back(entry);
+      else
+        ok = false;
+    }
+  }
+
+  size_t num_threads = query.num_threads_ > 0 ?
+      static_cast<size_t>(query.num_threads_) :
+      std::thread::hardware_concurrency();
+  num_threads = std::max<size_t>(1, num_threads);
+
+  // The geometry is split between its top level entities
+  std::vector<char> geometry_text;
+  std::vector<EntitiesChunk> chunks;
+  const XmlIndexEntry* geometry = query.geometry_ ?
+      index_.FindEntry(XmlIndexEntryType_Section, kGeometryTag) : NULL;
+  if (ok && geometry != NULL) {
+    size_t num_chunks = num_threads > 1 ? num_threads * kChunksPerThread : 1;
+    ok = ReadIndexedText(*geometry, geometry_text) &&
+         SplitChildren(geometry_text, kGeometryTag, num_chunks, chunks);
+  }
+  if (!ok)
+    return false;
+
+  // Each definition and geometry chunk is parsed into its own result, and
+  // the results are merged in file order
+  std::vector<XmlComponentDefinitionInfo> definition_infos(definitions.size());
+  std::vector<char> definition_ok(definitions.size(), 0);
+  const XmlQuantizationInfo* geometry_quantization =
+      FindQuantization(true, std::string());
+  RunTasks(definitions.size() + chunks.size(), num_threads,
+           [&](size_t i) {
+    if (i < definitions.size()) {
+      tinyxml2::XMLDocument doc;
+      definition_ok[i] =
+          ReadIndexedElement(*definitions[i], doc) &&
+          ReadComponentDefinitionInfo(ConstNode(doc.FirstChildElement()),
+                                      true, definition_infos[i]);
+    } else {
+      // The entities are the top level elements of the document
+      EntitiesChunk& chunk = chunks[i - definitions.size()];
+      tinyxml2::XMLDocument doc;
+      PrepareDocument(doc);
+      chunk.ok_ = doc.Parse(&geometry_text[chunk.begin_],
+                            chunk.end_ - chunk.begin_) ==
+                  tinyxml2::XML_NO_ERROR &&
+                  ReadEntities(ConstNode(&doc), geometry_quantization,
+                               chunk.entities_);
+    }
+  });
+
+  for (size_t i = 0; i < definitions.size(); ++i) {
+    if (definition_ok[i])
+      model_info.definitions_.push_back(std::move(definition_infos[i]));
+    else
+      ok = false;
+  }
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    ok &= chunks[i].ok_;
+    AppendEntities(chunks[i].entities_, model_info.entities_);
+  }
+  return ok;
+}
+
+bool CXmlFile::LoadModelInfo(const std::string& filename,
+                             const XmlModelQuery& query,
+                             XmlModelInfo& model_info) {
+  if (filename.empty())
+    return false;
+
+  if (xml_doc_) {
+    printf("Warning! loading from an already open file\n");
+    return false;
+  }
+
+  filename_ = filename;
+  create_new_file_ = false;
+
+  // A sidecar older than the file fails to read, the file is scanned then
+  if (index_.Read(CXmlIndex::GetIndexFilename(filename)) &&
+      ReadQueriedModelInfo(query, model_info))
+    return true;
+  return ScanIndex(query) && ReadQueriedModelInfo(query, model_info);
+}
+
+//------------------------------------------------------------------------------
+// Progressive output
+
+void CXmlFile::WriteBounds(const CBoundingBox3d& bounds) {
+  if (bounds.IsEmpty())
+    return;
+  const CPoint3d* corners[2] = { &bounds.min(), &bounds.max() };
+  const std::string* tags[2] = { &kMinTag, &kMaxTag };
+  for (int i = 0; i < 2; ++i) {
+    tinyxml2::XMLElement* elem = WriteStartTag(tags[i]->c_str());
+    elem->SetAttribute(kXTag.c_str(), corners[i]->x());
+    elem->SetAttribute(kYTag.c_str(), corners[i]->y());
+    elem->SetAttribute(kZTag.c_str(), corners[i]->z());
+    PopParentNode();
+  }
+}
+
+// Reads the optional Min and Max children, leaving child at the next node
+static bool ReadBounds(const tinyxml2::XMLNode*& child,
+                       CBoundingBox3d& bounds) {
+  if (child == NULL || child->Value() != kMinTag)
+    return true; // Empty bounds
+  CPoint3d min, max;
+  bool ok = ReadPoint(child, min);
+  child = child->NextSibling();
+  ok = ok && child != NULL && child->Value() == kMaxTag &&
+       ReadPoint(child, max);
+  if (ok) {
+    bounds.Add(min);
+    bounds.Add(max);
+    child = child->NextSibling();
+  }
+  return ok;
+}
+
+void CXmlFile::WriteCoarseDefinition(const XmlCoarseDefinitionInfo& info,
+                                     bool is_geometry) {
+  tinyxml2::XMLElement* elem =
+      WriteStartTag(is_geometry ? kGeometryTag.c_str() : kDefinitionTag.c_str());
+  if (!is_geometry)
+    elem->SetAttribute(kNameTag.c_str(), info.name_.c_str());
+  WriteBounds(info.bounds_);
+
+  // Simplified mesh as shared points and three indices per triangle
+  if (!info.mesh_.indices_.empty()) {
+    tinyxml2::XMLElement* elem = WriteStartTag(kSimplifiedMeshTag.c_str());
+    elem->SetAttribute(kCountTag.c_str(),
+                       static_cast<int64_t>(info.mesh_.indices_.size() / 3));
+    std::string text;
+    elem = WriteStartTag(kPointsTag.c_str());
+    elem->SetAttribute(kCountTag.c_str(),
+                       static_cast<int64_t>(info.mesh_.points_.size()));
+    AppendPointList(info.mesh_.points_, text);
+    WriteText(text);
+    PopParentNode();
+
+    text.clear();
+    std::vector<uint64_t> indices(info.mesh_.indices_.begin(),
+                                  info.mesh_.indices_.end());
+    WriteStartTag(kIndicesTag.c_str());
+    AppendIndexList(indices, text);
+    WriteText(text);
+    PopParentNode();
+    PopParentNode(); // SimplifiedMesh
+  }
+
+  for (size_t i = 0; i < info.group_bounds_.size(); ++i) {
+    WriteStartTag(kGroupBoundsTag.c_str());
+    WriteBounds(info.group_bounds_[i]);
+    PopParentNode();
+  }
+
+  for (size_t i = 0; i < info.instances_.size(); ++i) {
+    const XmlCoarseInstanceInfo& instance_info = info.instances_[i];
+    tinyxml2::XMLElement* elem = WriteStartTag(kInstanceTag.c_str());
+    elem->SetAttribute(kDefinitionTag.c_str(),
+                       instance_info.definition_name_.c_str());
+    WriteBounds(instance_info.bounds_);
+    WriteTransformation(instance_info.transform_);
+    PopParentNode();
+  }
+
+  PopParentNode();
+}
+
+void CXmlFile::WriteCoarseModel() {
+  XmlCoarseModelInfo info;
+  coarse_builder_.GetCoarseModel(info);
+
+  // The coarse model goes ahead of the full detail definitions and geometry
+  tinyxml2::XMLElement* section = xml_doc_->NewElement(kCoarseTag.c_str());
+  tinyxml2::XMLNode* next = xml_doc_->FirstChild();
+  while (next != NULL && next->Value() != kCompDefsTag &&
+         next->Value() != kGeometryTag) {
+    next = next->NextSibling();
+  }
+  if (next == NULL) {
+    xml_doc_->InsertEndChild(section);
+  } else if (next->PreviousSibling() == NULL) {
+    xml_doc_->InsertFirstChild(section);
+  } else {
+    xml_doc_->InsertAfterChild(next->PreviousSibling(), section);
+  }
+
+  tinyxml2::XMLNode* parent_node = parent_node_;
+  parent_node_ = section;
+  for (size_t i = 0; i < info.definitions_.size(); ++i) {
+    WriteCoarseDefinition(info.definitions_[i], false);
+  }
+  WriteCoarseDefinition(info.geometry_, true);
+  parent_node_ = parent_node;
+}
+
+bool CXmlFile::ReadCoarseDefinition(const tinyxml2::XMLNode* parent_node,
+                                    XmlCoarseDefinitionInfo& info) const {
+  const char* name = parent_node->ToElement()->Attribute(kNameTag.c_str());
+  if (name != NULL)
+    info.name_ = name;
+
   const tinyxml2::XMLNode* child = parent_node->FirstChild();
-  while (child != NULL) {
-    const char* tag = child->ToElement()->Value();
-    if (tag == kComponentInstanceTag) {
-      XmlComponentInstanceInfo instance;
-      ReadComponentInstanceInfo(child, instance);
-      entities.component_instances_.push_back(instance);
-    } else if (tag == kGroupTag) {
-      XmlGroupInfo group;
-      // Recurse into group entities
-      ok &= ReadEntities(child, *group.entities_);
-      // Read the transformation
-      ok &= ReadTransformation(child, group.transform_);
-      entities.groups_.push_back(group);
-    } else if (tag == kFaceTag) {
-      // Read faces
-      XmlFaceInfo face_info;
-      ok &= ReadFaceInfo(child, face_info);
-      entities.faces_.push_back(face_info);
-    } else if (tag == kEdgeTag) {
-      // Read edges
-      XmlEdgeInfo edge_info;
-      ok &= ReadEdgeInfo(child, edge_info);
-      entities.edges_.push_back(edge_info);
-    } else if (tag == kCurveTag) {
-      // Read curves
-      XmlCurveInfo curve_info;
-      ok &= ReadCurveInfo(child, curve_info);
-      entities.curves_.push_back(curve_info);
+  bool ok = ReadBounds(child, info.bounds_);
+
+  // Simplified mesh (optional)
+  if (ok && child != NULL && child->Value() == kSimplifiedMeshTag) {
+    int64_t count = 0;
+    const tinyxml2::XMLNode* node = child->FirstChild();
+    std::vector<uint64_t> indices;
+    ok = child->ToElement()->QueryInt64Attribute(kCountTag.c_str(),
+                                                 &count) ==
+         tinyxml2::XML_NO_ERROR &&
+         node != NULL && node->Value() == kPointsTag &&
+         ParsePointList(node->ToElement()->GetText(), info.mesh_.points_);
+    node = ok ? node->NextSibling() : NULL;
+    ok = ok && node != NULL && node->Value() == kIndicesTag &&
+         ParseIndexList(node->ToElement()->GetText(), indices) &&
+         indices.size() == static_cast<uint64_t>(count) * 3;
+    for (size_t i = 0; ok && i < indices.size(); ++i) {
+      ok = indices[i] < info.mesh_.points_.size();
+      info.mesh_.indices_.push_back(static_cast<uint32_t>(indices[i]));
     }
     child = child->NextSibling();
   }
 
+  for (; ok && child != NULL; child = child->NextSibling()) {
+    if (child->Value() == kGroupBoundsTag) {
+      CBoundingBox3d bounds;
+      const tinyxml2::XMLNode* node = child->FirstChild();
+      ok = ReadBounds(node, bounds);
+      info.group_bounds_.push_back(bounds);
+    } else if (child->Value() == kInstanceTag) {
+      XmlCoarseInstanceInfo instance_info;
+      const char* definition_name =
+          child->ToElement()->Attribute(kDefinitionTag.c_str());
+      if (definition_name != NULL)
+        instance_info.definition_name_ = definition_name;
+      const tinyxml2::XMLNode* node = child->FirstChild();
+      ok = ReadBounds(node, instance_info.bounds_) &&
+           ReadTransformation(child, instance_info.transform_);
+      info.instances_.push_back(instance_info);
+    }
+  }
+  return ok;
+}
+
+bool CXmlFile::ReadCoarseModel(const tinyxml2::XMLNode* parent_node,
+                               XmlCoarseModelInfo& info) const {
+  bool ok = true;
+  const tinyxml2::XMLNode* child = parent_node->FirstChild();
+  for (; child != NULL; child = child->NextSibling()) {
+    if (child->Value() == kDefinitionTag) {
+      XmlCoarseDefinitionInfo definition_info;
+      ok &= ReadCoarseDefinition(child, definition_info);
+      info.definitions_.push_back(definition_info);
+    } else if (child->Value() == kGeometryTag) {
+      ok &= ReadCoarseDefinition(child, info.geometry_);
+    }
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Progressive reading
+
+// Sections read one child element at a time
+static bool IsChunkedSection(const std::string& section) {
+  return section == kCompDefsTag || section == kGeometryTag;
+}
+
+void CXmlFile::BeginProgressiveRead(CXmlProgressiveListener* listener) {
+  listener_ = listener;
+  scanner_.Reset();
+  stream_buffer_.clear();
+  stream_offset_ = 0;
+  stream_section_.clear();
+  in_chunk_ = false;
+  chunk_offset_ = 0;
+  has_quantization_ = false;
+  definition_quantization_.clear();
+}
+
+bool CXmlFile::ReadProgressive(const char* data, size_t length) {
+  stream_buffer_.append(data, length);
+  std::vector<XmlScanEvent> events;
+  if (!scanner_.Scan(data, length, events))
+    return false;
+
+  bool ok = true;
+  for (size_t i = 0; ok && i < events.size(); ++i) {
+    const XmlScanEvent& event = events[i];
+    bool is_chunked = IsChunkedSection(stream_section_);
+    if (event.type_ == XmlScanEventType_Start) {
+      if (event.depth_ == 0) {
+        stream_section_ = event.name_;
+        is_chunked = IsChunkedSection(stream_section_);
+      }
+      if (event.depth_ == (is_chunked ? 1 : 0)) {
+        in_chunk_ = true;
+        chunk_offset_ = event.offset_;
+      }
+    } else if (in_chunk_ && event.depth_ == (is_chunked ? 1 : 0)) {
+      ok = ReadProgressiveChunk(chunk_offset_, event.offset_);
+      in_chunk_ = false;
+    }
+  }
+
+  // Drop the bytes no chunk needs any more
+  uint64_t keep = in_chunk_ ? chunk_offset_ : scanner_.pending_offset();
+  stream_buffer_.erase(0, static_cast<size_t>(keep - stream_offset_));
+  stream_offset_ = keep;
+  return ok;
+}
+
+bool CXmlFile::EndProgressiveRead() {
+  bool ok = !in_chunk_ && scanner_.depth() == 0;
+  listener_ = NULL;
+  stream_buffer_.clear();
   return ok;
 }
+
+bool CXmlFile::ReadProgressiveChunk(uint64_t begin, uint64_t end) {
+  // The chunk is parsed in place. Its bytes are dropped once it is read, but
+  // the byte after it may begin the next chunk and is put back; the parsed
+  // strings all end before it.
+  char* text = &stream_buffer_[static_cast<size_t>(begin - stream_offset_)];
+  size_t length = static_cast<size_t>(end - begin);
+  char next = text[length];
+  tinyxml2::XMLDocument doc;
+  PrepareDocument(doc);
+  bool parsed = doc.ParseInPlace(text, length) == tinyxml2::XML_NO_ERROR;
+  text[length] = next;
+  const tinyxml2::XMLNode* elem = parsed ? doc.FirstChildElement() : NULL;
+  if (elem == NULL)
+    return false;
+
+  bool ok = true;
+  const std::string& section = stream_section_;
+  if (section == kSkpToXMLTag) {
+    ok = ReadHeader(elem);
+  } else if (section == kLayersTag) {
+    std::vector<XmlLayerInfo> layer_infos;
+    ok = ReadLayers(elem, layer_infos);
+    if (listener_ != NULL)
+      listener_->OnLayers(layer_infos);
+  } else if (section == kMaterialsTag) {
+    std::vector<XmlMaterialInfo> mat_infos;
+    ok = ReadMaterials(elem, mat_infos);
+    if (listener_ != NULL)
+      listener_->OnMaterials(mat_infos);
+  } else if (section == kCoarseTag) {
+    XmlCoarseModelInfo coarse_info;
+    ok = ReadCoarseModel(elem, coarse_info);
+    if (listener_ != NULL)
+      listener_->OnCoarseModel(coarse_info);
+  } else if (section == kCompDefsTag) {
+    XmlComponentDefinitionInfo info;
+    ok = ReadComponentDefinitionInfo(elem, true, info);
+    if (listener_ != NULL)
+      listener_->OnComponentDefinition(info);
+  } else if (section == kGeometryTag) {
+    // The chunk is a single entity, read as the only child of the document
+    XmlEntitiesInfo entities;
+    ok = ReadEntities(ConstNode(&doc), FindQuantization(true, std::string()),
+                      entities);
+    if (listener_ != NULL)
+      listener_->OnGeometry(entities);
+  }
+  return ok;
+}
+
+//------------------------------------------------------------------------------
+// Streaming reading
+
+namespace {
+
+// Collects what the streaming reader passes on into an XmlModelInfo
+class CModelInfoBuilder : public CXmlStreamListener {
+ public:
+  explicit CModelInfoBuilder(XmlModelInfo& model_info)
+    : model_info_(model_info) {}
+
+  virtual void OnLayer(XmlLayerInfo& info) {
+    model_info_.layers_.push_back(std::move(info));
+  }
+  virtual void OnMaterial(XmlMaterialInfo& info) {
+    model_info_.materials_.push_back(std::move(info));
+  }
+  virtual void OnBeginComponentDefinition(const std::string& name) {
+    model_info_.definitions_.push_back(XmlComponentDefinitionInfo());
+    model_info_.definitions_.back().name_ = name;
+    scopes_.push_back(&model_info_.definitions_.back().entities_);
+  }
+  virtual void OnEndComponentDefinition() {
+    scopes_.pop_back();
+  }
+  virtual void OnBeginGeometry() {
+    scopes_.push_back(&model_info_.entities_);
+  }
+  virtual void OnEndGeometry() {
+    scopes_.pop_back();
+  }
+  virtual void OnBeginGroup() {
+    std::vector<XmlGroupInfo>& groups = scopes_.back()->groups_;
+    groups.push_back(XmlGroupInfo());
+    scopes_.push_back(groups.back().entities_);
+  }
+  virtual void OnEndGroup(const SUTransformation& transform) {
+    scopes_.pop_back();
+    scopes_.back()->groups_.back().transform_ = transform;
+  }
+  virtual void OnComponentInstance(XmlComponentInstanceInfo& info) {
+    scopes_.back()->component_instances_.push_back(std::move(info));
+  }
+  virtual void OnFace(XmlFaceInfo& info) {
+    scopes_.back()->faces_.push_back(std::move(info));
+  }
+  virtual void OnEdge(XmlEdgeInfo& info) {
+    scopes_.back()->edges_.push_back(std::move(info));
+  }
+  virtual void OnCurve(XmlCurveInfo& info) {
+    scopes_.back()->curves_.push_back(std::move(info));
+  }
+
+ private:
+  XmlModelInfo& model_info_;
+  // The entities of the open definition or geometry and groups
+  std::vector<XmlEntitiesInfo*> scopes_;
+};
+
+} // namespace
+
+// Parses the element that just started on its own
+static bool ParseStreamedElement(CXmlPullParser& parser,
+                                 tinyxml2::XMLDocument& doc) {
+  const char* text = NULL;
+  size_t length = 0;
+  return parser.ReadElement(text, length) &&
+         doc.Parse(text, length) == tinyxml2::XML_NO_ERROR &&
+         doc.FirstChildElement() != NULL;
+}
+
+bool CXmlFile::ReadStreaming(const std::string& filename,
+                             CXmlStreamListener* listener) {
+  return ReadStreaming(filename, listener, NULL);
+}
+
+bool CXmlFile::ReadStreaming(const std::string& filename,
+                             CXmlStreamListener* listener,
+                             CXmlRenderBuilder* render_builder) {
+  CXmlPullParser parser;
+  parser.set_max_depth(options_.max_element_depth());
+  if (!parser.Open(filename))
+    return false;
+  CXmlStreamListener no_listener;
+  if (listener == NULL)
+    listener = &no_listener;
+
+  // Each layer, material and entity is parsed on its own into this document,
+  // which keeps its memory pools from one to the next
+  tinyxml2::XMLDocument doc;
+  PrepareDocument(doc);
+
+  struct OpenGroup {
+    int depth_;
+    bool has_transform_;
+    SUTransformation transform_;
+  };
+  std::vector<OpenGroup> groups;
+  std::string section;
+  const XmlQuantizationInfo* quantization = NULL;
+  bool has_header = false;
+  bool ok = true;
+  while (ok && parser.Next()) {
+    const std::string& tag = parser.name();
+    int depth = parser.depth();
+
+    if (parser.type() == XmlPullEventType_End) {
+      if (depth == 0) {
+        if (section == kGeometryTag)
+          listener->OnEndGeometry();
+        section.clear();
+      } else if (section == kCompDefsTag && depth == 1) {
+        listener->OnEndComponentDefinition();
+      } else if (!groups.empty() && groups.back().depth_ == depth) {
+        ok = groups.back().has_transform_;
+        listener->OnEndGroup(groups.back().transform_);
+        groups.pop_back();
+      }
+      continue;
+    }
+
+    // Sections
+    if (depth == 0) {
+      section = tag;
+      if (tag == kSkpToXMLTag) {
+        ok = ParseStreamedElement(parser, doc) &&
+             ReadHeader(ConstNode(doc.FirstChildElement()));
+        has_header = ok;
+        section.clear();
+      } else if (!has_header) {
+        ok = false;
+      } else if (tag == kGeometryTag) {
+        quantization = FindQuantization(true, std::string());
+        listener->OnBeginGeometry();
+      } else if (tag != kLayersTag && tag != kMaterialsTag &&
+                 tag != kCompDefsTag) {
+        // The coarse model and the like
+        ok = parser.SkipElement();
+        section.clear();
+      }
+      continue;
+    }
+
+    if (section == kLayersTag) {
+      XmlLayerInfo info;
+      ok = ParseStreamedElement(parser, doc) &&
+           ReadLayerInfo(ConstNode(doc.FirstChildElement()), info);
+      if (ok)
+        listener->OnLayer(info);
+    } else if (section == kMaterialsTag) {
+      XmlMaterialInfo info;
+      ok = ParseStreamedElement(parser, doc) &&
+           ReadMaterialInfo(ConstNode(doc.FirstChildElement()), info);
+      if (ok)
+        listener->OnMaterial(info);
+    } else if (section == kCompDefsTag && depth == 1) {
+      const char* name = parser.Attribute(kNameTag.c_str());
+      ok = tag == kCompDefTag && name != NULL;
+      if (ok) {
+        quantization = FindQuantization(false, name);
+        listener->OnBeginComponentDefinition(name);
+      }
+    } else if (tag == kGroupTag) {
+      OpenGroup group;
+      group.depth_ = depth;
+      group.has_transform_ = false;
+      groups.push_back(group);
+      listener->OnBeginGroup();
+    } else if (tag == kTransformTag && !groups.empty() &&
+               groups.back().depth_ == depth - 1) {
+      ok = ParseStreamedElement(parser, doc) &&
+           ReadTransformation(ConstNode(&doc), groups.back().transform_);
+      groups.back().has_transform_ = ok;
+    } else {
+      ok = ReadStreamingEntity(parser, quantization, doc, listener,
+                               render_builder);
+    }
+  }
+
+  return ok && parser.at_end() && has_header;
+}
+
+bool CXmlFile::ReadStreamingEntity(CXmlPullParser& parser,
+                                   const XmlQuantizationInfo* quantization,
+                                   tinyxml2::XMLDocument& doc,
+                                   CXmlStreamListener* listener,
+                                   CXmlRenderBuilder* render_builder) const {
+  const std::string tag = parser.name();
+  if (tag != kComponentInstanceTag && tag != kFaceTag && tag != kEdgeTag &&
+      tag != kLinesTag && tag != kCurveTag) {
+    // E.g. the deletion markers of a delta file
+    return parser.SkipElement();
+  }
+  if (render_builder != NULL && tag != kComponentInstanceTag &&
+      tag != kFaceTag) {
+    // Not rendered
+    return parser.SkipElement();
+  }
+  if (!ParseStreamedElement(parser, doc))
+    return false;
+
+  // As ReadEntities does
+  const tinyxml2::XMLNode* elem = doc.FirstChildElement();
+  bool ok = true;
+  if (tag == kComponentInstanceTag) {
+    XmlComponentInstanceInfo instance;
+    ReadComponentInstanceInfo(elem, instance);
+    listener->OnComponentInstance(instance);
+  } else if (tag == kFaceTag && render_builder != NULL) {
+    XmlRenderFace face(*render_builder);
+    ok = ReadFaceInfo(elem, quantization, face);
+  } else if (tag == kFaceTag) {
+    XmlFaceInfo face_info;
+    ok = ReadFaceInfo(elem, quantization, face_info);
+    listener->OnFace(face_info);
+  } else if (tag == kEdgeTag) {
+    XmlEdgeInfo edge_info;
+    ok = ReadEdgeInfo(elem, edge_info);
+    listener->OnEdge(edge_info);
+  } else if (tag == kLinesTag) {
+    std::vector<XmlEdgeInfo> edges;
+    ok = ReadLineListInfo(elem, edges);
+    for (size_t i = 0; i < edges.size(); ++i)
+      listener->OnEdge(edges[i]);
+  } else {
+    XmlCurveInfo curve_info;
+    ok = ReadCurveInfo(elem, curve_info);
+    listener->OnCurve(curve_info);
+  }
+  return ok;
+}
+
+bool CXmlFile::GetModelInfoStreaming(const std::string& filename,
+                                     XmlModelInfo& model_info) {
+  model_info = XmlModelInfo();
+  CModelInfoBuilder builder(model_info);
+  return ReadStreaming(filename, &builder);
+}
+
+bool CXmlFile::ReadRenderModel(const std::string& filename,
+                               XmlRenderModel& model) {
+  model = XmlRenderModel();
+  CXmlRenderBuilder builder(model);
+  return ReadStreaming(filename, &builder, &builder);
+}
+
+//------------------------------------------------------------------------------
+// Compact DOM
+
+bool CXmlFile::GetModelInfoCompact(const std::string& filename,
+                                   XmlModelInfo& model_info) {
+  model_info = XmlModelInfo();
+
+  tinyxml2::XMLCompactDocument doc;
+  PrepareDocument(doc);
+  // Mapped like Open does, so a large file is not held in memory twice
+  if (doc.LoadFileMapped(filename.c_str()) != tinyxml2::XML_NO_ERROR ||
+      !ReadHeader(doc.FirstChild()))
+    return false;
+  return ReadModelInfo(doc.Node(), model_info);
+}
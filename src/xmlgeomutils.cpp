@@ -106,4 +106,78 @@ bool CVector3d::operator!=(const CVector3d& v) const {
   return !operator==(v);
 }
 
+// Bounding Box Class---------------------------------
+void CBoundingBox3d::Add(const CPoint3d& pt) {
+  if (is_empty_) {
+    min_ = pt;
+    max_ = pt;
+    is_empty_ = false;
+    return;
+  }
+  if (pt.x() < min_.x()) min_.set_x(pt.x());
+  if (pt.y() < min_.y()) min_.set_y(pt.y());
+  if (pt.z() < min_.z()) min_.set_z(pt.z());
+  if (pt.x() > max_.x()) max_.set_x(pt.x());
+  if (pt.y() > max_.y()) max_.set_y(pt.y());
+  if (pt.z() > max_.z()) max_.set_z(pt.z());
+}
+
+void CBoundingBox3d::Add(const CBoundingBox3d& box) {
+  if (!box.IsEmpty()) {
+    Add(box.min());
+    Add(box.max());
+  }
+}
+
+// Transformation Utilities---------------------------
+CPoint3d TransformPoint(const SUTransformation& transform, const CPoint3d& pt) {
+  const double* m = transform.values;
+  double x = m[0] * pt.x() + m[4] * pt.y() + m[8] * pt.z() + m[12];
+  double y = m[1] * pt.x() + m[5] * pt.y() + m[9] * pt.z() + m[13];
+  double z = m[2] * pt.x() + m[6] * pt.y() + m[10] * pt.z() + m[14];
+  double w = m[3] * pt.x() + m[7] * pt.y() + m[11] * pt.z() + m[15];
+  if (w != 0.0 && w != 1.0) {
+    x /= w;
+    y /= w;
+    z /= w;
+  }
+  return CPoint3d(x, y, z);
+}
+
+SUTransformation GetIdentityTransform() {
+  SUTransformation transform;
+  for (int i = 0; i < 16; ++i)
+    transform.values[i] = (i % 5 == 0) ? 1.0 : 0.0;
+  return transform;
+}
+
+SUTransformation MultiplyTransforms(const SUTransformation& a,
+                                    const SUTransformation& b) {
+  SUTransformation result;
+  for (int col = 0; col < 4; ++col) {
+    for (int row = 0; row < 4; ++row) {
+      double sum = 0.0;
+      for (int k = 0; k < 4; ++k) {
+        sum += a.values[k * 4 + row] * b.values[col * 4 + k];
+      }
+      result.values[col * 4 + row] = sum;
+    }
+  }
+  return result;
+}
+
+CBoundingBox3d TransformBoundingBox(const SUTransformation& transform,
+                                    const CBoundingBox3d& box) {
+  CBoundingBox3d result;
+  if (box.IsEmpty())
+    return result;
+  for (int i = 0; i < 8; ++i) {
+    CPoint3d corner((i & 1) ? box.max().x() : box.min().x(),
+                    (i & 2) ? box.max().y() : box.min().y(),
+                    (i & 4) ? box.max().z() : box.min().z());
+    result.Add(TransformPoint(transform, corner));
+  }
+  return result;
+}
+
 } // end namespace XmlGeomUtils
@@ -0,0 +1,285 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+
+#include "xmlindex.h"
+#include "tinyxml2.h"
+
+// Index file layout (all integers are LEB128 varints unless noted):
+//   "SKXI"              magic, 4 bytes
+//   version             1 byte
+//   count
+//   count entries of:
+//     type              1 byte
+//     offset            delta from the previous entry's offset
+//     length
+//     name length
+//     name              utf8, not null terminated
+//     groups only:
+//       scope type      1 byte
+//       scope name length
+//       scope name      utf8, not null terminated
+static const char kIndexMagic[4] = { 'S', 'K', 'X', 'I' };
+static const unsigned char kIndexVersion = 2;
+
+static const char* kIndexExtension = ".idx";
+static const char* kGeometryTag = "Geometry";
+static const char* kCompDefTag = "ComponentDefinition";
+static const char* kGroupTag = "Group";
+static const char* kNameTag = "Name";
+
+namespace {
+
+bool LessOffset(const XmlIndexEntry& a, const XmlIndexEntry& b) {
+  return a.offset_ < b.offset_;
+}
+
+// An XMLPrinter that records the byte range of the indexed elements while
+// the document is being written.
+class CIndexPrinter : public tinyxml2::XMLPrinter {
+ public:
+  CIndexPrinter(FILE* fp, bool index_groups, CXmlIndex* index,
+                CXmlProfile* profile)
+    : tinyxml2::XMLPrinter(fp), index_groups_(index_groups), index_(index),
+      profile_(profile) {}
+
+  virtual bool VisitEnter(const tinyxml2::XMLElement& element,
+                          const tinyxml2::XMLAttribute* attribute) {
+    // The '>' of the parent belongs to the parent, not to this element
+    SealElementIfJustOpened();
+
+    OpenElement open;
+    open.indexed_ = false;
+    open.scope_ = false;
+    open.entry_.offset_ = BytesWritten();
+
+    const char* tag = element.Name();
+    if (open_elements_.empty()) {
+      // Top level section
+      open.indexed_ = true;
+      open.entry_.type_ = XmlIndexEntryType_Section;
+      open.entry_.name_ = tag;
+      if (strcmp(tag, kGeometryTag) == 0) {
+        open.scope_ = true;
+        PushScope(tag, XmlIndexEntryType_Section, tag);
+      }
+    } else if (open_elements_.size() == 1 && strcmp(tag, kCompDefTag) == 0) {
+      // Component definition. Instances also contain a ComponentDefinition
+      // tag but never at this depth.
+      const char* name = element.Attribute(kNameTag);
+      open.indexed_ = true;
+      open.entry_.type_ = XmlIndexEntryType_ComponentDefinition;
+      open.entry_.name_ = name != NULL ? name : "";
+      open.scope_ = true;
+      PushScope(open.entry_.name_, XmlIndexEntryType_ComponentDefinition,
+                open.entry_.name_);
+    } else if (strcmp(tag, kGroupTag) == 0 && !scopes_.empty()) {
+      std::stringstream ss;
+      ss << scopes_.back().path_ << '/' << scopes_.back().num_groups_++;
+      // Copied, pushing the scope may move the parent
+      XmlIndexEntryType scope_type = scopes_.back().type_;
+      std::string scope_name = scopes_.back().name_;
+      open.scope_ = true;
+      PushScope(ss.str(), scope_type, scope_name);
+      if (index_groups_) {
+        open.indexed_ = true;
+        open.entry_.type_ = XmlIndexEntryType_Group;
+        open.entry_.name_ = ss.str();
+        open.entry_.scope_type_ = scope_type;
+        open.entry_.scope_name_ = scope_name;
+      }
+    }
+    open_elements_.push_back(open);
+
+    if (profile_ != NULL)
+      profile_->BeginElement(element, BytesWritten());
+    return tinyxml2::XMLPrinter::VisitEnter(element, attribute);
+  }
+
+  virtual bool VisitExit(const tinyxml2::XMLElement& element) {
+    bool ok = tinyxml2::XMLPrinter::VisitExit(element);
+    if (profile_ != NULL)
+      profile_->EndElement(BytesWritten());
+
+    OpenElement& open = open_elements_.back();
+    if (open.indexed_) {
+      open.entry_.length_ = BytesWritten() - open.entry_.offset_;
+      index_->AddEntry(open.entry_);
+    }
+    if (open.scope_) {
+      scopes_.pop_back();
+    }
+    open_elements_.pop_back();
+    return ok;
+  }
+
+ private:
+  struct OpenElement {
+    bool indexed_;
+    bool scope_;
+    XmlIndexEntry entry_;
+  };
+
+  // A component definition, the model geometry or a group. Used to build
+  // the group paths. Groups carry the definition or geometry they are in.
+  struct Scope {
+    std::string path_;
+    size_t num_groups_;
+    XmlIndexEntryType type_;
+    std::string name_;
+  };
+
+  void PushScope(const std::string& path, XmlIndexEntryType type,
+                 const std::string& name) {
+    Scope scope;
+    scope.path_ = path;
+    scope.num_groups_ = 0;
+    scope.type_ = type;
+    scope.name_ = name;
+    scopes_.push_back(scope);
+  }
+
+  bool index_groups_;
+  CXmlIndex* index_;
+  CXmlProfile* profile_;
+  std::vector<OpenElement> open_elements_;
+  std::vector<Scope> scopes_;
+};
+
+void WriteVarint(uint64_t value, std::string& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+bool ReadVarint(const std::string& in, size_t& pos, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+    unsigned char byte = static_cast<unsigned char>(in[pos++]);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+std::string CXmlIndex::GetIndexFilename(const std::string& xml_filename) {
+  return xml_filename + kIndexExtension;
+}
+
+bool CXmlIndex::PrintDocument(const tinyxml2::XMLDocument& doc, FILE* fp,
+                              bool index_groups, CXmlProfile* profile) {
+  Clear();
+  if (profile != NULL)
+    profile->Clear();
+  CIndexPrinter printer(fp, index_groups, this, profile);
+  doc.Accept(&printer);
+  if (profile != NULL)
+    profile->EndDocument(printer.BytesWritten());
+
+  // Entries are added as elements are closed, so nested entries come first
+  std::stable_sort(entries_.begin(), entries_.end(), LessOffset);
+  return ferror(fp) == 0;
+}
+
+bool CXmlIndex::Write(const std::string& filename) const {
+  std::string data(kIndexMagic, sizeof(kIndexMagic));
+  data.push_back(static_cast<char>(kIndexVersion));
+  WriteVarint(entries_.size(), data);
+
+  uint64_t prev_offset = 0;
+  for (std::vector<XmlIndexEntry>::const_iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    data.push_back(static_cast<char>(it->type_));
+    WriteVarint(it->offset_ - prev_offset, data);
+    WriteVarint(it->length_, data);
+    WriteVarint(it->name_.size(), data);
+    data.append(it->name_);
+    if (it->type_ == XmlIndexEntryType_Group) {
+      data.push_back(static_cast<char>(it->scope_type_));
+      WriteVarint(it->scope_name_.size(), data);
+      data.append(it->scope_name_);
+    }
+    prev_offset = it->offset_;
+  }
+
+  FILE* fp = fopen(filename.c_str(), "wb");
+  if (fp == NULL)
+    return false;
+  bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+  ok &= fclose(fp) == 0;
+  return ok;
+}
+
+bool CXmlIndex::Read(const std::string& filename) {
+  Clear();
+
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL)
+    return false;
+  std::string data;
+  char buf[4096];
+  size_t count = 0;
+  while ((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    data.append(buf, count);
+  }
+  fclose(fp);
+
+  if (data.size() < sizeof(kIndexMagic) + 1 ||
+      memcmp(data.data(), kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+      static_cast<unsigned char>(data[sizeof(kIndexMagic)]) != kIndexVersion)
+    return false;
+
+  size_t pos = sizeof(kIndexMagic) + 1;
+  uint64_t num_entries = 0;
+  if (!ReadVarint(data, pos, num_entries))
+    return false;
+
+  uint64_t offset = 0;
+  for (uint64_t i = 0; i < num_entries; ++i) {
+    if (pos >= data.size())
+      return false;
+    XmlIndexEntry entry;
+    entry.type_ = static_cast<XmlIndexEntryType>(data[pos++]);
+    uint64_t delta = 0, name_length = 0;
+    if (!ReadVarint(data, pos, delta) ||
+        !ReadVarint(data, pos, entry.length_) ||
+        !ReadVarint(data, pos, name_length) ||
+        name_length > data.size() - pos)
+      return false;
+    offset += delta;
+    entry.offset_ = offset;
+    entry.name_.assign(data, pos, name_length);
+    pos += name_length;
+    if (entry.type_ == XmlIndexEntryType_Group) {
+      if (pos >= data.size())
+        return false;
+      entry.scope_type_ = static_cast<XmlIndexEntryType>(data[pos++]);
+      if (!ReadVarint(data, pos, name_length) ||
+          name_length > data.size() - pos)
+        return false;
+      entry.scope_name_.assign(data, pos, name_length);
+      pos += name_length;
+    }
+    entries_.push_back(entry);
+  }
+  return true;
+}
+
+const XmlIndexEntry* CXmlIndex::FindEntry(XmlIndexEntryType type,
+                                          const std::string& name) const {
+  for (std::vector<XmlIndexEntry>::const_iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    if (it->type_ == type && it->name_ == name)
+      return &(*it);
+  }
+  return NULL;
+}
@@ -0,0 +1,740 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <set>
+#include <sstream>
+
+#include "xmlmanifest.h"
+#include "tinyxml2.h"
+
+// Manifest file layout (all integers are LEB128 varints unless noted):
+//   "SKXM"              magic, 4 bytes
+//   version             1 byte
+//   count
+//   count entries of:
+//     type              1 byte
+//     hash              8 bytes, little endian
+//     own hash          8 bytes, little endian
+//     name length
+//     name              utf8, not null terminated
+static const char kManifestMagic[4] = { 'S', 'K', 'X', 'M' };
+static const unsigned char kManifestVersion = 1;
+
+static const char* kManifestExtension = ".manifest";
+
+static const std::string kSkpToXMLTag("SkpToXML");
+static const std::string kLayersTag("Layers");
+static const std::string kMaterialsTag("Materials");
+static const std::string kCompDefsTag("ComponentDefinitions");
+static const std::string kCoarseTag("Coarse");
+static const std::string kGeometryTag("Geometry");
+static const std::string kGroupTag("Group");
+static const std::string kQuantizationTag("Quantization");
+static const std::string kDefinitionTag("Definition");
+static const std::string kNameTag("Name");
+static const std::string kDeltaTag("delta");
+static const std::string kDeletedTag("Deleted");
+static const std::string kPathTag("Path");
+static const std::string kEntitiesTag("Entities");
+
+// 64-bit FNV-1a
+static const uint64_t kHashSeed = 14695981039346656037ULL;
+static const uint64_t kHashPrime = 1099511628211ULL;
+
+namespace {
+
+bool LessEntry(const XmlManifestEntry& a, const XmlManifestEntry& b) {
+  if (a.type_ != b.type_)
+    return a.type_ < b.type_;
+  return a.name_ < b.name_;
+}
+
+uint64_t HashBytes(const char* data, size_t length, uint64_t hash) {
+  for (size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= kHashPrime;
+  }
+  return hash;
+}
+
+uint64_t HashValue(uint64_t value, uint64_t hash) {
+  for (int i = 0; i < 8; ++i) {
+    hash ^= (value >> (i * 8)) & 0xff;
+    hash *= kHashPrime;
+  }
+  return hash;
+}
+
+// Hashes the compact text of the element and its contents
+uint64_t HashElement(const tinyxml2::XMLNode* node, uint64_t hash) {
+  tinyxml2::XMLPrinter printer(NULL, true);
+  node->Accept(&printer);
+  return HashBytes(printer.CStr(), printer.CStrSize() - 1, hash);
+}
+
+bool IsGroup(const tinyxml2::XMLElement* elem) {
+  return elem->Value() == kGroupTag;
+}
+
+// Hash of the element's children other than groups
+uint64_t HashOwnEntities(const tinyxml2::XMLElement* parent, uint64_t hash) {
+  for (const tinyxml2::XMLElement* child = parent->FirstChildElement();
+       child != NULL; child = child->NextSiblingElement()) {
+    if (!IsGroup(child))
+      hash = HashElement(child, hash);
+  }
+  return hash;
+}
+
+std::string GetName(const tinyxml2::XMLElement* elem) {
+  const char* name = elem->Attribute(kNameTag.c_str());
+  return name != NULL ? name : "";
+}
+
+std::string GetChildPath(const std::string& path, size_t ordinal) {
+  std::stringstream ss;
+  ss << path << '/' << ordinal;
+  return ss.str();
+}
+
+tinyxml2::XMLNode* DeepClone(const tinyxml2::XMLNode* node,
+                             tinyxml2::XMLDocument* doc) {
+  tinyxml2::XMLNode* clone = node->ShallowClone(doc);
+  for (const tinyxml2::XMLNode* child = node->FirstChild(); child != NULL;
+       child = child->NextSibling()) {
+    clone->InsertEndChild(DeepClone(child, doc));
+  }
+  return clone;
+}
+
+// Finds the group at the path, e.g. "Geometry/0/2". Returns NULL if there
+// is no such group; parent is then the element the group would be added to,
+// or NULL if that does not exist either.
+tinyxml2::XMLElement* FindGroup(tinyxml2::XMLElement* geometry,
+                                const std::string& path,
+                                tinyxml2::XMLElement*& parent) {
+  parent = NULL;
+  if (geometry == NULL || path.compare(0, kGeometryTag.size(),
+                                       kGeometryTag) != 0)
+    return NULL;
+  tinyxml2::XMLElement* elem = geometry;
+  size_t pos = kGeometryTag.size();
+  while (pos < path.size()) {
+    if (elem == NULL || path[pos] != '/')
+      return NULL;
+    char* end = NULL;
+    unsigned long ordinal = strtoul(path.c_str() + pos + 1, &end, 10);
+    if (end == path.c_str() + pos + 1)
+      return NULL;
+    pos = end - path.c_str();
+    parent = elem;
+    tinyxml2::XMLElement* child = elem->FirstChildElement(kGroupTag.c_str());
+    for (unsigned long i = 0; i < ordinal && child != NULL; ++i) {
+      child = child->NextSiblingElement(kGroupTag.c_str());
+    }
+    if (child == NULL && pos < path.size())
+      parent = NULL;
+    elem = child;
+  }
+  return elem;
+}
+
+void WriteVarint(uint64_t value, std::string& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+bool ReadVarint(const std::string& in, size_t& pos, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+    unsigned char byte = static_cast<unsigned char>(in[pos++]);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+void WriteFixed64(uint64_t value, std::string& out) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<char>((value >> (i * 8)) & 0xff));
+  }
+}
+
+bool ReadFixed64(const std::string& in, size_t& pos, uint64_t& value) {
+  if (in.size() - pos < 8)
+    return false;
+  value = 0;
+  for (int i = 0; i < 8; ++i) {
+    value |= static_cast<uint64_t>(static_cast<unsigned char>(in[pos++]))
+             << (i * 8);
+  }
+  return true;
+}
+
+// Drops the unchanged items of a section and adds the deletion markers.
+// Returns the section, which may have been created for the markers, or NULL
+// if nothing is left.
+tinyxml2::XMLElement* PruneSection(tinyxml2::XMLDocument& doc,
+                                   tinyxml2::XMLElement* section,
+                                   const std::string& tag,
+                                   tinyxml2::XMLNode* insert_after,
+                                   XmlManifestEntryType type,
+                                   const CXmlManifest& current,
+                                   const CXmlManifest& previous,
+                                   std::set<std::string>& written,
+                                   XmlDeltaStats& stats) {
+  if (section != NULL) {
+    tinyxml2::XMLElement* child = section->FirstChildElement();
+    while (child != NULL) {
+      tinyxml2::XMLElement* next = child->NextSiblingElement();
+      std::string name = GetName(child);
+      const XmlManifestEntry* entry = current.FindEntry(type, name);
+      const XmlManifestEntry* old_entry = previous.FindEntry(type, name);
+      if (entry != NULL && old_entry != NULL &&
+          entry->hash_ == old_entry->hash_) {
+        section->DeleteChild(child);
+        stats.unchanged_++;
+      } else {
+        written.insert(name);
+        stats.changed_++;
+      }
+      child = next;
+    }
+  }
+
+  const std::vector<XmlManifestEntry>& entries = previous.entries();
+  for (size_t i = 0; i < entries.size(); ++i) {
+    if (entries[i].type_ != type ||
+        current.FindEntry(type, entries[i].name_) != NULL)
+      continue;
+    if (section == NULL) {
+      section = doc.NewElement(tag.c_str());
+      doc.InsertAfterChild(insert_after, section);
+    }
+    tinyxml2::XMLElement* deleted = doc.NewElement(kDeletedTag.c_str());
+    deleted->SetAttribute(kNameTag.c_str(), entries[i].name_.c_str());
+    section->InsertEndChild(deleted);
+    stats.deleted_++;
+  }
+
+  if (section != NULL && section->FirstChild() == NULL) {
+    doc.DeleteChild(section);
+    section = NULL;
+  }
+  return section;
+}
+
+// Replaces, adds or deletes the named items of a section
+void ApplySection(tinyxml2::XMLDocument& doc, tinyxml2::XMLElement* section,
+                  const tinyxml2::XMLElement* delta_section,
+                  std::set<std::string>& deleted) {
+  std::map<std::string, tinyxml2::XMLElement*> items;
+  for (tinyxml2::XMLElement* child = section->FirstChildElement();
+       child != NULL; child = child->NextSiblingElement()) {
+    items[GetName(child)] = child;
+  }
+  for (const tinyxml2::XMLElement* child = delta_section->FirstChildElement();
+       child != NULL; child = child->NextSiblingElement()) {
+    std::string name = GetName(child);
+    std::map<std::string, tinyxml2::XMLElement*>::iterator it =
+        items.find(name);
+    if (child->Value() == kDeletedTag) {
+      if (it != items.end()) {
+        section->DeleteChild(it->second);
+        items.erase(it);
+      }
+      deleted.insert(name);
+    } else if (it != items.end()) {
+      tinyxml2::XMLNode* clone = DeepClone(child, &doc);
+      section->InsertAfterChild(it->second, clone);
+      section->DeleteChild(it->second);
+      it->second = clone->ToElement();
+    } else {
+      items[name] = section->InsertEndChild(DeepClone(child, &doc))
+                        ->ToElement();
+    }
+  }
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+std::string CXmlManifest::GetManifestFilename(const std::string& xml_filename) {
+  return xml_filename + kManifestExtension;
+}
+
+uint64_t CXmlManifest::AddGroups(const tinyxml2::XMLElement* parent,
+                                 const std::string& path, uint64_t seed) {
+  uint64_t groups_hash = kHashSeed;
+  size_t ordinal = 0;
+  for (const tinyxml2::XMLElement* child = parent->FirstChildElement();
+       child != NULL; child = child->NextSiblingElement()) {
+    if (!IsGroup(child))
+      continue;
+    XmlManifestEntry entry;
+    entry.type_ = XmlManifestEntryType_Group;
+    entry.name_ = GetChildPath(path, ordinal++);
+    uint64_t child_groups_hash = AddGroups(child, entry.name_, seed);
+    entry.own_hash_ = HashOwnEntities(child, seed);
+    entry.hash_ = HashValue(child_groups_hash, entry.own_hash_);
+    entries_.push_back(entry);
+    groups_hash = HashValue(entry.hash_, groups_hash);
+  }
+  return groups_hash;
+}
+
+void CXmlManifest::Build(const tinyxml2::XMLDocument& doc) {
+  Clear();
+
+  // The dequantization parameters are part of the definitions and geometry
+  // they apply to
+  std::map<std::string, uint64_t> definition_seeds;
+  uint64_t geometry_seed = kHashSeed;
+  const tinyxml2::XMLElement* header =
+      doc.FirstChildElement(kSkpToXMLTag.c_str());
+  if (header != NULL) {
+    for (const tinyxml2::XMLElement* child =
+             header->FirstChildElement(kQuantizationTag.c_str());
+         child != NULL;
+         child = child->NextSiblingElement(kQuantizationTag.c_str())) {
+      const char* name = child->Attribute(kDefinitionTag.c_str());
+      if (name != NULL)
+        definition_seeds[name] = HashElement(child, kHashSeed);
+      else
+        geometry_seed = HashElement(child, kHashSeed);
+    }
+  }
+
+  for (const tinyxml2::XMLElement* section = doc.FirstChildElement();
+       section != NULL; section = section->NextSiblingElement()) {
+    XmlManifestEntryType type;
+    if (section->Value() == kLayersTag) {
+      type = XmlManifestEntryType_Layer;
+    } else if (section->Value() == kMaterialsTag) {
+      type = XmlManifestEntryType_Material;
+    } else if (section->Value() == kCompDefsTag) {
+      type = XmlManifestEntryType_ComponentDefinition;
+    } else if (section->Value() == kGeometryTag) {
+      XmlManifestEntry entry;
+      entry.type_ = XmlManifestEntryType_Geometry;
+      uint64_t groups_hash = AddGroups(section, kGeometryTag, geometry_seed);
+      entry.own_hash_ = HashOwnEntities(section, geometry_seed);
+      entry.hash_ = HashValue(groups_hash, entry.own_hash_);
+      entries_.push_back(entry);
+      continue;
+    } else {
+      continue;
+    }
+
+    for (const tinyxml2::XMLElement* child = section->FirstChildElement();
+         child != NULL; child = child->NextSiblingElement()) {
+      XmlManifestEntry entry;
+      entry.type_ = type;
+      entry.name_ = GetName(child);
+      uint64_t seed = kHashSeed;
+      std::map<std::string, uint64_t>::const_iterator it =
+          definition_seeds.find(entry.name_);
+      if (type == XmlManifestEntryType_ComponentDefinition &&
+          it != definition_seeds.end())
+        seed = it->second;
+      entry.hash_ = entry.own_hash_ = HashElement(child, seed);
+      entries_.push_back(entry);
+    }
+  }
+
+  std::sort(entries_.begin(), entries_.end(), LessEntry);
+}
+
+void CXmlManifest::PruneGroups(
+    tinyxml2::XMLElement* parent, const std::string& path,
+    const CXmlManifest& previous,
+    std::vector<tinyxml2::XMLElement*>& changed_groups,
+    std::vector<std::string>& changed_paths, XmlDeltaStats& stats) const {
+  size_t ordinal = 0;
+  for (tinyxml2::XMLElement* child = parent->FirstChildElement();
+       child != NULL; child = child->NextSiblingElement()) {
+    if (!IsGroup(child))
+      continue;
+    std::string child_path = GetChildPath(path, ordinal++);
+    const XmlManifestEntry* entry =
+        FindEntry(XmlManifestEntryType_Group, child_path);
+    const XmlManifestEntry* old_entry =
+        previous.FindEntry(XmlManifestEntryType_Group, child_path);
+    if (entry == NULL)
+      continue;
+    if (old_entry != NULL && old_entry->hash_ == entry->hash_) {
+      stats.unchanged_++;
+    } else if (old_entry == NULL || old_entry->own_hash_ != entry->own_hash_) {
+      changed_groups.push_back(child);
+      changed_paths.push_back(child_path);
+      stats.changed_++;
+    } else {
+      // Only some of the nested groups changed
+      PruneGroups(child, child_path, previous, changed_groups, changed_paths,
+                  stats);
+    }
+  }
+
+  // Group paths are ordinals, so removed groups are always the last ones
+  for (;; ++ordinal) {
+    std::string child_path = GetChildPath(path, ordinal);
+    if (previous.FindEntry(XmlManifestEntryType_Group, child_path) == NULL)
+      break;
+    changed_paths.push_back(child_path);
+    changed_groups.push_back(NULL);
+    stats.deleted_++;
+  }
+}
+
+XmlDeltaStats CXmlManifest::PruneDocument(tinyxml2::XMLDocument& doc,
+                                          const CXmlManifest& previous) const {
+  XmlDeltaStats stats;
+  tinyxml2::XMLElement* header = doc.FirstChildElement(kSkpToXMLTag.c_str());
+  if (header == NULL)
+    return stats;
+  header->SetAttribute(kDeltaTag.c_str(), 1);
+
+  // A delta is applied to a full export, so it has no coarse model
+  tinyxml2::XMLElement* coarse = doc.FirstChildElement(kCoarseTag.c_str());
+  if (coarse != NULL)
+    doc.DeleteChild(coarse);
+
+  // Names written per section, the definitions are needed below
+  std::set<std::string> written[3];
+  tinyxml2::XMLNode* last_section = header;
+  const std::string* tags[3] = { &kLayersTag, &kMaterialsTag, &kCompDefsTag };
+  const XmlManifestEntryType types[3] = {
+    XmlManifestEntryType_Layer,
+    XmlManifestEntryType_Material,
+    XmlManifestEntryType_ComponentDefinition
+  };
+  for (int i = 0; i < 3; ++i) {
+    tinyxml2::XMLElement* section =
+        PruneSection(doc, doc.FirstChildElement(tags[i]->c_str()), *tags[i],
+                     last_section, types[i], *this, previous, written[i],
+                     stats);
+    if (section != NULL)
+      last_section = section;
+  }
+
+  // Only the quantization parameters of the written definitions are needed
+  tinyxml2::XMLElement* quantization =
+      header->FirstChildElement(kQuantizationTag.c_str());
+  while (quantization != NULL) {
+    tinyxml2::XMLElement* next =
+        quantization->NextSiblingElement(kQuantizationTag.c_str());
+    const char* name = quantization->Attribute(kDefinitionTag.c_str());
+    if (name != NULL && written[2].find(name) == written[2].end())
+      header->DeleteChild(quantization);
+    quantization = next;
+  }
+
+  tinyxml2::XMLElement* geometry = doc.FirstChildElement(kGeometryTag.c_str());
+  if (geometry == NULL)
+    return stats;
+
+  const XmlManifestEntry* entry =
+      FindEntry(XmlManifestEntryType_Geometry, std::string());
+  const XmlManifestEntry* old_entry =
+      previous.FindEntry(XmlManifestEntryType_Geometry, std::string());
+  bool entities_changed = entry == NULL || old_entry == NULL ||
+                          entry->own_hash_ != old_entry->own_hash_;
+  if (entities_changed) {
+    geometry->SetAttribute(kEntitiesTag.c_str(), 1);
+    stats.changed_++;
+  } else {
+    stats.unchanged_++;
+  }
+
+  std::vector<tinyxml2::XMLElement*> changed_groups;
+  std::vector<std::string> changed_paths;
+  PruneGroups(geometry, kGeometryTag, previous, changed_groups, changed_paths,
+              stats);
+
+  // Nested changed groups are copied up to the geometry; the top level ones
+  // stay where they are
+  std::set<tinyxml2::XMLElement*> kept;
+  std::vector<tinyxml2::XMLNode*> additions;
+  for (size_t i = 0; i < changed_groups.size(); ++i) {
+    tinyxml2::XMLElement* elem = changed_groups[i];
+    if (elem == NULL) {
+      elem = doc.NewElement(kDeletedTag.c_str());
+    } else if (elem->Parent() == geometry) {
+      kept.insert(elem);
+    } else {
+      elem = DeepClone(elem, &doc)->ToElement();
+    }
+    elem->SetAttribute(kPathTag.c_str(), changed_paths[i].c_str());
+    if (kept.find(elem) == kept.end())
+      additions.push_back(elem);
+  }
+
+  tinyxml2::XMLElement* child = geometry->FirstChildElement();
+  while (child != NULL) {
+    tinyxml2::XMLElement* next = child->NextSiblingElement();
+    if (IsGroup(child) ? kept.find(child) == kept.end() : !entities_changed)
+      geometry->DeleteChild(child);
+    child = next;
+  }
+  for (size_t i = 0; i < additions.size(); ++i) {
+    geometry->InsertEndChild(additions[i]);
+  }
+
+  if (!entities_changed && geometry->FirstChild() == NULL)
+    doc.DeleteChild(geometry);
+  return stats;
+}
+
+bool CXmlManifest::ApplyDelta(const std::string& xml_filename,
+                              const std::string& delta_filename,
+                              const std::string& out_filename) {
+  tinyxml2::XMLDocument doc;
+  tinyxml2::XMLDocument delta;
+  if (doc.LoadFileMapped(xml_filename.c_str()) != tinyxml2::XML_NO_ERROR ||
+      delta.LoadFileMapped(delta_filename.c_str()) != tinyxml2::XML_NO_ERROR)
+    return false;
+
+  tinyxml2::XMLElement* header = doc.FirstChildElement(kSkpToXMLTag.c_str());
+  const tinyxml2::XMLElement* delta_header =
+      delta.FirstChildElement(kSkpToXMLTag.c_str());
+  int is_delta = 0;
+  if (header == NULL || delta_header == NULL ||
+      delta_header->QueryIntAttribute(kDeltaTag.c_str(), &is_delta) !=
+          tinyxml2::XML_NO_ERROR ||
+      is_delta != 1)
+    return false;
+
+  // Header attributes and quantization parameters
+  for (const tinyxml2::XMLAttribute* attribute = delta_header->FirstAttribute();
+       attribute != NULL; attribute = attribute->Next()) {
+    if (attribute->Name() != kDeltaTag)
+      header->SetAttribute(attribute->Name(), attribute->Value());
+  }
+  std::map<std::string, tinyxml2::XMLElement*> quantizations;
+  for (tinyxml2::XMLElement* child =
+           header->FirstChildElement(kQuantizationTag.c_str());
+       child != NULL;
+       child = child->NextSiblingElement(kQuantizationTag.c_str())) {
+    const char* name = child->Attribute(kDefinitionTag.c_str());
+    quantizations[name != NULL ? std::string("/") + name : ""] = child;
+  }
+  for (const tinyxml2::XMLElement* child =
+           delta_header->FirstChildElement(kQuantizationTag.c_str());
+       child != NULL;
+       child = child->NextSiblingElement(kQuantizationTag.c_str())) {
+    const char* name = child->Attribute(kDefinitionTag.c_str());
+    std::string key = name != NULL ? std::string("/") + name : "";
+    tinyxml2::XMLNode* clone = DeepClone(child, &doc);
+    std::map<std::string, tinyxml2::XMLElement*>::iterator it =
+        quantizations.find(key);
+    if (it != quantizations.end()) {
+      header->InsertAfterChild(it->second, clone);
+      header->DeleteChild(it->second);
+    } else {
+      header->InsertEndChild(clone);
+    }
+    quantizations[key] = clone->ToElement();
+  }
+
+  // Layers, materials and definitions
+  const std::string* tags[3] = { &kLayersTag, &kMaterialsTag, &kCompDefsTag };
+  tinyxml2::XMLNode* last_section = header;
+  for (int i = 0; i < 3; ++i) {
+    tinyxml2::XMLElement* section = doc.FirstChildElement(tags[i]->c_str());
+    const tinyxml2::XMLElement* delta_section =
+        delta.FirstChildElement(tags[i]->c_str());
+    if (delta_section != NULL) {
+      if (section == NULL) {
+        section = doc.NewElement(tags[i]->c_str());
+        doc.InsertAfterChild(last_section, section);
+      }
+      std::set<std::string> deleted;
+      ApplySection(doc, section, delta_section, deleted);
+      if (tags[i] == &kCompDefsTag) {
+        for (std::set<std::string>::const_iterator it = deleted.begin();
+             it != deleted.end(); ++it) {
+          std::map<std::string, tinyxml2::XMLElement*>::iterator found =
+              quantizations.find("/" + *it);
+          if (found != quantizations.end())
+            header->DeleteChild(found->second);
+        }
+      }
+    }
+    if (section != NULL)
+      last_section = section;
+  }
+
+  // Geometry
+  const tinyxml2::XMLElement* delta_geometry =
+      delta.FirstChildElement(kGeometryTag.c_str());
+  if (delta_geometry != NULL) {
+    tinyxml2::XMLElement* geometry =
+        doc.FirstChildElement(kGeometryTag.c_str());
+    if (geometry == NULL) {
+      geometry = doc.NewElement(kGeometryTag.c_str());
+      doc.InsertEndChild(geometry);
+    }
+
+    int entities_changed = 0;
+    delta_geometry->QueryIntAttribute(kEntitiesTag.c_str(), &entities_changed);
+    if (entities_changed != 0) {
+      tinyxml2::XMLElement* child = geometry->FirstChildElement();
+      while (child != NULL) {
+        tinyxml2::XMLElement* next = child->NextSiblingElement();
+        if (!IsGroup(child))
+          geometry->DeleteChild(child);
+        child = next;
+      }
+    }
+
+    // Find every target before changing anything, as group paths are
+    // ordinals
+    struct GroupChange {
+      tinyxml2::XMLElement* target_;
+      tinyxml2::XMLElement* parent_;
+      const tinyxml2::XMLElement* replacement_;
+    };
+    std::vector<GroupChange> changes;
+    for (const tinyxml2::XMLElement* child = delta_geometry->FirstChildElement();
+         child != NULL; child = child->NextSiblingElement()) {
+      const char* path = child->Attribute(kPathTag.c_str());
+      bool is_deleted = child->Value() == kDeletedTag;
+      if (!IsGroup(child) && !is_deleted) {
+        if (entities_changed != 0)
+          geometry->InsertEndChild(DeepClone(child, &doc));
+        continue;
+      }
+      if (path == NULL)
+        return false;
+      GroupChange change;
+      change.target_ = FindGroup(geometry, path, change.parent_);
+      change.replacement_ = is_deleted ? NULL : child;
+      if (change.target_ == NULL && (is_deleted || change.parent_ == NULL))
+        return false;
+      changes.push_back(change);
+    }
+
+    std::vector<tinyxml2::XMLElement*> deletions;
+    for (size_t i = 0; i < changes.size(); ++i) {
+      const GroupChange& change = changes[i];
+      if (change.replacement_ == NULL) {
+        deletions.push_back(change.target_);
+        continue;
+      }
+      tinyxml2::XMLElement* clone =
+          DeepClone(change.replacement_, &doc)->ToElement();
+      clone->DeleteAttribute(kPathTag.c_str());
+      if (change.target_ != NULL) {
+        change.parent_->InsertAfterChild(change.target_, clone);
+        change.parent_->DeleteChild(change.target_);
+      } else {
+        // New groups follow the last group of their parent
+        tinyxml2::XMLElement* last_group = NULL;
+        for (tinyxml2::XMLElement* sibling =
+                 change.parent_->FirstChildElement(kGroupTag.c_str());
+             sibling != NULL;
+             sibling = sibling->NextSiblingElement(kGroupTag.c_str())) {
+          last_group = sibling;
+        }
+        if (last_group != NULL)
+          change.parent_->InsertAfterChild(last_group, clone);
+        else
+          change.parent_->InsertFirstChild(clone);
+      }
+    }
+    for (size_t i = 0; i < deletions.size(); ++i) {
+      deletions[i]->Parent()->DeleteChild(deletions[i]);
+    }
+  }
+
+  return doc.SaveFile(out_filename.c_str()) == tinyxml2::XML_NO_ERROR;
+}
+
+bool CXmlManifest::Write(const std::string& filename) const {
+  std::string data(kManifestMagic, sizeof(kManifestMagic));
+  data.push_back(static_cast<char>(kManifestVersion));
+  WriteVarint(entries_.size(), data);
+
+  for (std::vector<XmlManifestEntry>::const_iterator it = entries_.begin();
+       it != entries_.end(); ++it) {
+    data.push_back(static_cast<char>(it->type_));
+    WriteFixed64(it->hash_, data);
+    WriteFixed64(it->own_hash_, data);
+    WriteVarint(it->name_.size(), data);
+    data.append(it->name_);
+  }
+
+  FILE* fp = fopen(filename.c_str(), "wb");
+  if (fp == NULL)
+    return false;
+  bool ok = fwrite(data.data(), 1, data.size(), fp) == data.size();
+  ok &= fclose(fp) == 0;
+  return ok;
+}
+
+bool CXmlManifest::Read(const std::string& filename) {
+  Clear();
+
+  FILE* fp = fopen(filename.c_str(), "rb");
+  if (fp == NULL)
+    return false;
+  std::string data;
+  char buf[4096];
+  size_t count = 0;
+  while ((count = fread(buf, 1, sizeof(buf), fp)) > 0) {
+    data.append(buf, count);
+  }
+  fclose(fp);
+
+  if (data.size() < sizeof(kManifestMagic) + 1 ||
+      memcmp(data.data(), kManifestMagic, sizeof(kManifestMagic)) != 0 ||
+      static_cast<unsigned char>(data[sizeof(kManifestMagic)]) !=
+          kManifestVersion)
+    return false;
+
+  size_t pos = sizeof(kManifestMagic) + 1;
+  uint64_t num_entries = 0;
+  if (!ReadVarint(data, pos, num_entries))
+    return false;
+
+  for (uint64_t i = 0; i < num_entries; ++i) {
+    if (pos >= data.size())
+      return false;
+    XmlManifestEntry entry;
+    entry.type_ = static_cast<XmlManifestEntryType>(data[pos++]);
+    uint64_t name_length = 0;
+    if (!ReadFixed64(data, pos, entry.hash_) ||
+        !ReadFixed64(data, pos, entry.own_hash_) ||
+        !ReadVarint(data, pos, name_length) ||
+        name_length > data.size() - pos)
+      return false;
+    entry.name_.assign(data, pos, name_length);
+    pos += name_length;
+    entries_.push_back(entry);
+  }
+
+  // Written sorted, but do not rely on it for the lookups
+  std::sort(entries_.begin(), entries_.end(), LessEntry);
+  return true;
+}
+
+const XmlManifestEntry* CXmlManifest::FindEntry(
+    XmlManifestEntryType type, const std::string& name) const {
+  XmlManifestEntry key;
+  key.type_ = type;
+  key.name_ = name;
+  std::vector<XmlManifestEntry>::const_iterator it =
+      std::lower_bound(entries_.begin(), entries_.end(), key, LessEntry);
+  if (it != entries_.end() && it->type_ == type && it->name_ == name)
+    return &(*it);
+  return NULL;
+}
@@ -0,0 +1,301 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <map>
+
+#include "xmlmeshcompression.h"
+
+namespace XmlMeshCompression {
+
+namespace {
+
+// Binary range coder with adaptive probabilities, as in LZMA
+const int kProbBits = 11;
+const uint32_t kProbInit = 1 << (kProbBits - 1);
+const int kProbMoveBits = 5;
+const uint32_t kTopValue = 1 << 24;
+
+// Adaptive model for a byte, coded as eight binary decisions
+struct ByteModel {
+  ByteModel() {
+    for (int i = 0; i < 256; ++i)
+      probs_[i] = kProbInit;
+  }
+  uint16_t probs_[256];
+};
+
+// Varints are coded with one model for their first byte and one for the rest
+struct IntegerModel {
+  ByteModel first_;
+  ByteModel rest_;
+};
+
+class CRangeEncoder {
+ public:
+  explicit CRangeEncoder(std::string& out)
+    : out_(out), low_(0), range_(0xffffffff), cache_(0), cache_size_(1) {}
+
+  void EncodeBit(uint16_t& prob, int bit) {
+    uint32_t bound = (range_ >> kProbBits) * prob;
+    if (bit == 0) {
+      range_ = bound;
+      prob += ((1 << kProbBits) - prob) >> kProbMoveBits;
+    } else {
+      low_ += bound;
+      range_ -= bound;
+      prob -= prob >> kProbMoveBits;
+    }
+    while (range_ < kTopValue) {
+      range_ <<= 8;
+      ShiftLow();
+    }
+  }
+
+  void EncodeByte(ByteModel& model, uint8_t value) {
+    uint32_t m = 1;
+    for (int i = 7; i >= 0; --i) {
+      int bit = (value >> i) & 1;
+      EncodeBit(model.probs_[m], bit);
+      m = (m << 1) | bit;
+    }
+  }
+
+  void EncodeInteger(IntegerModel& model, uint32_t value) {
+    ByteModel* byte_model = &model.first_;
+    while (value >= 0x80) {
+      EncodeByte(*byte_model, static_cast<uint8_t>((value & 0x7f) | 0x80));
+      value >>= 7;
+      byte_model = &model.rest_;
+    }
+    EncodeByte(*byte_model, static_cast<uint8_t>(value));
+  }
+
+  void Flush() {
+    for (int i = 0; i < 5; ++i)
+      ShiftLow();
+  }
+
+ private:
+  void ShiftLow() {
+    if (static_cast<uint32_t>(low_) < 0xff000000 || (low_ >> 32) != 0) {
+      uint8_t carry = static_cast<uint8_t>(low_ >> 32);
+      uint8_t temp = cache_;
+      do {
+        out_ += static_cast<char>(temp + carry);
+        temp = 0xff;
+      } while (--cache_size_ != 0);
+      cache_ = static_cast<uint8_t>(low_ >> 24);
+    }
+    cache_size_++;
+    low_ = (low_ & 0x00ffffff) << 8;
+  }
+
+  std::string& out_;
+  uint64_t low_;
+  uint32_t range_;
+  uint8_t cache_;
+  uint64_t cache_size_;
+};
+
+class CRangeDecoder {
+ public:
+  CRangeDecoder(const std::string& in, size_t pos)
+    : in_(in), pos_(pos), range_(0xffffffff), code_(0), overrun_(false) {
+    for (int i = 0; i < 5; ++i)
+      code_ = (code_ << 8) | NextByte();
+  }
+
+  int DecodeBit(uint16_t& prob) {
+    uint32_t bound = (range_ >> kProbBits) * prob;
+    int bit;
+    if (code_ < bound) {
+      range_ = bound;
+      prob += ((1 << kProbBits) - prob) >> kProbMoveBits;
+      bit = 0;
+    } else {
+      code_ -= bound;
+      range_ -= bound;
+      prob -= prob >> kProbMoveBits;
+      bit = 1;
+    }
+    while (range_ < kTopValue) {
+      range_ <<= 8;
+      code_ = (code_ << 8) | NextByte();
+    }
+    return bit;
+  }
+
+  uint8_t DecodeByte(ByteModel& model) {
+    uint32_t m = 1;
+    for (int i = 0; i < 8; ++i) {
+      m = (m << 1) | DecodeBit(model.probs_[m]);
+    }
+    return static_cast<uint8_t>(m & 0xff);
+  }
+
+  bool DecodeInteger(IntegerModel& model, uint32_t& value) {
+    value = 0;
+    ByteModel* byte_model = &model.first_;
+    for (int shift = 0; shift < 35; shift += 7) {
+      uint8_t byte = DecodeByte(*byte_model);
+      value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0)
+        return !overrun_;
+      byte_model = &model.rest_;
+    }
+    return false;
+  }
+
+ private:
+  uint8_t NextByte() {
+    if (pos_ >= in_.size()) {
+      overrun_ = true;
+      return 0;
+    }
+    return static_cast<uint8_t>(in_[pos_++]);
+  }
+
+  const std::string& in_;
+  size_t pos_;
+  uint32_t range_;
+  uint32_t code_;
+  bool overrun_;
+};
+
+uint32_t ZigZag(uint32_t delta) {
+  int32_t value = static_cast<int32_t>(delta);
+  return (static_cast<uint32_t>(value) << 1) ^
+         static_cast<uint32_t>(value >> 31);
+}
+
+uint32_t UnZigZag(uint32_t value) {
+  return (value >> 1) ^ (0 - (value & 1));
+}
+
+void WriteVarint(uint64_t value, std::string& out) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<char>((value & 0x7f) | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<char>(value));
+}
+
+bool ReadVarint(const std::string& in, size_t& pos, uint64_t& value) {
+  value = 0;
+  for (int shift = 0; shift < 64 && pos < in.size(); shift += 7) {
+    unsigned char byte = static_cast<unsigned char>(in[pos++]);
+    value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+  return false;
+}
+
+} // namespace
+
+void Encode(const std::vector<uint32_t>& corners, size_t stride,
+            std::string& payload) {
+  payload.clear();
+  size_t num_corners = stride > 0 ? corners.size() / stride : 0;
+
+  // Merge identical corners into unique vertices, in order of first use
+  std::vector<uint32_t> indices(num_corners);
+  std::vector<size_t> unique_corners;
+  std::map<std::vector<uint32_t>, uint32_t> vertex_index;
+  for (size_t i = 0; i < num_corners; ++i) {
+    std::vector<uint32_t> key(corners.begin() + i * stride,
+                              corners.begin() + (i + 1) * stride);
+    std::map<std::vector<uint32_t>, uint32_t>::iterator it =
+        vertex_index.find(key);
+    if (it == vertex_index.end()) {
+      uint32_t index = static_cast<uint32_t>(unique_corners.size());
+      it = vertex_index.insert(std::make_pair(key, index)).first;
+      unique_corners.push_back(i);
+    }
+    indices[i] = it->second;
+  }
+  WriteVarint(unique_corners.size(), payload);
+
+  CRangeEncoder encoder(payload);
+
+  // Connectivity: 0 for the next new vertex, otherwise the zigzag delta from
+  // the previous corner plus one
+  IntegerModel index_model;
+  uint32_t next_new = 0;
+  uint32_t last = 0;
+  for (size_t i = 0; i < num_corners; ++i) {
+    uint32_t index = indices[i];
+    if (index == next_new) {
+      encoder.EncodeInteger(index_model, 0);
+      next_new++;
+    } else {
+      encoder.EncodeInteger(index_model, ZigZag(index - last) + 1);
+    }
+    last = index;
+  }
+
+  // Attributes: deltas from the previous vertex
+  std::vector<IntegerModel> attribute_models(stride);
+  std::vector<uint32_t> previous(stride, 0);
+  for (size_t i = 0; i < unique_corners.size(); ++i) {
+    const uint32_t* values = &corners[unique_corners[i] * stride];
+    for (size_t c = 0; c < stride; ++c) {
+      encoder.EncodeInteger(attribute_models[c],
+                            ZigZag(values[c] - previous[c]));
+      previous[c] = values[c];
+    }
+  }
+  encoder.Flush();
+}
+
+bool Decode(const std::string& payload, size_t stride, uint64_t num_corners,
+            std::vector<uint32_t>& corners) {
+  size_t pos = 0;
+  uint64_t num_vertices = 0;
+  if (stride == 0 || !ReadVarint(payload, pos, num_vertices) ||
+      num_vertices > num_corners)
+    return false;
+
+  CRangeDecoder decoder(payload, pos);
+
+  // Connectivity
+  IntegerModel index_model;
+  std::vector<uint32_t> indices;
+  uint32_t next_new = 0;
+  uint32_t last = 0;
+  for (uint64_t i = 0; i < num_corners; ++i) {
+    uint32_t code = 0;
+    if (!decoder.DecodeInteger(index_model, code))
+      return false;
+    uint32_t index = code == 0 ? next_new : last + UnZigZag(code - 1);
+    if (index > next_new || index >= num_vertices)
+      return false;
+    if (index == next_new)
+      next_new++;
+    indices.push_back(index);
+    last = index;
+  }
+
+  // Attributes
+  std::vector<IntegerModel> attribute_models(stride);
+  std::vector<uint32_t> vertices;
+  std::vector<uint32_t> previous(stride, 0);
+  for (uint64_t i = 0; i < num_vertices; ++i) {
+    for (size_t c = 0; c < stride; ++c) {
+      uint32_t code = 0;
+      if (!decoder.DecodeInteger(attribute_models[c], code))
+        return false;
+      previous[c] += UnZigZag(code);
+      vertices.push_back(previous[c]);
+    }
+  }
+
+  corners.clear();
+  corners.reserve(indices.size() * stride);
+  for (size_t i = 0; i < indices.size(); ++i) {
+    const uint32_t* values = &vertices[indices[i] * stride];
+    corners.insert(corners.end(), values, values + stride);
+  }
+  return true;
+}
+
+} // end namespace XmlMeshCompression
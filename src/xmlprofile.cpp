@@ -0,0 +1,195 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+
+#include "xmlprofile.h"
+#include "tinyxml2.h"
+
+static const char* kReportExtension = ".profile";
+static const char* kCompDefsTag = "ComponentDefinitions";
+static const char* kCompDefTag = "ComponentDefinition";
+static const char* kNameTag = "Name";
+
+namespace {
+
+// An XMLPrinter that records the profile while the document is written
+class CProfilePrinter : public tinyxml2::XMLPrinter {
+ public:
+  CProfilePrinter(FILE* fp, CXmlProfile* profile)
+    : tinyxml2::XMLPrinter(fp), profile_(profile) {}
+
+  virtual bool VisitEnter(const tinyxml2::XMLElement& element,
+                          const tinyxml2::XMLAttribute* attribute) {
+    // The '>' of the parent belongs to the parent, not to this element
+    SealElementIfJustOpened();
+    profile_->BeginElement(element, BytesWritten());
+    return tinyxml2::XMLPrinter::VisitEnter(element, attribute);
+  }
+
+  virtual bool VisitExit(const tinyxml2::XMLElement& element) {
+    bool ok = tinyxml2::XMLPrinter::VisitExit(element);
+    profile_->EndElement(BytesWritten());
+    return ok;
+  }
+
+ private:
+  CXmlProfile* profile_;
+};
+
+typedef std::pair<std::string, XmlProfileCounts> NamedCounts;
+
+bool MoreBytes(const NamedCounts& a, const NamedCounts& b) {
+  if (a.second.bytes_ != b.second.bytes_)
+    return a.second.bytes_ > b.second.bytes_;
+  return a.first < b.first;
+}
+
+void Add(const XmlProfileCounts& counts, XmlProfileCounts& sum) {
+  sum.bytes_ += counts.bytes_;
+  sum.elements_ += counts.elements_;
+  sum.attributes_ += counts.attributes_;
+}
+
+void GetSorted(const XmlProfileCountsMap& counts,
+               std::vector<NamedCounts>& sorted) {
+  sorted.assign(counts.begin(), counts.end());
+  std::sort(sorted.begin(), sorted.end(), MoreBytes);
+}
+
+void WriteTable(FILE* fp, const char* title,
+                const std::vector<NamedCounts>& rows, uint64_t total_bytes) {
+  fprintf(fp, "\n%s\n", title);
+  fprintf(fp, "  %-32s %14s %7s %12s %12s\n", "", "bytes", "%", "elements",
+          "attributes");
+  for (size_t i = 0; i < rows.size(); ++i) {
+    const XmlProfileCounts& counts = rows[i].second;
+    double percent = total_bytes > 0 ?
+        100.0 * counts.bytes_ / total_bytes : 0.0;
+    fprintf(fp, "  %-32s %14llu %6.2f%% %12llu %12llu\n",
+            rows[i].first.c_str(),
+            static_cast<unsigned long long>(counts.bytes_), percent,
+            static_cast<unsigned long long>(counts.elements_),
+            static_cast<unsigned long long>(counts.attributes_));
+  }
+}
+
+} // namespace
+
+//------------------------------------------------------------------------------
+
+std::string CXmlProfile::GetReportFilename(const std::string& xml_filename) {
+  return xml_filename + kReportExtension;
+}
+
+bool CXmlProfile::PrintDocument(const tinyxml2::XMLDocument& doc, FILE* fp) {
+  Clear();
+  CProfilePrinter printer(fp, this);
+  doc.Accept(&printer);
+  EndDocument(printer.BytesWritten());
+  return ferror(fp) == 0;
+}
+
+void CXmlProfile::Clear() {
+  open_elements_.clear();
+  tags_.clear();
+  sections_.clear();
+  definitions_.clear();
+  total_ = XmlProfileCounts();
+}
+
+void CXmlProfile::BeginElement(const tinyxml2::XMLElement& element,
+                               uint64_t offset) {
+  OpenElement open;
+  open.tag_ = element.Name();
+  // Instances also contain a ComponentDefinition tag but never at this depth
+  open.is_definition_ = open_elements_.size() == 1 &&
+                        open_elements_[0].tag_ == kCompDefsTag &&
+                        open.tag_ == kCompDefTag;
+  if (open.is_definition_) {
+    const char* name = element.Attribute(kNameTag);
+    open.definition_name_ = name != NULL ? name : "";
+  }
+  open.offset_ = offset;
+  open.child_bytes_ = 0;
+  open.own_attributes_ = 0;
+  for (const tinyxml2::XMLAttribute* attribute = element.FirstAttribute();
+       attribute != NULL; attribute = attribute->Next()) {
+    open.own_attributes_++;
+  }
+  open.elements_ = 1;
+  open.attributes_ = open.own_attributes_;
+  open_elements_.push_back(open);
+}
+
+void CXmlProfile::EndElement(uint64_t offset) {
+  if (open_elements_.empty())
+    return;
+  OpenElement open = open_elements_.back();
+  open_elements_.pop_back();
+
+  uint64_t bytes = offset - open.offset_;
+  XmlProfileCounts& tag = tags_[open.tag_];
+  tag.bytes_ += bytes - open.child_bytes_;
+  tag.elements_++;
+  tag.attributes_ += open.own_attributes_;
+
+  XmlProfileCounts counts;
+  counts.bytes_ = bytes;
+  counts.elements_ = open.elements_;
+  counts.attributes_ = open.attributes_;
+  if (open.is_definition_)
+    Add(counts, definitions_[open.definition_name_]);
+
+  if (open_elements_.empty()) {
+    Add(counts, sections_[open.tag_]);
+  } else {
+    OpenElement& parent = open_elements_.back();
+    parent.child_bytes_ += bytes;
+    parent.elements_ += open.elements_;
+    parent.attributes_ += open.attributes_;
+  }
+}
+
+void CXmlProfile::EndDocument(uint64_t offset) {
+  total_ = XmlProfileCounts();
+  for (XmlProfileCountsMap::const_iterator it = sections_.begin();
+       it != sections_.end(); ++it) {
+    Add(it->second, total_);
+  }
+  // Blank lines between the sections and the like
+  total_.bytes_ = offset;
+}
+
+void CXmlProfile::GetTopDefinitions(size_t count,
+                                    std::vector<NamedCounts>& top) const {
+  GetSorted(definitions_, top);
+  if (top.size() > count)
+    top.resize(count);
+}
+
+bool CXmlProfile::WriteReport(const std::string& filename,
+                              size_t top_definitions) const {
+  FILE* fp = fopen(filename.c_str(), "w");
+  if (fp == NULL)
+    return false;
+
+  fprintf(fp, "Total: %llu bytes, %llu elements, %llu attributes\n",
+          static_cast<unsigned long long>(total_.bytes_),
+          static_cast<unsigned long long>(total_.elements_),
+          static_cast<unsigned long long>(total_.attributes_));
+
+  std::vector<NamedCounts> rows;
+  GetSorted(tags_, rows);
+  WriteTable(fp, "By tag, without child elements:", rows, total_.bytes_);
+  GetSorted(sections_, rows);
+  WriteTable(fp, "By section:", rows, total_.bytes_);
+
+  GetTopDefinitions(top_definitions, rows);
+  char title[64];
+  snprintf(title, sizeof(title), "Top %llu of %llu definitions:",
+           static_cast<unsigned long long>(rows.size()),
+           static_cast<unsigned long long>(definitions_.size()));
+  WriteTable(fp, title, rows, total_.bytes_);
+
+  return fclose(fp) == 0;
+}
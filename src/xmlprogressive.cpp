@@ -0,0 +1,250 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+#include <set>
+
+#include "xmlprogressive.h"
+
+using namespace XmlGeomUtils;
+
+// Cells along the longest side of a definition when clustering its vertices
+static const int kClusterCells = 16;
+
+//------------------------------------------------------------------------------
+
+void CXmlCoarseBuilder::SimplifyMesh(const std::vector<CPoint3d>& triangles,
+                                     const CBoundingBox3d& bounds,
+                                     int num_cells, XmlCoarseMeshInfo& mesh) {
+  if (triangles.empty() || bounds.IsEmpty() || num_cells <= 0)
+    return;
+  CVector3d extent = bounds.max() - bounds.min();
+  double max_extent = std::max(extent.x(), std::max(extent.y(), extent.z()));
+  if (max_extent <= 0.0)
+    return;
+  double cell_size = max_extent / num_cells;
+
+  // Cluster of each vertex
+  std::map<uint64_t, uint32_t> cluster_index;
+  std::vector<CPoint3d> sums;
+  std::vector<uint32_t> counts;
+  std::vector<uint32_t> clusters(triangles.size());
+  for (size_t i = 0; i < triangles.size(); ++i) {
+    const CPoint3d& pt = triangles[i];
+    uint64_t ix = static_cast<uint64_t>((pt.x() - bounds.min().x()) / cell_size);
+    uint64_t iy = static_cast<uint64_t>((pt.y() - bounds.min().y()) / cell_size);
+    uint64_t iz = static_cast<uint64_t>((pt.z() - bounds.min().z()) / cell_size);
+    uint64_t key = (ix * (num_cells + 1) + iy) * (num_cells + 1) + iz;
+    std::map<uint64_t, uint32_t>::iterator it = cluster_index.find(key);
+    if (it == cluster_index.end()) {
+      uint32_t index = static_cast<uint32_t>(sums.size());
+      it = cluster_index.insert(std::make_pair(key, index)).first;
+      sums.push_back(CPoint3d());
+      counts.push_back(0);
+    }
+    sums[it->second] = sums[it->second] + pt;
+    counts[it->second]++;
+    clusters[i] = it->second;
+  }
+
+  // Keep each triangle that still spans three clusters, once
+  std::set<std::vector<uint32_t> > kept;
+  std::vector<uint32_t> point_index(sums.size(), 0xffffffff);
+  for (size_t i = 0; i + 2 < clusters.size(); i += 3) {
+    uint32_t c0 = clusters[i], c1 = clusters[i + 1], c2 = clusters[i + 2];
+    if (c0 == c1 || c1 == c2 || c0 == c2)
+      continue;
+    std::vector<uint32_t> key(&clusters[i], &clusters[i] + 3);
+    std::sort(key.begin(), key.end());
+    if (!kept.insert(key).second)
+      continue;
+    for (int j = 0; j < 3; ++j) {
+      uint32_t c = clusters[i + j];
+      if (point_index[c] == 0xffffffff) {
+        point_index[c] = static_cast<uint32_t>(mesh.points_.size());
+        mesh.points_.push_back(sums[c] / counts[c]);
+      }
+      mesh.indices_.push_back(point_index[c]);
+    }
+  }
+}
+
+void CXmlCoarseBuilder::BeginScope(bool is_group, bool is_geometry,
+                                   const std::string& name) {
+  Scope scope;
+  scope.is_group_ = is_group;
+  scope.is_geometry_ = is_geometry;
+  scope.name_ = name;
+  scope.transform_ = GetIdentityTransform();
+  scopes_.push_back(scope);
+}
+
+void CXmlCoarseBuilder::BeginDefinition(const std::string& name) {
+  BeginScope(false, false, name);
+}
+
+void CXmlCoarseBuilder::BeginGeometry() {
+  BeginScope(false, true, std::string());
+}
+
+void CXmlCoarseBuilder::BeginGroup() {
+  BeginScope(true, false, std::string());
+}
+
+void CXmlCoarseBuilder::EndScope() {
+  if (scopes_.empty())
+    return;
+  Scope scope;
+  std::swap(scope, scopes_.back());
+  scopes_.pop_back();
+
+  if (scope.is_group_) {
+    if (scopes_.empty())
+      return;
+    Scope& parent = scopes_.back();
+    const SUTransformation& transform = scope.transform_;
+
+    // Move the group contents into the parent's coordinates
+    for (size_t i = 0; i < scope.triangles_.size(); ++i) {
+      parent.triangles_.push_back(TransformPoint(transform,
+                                                 scope.triangles_[i]));
+    }
+    parent.bounds_.Add(TransformBoundingBox(transform, scope.bounds_));
+    for (size_t i = 0; i < scope.instances_.size(); ++i) {
+      Instance instance = scope.instances_[i];
+      instance.transform_ = MultiplyTransforms(transform, instance.transform_);
+      parent.instances_.push_back(instance);
+    }
+
+    Group group;
+    group.bounds_ = scope.bounds_;
+    group.instances_.swap(scope.instances_);
+    group.transform_ = transform;
+    parent.groups_.push_back(group);
+    return;
+  }
+
+  Definition definition;
+  definition.bounds_ = scope.bounds_;
+  SimplifyMesh(scope.triangles_, scope.bounds_, kClusterCells,
+               definition.mesh_);
+  definition.instances_.swap(scope.instances_);
+  definition.groups_.swap(scope.groups_);
+  if (scope.is_geometry_) {
+    geometry_ = definition;
+  } else {
+    if (definitions_.find(scope.name_) == definitions_.end())
+      definition_order_.push_back(scope.name_);
+    definitions_[scope.name_] = definition;
+  }
+}
+
+void CXmlCoarseBuilder::AddTriangle(const CPoint3d& pt1, const CPoint3d& pt2,
+                                    const CPoint3d& pt3) {
+  if (scopes_.empty())
+    return;
+  Scope& scope = scopes_.back();
+  scope.triangles_.push_back(pt1);
+  scope.triangles_.push_back(pt2);
+  scope.triangles_.push_back(pt3);
+  scope.bounds_.Add(pt1);
+  scope.bounds_.Add(pt2);
+  scope.bounds_.Add(pt3);
+}
+
+void CXmlCoarseBuilder::AddPoint(const CPoint3d& pt) {
+  if (!scopes_.empty())
+    scopes_.back().bounds_.Add(pt);
+}
+
+void CXmlCoarseBuilder::AddInstance(const std::string& definition_name,
+                                    const SUTransformation& transform) {
+  if (scopes_.empty())
+    return;
+  Instance instance;
+  instance.definition_name_ = definition_name;
+  instance.transform_ = transform;
+  scopes_.back().instances_.push_back(instance);
+}
+
+void CXmlCoarseBuilder::SetGroupTransform(const SUTransformation& transform) {
+  if (!scopes_.empty() && scopes_.back().is_group_)
+    scopes_.back().transform_ = transform;
+}
+
+CBoundingBox3d CXmlCoarseBuilder::GetDefinitionBounds(
+    const std::string& name,
+    std::map<std::string, CBoundingBox3d>& resolved) const {
+  std::map<std::string, CBoundingBox3d>::const_iterator found =
+      resolved.find(name);
+  if (found != resolved.end())
+    return found->second;
+
+  std::map<std::string, Definition>::const_iterator it =
+      definitions_.find(name);
+  if (it == definitions_.end())
+    return CBoundingBox3d();
+
+  // An empty entry guards against definitions that contain themselves
+  resolved[name] = CBoundingBox3d();
+  CBoundingBox3d bounds = it->second.bounds_;
+  for (size_t i = 0; i < it->second.instances_.size(); ++i) {
+    bounds.Add(GetInstanceBounds(it->second.instances_[i], resolved));
+  }
+  resolved[name] = bounds;
+  return bounds;
+}
+
+CBoundingBox3d CXmlCoarseBuilder::GetInstanceBounds(
+    const Instance& instance,
+    std::map<std::string, CBoundingBox3d>& resolved) const {
+  return TransformBoundingBox(
+      instance.transform_,
+      GetDefinitionBounds(instance.definition_name_, resolved));
+}
+
+void CXmlCoarseBuilder::GetDefinitionInfo(
+    const Definition& definition,
+    std::map<std::string, CBoundingBox3d>& resolved,
+    XmlCoarseDefinitionInfo& info) const {
+  info.bounds_ = definition.bounds_;
+  info.mesh_ = definition.mesh_;
+  for (size_t i = 0; i < definition.instances_.size(); ++i) {
+    const Instance& instance = definition.instances_[i];
+    XmlCoarseInstanceInfo instance_info;
+    instance_info.definition_name_ = instance.definition_name_;
+    instance_info.transform_ = instance.transform_;
+    instance_info.bounds_ = GetInstanceBounds(instance, resolved);
+    info.bounds_.Add(instance_info.bounds_);
+    info.instances_.push_back(instance_info);
+  }
+  for (size_t i = 0; i < definition.groups_.size(); ++i) {
+    const Group& group = definition.groups_[i];
+    CBoundingBox3d bounds = group.bounds_;
+    for (size_t j = 0; j < group.instances_.size(); ++j) {
+      bounds.Add(GetInstanceBounds(group.instances_[j], resolved));
+    }
+    info.group_bounds_.push_back(TransformBoundingBox(group.transform_,
+                                                      bounds));
+  }
+}
+
+void CXmlCoarseBuilder::GetCoarseModel(XmlCoarseModelInfo& info) const {
+  info = XmlCoarseModelInfo();
+  std::map<std::string, CBoundingBox3d> resolved;
+  for (size_t i = 0; i < definition_order_.size(); ++i) {
+    const std::string& name = definition_order_[i];
+    XmlCoarseDefinitionInfo definition_info;
+    definition_info.name_ = name;
+    GetDefinitionInfo(definitions_.find(name)->second, resolved,
+                      definition_info);
+    info.definitions_.push_back(definition_info);
+  }
+  GetDefinitionInfo(geometry_, resolved, info.geometry_);
+}
+
+void CXmlCoarseBuilder::Clear() {
+  scopes_.clear();
+  definitions_.clear();
+  definition_order_.clear();
+  geometry_ = Definition();
+}
@@ -0,0 +1,384 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "xmlpullparser.h"
+
+static bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void AppendUtf8(unsigned long code, std::string& text) {
+  if (code < 0x80) {
+    text += static_cast<char>(code);
+  } else if (code < 0x800) {
+    text += static_cast<char>(0xC0 | (code >> 6));
+    text += static_cast<char>(0x80 | (code & 0x3F));
+  } else if (code < 0x10000) {
+    text += static_cast<char>(0xE0 | (code >> 12));
+    text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    text += static_cast<char>(0x80 | (code & 0x3F));
+  } else {
+    text += static_cast<char>(0xF0 | (code >> 18));
+    text += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+    text += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+    text += static_cast<char>(0x80 | (code & 0x3F));
+  }
+}
+
+//------------------------------------------------------------------------------
+
+CXmlPullParser::CXmlPullParser(size_t block_size)
+  : fp_(NULL),
+    block_size_(block_size > 0 ? block_size : 1),
+    max_depth_(kMaxDepth),
+    pos_(0),
+    end_(0),
+    keep_(0),
+    pinned_(false),
+    eof_(false),
+    type_(XmlPullEventType_Start),
+    depth_(0),
+    num_attributes_(0),
+    tag_start_(0),
+    pending_end_(false),
+    at_end_(false),
+    error_(false) {
+}
+
+CXmlPullParser::~CXmlPullParser() {
+  Close();
+}
+
+bool CXmlPullParser::Open(const std::string& filename) {
+  Close();
+  fp_ = fopen(filename.c_str(), "rb");
+  return fp_ != NULL;
+}
+
+void CXmlPullParser::Close() {
+  if (fp_ != NULL)
+    fclose(fp_);
+  fp_ = NULL;
+  buffer_.clear();
+  pos_ = end_ = keep_ = tag_start_ = 0;
+  pinned_ = eof_ = pending_end_ = at_end_ = error_ = false;
+  open_elements_.clear();
+  num_attributes_ = 0;
+  depth_ = 0;
+}
+
+const char* CXmlPullParser::Attribute(const char* name) const {
+  for (size_t i = 0; i < num_attributes_; ++i) {
+    if (attributes_[i].first == name)
+      return attributes_[i].second.c_str();
+  }
+  return NULL;
+}
+
+bool CXmlPullParser::Fill(size_t count) {
+  while (end_ - pos_ < count) {
+    if (eof_ || fp_ == NULL)
+      return false;
+
+    // Drop the bytes before the first one still needed
+    size_t keep = std::min(keep_, pos_);
+    if (keep > 0) {
+      memmove(&buffer_[0], &buffer_[keep], end_ - keep);
+      pos_ -= keep;
+      end_ -= keep;
+      keep_ -= keep;
+      tag_start_ = tag_start_ >= keep ? tag_start_ - keep : 0;
+    }
+    if (buffer_.size() - end_ < block_size_)
+      buffer_.resize(end_ + block_size_);
+
+    size_t read = fread(&buffer_[end_], 1, block_size_, fp_);
+    end_ += read;
+    if (read < block_size_) {
+      eof_ = true;
+      if (ferror(fp_))
+        error_ = true;
+    }
+  }
+  return true;
+}
+
+void CXmlPullParser::SkipSpace() {
+  while (Fill(1) && IsSpace(buffer_[pos_]))
+    ++pos_;
+}
+
+bool CXmlPullParser::ParseName(std::string& name) {
+  name.clear();
+  while (Fill(1)) {
+    char c = buffer_[pos_];
+    if (IsSpace(c) || c == '/' || c == '>' || c == '=')
+      return !name.empty();
+    name += c;
+    ++pos_;
+  }
+  return false;
+}
+
+bool CXmlPullParser::SkipUntil(const char* terminator) {
+  size_t length = strlen(terminator);
+  for (;;) {
+    if (!Fill(length))
+      return false;
+    const char* begin = &buffer_[pos_];
+    const char* end = &buffer_[0] + end_;
+    const char* found = std::search(begin, end, terminator,
+                                    terminator + length);
+    if (found != end) {
+      pos_ += (found - begin) + length;
+      return true;
+    }
+    // The terminator may straddle the next block
+    pos_ = end_ - (length - 1);
+    if (!Fill(length))
+      return false;
+  }
+}
+
+bool CXmlPullParser::SkipMarkup() {
+  // At "<!" or "<?"
+  if (!Fill(2))
+    return false;
+  if (buffer_[pos_ + 1] == '?')
+    return SkipUntil("?>");
+  if (Fill(4) && memcmp(&buffer_[pos_], "<!--", 4) == 0)
+    return SkipUntil("-->");
+  if (Fill(9) && memcmp(&buffer_[pos_], "<![CDATA[", 9) == 0)
+    return SkipUntil("]]>");
+  return SkipUntil(">");
+}
+
+bool CXmlPullParser::ParseStartTag() {
+  ++pos_;  // '<'
+  if (!ParseName(name_))
+    return false;
+
+  num_attributes_ = 0;
+  std::string raw_value;
+  bool is_empty = false;
+  for (;;) {
+    SkipSpace();
+    if (!Fill(1))
+      return false;
+    char c = buffer_[pos_];
+    if (c == '>') {
+      ++pos_;
+      break;
+    }
+    if (c == '/') {
+      if (!Fill(2) || buffer_[pos_ + 1] != '>')
+        return false;
+      pos_ += 2;
+      is_empty = true;
+      break;
+    }
+
+    if (num_attributes_ == attributes_.size())
+      attributes_.push_back(std::pair<std::string, std::string>());
+    std::pair<std::string, std::string>& attribute =
+        attributes_[num_attributes_];
+    if (!ParseName(attribute.first))
+      return false;
+    SkipSpace();
+    if (!Fill(1) || buffer_[pos_] != '=')
+      return false;
+    ++pos_;
+    SkipSpace();
+    if (!Fill(1))
+      return false;
+    char quote = buffer_[pos_];
+    if (quote != '"' && quote != '\'')
+      return false;
+    ++pos_;
+    raw_value.clear();
+    for (;;) {
+      if (!Fill(1))
+        return false;
+      const char* begin = &buffer_[pos_];
+      const char* found = static_cast<const char*>(
+          memchr(begin, quote, end_ - pos_));
+      if (found != NULL) {
+        raw_value.append(begin, found - begin);
+        pos_ += (found - begin) + 1;
+        break;
+      }
+      raw_value.append(begin, end_ - pos_);
+      pos_ = end_;
+    }
+    Unescape(raw_value, attribute.second);
+    ++num_attributes_;
+  }
+
+  type_ = XmlPullEventType_Start;
+  depth_ = static_cast<int>(open_elements_.size());
+  if (is_empty) {
+    pending_end_ = true;
+  } else {
+    if (depth_ + 1 > max_depth_)
+      return false;
+    open_elements_.push_back(name_);
+  }
+  return true;
+}
+
+bool CXmlPullParser::ParseEndTag() {
+  pos_ += 2;  // "</"
+  if (!ParseName(name_))
+    return false;
+  SkipSpace();
+  if (!Fill(1) || buffer_[pos_] != '>')
+    return false;
+  ++pos_;
+  if (open_elements_.empty() || open_elements_.back() != name_)
+    return false;
+  open_elements_.pop_back();
+  type_ = XmlPullEventType_End;
+  depth_ = static_cast<int>(open_elements_.size());
+  num_attributes_ = 0;
+  return true;
+}
+
+bool CXmlPullParser::ParseTag() {
+  if (!Fill(2))
+    return false;
+  char c = buffer_[pos_ + 1];
+  if (c == '/')
+    return ParseEndTag();
+  return ParseStartTag();
+}
+
+bool CXmlPullParser::Next() {
+  if (error_ || at_end_ || fp_ == NULL)
+    return false;
+  if (pending_end_) {
+    // Second event of an empty element tag
+    pending_end_ = false;
+    type_ = XmlPullEventType_End;
+    num_attributes_ = 0;
+    return true;
+  }
+
+  for (;;) {
+    // Skip the text up to the next tag
+    for (;;) {
+      if (!pinned_)
+        keep_ = pos_;
+      if (!Fill(1)) {
+        if (open_elements_.empty() && !error_)
+          at_end_ = true;
+        else
+          error_ = true;
+        return false;
+      }
+      const char* begin = &buffer_[pos_];
+      const char* found = static_cast<const char*>(
+          memchr(begin, '<', end_ - pos_));
+      if (found != NULL) {
+        pos_ += found - begin;
+        break;
+      }
+      pos_ = end_;
+    }
+
+    tag_start_ = pos_;
+    if (!pinned_)
+      keep_ = pos_;
+    if (!Fill(2)) {
+      error_ = true;
+      return false;
+    }
+    char c = buffer_[pos_ + 1];
+    if (c == '!' || c == '?') {
+      if (!SkipMarkup()) {
+        error_ = true;
+        return false;
+      }
+      continue;
+    }
+    if (!ParseTag()) {
+      error_ = true;
+      return false;
+    }
+    return true;
+  }
+}
+
+bool CXmlPullParser::SkipToElementEnd() {
+  if (type_ != XmlPullEventType_Start)
+    return false;
+  if (pending_end_) {
+    pending_end_ = false;
+    return true;
+  }
+  int depth = depth_;
+  while (Next()) {
+    if (type_ == XmlPullEventType_End && depth_ == depth)
+      return true;
+  }
+  return false;
+}
+
+bool CXmlPullParser::ReadElement(const char*& text, size_t& length) {
+  if (type_ != XmlPullEventType_Start)
+    return false;
+  pinned_ = true;
+  keep_ = tag_start_;
+  bool ok = SkipToElementEnd();
+  pinned_ = false;
+  if (!ok)
+    return false;
+  text = &buffer_[keep_];
+  length = pos_ - keep_;
+  return true;
+}
+
+bool CXmlPullParser::SkipElement() {
+  return SkipToElementEnd();
+}
+
+void CXmlPullParser::Unescape(const std::string& text, std::string& value) {
+  value.clear();
+  size_t i = 0;
+  while (i < text.size()) {
+    size_t amp = text.find('&', i);
+    if (amp == std::string::npos) {
+      value.append(text, i, std::string::npos);
+      break;
+    }
+    value.append(text, i, amp - i);
+    size_t semicolon = text.find(';', amp);
+    if (semicolon == std::string::npos) {
+      value.append(text, amp, std::string::npos);
+      break;
+    }
+    std::string entity = text.substr(amp + 1, semicolon - amp - 1);
+    if (entity == "amp") {
+      value += '&';
+    } else if (entity == "lt") {
+      value += '<';
+    } else if (entity == "gt") {
+      value += '>';
+    } else if (entity == "quot") {
+      value += '"';
+    } else if (entity == "apos") {
+      value += '\'';
+    } else if (entity.size() > 1 && entity[0] == '#') {
+      bool hex = entity[1] == 'x' || entity[1] == 'X';
+      unsigned long code = strtoul(entity.c_str() + (hex ? 2 : 1), NULL,
+                                   hex ? 16 : 10);
+      AppendUtf8(code, value);
+    } else {
+      // Unknown entities are kept as they are, like tinyxml2 does
+      value.append(text, amp, semicolon - amp + 1);
+    }
+    i = semicolon + 1;
+  }
+}
@@ -0,0 +1,145 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <cmath>
+
+#include "xmlquantization.h"
+
+using namespace XmlGeomUtils;
+
+namespace XmlQuantization {
+
+static const char kBase64Chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static double Clamp(double value, double min, double max) {
+  return value < min ? min : (value > max ? max : value);
+}
+
+static double Sign(double value) {
+  return value < 0.0 ? -1.0 : 1.0;
+}
+
+double GetPositionStep(double extent, double tolerance) {
+  double step = extent / kMaxPosition;
+  return step > tolerance ? step : tolerance;
+}
+
+uint32_t QuantizePosition(double value, double origin, double step) {
+  if (step <= 0.0)
+    return 0;
+  double q = floor((value - origin) / step + 0.5);
+  return static_cast<uint32_t>(Clamp(q, 0.0, kMaxPosition));
+}
+
+double DequantizePosition(uint32_t value, double origin, double step) {
+  return origin + value * step;
+}
+
+uint16_t QuantizeUnit(double value, double min, double max) {
+  if (max <= min)
+    return 0;
+  double q = floor((value - min) / (max - min) * kMaxUnit + 0.5);
+  return static_cast<uint16_t>(Clamp(q, 0.0, kMaxUnit));
+}
+
+double DequantizeUnit(uint16_t value, double min, double max) {
+  return min + (max - min) * value / kMaxUnit;
+}
+
+void EncodeNormal(const CVector3d& normal, uint16_t& u, uint16_t& v) {
+  // Project onto the octahedron, then fold the lower half over the upper
+  double sum = fabs(normal.x()) + fabs(normal.y()) + fabs(normal.z());
+  double x = 0.0, y = 0.0;
+  if (sum > 0.0) {
+    x = normal.x() / sum;
+    y = normal.y() / sum;
+    if (normal.z() < 0.0) {
+      double folded_x = (1.0 - fabs(y)) * Sign(x);
+      double folded_y = (1.0 - fabs(x)) * Sign(y);
+      x = folded_x;
+      y = folded_y;
+    }
+  }
+  u = QuantizeUnit(x, -1.0, 1.0);
+  v = QuantizeUnit(y, -1.0, 1.0);
+}
+
+CVector3d DecodeNormal(uint16_t u, uint16_t v) {
+  double x = DequantizeUnit(u, -1.0, 1.0);
+  double y = DequantizeUnit(v, -1.0, 1.0);
+  double z = 1.0 - fabs(x) - fabs(y);
+  if (z < 0.0) {
+    double unfolded_x = (1.0 - fabs(y)) * Sign(x);
+    double unfolded_y = (1.0 - fabs(x)) * Sign(y);
+    x = unfolded_x;
+    y = unfolded_y;
+  }
+  double length = sqrt(x * x + y * y + z * z);
+  if (length > 0.0) {
+    x /= length;
+    y /= length;
+    z /= length;
+  }
+  return CVector3d(x, y, z);
+}
+
+std::string EncodeBase64(const std::string& data) {
+  std::string text;
+  text.reserve((data.size() + 2) / 3 * 4);
+  size_t i = 0;
+  for (; i + 2 < data.size(); i += 3) {
+    uint32_t bits = (static_cast<unsigned char>(data[i]) << 16) |
+                    (static_cast<unsigned char>(data[i + 1]) << 8) |
+                    static_cast<unsigned char>(data[i + 2]);
+    text += kBase64Chars[(bits >> 18) & 0x3f];
+    text += kBase64Chars[(bits >> 12) & 0x3f];
+    text += kBase64Chars[(bits >> 6) & 0x3f];
+    text += kBase64Chars[bits & 0x3f];
+  }
+  if (i < data.size()) {
+    uint32_t bits = static_cast<unsigned char>(data[i]) << 16;
+    if (i + 1 < data.size())
+      bits |= static_cast<unsigned char>(data[i + 1]) << 8;
+    text += kBase64Chars[(bits >> 18) & 0x3f];
+    text += kBase64Chars[(bits >> 12) & 0x3f];
+    text += i + 1 < data.size() ? kBase64Chars[(bits >> 6) & 0x3f] : '=';
+    text += '=';
+  }
+  return text;
+}
+
+static int GetBase64Value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+bool DecodeBase64(const char* text, std::string& data) {
+  data.clear();
+  if (text == NULL)
+    return true;
+  uint32_t bits = 0;
+  int num_bits = 0;
+  for (const char* p = text; *p != 0; ++p) {
+    char c = *p;
+    if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+      continue; // Line breaks and indentation
+    if (c == '=')
+      break;
+    int value = GetBase64Value(c);
+    if (value < 0)
+      return false;
+    bits = (bits << 6) | value;
+    num_bits += 6;
+    if (num_bits >= 8) {
+      num_bits -= 8;
+      data += static_cast<char>((bits >> num_bits) & 0xff);
+    }
+  }
+  return true;
+}
+
+} // end namespace XmlQuantization
@@ -0,0 +1,148 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <cstring>
+#include <utility>
+
+#include "xmlrender.h"
+
+//------------------------------------------------------------------------------
+
+void XmlRenderFace::Vertices::push_back(const XmlFaceVertex& vertex) {
+  // The materials come before the vertices
+  if (count_++ == 0 && !face_.has_single_loop_)
+    face_.builder_.BeginFace(face_.front_mat_name_);
+  if (!face_.has_single_loop_) {
+    face_.builder_.AddVertex(vertex, face_.has_normals_,
+                             face_.has_front_texture_);
+  }
+}
+
+//------------------------------------------------------------------------------
+
+size_t CXmlRenderBuilder::VertexHash::operator()(
+    const XmlRenderVertex& vertex) const {
+  // FNV-1a over the bytes, equal vertices are the same bytes
+  const unsigned char* bytes = reinterpret_cast<const unsigned char*>(&vertex);
+  uint64_t hash = 14695981039346656037ULL;
+  for (size_t i = 0; i < sizeof(vertex); ++i) {
+    hash ^= bytes[i];
+    hash *= 1099511628211ULL;
+  }
+  return static_cast<size_t>(hash);
+}
+
+bool CXmlRenderBuilder::VertexEqual::operator()(
+    const XmlRenderVertex& a, const XmlRenderVertex& b) const {
+  return memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+CXmlRenderBuilder::CXmlRenderBuilder(XmlRenderModel& model)
+  : model_(model),
+    batch_(NULL) {
+}
+
+void CXmlRenderBuilder::OnMaterial(XmlMaterialInfo& info) {
+  model_.materials_.push_back(std::move(info));
+}
+
+void CXmlRenderBuilder::BeginMesh(XmlRenderMeshType type,
+                                  const std::string& name) {
+  XmlRenderMesh mesh;
+  mesh.type_ = type;
+  mesh.definition_name_ = name;
+  mesh.transform_ = XmlGeomUtils::GetIdentityTransform();
+  if (type == XmlRenderMeshType_Group)
+    mesh.parent_ = meshes_.back().mesh_;
+  model_.meshes_.push_back(std::move(mesh));
+
+  OpenMesh open_mesh;
+  open_mesh.mesh_ = model_.meshes_.size() - 1;
+  meshes_.push_back(open_mesh);
+  batch_ = NULL;
+}
+
+void CXmlRenderBuilder::OnBeginComponentDefinition(const std::string& name) {
+  BeginMesh(XmlRenderMeshType_Definition, name);
+}
+
+void CXmlRenderBuilder::OnEndComponentDefinition() {
+  meshes_.pop_back();
+  batch_ = NULL;
+}
+
+void CXmlRenderBuilder::OnBeginGeometry() {
+  BeginMesh(XmlRenderMeshType_Geometry, std::string());
+}
+
+void CXmlRenderBuilder::OnEndGeometry() {
+  meshes_.pop_back();
+  batch_ = NULL;
+}
+
+void CXmlRenderBuilder::OnBeginGroup() {
+  BeginMesh(XmlRenderMeshType_Group, std::string());
+}
+
+void CXmlRenderBuilder::OnEndGroup(const SUTransformation& transform) {
+  model_.meshes_[meshes_.back().mesh_].transform_ = transform;
+  meshes_.pop_back();
+  batch_ = NULL;
+}
+
+void CXmlRenderBuilder::OnComponentInstance(XmlComponentInstanceInfo& info) {
+  XmlRenderInstance instance;
+  instance.definition_name_.swap(info.definition_name_);
+  instance.transform_ = info.transform_;
+  model_.meshes_[meshes_.back().mesh_].instances_.push_back(
+      std::move(instance));
+}
+
+void CXmlRenderBuilder::OnFace(XmlFaceInfo& info) {
+  if (info.has_single_loop_ || info.vertices_.empty())
+    return;
+  BeginFace(info.front_mat_name_);
+  for (size_t i = 0; i < info.vertices_.size(); ++i) {
+    AddVertex(info.vertices_[i], info.has_normals_, info.has_front_texture_);
+  }
+}
+
+void CXmlRenderBuilder::BeginFace(const std::string& material_name) {
+  face_vertices_.clear();
+  OpenMesh& open_mesh = meshes_.back();
+  XmlRenderMesh& mesh = model_.meshes_[open_mesh.mesh_];
+  std::map<std::string, size_t>::iterator it =
+      open_mesh.batches_.find(material_name);
+  if (it == open_mesh.batches_.end()) {
+    it = open_mesh.batches_.insert(
+        std::make_pair(material_name, mesh.batches_.size())).first;
+    mesh.batches_.push_back(XmlRenderBatch());
+    mesh.batches_.back().material_name_ = material_name;
+  }
+  batch_ = &mesh.batches_[it->second];
+}
+
+void CXmlRenderBuilder::AddVertex(const XmlFaceVertex& vertex,
+                                  bool has_normal, bool has_texture) {
+  XmlRenderVertex render_vertex;
+  memset(&render_vertex, 0, sizeof(render_vertex));
+  render_vertex.position_[0] = static_cast<float>(vertex.vertex_.x());
+  render_vertex.position_[1] = static_cast<float>(vertex.vertex_.y());
+  render_vertex.position_[2] = static_cast<float>(vertex.vertex_.z());
+  if (has_normal) {
+    render_vertex.normal_[0] = static_cast<float>(vertex.normal_.x());
+    render_vertex.normal_[1] = static_cast<float>(vertex.normal_.y());
+    render_vertex.normal_[2] = static_cast<float>(vertex.normal_.z());
+  }
+  if (has_texture) {
+    render_vertex.uv_[0] = static_cast<float>(vertex.front_texture_coord_.x());
+    render_vertex.uv_[1] = static_cast<float>(vertex.front_texture_coord_.y());
+  }
+
+  uint32_t index = static_cast<uint32_t>(batch_->vertices_.size());
+  std::pair<std::unordered_map<XmlRenderVertex, uint32_t, VertexHash,
+                               VertexEqual>::iterator, bool> inserted =
+      face_vertices_.insert(std::make_pair(render_vertex, index));
+  if (inserted.second)
+    batch_->vertices_.push_back(render_vertex);
+  batch_->indices_.push_back(inserted.first->second);
+}
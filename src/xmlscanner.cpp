@@ -0,0 +1,153 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include "xmlscanner.h"
+
+static const std::string kCommentStart("--");
+static const std::string kCDataStart("[CDATA[");
+
+static bool IsPrefix(const std::string& prefix, const std::string& text) {
+  return prefix.size() <= text.size() &&
+         text.compare(0, prefix.size(), prefix) == 0;
+}
+
+static bool IsSpace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+CXmlScanner::CXmlScanner(int max_depth) : max_depth_(max_depth) {
+  Reset();
+}
+
+void CXmlScanner::Reset() {
+  state_ = State_Text;
+  depth_ = 0;
+  offset_ = 0;
+  tag_offset_ = 0;
+  quote_ = 0;
+  previous_[0] = previous_[1] = 0;
+  markup_.clear();
+  pending_ = XmlScanEvent();
+}
+
+bool CXmlScanner::Scan(const char* data, size_t length,
+                       std::vector<XmlScanEvent>& events) {
+  bool report = depth_ <= max_depth_;
+  for (size_t i = 0; i < length; ++i, ++offset_) {
+    char c = data[i];
+    switch (state_) {
+      case State_Text:
+        if (c == '<') {
+          state_ = State_TagOpen;
+          tag_offset_ = offset_;
+        }
+        break;
+
+      case State_TagOpen:
+        if (c == '/') {
+          state_ = State_EndTag;
+        } else if (c == '?') {
+          state_ = State_Instruction;
+        } else if (c == '!') {
+          state_ = State_Markup;
+          markup_.clear();
+        } else {
+          state_ = State_StartTagName;
+          report = depth_ <= max_depth_;
+          if (report) {
+            pending_.type_ = XmlScanEventType_Start;
+            pending_.depth_ = depth_;
+            pending_.offset_ = tag_offset_;
+            pending_.name_.assign(1, c);
+          }
+        }
+        previous_[0] = previous_[1] = 0;
+        break;
+
+      case State_StartTagName:
+        if (!IsSpace(c) && c != '/' && c != '>') {
+          if (report)
+            pending_.name_ += c;
+          break;
+        }
+        state_ = State_StartTag;
+        // The character also belongs to the rest of the tag
+        // fall through
+
+      case State_StartTag:
+        if (quote_ != 0) {
+          if (c == quote_)
+            quote_ = 0;
+        } else if (c == '"' || c == '\'') {
+          quote_ = c;
+        } else if (c == '>') {
+          bool is_empty = previous_[1] == '/';
+          if (report)
+            events.push_back(pending_);
+          if (is_empty) {
+            if (report) {
+              XmlScanEvent end;
+              end.type_ = XmlScanEventType_End;
+              end.depth_ = depth_;
+              end.offset_ = offset_ + 1;
+              events.push_back(end);
+            }
+          } else {
+            depth_++;
+          }
+          state_ = State_Text;
+        }
+        break;
+
+      case State_EndTag:
+        if (c == '>') {
+          if (--depth_ < 0)
+            return false;
+          if (depth_ <= max_depth_) {
+            XmlScanEvent end;
+            end.type_ = XmlScanEventType_End;
+            end.depth_ = depth_;
+            end.offset_ = offset_ + 1;
+            events.push_back(end);
+          }
+          state_ = State_Text;
+        }
+        break;
+
+      case State_Markup:
+        markup_ += c;
+        if (markup_ == kCommentStart) {
+          state_ = State_Comment;
+        } else if (markup_ == kCDataStart) {
+          state_ = State_CData;
+        } else if (!IsPrefix(markup_, kCommentStart) &&
+                   !IsPrefix(markup_, kCDataStart)) {
+          state_ = c == '>' ? State_Text : State_Declaration;
+        }
+        c = 0; // Do not let the opening dashes close the comment
+        break;
+
+      case State_Comment:
+        if (c == '>' && previous_[0] == '-' && previous_[1] == '-')
+          state_ = State_Text;
+        break;
+
+      case State_CData:
+        if (c == '>' && previous_[0] == ']' && previous_[1] == ']')
+          state_ = State_Text;
+        break;
+
+      case State_Declaration:
+        if (c == '>')
+          state_ = State_Text;
+        break;
+
+      case State_Instruction:
+        if (c == '>' && previous_[1] == '?')
+          state_ = State_Text;
+        break;
+    }
+    previous_[0] = previous_[1];
+    previous_[1] = c;
+  }
+  return true;
+}
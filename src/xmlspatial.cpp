@@ -0,0 +1,1400 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <map>
+#include <thread>
+
+#include "xmlspatial.h"
+
+using namespace XmlGeomUtils;
+
+// Bins per axis when looking for the cheapest split
+static const int kNumBins = 16;
+// Cost of visiting a node, relative to testing a primitive
+static const double kTraversalCost = 1.0;
+// Ranges of at most this many primitives may become leaves, larger ones
+// are always split
+static const size_t kMaxLeafSize = 4;
+// Below this depth splits are balanced instead, which bounds the depth
+static const int kMaxSahDepth = 48;
+// Ranges this large are split across threads while building
+static const size_t kParallelBuildSize = 4096;
+// Slabs are widened by this factor, so rounding does not miss a box the
+// ray just touches
+static const double kSlabPadding = 1.0 + 4.0 * DBL_EPSILON;
+
+//------------------------------------------------------------------------------
+// Geometry
+
+static void GetCoords(const CPoint3d& pt, double* coords) {
+  coords[0] = pt.x();
+  coords[1] = pt.y();
+  coords[2] = pt.z();
+}
+
+static CVector3d Cross(const CVector3d& a, const CVector3d& b) {
+  return CVector3d(a.y() * b.z() - a.z() * b.y(),
+                   a.z() * b.x() - a.x() * b.z(),
+                   a.x() * b.y() - a.y() * b.x());
+}
+
+static double Dot(const CVector3d& a, const CVector3d& b) {
+  return a.x() * b.x() + a.y() * b.y() + a.z() * b.z();
+}
+
+static bool IsIdentity(const SUTransformation& transform) {
+  for (int i = 0; i < 16; ++i) {
+    if (transform.values[i] != ((i % 5 == 0) ? 1.0 : 0.0))
+      return false;
+  }
+  return true;
+}
+
+// Returns false if the transformation is singular
+static bool InvertTransform(const SUTransformation& transform,
+                            SUTransformation& inverse) {
+  const double* m = transform.values;
+  double* inv = inverse.values;
+  inv[0] = m[5] * m[10] * m[15] - m[5] * m[11] * m[14] - m[9] * m[6] * m[15] +
+           m[9] * m[7] * m[14] + m[13] * m[6] * m[11] - m[13] * m[7] * m[10];
+  inv[4] = -m[4] * m[10] * m[15] + m[4] * m[11] * m[14] +
+           m[8] * m[6] * m[15] - m[8] * m[7] * m[14] - m[12] * m[6] * m[11] +
+           m[12] * m[7] * m[10];
+  inv[8] = m[4] * m[9] * m[15] - m[4] * m[11] * m[13] - m[8] * m[5] * m[15] +
+           m[8] * m[7] * m[13] + m[12] * m[5] * m[11] - m[12] * m[7] * m[9];
+  inv[12] = -m[4] * m[9] * m[14] + m[4] * m[10] * m[13] +
+            m[8] * m[5] * m[14] - m[8] * m[6] * m[13] - m[12] * m[5] * m[10] +
+            m[12] * m[6] * m[9];
+  inv[1] = -m[1] * m[10] * m[15] + m[1] * m[11] * m[14] +
+           m[9] * m[2] * m[15] - m[9] * m[3] * m[14] - m[13] * m[2] * m[11] +
+           m[13] * m[3] * m[10];
+  inv[5] = m[0] * m[10] * m[15] - m[0] * m[11] * m[14] - m[8] * m[2] * m[15] +
+           m[8] * m[3] * m[14] + m[12] * m[2] * m[11] - m[12] * m[3] * m[10];
+  inv[9] = -m[0] * m[9] * m[15] + m[0] * m[11] * m[13] +
+           m[8] * m[1] * m[15] - m[8] * m[3] * m[13] - m[12] * m[1] * m[11] +
+           m[12] * m[3] * m[9];
+  inv[13] = m[0] * m[9] * m[14] - m[0] * m[10] * m[13] - m[8] * m[1] * m[14] +
+            m[8] * m[2] * m[13] + m[12] * m[1] * m[10] - m[12] * m[2] * m[9];
+  inv[2] = m[1] * m[6] * m[15] - m[1] * m[7] * m[14] - m[5] * m[2] * m[15] +
+           m[5] * m[3] * m[14] + m[13] * m[2] * m[7] - m[13] * m[3] * m[6];
+  inv[6] = -m[0] * m[6] * m[15] + m[0] * m[7] * m[14] +
+           m[4] * m[2] * m[15] - m[4] * m[3] * m[14] - m[12] * m[2] * m[7] +
+           m[12] * m[3] * m[6];
+  inv[10] = m[0] * m[5] * m[15] - m[0] * m[7] * m[13] - m[4] * m[1] * m[15] +
+            m[4] * m[3] * m[13] + m[12] * m[1] * m[7] - m[12] * m[3] * m[5];
+  inv[14] = -m[0] * m[5] * m[14] + m[0] * m[6] * m[13] +
+            m[4] * m[1] * m[14] - m[4] * m[2] * m[13] - m[12] * m[1] * m[6] +
+            m[12] * m[2] * m[5];
+  inv[3] = -m[1] * m[6] * m[11] + m[1] * m[7] * m[10] +
+           m[5] * m[2] * m[11] - m[5] * m[3] * m[10] - m[9] * m[2] * m[7] +
+           m[9] * m[3] * m[6];
+  inv[7] = m[0] * m[6] * m[11] - m[0] * m[7] * m[10] - m[4] * m[2] * m[11] +
+           m[4] * m[3] * m[10] + m[8] * m[2] * m[7] - m[8] * m[3] * m[6];
+  inv[11] = -m[0] * m[5] * m[11] + m[0] * m[7] * m[9] +
+            m[4] * m[1] * m[11] - m[4] * m[3] * m[9] - m[8] * m[1] * m[7] +
+            m[8] * m[3] * m[5];
+  inv[15] = m[0] * m[5] * m[10] - m[0] * m[6] * m[9] - m[4] * m[1] * m[10] +
+            m[4] * m[2] * m[9] + m[8] * m[1] * m[6] - m[8] * m[2] * m[5];
+
+  double det = m[0] * inv[0] + m[1] * inv[4] + m[2] * inv[8] + m[3] * inv[12];
+  if (det == 0.0 || !std::isfinite(det))
+    return false;
+  for (int i = 0; i < 16; ++i)
+    inv[i] /= det;
+  return true;
+}
+
+namespace {
+
+// A ray in the coordinates of an object
+struct LocalRay {
+  CPoint3d origin_;
+  CVector3d direction_;
+  double origin_coords_[3];
+  double direction_coords_[3];
+  double inverse_[3];
+};
+
+// A box in the coordinates of an object
+struct LocalBox {
+  double min_[3];
+  double max_[3];
+};
+
+} // namespace
+
+static LocalRay GetLocalRay(const SUTransformation& to_local,
+                            bool is_identity, const XmlSpatialRay& ray) {
+  LocalRay local;
+  if (is_identity) {
+    local.origin_ = ray.origin_;
+    local.direction_ = ray.direction_;
+  } else {
+    // The transformations are affine, so the distances along the ray stay
+    // the same
+    local.origin_ = TransformPoint(to_local, ray.origin_);
+    local.direction_ =
+        TransformPoint(to_local, ray.origin_ + ray.direction_) - local.origin_;
+  }
+  GetCoords(local.origin_, local.origin_coords_);
+  local.direction_coords_[0] = local.direction_.x();
+  local.direction_coords_[1] = local.direction_.y();
+  local.direction_coords_[2] = local.direction_.z();
+  for (int axis = 0; axis < 3; ++axis)
+    local.inverse_[axis] = 1.0 / local.direction_coords_[axis];
+  return local;
+}
+
+static LocalBox GetLocalBox(const CBoundingBox3d& box) {
+  LocalBox local;
+  GetCoords(box.min(), local.min_);
+  GetCoords(box.max(), local.max_);
+  return local;
+}
+
+// Distance along the ray at which it enters the box, if it does before
+// max_distance
+static bool IntersectRayBox(const LocalRay& ray, const double* box_min,
+                            const double* box_max, double max_distance,
+                            double& distance) {
+  double enter = 0.0;
+  double leave = max_distance;
+  for (int axis = 0; axis < 3; ++axis) {
+    double origin = ray.origin_coords_[axis];
+    if (ray.direction_coords_[axis] == 0.0) {
+      if (origin < box_min[axis] || origin > box_max[axis])
+        return false;
+      continue;
+    }
+    double slab_enter = (box_min[axis] - origin) * ray.inverse_[axis];
+    double slab_leave = (box_max[axis] - origin) * ray.inverse_[axis];
+    if (slab_enter > slab_leave)
+      std::swap(slab_enter, slab_leave);
+    enter = std::max(enter, slab_enter);
+    leave = std::min(leave, slab_leave * kSlabPadding);
+    if (enter > leave)
+      return false;
+  }
+  distance = enter;
+  return true;
+}
+
+// Both sides of the triangle are hit
+static bool IntersectRayTriangle(const LocalRay& ray,
+                                 const CPoint3d* vertices,
+                                 double max_distance, double& distance) {
+  CVector3d edge1 = vertices[1] - vertices[0];
+  CVector3d edge2 = vertices[2] - vertices[0];
+  CVector3d p = Cross(ray.direction_, edge2);
+  double det = Dot(edge1, p);
+  if (det == 0.0)
+    return false;
+  double inv_det = 1.0 / det;
+  CVector3d s = ray.origin_ - vertices[0];
+  double u = Dot(s, p) * inv_det;
+  if (u < 0.0 || u > 1.0)
+    return false;
+  CVector3d q = Cross(s, edge1);
+  double v = Dot(ray.direction_, q) * inv_det;
+  if (v < 0.0 || u + v > 1.0)
+    return false;
+  double t = Dot(edge2, q) * inv_det;
+  if (t < 0.0 || t > max_distance)
+    return false;
+  distance = t;
+  return true;
+}
+
+static bool BoxesOverlap(const double* min1, const double* max1,
+                         const double* min2, const double* max2) {
+  for (int axis = 0; axis < 3; ++axis) {
+    if (min1[axis] > max2[axis] || max1[axis] < min2[axis])
+      return false;
+  }
+  return true;
+}
+
+// Separating axis test of the triangle against the box
+static bool TriangleOverlapsBox(const CPoint3d* vertices,
+                                const double* box_min,
+                                const double* box_max) {
+  double half[3];
+  double v[3][3];
+  for (int axis = 0; axis < 3; ++axis) {
+    double center = (box_min[axis] + box_max[axis]) / 2.0;
+    half[axis] = (box_max[axis] - box_min[axis]) / 2.0;
+    double coords[3];
+    for (int i = 0; i < 3; ++i) {
+      GetCoords(vertices[i], coords);
+      v[i][axis] = coords[axis] - center;
+    }
+  }
+
+  // The box's face normals
+  for (int axis = 0; axis < 3; ++axis) {
+    double low = std::min(v[0][axis], std::min(v[1][axis], v[2][axis]));
+    double high = std::max(v[0][axis], std::max(v[1][axis], v[2][axis]));
+    if (low > half[axis] || high < -half[axis])
+      return false;
+  }
+
+  // The cross products of the box's edges and the triangle's edges
+  double edges[3][3];
+  for (int i = 0; i < 3; ++i) {
+    for (int axis = 0; axis < 3; ++axis)
+      edges[i][axis] = v[(i + 1) % 3][axis] - v[i][axis];
+  }
+  for (int i = 0; i < 3; ++i) {
+    const double* e = edges[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      double test_axis[3] = {0.0, 0.0, 0.0};
+      int a1 = (axis + 1) % 3;
+      int a2 = (axis + 2) % 3;
+      test_axis[a1] = -e[a2];
+      test_axis[a2] = e[a1];
+      double low = DBL_MAX;
+      double high = -DBL_MAX;
+      for (int k = 0; k < 3; ++k) {
+        double p = test_axis[0] * v[k][0] + test_axis[1] * v[k][1] +
+                   test_axis[2] * v[k][2];
+        low = std::min(low, p);
+        high = std::max(high, p);
+      }
+      double radius = half[0] * fabs(test_axis[0]) +
+                      half[1] * fabs(test_axis[1]) +
+                      half[2] * fabs(test_axis[2]);
+      if (low > radius || high < -radius)
+        return false;
+    }
+  }
+
+  // The triangle's normal
+  double n[3] = {
+    edges[0][1] * edges[1][2] - edges[0][2] * edges[1][1],
+    edges[0][2] * edges[1][0] - edges[0][0] * edges[1][2],
+    edges[0][0] * edges[1][1] - edges[0][1] * edges[1][0]
+  };
+  double d = n[0] * v[0][0] + n[1] * v[0][1] + n[2] * v[0][2];
+  double radius = half[0] * fabs(n[0]) + half[1] * fabs(n[1]) +
+                  half[2] * fabs(n[2]);
+  return fabs(d) <= radius;
+}
+
+static CPoint3d ClosestPointOnTriangle(const CPoint3d& p,
+                                       const CPoint3d* vertices) {
+  const CPoint3d& a = vertices[0];
+  const CPoint3d& b = vertices[1];
+  const CPoint3d& c = vertices[2];
+  CVector3d ab = b - a;
+  CVector3d ac = c - a;
+  CVector3d ap = p - a;
+  double d1 = Dot(ab, ap);
+  double d2 = Dot(ac, ap);
+  if (d1 <= 0.0 && d2 <= 0.0)
+    return a;
+
+  CVector3d bp = p - b;
+  double d3 = Dot(ab, bp);
+  double d4 = Dot(ac, bp);
+  if (d3 >= 0.0 && d4 <= d3)
+    return b;
+
+  double vc = d1 * d4 - d3 * d2;
+  if (vc <= 0.0 && d1 >= 0.0 && d3 <= 0.0)
+    return a + ab * (d1 / (d1 - d3));
+
+  CVector3d cp = p - c;
+  double d5 = Dot(ab, cp);
+  double d6 = Dot(ac, cp);
+  if (d6 >= 0.0 && d5 <= d6)
+    return c;
+
+  double vb = d5 * d2 - d1 * d6;
+  if (vb <= 0.0 && d2 >= 0.0 && d6 <= 0.0)
+    return a + ac * (d2 / (d2 - d6));
+
+  double va = d3 * d6 - d5 * d4;
+  if (va <= 0.0 && (d4 - d3) >= 0.0 && (d5 - d6) >= 0.0)
+    return b + (c - b) * ((d4 - d3) / ((d4 - d3) + (d5 - d6)));
+
+  double denom = va + vb + vc;
+  if (denom == 0.0) {
+    // Degenerate, closest of the corners
+    return a;
+  }
+  return a + ab * (vb / denom) + ac * (vc / denom);
+}
+
+static double GetDistanceSquared(const CPoint3d& a, const CPoint3d& b) {
+  CVector3d d = a - b;
+  return Dot(d, d);
+}
+
+static double GetBoxDistanceSquared(const CPoint3d& point,
+                                    const double* box_min,
+                                    const double* box_max) {
+  double coords[3];
+  GetCoords(point, coords);
+  double result = 0.0;
+  for (int axis = 0; axis < 3; ++axis) {
+    double d = 0.0;
+    if (coords[axis] < box_min[axis])
+      d = box_min[axis] - coords[axis];
+    else if (coords[axis] > box_max[axis])
+      d = coords[axis] - box_max[axis];
+    result += d * d;
+  }
+  return result;
+}
+
+static double GetHalfArea(const double* box_min, const double* box_max) {
+  double dx = box_max[0] - box_min[0];
+  double dy = box_max[1] - box_min[1];
+  double dz = box_max[2] - box_min[2];
+  return dx * dy + dy * dz + dz * dx;
+}
+
+//------------------------------------------------------------------------------
+
+CXmlSpatialIndex::CXmlSpatialIndex()
+  : num_threads_(0),
+    root_(0) {
+}
+
+void CXmlSpatialIndex::Clear() {
+  objects_.clear();
+  hierarchies_.clear();
+  root_ = 0;
+}
+
+size_t CXmlSpatialIndex::GetNumThreads(size_t num_tasks) const {
+  size_t num_threads = num_threads_ > 0 ?
+      static_cast<size_t>(num_threads_) : std::thread::hardware_concurrency();
+  return std::max<size_t>(1, std::min(num_threads, num_tasks));
+}
+
+template <typename Function>
+void CXmlSpatialIndex::RunParallel(size_t count,
+                                   const Function& function) const {
+  size_t num_threads = GetNumThreads(count);
+  std::atomic<size_t> next(0);
+  auto run = [&next, &function, count] {
+    for (size_t i = next++; i < count; i = next++)
+      function(i);
+  };
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.push_back(std::thread(run));
+  }
+  run();
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+//------------------------------------------------------------------------------
+// Building
+
+void CXmlSpatialIndex::Build(const XmlModelInfo& model) {
+  Clear();
+  AddObjects(model);
+
+  // Largest first, so that a large object does not start last
+  std::vector<std::pair<size_t, uint32_t> > order;
+  for (uint32_t i = 0; i < objects_.size(); ++i) {
+    const std::vector<XmlFaceInfo>& faces = objects_[i].entities_->faces_;
+    size_t num_triangles = 0;
+    for (size_t j = 0; j < faces.size(); ++j) {
+      if (!faces[j].has_single_loop_)
+        num_triangles += faces[j].vertices_.size() / 3;
+    }
+    order.push_back(std::make_pair(num_triangles, i));
+  }
+  std::sort(order.begin(), order.end(),
+            std::greater<std::pair<size_t, uint32_t> >());
+
+  // Large objects also split their own build over the threads
+  size_t num_threads = GetNumThreads(static_cast<size_t>(-1));
+  int spawn_depth = 0;
+  while ((static_cast<size_t>(1) << spawn_depth) < num_threads)
+    ++spawn_depth;
+  RunParallel(order.size(), [this, &order, spawn_depth](size_t i) {
+    BuildTriangles(order[i].second,
+                   order[i].first >= kParallelBuildSize ? spawn_depth : 0);
+  });
+
+  BuildInstances();
+}
+
+void CXmlSpatialIndex::AddObjects(const XmlModelInfo& model) {
+  // A name used twice refers to the last definition, as in the tiler
+  std::map<std::string, uint32_t> definitions;
+  for (size_t i = 0; i < model.definitions_.size(); ++i) {
+    objects_.push_back(XmlSpatialObject());
+    objects_.back().type_ = XmlSpatialObjectType_Definition;
+    objects_.back().name_ = model.definitions_[i].name_;
+    objects_.back().entities_ = &model.definitions_[i].entities_;
+    definitions[model.definitions_[i].name_] = static_cast<uint32_t>(i);
+  }
+  root_ = static_cast<uint32_t>(objects_.size());
+  objects_.push_back(XmlSpatialObject());
+  objects_.back().type_ = XmlSpatialObjectType_Geometry;
+  objects_.back().entities_ = &model.entities_;
+  hierarchies_.resize(objects_.size());
+
+  // The groups are added behind the objects they are in, so this reaches
+  // every nested group without recursion
+  for (size_t i = 0; i < objects_.size(); ++i) {
+    const XmlEntitiesInfo& entities = *objects_[i].entities_;
+    std::vector<XmlSpatialInstance> instances;
+    std::vector<SUTransformation> inverses;
+    SUTransformation inverse;
+    for (size_t j = 0; j < entities.component_instances_.size(); ++j) {
+      const XmlComponentInstanceInfo& instance =
+          entities.component_instances_[j];
+      std::map<std::string, uint32_t>::const_iterator it =
+          definitions.find(instance.definition_name_);
+      if (it == definitions.end() ||
+          !InvertTransform(instance.transform_, inverse))
+        continue;
+      XmlSpatialInstance info;
+      info.object_ = it->second;
+      info.transform_ = instance.transform_;
+      instances.push_back(info);
+      inverses.push_back(inverse);
+    }
+    for (size_t j = 0; j < entities.groups_.size(); ++j) {
+      const XmlGroupInfo& group = entities.groups_[j];
+      if (group.entities_ == NULL ||
+          !InvertTransform(group.transform_, inverse))
+        continue;
+      XmlSpatialInstance info;
+      info.object_ = static_cast<uint32_t>(objects_.size());
+      info.transform_ = group.transform_;
+      instances.push_back(info);
+      inverses.push_back(inverse);
+
+      objects_.push_back(XmlSpatialObject());
+      objects_.back().type_ = XmlSpatialObjectType_Group;
+      objects_.back().entities_ = group.entities_;
+      hierarchies_.push_back(Hierarchy());
+    }
+    objects_[i].instances_.swap(instances);
+    hierarchies_[i].inverses_.swap(inverses);
+  }
+}
+
+void CXmlSpatialIndex::BuildTriangles(uint32_t object, int spawn_depth) {
+  const std::vector<XmlFaceInfo>& faces = objects_[object].entities_->faces_;
+  std::vector<Triangle> triangles;
+  for (size_t i = 0; i < faces.size(); ++i) {
+    const XmlFaceInfo& face = faces[i];
+    if (face.has_single_loop_)
+      continue;
+    for (size_t j = 0; j + 2 < face.vertices_.size(); j += 3) {
+      Triangle triangle;
+      for (int k = 0; k < 3; ++k)
+        triangle.vertices_[k] = face.vertices_[j + k].vertex_;
+      triangle.face_ = static_cast<uint32_t>(i);
+      triangle.triangle_ = static_cast<uint32_t>(j / 3);
+      triangles.push_back(triangle);
+    }
+  }
+
+  std::vector<BuildItem> items(triangles.size());
+  for (size_t i = 0; i < triangles.size(); ++i) {
+    BuildItem& item = items[i];
+    GetCoords(triangles[i].vertices_[0], item.min_);
+    GetCoords(triangles[i].vertices_[0], item.max_);
+    for (int k = 1; k < 3; ++k) {
+      double coords[3];
+      GetCoords(triangles[i].vertices_[k], coords);
+      for (int axis = 0; axis < 3; ++axis) {
+        item.min_[axis] = std::min(item.min_[axis], coords[axis]);
+        item.max_[axis] = std::max(item.max_[axis], coords[axis]);
+      }
+    }
+    for (int axis = 0; axis < 3; ++axis)
+      item.centroid_[axis] = (item.min_[axis] + item.max_[axis]) / 2.0;
+    item.index_ = static_cast<uint32_t>(i);
+  }
+
+  Hierarchy& hierarchy = hierarchies_[object];
+  if (!items.empty())
+    BuildNodes(items, 0, items.size(), 0, spawn_depth,
+               hierarchy.triangle_nodes_);
+  hierarchy.triangles_.resize(items.size());
+  for (size_t i = 0; i < items.size(); ++i) {
+    hierarchy.triangles_[i] = triangles[items[i].index_];
+  }
+}
+
+void CXmlSpatialIndex::BuildNodes(std::vector<BuildItem>& items, size_t begin,
+                                  size_t end, int depth, int spawn_depth,
+                                  std::vector<Node>& nodes) {
+  Node node;
+  double centroid_min[3];
+  double centroid_max[3];
+  for (int axis = 0; axis < 3; ++axis) {
+    node.min_[axis] = centroid_min[axis] = DBL_MAX;
+    node.max_[axis] = centroid_max[axis] = -DBL_MAX;
+  }
+  for (size_t i = begin; i < end; ++i) {
+    const BuildItem& item = items[i];
+    for (int axis = 0; axis < 3; ++axis) {
+      node.min_[axis] = std::min(node.min_[axis], item.min_[axis]);
+      node.max_[axis] = std::max(node.max_[axis], item.max_[axis]);
+      centroid_min[axis] = std::min(centroid_min[axis], item.centroid_[axis]);
+      centroid_max[axis] = std::max(centroid_max[axis], item.centroid_[axis]);
+    }
+  }
+
+  // The cheapest split by the surface area heuristic, over binned centroids.
+  // Costs are kept multiplied by the node's area, so flat nodes compare too.
+  size_t count = end - begin;
+  size_t mid = begin;
+  if (count > 1 && depth < kMaxSahDepth) {
+    double area = GetHalfArea(node.min_, node.max_);
+    double best_cost = DBL_MAX;
+    int best_axis = -1;
+    int best_bin = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+      double extent = centroid_max[axis] - centroid_min[axis];
+      if (!(extent > 0.0))
+        continue;
+      double scale = kNumBins / extent;
+      size_t bin_counts[kNumBins] = {0};
+      double bin_min[kNumBins][3];
+      double bin_max[kNumBins][3];
+      for (int b = 0; b < kNumBins; ++b) {
+        for (int k = 0; k < 3; ++k) {
+          bin_min[b][k] = DBL_MAX;
+          bin_max[b][k] = -DBL_MAX;
+        }
+      }
+      for (size_t i = begin; i < end; ++i) {
+        const BuildItem& item = items[i];
+        int b = std::min(kNumBins - 1, static_cast<int>(
+            (item.centroid_[axis] - centroid_min[axis]) * scale));
+        ++bin_counts[b];
+        for (int k = 0; k < 3; ++k) {
+          bin_min[b][k] = std::min(bin_min[b][k], item.min_[k]);
+          bin_max[b][k] = std::max(bin_max[b][k], item.max_[k]);
+        }
+      }
+
+      // Area and count left of each bin boundary, then sweep from the right
+      double left_area[kNumBins];
+      size_t left_count[kNumBins];
+      double box_min[3] = {DBL_MAX, DBL_MAX, DBL_MAX};
+      double box_max[3] = {-DBL_MAX, -DBL_MAX, -DBL_MAX};
+      size_t total = 0;
+      for (int b = 0; b < kNumBins - 1; ++b) {
+        total += bin_counts[b];
+        for (int k = 0; k < 3; ++k) {
+          box_min[k] = std::min(box_min[k], bin_min[b][k]);
+          box_max[k] = std::max(box_max[k], bin_max[b][k]);
+        }
+        left_count[b + 1] = total;
+        left_area[b + 1] = total > 0 ? GetHalfArea(box_min, box_max) : 0.0;
+      }
+      for (int k = 0; k < 3; ++k) {
+        box_min[k] = DBL_MAX;
+        box_max[k] = -DBL_MAX;
+      }
+      total = 0;
+      for (int b = kNumBins - 1; b > 0; --b) {
+        total += bin_counts[b];
+        for (int k = 0; k < 3; ++k) {
+          box_min[k] = std::min(box_min[k], bin_min[b][k]);
+          box_max[k] = std::max(box_max[k], bin_max[b][k]);
+        }
+        if (total == 0 || left_count[b] == 0)
+          continue;
+        double cost = left_area[b] * left_count[b] +
+                      GetHalfArea(box_min, box_max) * total;
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_bin = b;
+        }
+      }
+    }
+
+    double leaf_cost = area * (static_cast<double>(count) - kTraversalCost);
+    if (best_axis >= 0 && (best_cost < leaf_cost || count > kMaxLeafSize)) {
+      double scale = kNumBins /
+          (centroid_max[best_axis] - centroid_min[best_axis]);
+      double low = centroid_min[best_axis];
+      mid = std::partition(items.begin() + begin, items.begin() + end,
+                           [best_axis, best_bin, scale, low](
+                               const BuildItem& item) {
+        return std::min(kNumBins - 1, static_cast<int>(
+            (item.centroid_[best_axis] - low) * scale)) < best_bin;
+      }) - items.begin();
+    }
+  }
+  if (mid == begin && count > kMaxLeafSize) {
+    // Too deep, or no split to choose from: halve along the longest axis
+    int axis = 0;
+    for (int k = 1; k < 3; ++k) {
+      if (centroid_max[k] - centroid_min[k] >
+          centroid_max[axis] - centroid_min[axis])
+        axis = k;
+    }
+    mid = begin + count / 2;
+    std::nth_element(items.begin() + begin, items.begin() + mid,
+                     items.begin() + end,
+                     [axis](const BuildItem& a, const BuildItem& b) {
+      return a.centroid_[axis] < b.centroid_[axis];
+    });
+  }
+
+  size_t index = nodes.size();
+  nodes.push_back(node);
+  if (mid == begin) {
+    nodes[index].offset_ = static_cast<uint32_t>(begin);
+    nodes[index].count_ = static_cast<uint32_t>(count);
+    return;
+  }
+
+  nodes[index].count_ = 0;
+  if (spawn_depth > 0 && count >= kParallelBuildSize) {
+    // The sides are disjoint ranges of the items. The right side's nodes
+    // only hold offsets relative to themselves, so they are appended as
+    // they are.
+    std::vector<Node> right_nodes;
+    std::thread thread([&items, mid, end, depth, spawn_depth, &right_nodes] {
+      BuildNodes(items, mid, end, depth + 1, spawn_depth - 1, right_nodes);
+    });
+    BuildNodes(items, begin, mid, depth + 1, spawn_depth - 1, nodes);
+    thread.join();
+    nodes[index].offset_ = static_cast<uint32_t>(nodes.size() - index);
+    nodes.insert(nodes.end(), right_nodes.begin(), right_nodes.end());
+  } else {
+    BuildNodes(items, begin, mid, depth + 1, spawn_depth, nodes);
+    nodes[index].offset_ = static_cast<uint32_t>(nodes.size() - index);
+    BuildNodes(items, mid, end, depth + 1, spawn_depth, nodes);
+  }
+}
+
+void CXmlSpatialIndex::BuildInstances() {
+  // The objects are finished depth first, an object after all the objects
+  // it instances, so their bounds are known. An instance of an object that
+  // is still open would place the object inside itself and is dropped.
+  enum { kNew, kOpen, kDone };
+  std::vector<char> state(objects_.size(), kNew);
+  std::vector<std::vector<char> > dropped(objects_.size());
+  struct Visit {
+    uint32_t object_;
+    size_t next_;
+  };
+  std::vector<Visit> stack;
+  for (uint32_t start = 0; start < objects_.size(); ++start) {
+    if (state[start] != kNew)
+      continue;
+    Visit visit = {start, 0};
+    stack.push_back(visit);
+    state[start] = kOpen;
+    dropped[start].assign(objects_[start].instances_.size(), 0);
+    while (!stack.empty()) {
+      uint32_t object = stack.back().object_;
+      std::vector<XmlSpatialInstance>& instances = objects_[object].instances_;
+      if (stack.back().next_ < instances.size()) {
+        size_t i = stack.back().next_++;
+        uint32_t child = instances[i].object_;
+        if (state[child] == kOpen) {
+          dropped[object][i] = 1;
+        } else if (state[child] == kNew) {
+          Visit child_visit = {child, 0};
+          stack.push_back(child_visit);
+          state[child] = kOpen;
+          dropped[child].assign(objects_[child].instances_.size(), 0);
+        }
+        continue;
+      }
+
+      Hierarchy& hierarchy = hierarchies_[object];
+      size_t kept = 0;
+      for (size_t i = 0; i < instances.size(); ++i) {
+        if (dropped[object][i])
+          continue;
+        instances[kept] = instances[i];
+        hierarchy.inverses_[kept] = hierarchy.inverses_[i];
+        ++kept;
+      }
+      instances.resize(kept);
+      hierarchy.inverses_.resize(kept);
+
+      CBoundingBox3d bounds;
+      if (!hierarchy.triangle_nodes_.empty()) {
+        const Node& root = hierarchy.triangle_nodes_[0];
+        bounds.Add(CPoint3d(root.min_[0], root.min_[1], root.min_[2]));
+        bounds.Add(CPoint3d(root.max_[0], root.max_[1], root.max_[2]));
+      }
+      std::vector<BuildItem> items;
+      for (size_t i = 0; i < instances.size(); ++i) {
+        CBoundingBox3d child_bounds = TransformBoundingBox(
+            instances[i].transform_, objects_[instances[i].object_].bounds_);
+        if (child_bounds.IsEmpty())
+          continue;
+        bounds.Add(child_bounds);
+        BuildItem item;
+        GetCoords(child_bounds.min(), item.min_);
+        GetCoords(child_bounds.max(), item.max_);
+        for (int axis = 0; axis < 3; ++axis)
+          item.centroid_[axis] = (item.min_[axis] + item.max_[axis]) / 2.0;
+        item.index_ = static_cast<uint32_t>(i);
+        items.push_back(item);
+      }
+      if (!items.empty())
+        BuildNodes(items, 0, items.size(), 0, 0, hierarchy.instance_nodes_);
+      hierarchy.instances_.resize(items.size());
+      for (size_t i = 0; i < items.size(); ++i) {
+        hierarchy.instances_[i] = items[i].index_;
+      }
+      objects_[object].bounds_ = bounds;
+
+      state[object] = kDone;
+      stack.pop_back();
+    }
+  }
+}
+
+//------------------------------------------------------------------------------
+// Queries
+
+CXmlSpatialIndex::Frame CXmlSpatialIndex::GetRootFrame() const {
+  Frame frame;
+  frame.object_ = root_;
+  frame.parent_ = -1;
+  frame.instance_ = 0;
+  frame.to_world_ = GetIdentityTransform();
+  frame.to_local_ = frame.to_world_;
+  frame.is_identity_ = true;
+  return frame;
+}
+
+CXmlSpatialIndex::Frame CXmlSpatialIndex::GetInstanceFrame(
+    const std::vector<Frame>& frames, int parent, uint32_t instance) const {
+  const Frame& parent_frame = frames[parent];
+  const XmlSpatialInstance& info =
+      objects_[parent_frame.object_].instances_[instance];
+  const SUTransformation& inverse =
+      hierarchies_[parent_frame.object_].inverses_[instance];
+  Frame frame;
+  frame.object_ = info.object_;
+  frame.parent_ = parent;
+  frame.instance_ = instance;
+  if (parent_frame.is_identity_) {
+    frame.to_world_ = info.transform_;
+    frame.to_local_ = inverse;
+  } else {
+    frame.to_world_ = MultiplyTransforms(parent_frame.to_world_,
+                                         info.transform_);
+    frame.to_local_ = MultiplyTransforms(inverse, parent_frame.to_local_);
+  }
+  frame.is_identity_ = IsIdentity(frame.to_world_);
+  return frame;
+}
+
+void CXmlSpatialIndex::GetTriangle(const std::vector<Frame>& frames,
+                                   int frame, const Triangle& triangle,
+                                   XmlSpatialTriangle& result) const {
+  result.object_ = frames[frame].object_;
+  result.face_ = triangle.face_;
+  result.triangle_ = triangle.triangle_;
+  result.instance_path_.clear();
+  for (int i = frame; frames[i].parent_ >= 0; i = frames[i].parent_) {
+    result.instance_path_.push_back(frames[i].instance_);
+  }
+  std::reverse(result.instance_path_.begin(), result.instance_path_.end());
+}
+
+static void GetWorldTriangle(const SUTransformation& to_world,
+                             bool is_identity, const CPoint3d* vertices,
+                             CPoint3d* world) {
+  for (int k = 0; k < 3; ++k) {
+    world[k] = is_identity ? vertices[k] : TransformPoint(to_world,
+                                                          vertices[k]);
+  }
+}
+
+namespace {
+
+// A node still to be visited, in one of the hierarchies of a frame
+struct StackEntry {
+  int frame_;
+  uint32_t node_;
+  bool instances_;
+  // Ray distance or squared point distance to the node's box
+  double distance_;
+};
+
+} // namespace
+
+bool CXmlSpatialIndex::CastRay(const XmlSpatialRay& ray,
+                               XmlSpatialHit& hit) const {
+  hit = XmlSpatialHit();
+  if (objects_.empty())
+    return false;
+
+  std::vector<Frame> frames(1, GetRootFrame());
+  std::vector<LocalRay> rays(1, GetLocalRay(frames[0].to_local_, true, ray));
+  std::vector<StackEntry> stack;
+  double max_distance = ray.max_distance_;
+  int hit_frame = -1;
+  const Triangle* hit_triangle = NULL;
+
+  auto push_roots = [this, &frames, &rays, &stack, &max_distance](int frame) {
+    const Hierarchy& hierarchy = hierarchies_[frames[frame].object_];
+    for (int i = 0; i < 2; ++i) {
+      const std::vector<Node>& nodes =
+          i == 0 ? hierarchy.triangle_nodes_ : hierarchy.instance_nodes_;
+      StackEntry entry = {frame, 0, i == 1, 0.0};
+      if (!nodes.empty() &&
+          IntersectRayBox(rays[frame], nodes[0].min_, nodes[0].max_,
+                          max_distance, entry.distance_))
+        stack.push_back(entry);
+    }
+  };
+  push_roots(0);
+
+  while (!stack.empty()) {
+    StackEntry entry = stack.back();
+    stack.pop_back();
+    if (entry.distance_ > max_distance)
+      continue;
+    const Hierarchy& hierarchy = hierarchies_[frames[entry.frame_].object_];
+    const std::vector<Node>& nodes = entry.instances_ ?
+        hierarchy.instance_nodes_ : hierarchy.triangle_nodes_;
+    const Node& node = nodes[entry.node_];
+
+    if (node.count_ == 0) {
+      // The nearer child is visited first
+      const LocalRay& local = rays[entry.frame_];
+      StackEntry children[2] = {entry, entry};
+      children[0].node_ = entry.node_ + 1;
+      children[1].node_ = entry.node_ + node.offset_;
+      bool hits[2];
+      for (int i = 0; i < 2; ++i) {
+        const Node& child = nodes[children[i].node_];
+        hits[i] = IntersectRayBox(local, child.min_, child.max_, max_distance,
+                                  children[i].distance_);
+      }
+      if (hits[0] && hits[1] &&
+          children[0].distance_ < children[1].distance_) {
+        std::swap(children[0], children[1]);
+        std::swap(hits[0], hits[1]);
+      }
+      for (int i = 0; i < 2; ++i) {
+        if (hits[i])
+          stack.push_back(children[i]);
+      }
+      continue;
+    }
+
+    if (!entry.instances_) {
+      const LocalRay& local = rays[entry.frame_];
+      for (uint32_t i = node.offset_; i < node.offset_ + node.count_; ++i) {
+        const Triangle& triangle = hierarchy.triangles_[i];
+        double distance;
+        if (IntersectRayTriangle(local, triangle.vertices_, max_distance,
+                                 distance)) {
+          max_distance = distance;
+          hit_frame = entry.frame_;
+          hit_triangle = &triangle;
+        }
+      }
+      continue;
+    }
+
+    for (uint32_t i = node.offset_; i < node.offset_ + node.count_; ++i) {
+      frames.push_back(GetInstanceFrame(frames, entry.frame_,
+                                        hierarchy.instances_[i]));
+      rays.push_back(GetLocalRay(frames.back().to_local_,
+                                 frames.back().is_identity_, ray));
+      push_roots(static_cast<int>(frames.size()) - 1);
+    }
+  }
+
+  if (hit_triangle == NULL)
+    return false;
+  hit.found_ = true;
+  hit.distance_ = max_distance;
+  hit.point_ = ray.origin_ + ray.direction_ * max_distance;
+  GetTriangle(frames, hit_frame, *hit_triangle, hit.triangle_);
+  return true;
+}
+
+void CXmlSpatialIndex::FindOverlaps(
+    const CBoundingBox3d& box,
+    std::vector<XmlSpatialTriangle>& triangles) const {
+  triangles.clear();
+  if (objects_.empty() || box.IsEmpty())
+    return;
+
+  LocalBox world_box = GetLocalBox(box);
+  std::vector<Frame> frames(1, GetRootFrame());
+  // The box in each frame's coordinates, around the transformed box
+  std::vector<LocalBox> boxes(1, world_box);
+  std::vector<StackEntry> stack;
+
+  auto push_roots = [this, &frames, &boxes, &stack](int frame) {
+    const Hierarchy& hierarchy = hierarchies_[frames[frame].object_];
+    for (int i = 0; i < 2; ++i) {
+      const std::vector<Node>& nodes =
+          i == 0 ? hierarchy.triangle_nodes_ : hierarchy.instance_nodes_;
+      StackEntry entry = {frame, 0, i == 1, 0.0};
+      if (!nodes.empty() &&
+          BoxesOverlap(boxes[frame].min_, boxes[frame].max_, nodes[0].min_,
+                       nodes[0].max_))
+        stack.push_back(entry);
+    }
+  };
+  push_roots(0);
+
+  while (!stack.empty()) {
+    StackEntry entry = stack.back();
+    stack.pop_back();
+    const Frame& frame = frames[entry.frame_];
+    const Hierarchy& hierarchy = hierarchies_[frame.object_];
+    const std::vector<Node>& nodes = entry.instances_ ?
+        hierarchy.instance_nodes_ : hierarchy.triangle_nodes_;
+    const Node& node = nodes[entry.node_];
+
+    if (node.count_ == 0) {
+      const LocalBox& local = boxes[entry.frame_];
+      uint32_t children[2] = {entry.node_ + 1, entry.node_ + node.offset_};
+      for (int i = 1; i >= 0; --i) {
+        const Node& child = nodes[children[i]];
+        if (BoxesOverlap(local.min_, local.max_, child.min_, child.max_)) {
+          StackEntry child_entry = entry;
+          child_entry.node_ = children[i];
+          stack.push_back(child_entry);
+        }
+      }
+      continue;
+    }
+
+    if (!entry.instances_) {
+      // The local box is larger than the query box, so the triangles are
+      // tested in world coordinates
+      for (uint32_t i = node.offset_; i < node.offset_ + node.count_; ++i) {
+        const Triangle& triangle = hierarchy.triangles_[i];
+        CPoint3d world[3];
+        GetWorldTriangle(frame.to_world_, frame.is_identity_,
+                         triangle.vertices_, world);
+        if (TriangleOverlapsBox(world, world_box.min_, world_box.max_)) {
+          triangles.push_back(XmlSpatialTriangle());
+          GetTriangle(frames, entry.frame_, triangle, triangles.back());
+        }
+      }
+      continue;
+    }
+
+    for (uint32_t i = node.offset_; i < node.offset_ + node.count_; ++i) {
+      frames.push_back(GetInstanceFrame(frames, entry.frame_,
+                                        hierarchy.instances_[i]));
+      boxes.push_back(GetLocalBox(
+          TransformBoundingBox(frames.back().to_local_, box)));
+      push_roots(static_cast<int>(frames.size()) - 1);
+    }
+  }
+}
+
+bool CXmlSpatialIndex::FindNearest(const CPoint3d& point, double max_distance,
+                                   XmlSpatialHit& hit) const {
+  hit = XmlSpatialHit();
+  if (objects_.empty() || max_distance < 0.0)
+    return false;
+
+  std::vector<Frame> frames(1, GetRootFrame());
+  std::vector<StackEntry> stack;
+  double best = max_distance < sqrt(DBL_MAX) ?
+      max_distance * max_distance : DBL_MAX;
+  int hit_frame = -1;
+  const Triangle* hit_triangle = NULL;
+
+  // Squared distance to the node's box in world coordinates
+  auto get_distance = [&frames, &point](int frame, const Node& node) {
+    if (frames[frame].is_identity_)
+      return GetBoxDistanceSquared(point, node.min_, node.max_);
+    CBoundingBox3d box;
+    box.Add(CPoint3d(node.min_[0], node.min_[1], node.min_[2]));
+    box.Add(CPoint3d(node.max_[0], node.max_[1], node.max_[2]));
+    LocalBox world = GetLocalBox(
+        TransformBoundingBox(frames[frame].to_world_, box));
+    return GetBoxDistanceSquared(point, world.min_, world.max_);
+  };
+  auto push_roots = [this, &frames, &stack, &best, &get_distance](int frame) {
+    const Hierarchy& hierarchy = hierarchies_[frames[frame].object_];
+    for (int i = 0; i < 2; ++i) {
+      const std::vector<Node>& nodes =
+          i == 0 ? hierarchy.triangle_nodes_ : hierarchy.instance_nodes_;
+      if (nodes.empty())
+        continue;
+      StackEntry entry = {frame, 0, i == 1, get_distance(frame, nodes[0])};
+      if (entry.distance_ <= best)
+        stack.push_back(entry);
+    }
+  };
+  push_roots(0);
+
+  while (!stack.empty()) {
+    StackEntry entry = stack.back();
+    stack.pop_back();
+    if (entry.distance_ > best)
+      continue;
+    const Hierarchy& hierarchy = hierarchies_[frames[entry.frame_].object_];
+    const std::vector<Node>& nodes = entry.instances_ ?
+        hierarchy.instance_nodes_ : hierarchy.triangle_nodes_;
+    const Node& node = nodes[entry.node_];
+
+    if (node.count_ == 0) {
+      // The nearer child is visited first
+      StackEntry children[2] = {entry, entry};
+      children[0].node_ = entry.node_ + 1;
+      children[1].node_ = entry.node_ + node.offset_;
+      for (int i = 0; i < 2; ++i) {
+        children[i].distance_ = get_distance(entry.frame_,
+                                             nodes[children[i].node_]);
+      }
+      if (children[0].distance_ < children[1].distance_)
+        std::swap(children[0], children[1]);
+      for (int i = 0; i < 2; ++i) {
+        if (children[i].distance_ <= best)
+          stack.push_back(children[i]);
+      }
+      continue;
+    }
+
+    if (!entry.instances_) {
+      const Frame& frame = frames[entry.frame_];
+      for (uint32_t i = node.offset_; i < node.offset_ + node.count_; ++i) {
+        const Triangle& triangle = hierarchy.triangles_[i];
+        CPoint3d world[3];
+        GetWorldTriangle(frame.to_world_, frame.is_identity_,
+                         triangle.vertices_, world);
+        CPoint3d closest = ClosestPointOnTriangle(point, world);
+        double distance = GetDistanceSquared(closest, point);
+        if (distance < best || (hit_triangle == NULL && distance == best)) {
+          best = distance;
+          hit.point_ = closest;
+          hit_frame = entry.frame_;
+          hit_triangle = &triangle;
+        }
+      }
+      continue;
+    }
+
+    for (uint32_t i = node.offset_; i < node.offset_ + node.count_; ++i) {
+      frames.push_back(GetInstanceFrame(frames, entry.frame_,
+                                        hierarchy.instances_[i]));
+      push_roots(static_cast<int>(frames.size()) - 1);
+    }
+  }
+
+  if (hit_triangle == NULL)
+    return false;
+  hit.found_ = true;
+  hit.distance_ = sqrt(best);
+  GetTriangle(frames, hit_frame, *hit_triangle, hit.triangle_);
+  return true;
+}
+
+void CXmlSpatialIndex::CastRays(const std::vector<XmlSpatialRay>& rays,
+                                std::vector<XmlSpatialHit>& hits) const {
+  hits.resize(rays.size());
+  RunParallel(rays.size(), [this, &rays, &hits](size_t i) {
+    CastRay(rays[i], hits[i]);
+  });
+}
+
+void CXmlSpatialIndex::FindOverlaps(
+    const std::vector<CBoundingBox3d>& boxes,
+    std::vector<std::vector<XmlSpatialTriangle> >& triangles) const {
+  triangles.resize(boxes.size());
+  RunParallel(boxes.size(), [this, &boxes, &triangles](size_t i) {
+    FindOverlaps(boxes[i], triangles[i]);
+  });
+}
+
+void CXmlSpatialIndex::FindNearest(const std::vector<CPoint3d>& points,
+                                   double max_distance,
+                                   std::vector<XmlSpatialHit>& hits) const {
+  hits.resize(points.size());
+  RunParallel(points.size(), [this, &points, max_distance, &hits](size_t i) {
+    FindNearest(points[i], max_distance, hits[i]);
+  });
+}
+
+//------------------------------------------------------------------------------
+// Brute force
+
+template <typename Function>
+void CXmlSpatialIndex::ForEachWorldTriangle(const Function& function) const {
+  if (objects_.empty())
+    return;
+
+  // The frames of the instances from the root down to the current one, and
+  // the next instance to visit in each
+  std::vector<Frame> frames(1, GetRootFrame());
+  std::vector<uint32_t> next(1, 0);
+  auto visit = [this, &frames, &function](int frame) {
+    const Frame& info = frames[frame];
+    const std::vector<Triangle>& triangles =
+        hierarchies_[info.object_].triangles_;
+    for (size_t i = 0; i < triangles.size(); ++i) {
+      CPoint3d world[3];
+      GetWorldTriangle(info.to_world_, info.is_identity_,
+                       triangles[i].vertices_, world);
+      function(frames, frame, triangles[i], world);
+    }
+  };
+  visit(0);
+  while (!frames.empty()) {
+    int level = static_cast<int>(frames.size()) - 1;
+    if (next[level] == objects_[frames[level].object_].instances_.size()) {
+      frames.pop_back();
+      next.pop_back();
+      continue;
+    }
+    uint32_t instance = next[level]++;
+    frames.push_back(GetInstanceFrame(frames, level, instance));
+    next.push_back(0);
+    visit(level + 1);
+  }
+}
+
+uint64_t CXmlSpatialIndex::CountWorldTriangles() const {
+  if (objects_.empty())
+    return 0;
+
+  // An object is counted after all the objects it instances, depth first;
+  // Build left no instance cycles
+  std::vector<uint64_t> counts(objects_.size(), 0);
+  std::vector<char> done(objects_.size(), 0);
+  std::vector<std::pair<uint32_t, size_t> > stack(
+      1, std::make_pair(root_, static_cast<size_t>(0)));
+  while (!stack.empty()) {
+    uint32_t object = stack.back().first;
+    const std::vector<XmlSpatialInstance>& instances =
+        objects_[object].instances_;
+    if (stack.back().second < instances.size()) {
+      uint32_t child = instances[stack.back().second++].object_;
+      if (!done[child])
+        stack.push_back(std::make_pair(child, static_cast<size_t>(0)));
+      continue;
+    }
+
+    uint64_t count = hierarchies_[object].triangles_.size();
+    for (size_t i = 0; i < instances.size(); ++i)
+      count += counts[instances[i].object_];
+    counts[object] = count;
+    done[object] = 1;
+    stack.pop_back();
+  }
+  return counts[root_];
+}
+
+bool CXmlSpatialIndex::CastRayBruteForce(const XmlSpatialRay& ray,
+                                         XmlSpatialHit& hit) const {
+  hit = XmlSpatialHit();
+  LocalRay world_ray = GetLocalRay(GetIdentityTransform(), true, ray);
+  double max_distance = ray.max_distance_;
+  ForEachWorldTriangle([this, &world_ray, &max_distance, &hit](
+      const std::vector<Frame>& frames, int frame, const Triangle& triangle,
+      const CPoint3d* world) {
+    double distance;
+    if (IntersectRayTriangle(world_ray, world, max_distance, distance)) {
+      max_distance = distance;
+      hit.found_ = true;
+      GetTriangle(frames, frame, triangle, hit.triangle_);
+    }
+  });
+  if (hit.found_) {
+    hit.distance_ = max_distance;
+    hit.point_ = ray.origin_ + ray.direction_ * max_distance;
+  }
+  return hit.found_;
+}
+
+void CXmlSpatialIndex::FindOverlapsBruteForce(
+    const CBoundingBox3d& box,
+    std::vector<XmlSpatialTriangle>& triangles) const {
+  triangles.clear();
+  if (box.IsEmpty())
+    return;
+  LocalBox world_box = GetLocalBox(box);
+  ForEachWorldTriangle([this, &world_box, &triangles](
+      const std::vector<Frame>& frames, int frame, const Triangle& triangle,
+      const CPoint3d* world) {
+    if (TriangleOverlapsBox(world, world_box.min_, world_box.max_)) {
+      triangles.push_back(XmlSpatialTriangle());
+      GetTriangle(frames, frame, triangle, triangles.back());
+    }
+  });
+}
+
+bool CXmlSpatialIndex::FindNearestBruteForce(const CPoint3d& point,
+                                             double max_distance,
+                                             XmlSpatialHit& hit) const {
+  hit = XmlSpatialHit();
+  if (max_distance < 0.0)
+    return false;
+  double best = max_distance < sqrt(DBL_MAX) ?
+      max_distance * max_distance : DBL_MAX;
+  ForEachWorldTriangle([this, &point, &best, &hit](
+      const std::vector<Frame>& frames, int frame, const Triangle& triangle,
+      const CPoint3d* world) {
+    CPoint3d closest = ClosestPointOnTriangle(point, world);
+    double distance = GetDistanceSquared(closest, point);
+    if (distance < best || (!hit.found_ && distance == best)) {
+      best = distance;
+      hit.found_ = true;
+      hit.point_ = closest;
+      GetTriangle(frames, frame, triangle, hit.triangle_);
+    }
+  });
+  if (hit.found_)
+    hit.distance_ = sqrt(best);
+  return hit.found_;
+}
+
+//------------------------------------------------------------------------------
+// Benchmark
+
+static double GetSeconds() {
+  return std::chrono::duration<double>(
+      std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Deterministic, so runs compare
+static double GetRandom(uint64_t& state) {
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return static_cast<double>(state >> 11) / 9007199254740992.0;
+}
+
+static CPoint3d GetRandomPoint(const CBoundingBox3d& bounds, double margin,
+                               uint64_t& state) {
+  CVector3d extent = bounds.max() - bounds.min();
+  double x = GetRandom(state) * (1.0 + 2.0 * margin) - margin;
+  double y = GetRandom(state) * (1.0 + 2.0 * margin) - margin;
+  double z = GetRandom(state) * (1.0 + 2.0 * margin) - margin;
+  return CPoint3d(bounds.min().x() + x * extent.x(),
+                  bounds.min().y() + y * extent.y(),
+                  bounds.min().z() + z * extent.z());
+}
+
+static bool IsSameDistance(double a, double b) {
+  return fabs(a - b) <= 1e-9 * std::max(1.0, std::max(fabs(a), fabs(b)));
+}
+
+static bool IsSameHit(const XmlSpatialHit& a, const XmlSpatialHit& b) {
+  return a.found_ == b.found_ &&
+         (!a.found_ || IsSameDistance(a.distance_, b.distance_));
+}
+
+static bool IsLess(const XmlSpatialTriangle& a, const XmlSpatialTriangle& b) {
+  if (a.object_ != b.object_)
+    return a.object_ < b.object_;
+  if (a.face_ != b.face_)
+    return a.face_ < b.face_;
+  if (a.triangle_ != b.triangle_)
+    return a.triangle_ < b.triangle_;
+  return a.instance_path_ < b.instance_path_;
+}
+
+static bool IsSameOverlap(std::vector<XmlSpatialTriangle>& a,
+                          std::vector<XmlSpatialTriangle>& b) {
+  if (a.size() != b.size())
+    return false;
+  std::sort(a.begin(), a.end(), IsLess);
+  std::sort(b.begin(), b.end(), IsLess);
+  for (size_t i = 0; i < a.size(); ++i) {
+    if (IsLess(a[i], b[i]) || IsLess(b[i], a[i]))
+      return false;
+  }
+  return true;
+}
+
+void CXmlSpatialIndex::Benchmark(const XmlModelInfo& model,
+                                 size_t num_queries,
+                                 XmlSpatialBenchmarkInfo& info) {
+  info = XmlSpatialBenchmarkInfo();
+  double start = GetSeconds();
+  Build(model);
+  info.build_seconds_ = GetSeconds() - start;
+
+  info.triangles_ = CountWorldTriangles();
+  const CBoundingBox3d& bounds = objects_[root_].bounds_;
+  if (bounds.IsEmpty())
+    return;
+  info.queries_ = num_queries;
+
+  // Rays from around the model through it, boxes a tenth of its size and
+  // points around it
+  uint64_t state = 1;
+  CVector3d extent = bounds.max() - bounds.min();
+  CVector3d half = extent * 0.05;
+  std::vector<XmlSpatialRay> rays(num_queries);
+  std::vector<CBoundingBox3d> boxes(num_queries);
+  std::vector<CPoint3d> points(num_queries);
+  for (size_t i = 0; i < num_queries; ++i) {
+    rays[i].origin_ = GetRandomPoint(bounds, 0.25, state);
+    rays[i].direction_ = GetRandomPoint(bounds, 0.0, state) - rays[i].origin_;
+    CPoint3d center = GetRandomPoint(bounds, 0.0, state);
+    boxes[i].Add(center - half);
+    boxes[i].Add(center + half);
+    points[i] = GetRandomPoint(bounds, 0.25, state);
+  }
+
+  std::vector<XmlSpatialHit> hits;
+  std::vector<XmlSpatialHit> brute_force_hits(num_queries);
+  start = GetSeconds();
+  CastRays(rays, hits);
+  info.ray_seconds_ = GetSeconds() - start;
+  start = GetSeconds();
+  RunParallel(num_queries, [this, &rays, &brute_force_hits](size_t i) {
+    CastRayBruteForce(rays[i], brute_force_hits[i]);
+  });
+  info.ray_brute_force_seconds_ = GetSeconds() - start;
+  for (size_t i = 0; i < num_queries; ++i) {
+    if (!IsSameHit(hits[i], brute_force_hits[i]))
+      ++info.mismatches_;
+  }
+
+  std::vector<std::vector<XmlSpatialTriangle> > overlaps;
+  std::vector<std::vector<XmlSpatialTriangle> > brute_force_overlaps(
+      num_queries);
+  start = GetSeconds();
+  FindOverlaps(boxes, overlaps);
+  info.overlap_seconds_ = GetSeconds() - start;
+  start = GetSeconds();
+  RunParallel(num_queries, [this, &boxes, &brute_force_overlaps](size_t i) {
+    FindOverlapsBruteForce(boxes[i], brute_force_overlaps[i]);
+  });
+  info.overlap_brute_force_seconds_ = GetSeconds() - start;
+  for (size_t i = 0; i < num_queries; ++i) {
+    if (!IsSameOverlap(overlaps[i], brute_force_overlaps[i]))
+      ++info.mismatches_;
+  }
+
+  start = GetSeconds();
+  FindNearest(points, DBL_MAX, hits);
+  info.nearest_seconds_ = GetSeconds() - start;
+  start = GetSeconds();
+  RunParallel(num_queries, [this, &points, &brute_force_hits](size_t i) {
+    FindNearestBruteForce(points[i], DBL_MAX, brute_force_hits[i]);
+  });
+  info.nearest_brute_force_seconds_ = GetSeconds() - start;
+  for (size_t i = 0; i < num_queries; ++i) {
+    if (!IsSameHit(hits[i], brute_force_hits[i]))
+      ++info.mismatches_;
+  }
+}
@@ -0,0 +1,627 @@
+// Copyright 2013 Trimble Navigation Limited. All Rights Reserved.
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+
+#include "xmltiles.h"
+#include "tinyxml2.h"
+
+using namespace XmlGeomUtils;
+
+static const std::string kTileSetExtension(".tiles");
+static const std::string kTileInfix(".tile.");
+static const std::string kTileExtension(".xml");
+static const std::string kRootPath("r");
+
+static const std::string kTileSetTag("TileSet");
+static const std::string kXMLVersionTag("xmlversion");
+static const std::string kMaxTrianglesTag("MaxTriangles");
+static const std::string kTileTag("Tile");
+static const std::string kFileTag("File");
+static const std::string kGeometricErrorTag("GeometricError");
+static const std::string kTrianglesTag("Triangles");
+static const std::string kMinTag("Min");
+static const std::string kMaxTag("Max");
+static const std::string kXTag("x");
+static const std::string kYTag("y");
+static const std::string kZTag("z");
+
+static const int kTileSetVersion = 1;
+
+// Cells along the longest side of a tile when clustering its vertices
+static const int kTileClusterCells = 32;
+
+static CVector3d Cross(const CVector3d& a, const CVector3d& b) {
+  return CVector3d(a.y() * b.z() - a.z() * b.y(),
+                   a.z() * b.x() - a.x() * b.z(),
+                   a.x() * b.y() - a.y() * b.x());
+}
+
+static double Dot(const CVector3d& a, const CVector3d& b) {
+  return a.x() * b.x() + a.y() * b.y() + a.z() * b.z();
+}
+
+static CVector3d GetColumn(const SUTransformation& transform, int col) {
+  return CVector3d(transform.values[col * 4], transform.values[col * 4 + 1],
+                   transform.values[col * 4 + 2]);
+}
+
+static double GetDeterminant(const SUTransformation& transform) {
+  return Dot(GetColumn(transform, 0),
+             Cross(GetColumn(transform, 1), GetColumn(transform, 2)));
+}
+
+// Normals transform by the inverse transpose of the linear part, which is
+// the matrix of the column cross products divided by the determinant
+static CVector3d TransformNormal(const SUTransformation& transform,
+                                 const CVector3d& normal) {
+  CVector3d a = GetColumn(transform, 0);
+  CVector3d b = GetColumn(transform, 1);
+  CVector3d c = GetColumn(transform, 2);
+  CVector3d result = Cross(b, c) * normal.x() + Cross(c, a) * normal.y() +
+                     Cross(a, b) * normal.z();
+  if (Dot(a, Cross(b, c)) < 0.0)
+    result *= -1.0;
+  double length = sqrt(Dot(result, result));
+  return length > 0.0 ? result / length : normal;
+}
+
+static XmlEdgeInfo TransformEdge(const SUTransformation& transform,
+                                 const XmlEdgeInfo& edge) {
+  XmlEdgeInfo result = edge;
+  result.start_ = TransformPoint(transform, edge.start_);
+  result.end_ = TransformPoint(transform, edge.end_);
+  return result;
+}
+
+static CPoint3d GetMidPoint(const XmlEdgeInfo& edge) {
+  return (edge.start_ + edge.end_) / 2.0;
+}
+
+static int GetOctant(const CPoint3d& pt, const CPoint3d& center) {
+  return (pt.x() >= center.x() ? 1 : 0) | (pt.y() >= center.y() ? 2 : 0) |
+         (pt.z() >= center.z() ? 4 : 0);
+}
+
+static double GetMaxExtent(const CBoundingBox3d& bounds) {
+  if (bounds.IsEmpty())
+    return 0.0;
+  CVector3d extent = bounds.max() - bounds.min();
+  return std::max(extent.x(), std::max(extent.y(), extent.z()));
+}
+
+static size_t FindLastSlash(const std::string& filename) {
+  size_t index = filename.rfind('/');
+  if (index == std::string::npos) {
+    index = filename.rfind('\\');
+  }
+  return index;
+}
+
+// Bounds are written with full precision, so that large models are not
+// culled by rounded bounds
+static void SetExactAttribute(tinyxml2::XMLElement* elem, const char* name,
+                              double value) {
+  char buffer[32];
+  snprintf(buffer, sizeof(buffer), "%.17g", value);
+  elem->SetAttribute(name, buffer);
+}
+
+static void WriteBounds(tinyxml2::XMLDocument& doc,
+                        tinyxml2::XMLElement* parent,
+                        const CBoundingBox3d& bounds) {
+  if (bounds.IsEmpty())
+    return;
+  const CPoint3d* corners[2] = { &bounds.min(), &bounds.max() };
+  const std::string* tags[2] = { &kMinTag, &kMaxTag };
+  for (int i = 0; i < 2; ++i) {
+    tinyxml2::XMLElement* elem = doc.NewElement(tags[i]->c_str());
+    SetExactAttribute(elem, kXTag.c_str(), corners[i]->x());
+    SetExactAttribute(elem, kYTag.c_str(), corners[i]->y());
+    SetExactAttribute(elem, kZTag.c_str(), corners[i]->z());
+    parent->InsertEndChild(elem);
+  }
+}
+
+static bool ReadPoint(const tinyxml2::XMLElement* elem, CPoint3d& pt) {
+  double x = 0.0, y = 0.0, z = 0.0;
+  bool ok = elem->QueryDoubleAttribute(kXTag.c_str(), &x) ==
+                tinyxml2::XML_NO_ERROR &&
+            elem->QueryDoubleAttribute(kYTag.c_str(), &y) ==
+                tinyxml2::XML_NO_ERROR &&
+            elem->QueryDoubleAttribute(kZTag.c_str(), &z) ==
+                tinyxml2::XML_NO_ERROR;
+  pt.SetLocation(x, y, z);
+  return ok;
+}
+
+static void WriteTileElement(tinyxml2::XMLDocument& doc,
+                             tinyxml2::XMLNode* parent,
+                             const XmlTileSetInfo& tile_set, int index) {
+  const XmlTileInfo& tile = tile_set.tiles_[index];
+  tinyxml2::XMLElement* elem = doc.NewElement(kTileTag.c_str());
+  elem->SetAttribute(kFileTag.c_str(), tile.filename_.c_str());
+  SetExactAttribute(elem, kGeometricErrorTag.c_str(), tile.geometric_error_);
+  elem->SetAttribute(kTrianglesTag.c_str(),
+                     static_cast<int64_t>(tile.num_triangles_));
+  parent->InsertEndChild(elem);
+  WriteBounds(doc, elem, tile.bounds_);
+  for (size_t i = 0; i < tile.children_.size(); ++i) {
+    WriteTileElement(doc, elem, tile_set, tile.children_[i]);
+  }
+}
+
+static bool ReadTileElement(const tinyxml2::XMLElement* elem, int parent,
+                            XmlTileSetInfo& info) {
+  int index = static_cast<int>(info.tiles_.size());
+  info.tiles_.push_back(XmlTileInfo());
+  info.tiles_[index].parent_ = parent;
+  if (parent >= 0)
+    info.tiles_[parent].children_.push_back(index);
+
+  const char* filename = elem->Attribute(kFileTag.c_str());
+  int64_t num_triangles = 0;
+  double geometric_error = 0.0;
+  if (filename == NULL ||
+      elem->QueryDoubleAttribute(kGeometricErrorTag.c_str(),
+                                 &geometric_error) != tinyxml2::XML_NO_ERROR ||
+      elem->QueryInt64Attribute(kTrianglesTag.c_str(),
+                                &num_triangles) != tinyxml2::XML_NO_ERROR ||
+      num_triangles < 0) {
+    return false;
+  }
+  info.tiles_[index].filename_ = filename;
+  info.tiles_[index].geometric_error_ = geometric_error;
+  info.tiles_[index].num_triangles_ = static_cast<uint64_t>(num_triangles);
+
+  for (const tinyxml2::XMLElement* child = elem->FirstChildElement();
+       child != NULL; child = child->NextSiblingElement()) {
+    if (child->Value() == kMinTag || child->Value() == kMaxTag) {
+      CPoint3d pt;
+      if (!ReadPoint(child, pt))
+        return false;
+      info.tiles_[index].bounds_.Add(pt);
+    } else if (child->Value() == kTileTag) {
+      if (!ReadTileElement(child, index, info))
+        return false;
+    }
+  }
+  return true;
+}
+
+//------------------------------------------------------------------------------
+
+CXmlTiler::CXmlTiler()
+  : major_ver_(0), minor_ver_(0), build_no_(0), max_triangles_(65536),
+    max_depth_(10), num_threads_(0) {
+  SetOptions(CXmlOptions());
+}
+
+void CXmlTiler::SetOptions(const CXmlOptions& options) {
+  options_ = options;
+  // A tile is read as a whole, so none of the streaming aids are needed
+  options_.set_export_index(false);
+  options_.set_export_index_groups(false);
+  options_.set_export_progressive(false);
+  options_.set_export_tiles(false);
+  options_.set_export_manifest(false);
+  options_.set_delta_manifest(std::string());
+  options_.set_export_profile(false);
+}
+
+void CXmlTiler::SetVersion(int major_ver, int minor_ver, int build_no) {
+  major_ver_ = major_ver;
+  minor_ver_ = minor_ver;
+  build_no_ = build_no;
+}
+
+std::string CXmlTiler::GetTileSetFilename(const std::string& xml_filename) {
+  return xml_filename + kTileSetExtension;
+}
+
+void CXmlTiler::AddFace(const XmlFaceInfo& face,
+                        const SUTransformation& transform,
+                        const std::string& material_name) {
+  size_t count = face.vertices_.size() / 3 * 3;
+  if (count == 0)
+    return;
+  faces_.push_back(XmlFaceInfo());
+  XmlFaceInfo& world = faces_.back();
+  world.layer_name_ = face.layer_name_;
+  world.front_mat_name_ = face.front_mat_name_;
+  world.back_mat_name_ = face.back_mat_name_;
+  world.has_front_texture_ = face.has_front_texture_;
+  world.has_back_texture_ = face.has_back_texture_;
+  world.has_normals_ = face.has_normals_;
+
+  // Faces without a material take the material of the instance
+  if (world.front_mat_name_.empty())
+    world.front_mat_name_ = material_name;
+  if (world.back_mat_name_.empty())
+    world.back_mat_name_ = material_name;
+
+  world.vertices_.assign(face.vertices_.begin(),
+                         face.vertices_.begin() + count);
+  for (size_t i = 0; i < count; ++i) {
+    XmlFaceVertex& vertex = world.vertices_[i];
+    vertex.vertex_ = TransformPoint(transform, vertex.vertex_);
+    vertex.normal_ = TransformNormal(transform, vertex.normal_);
+  }
+
+  // Mirroring turns the triangles inside out
+  if (GetDeterminant(transform) < 0.0) {
+    for (size_t i = 0; i < count; i += 3) {
+      std::swap(world.vertices_[i + 1], world.vertices_[i + 2]);
+    }
+  }
+}
+
+void CXmlTiler::AddEntities(const DefinitionMap& definitions,
+                            const XmlEntitiesInfo& entities,
+                            const SUTransformation& transform,
+                            const std::string& material_name,
+                            std::vector<std::string>& definition_stack) {
+  for (size_t i = 0; i < entities.faces_.size(); ++i) {
+    AddFace(entities.faces_[i], transform, material_name);
+  }
+  for (size_t i = 0; i < entities.edges_.size(); ++i) {
+    edges_.push_back(TransformEdge(transform, entities.edges_[i]));
+  }
+  for (size_t i = 0; i < entities.curves_.size(); ++i) {
+    const XmlCurveInfo& curve = entities.curves_[i];
+    curves_.push_back(XmlCurveInfo());
+    for (size_t j = 0; j < curve.edges_.size(); ++j) {
+      curves_.back().edges_.push_back(TransformEdge(transform,
+                                                    curve.edges_[j]));
+    }
+  }
+  for (size_t i = 0; i < entities.groups_.size(); ++i) {
+    const XmlGroupInfo& group = entities.groups_[i];
+    if (group.entities_ != NULL) {
+      AddEntities(definitions, *group.entities_,
+                  MultiplyTransforms(transform, group.transform_),
+                  material_name, definition_stack);
+    }
+  }
+  for (size_t i = 0; i < entities.component_instances_.size(); ++i) {
+    const XmlComponentInstanceInfo& instance =
+        entities.component_instances_[i];
+    DefinitionMap::const_iterator it =
+        definitions.find(instance.definition_name_);
+    // Skip unknown definitions and definitions that contain themselves
+    if (it == definitions.end() ||
+        std::find(definition_stack.begin(), definition_stack.end(),
+                  instance.definition_name_) != definition_stack.end()) {
+      continue;
+    }
+    definition_stack.push_back(instance.definition_name_);
+    AddEntities(definitions, it->second->entities_,
+                MultiplyTransforms(transform, instance.transform_),
+                instance.material_name_.empty() ? material_name
+                                                : instance.material_name_,
+                definition_stack);
+    definition_stack.pop_back();
+  }
+}
+
+void CXmlTiler::AddTile(int parent, const std::string& prefix,
+                        const std::string& path, const CBoundingBox3d& cell,
+                        int depth, std::vector<Triangle>& triangles,
+                        std::vector<uint32_t>& edges,
+                        std::vector<uint32_t>& curves) {
+  int index = static_cast<int>(tile_set_.tiles_.size());
+  tile_set_.tiles_.push_back(XmlTileInfo());
+  contents_.push_back(TileContent());
+  if (parent >= 0)
+    tile_set_.tiles_[parent].children_.push_back(index);
+
+  CBoundingBox3d bounds;
+  for (size_t i = 0; i < triangles.size(); ++i) {
+    const XmlFaceInfo& face = faces_[triangles[i].face_];
+    for (uint32_t j = 0; j < 3; ++j) {
+      bounds.Add(face.vertices_[triangles[i].vertex_ + j].vertex_);
+    }
+  }
+  for (size_t i = 0; i < edges.size(); ++i) {
+    bounds.Add(edges_[edges[i]].start_);
+    bounds.Add(edges_[edges[i]].end_);
+  }
+  for (size_t i = 0; i < curves.size(); ++i) {
+    const XmlCurveInfo& curve = curves_[curves[i]];
+    for (size_t j = 0; j < curve.edges_.size(); ++j) {
+      bounds.Add(curve.edges_[j].start_);
+      bounds.Add(curve.edges_[j].end_);
+    }
+  }
+
+  XmlTileInfo& tile = tile_set_.tiles_[index];
+  tile.filename_ = prefix + path + kTileExtension;
+  tile.bounds_ = bounds;
+  tile.parent_ = parent;
+
+  TileContent& content = contents_[index];
+  if (triangles.size() <= max_triangles_ || depth >= max_depth_) {
+    tile.num_triangles_ = triangles.size();
+    content.triangles_.swap(triangles);
+    content.edges_.swap(edges);
+    content.curves_.swap(curves);
+    return;
+  }
+
+  // Interior tiles are drawn until their children are loaded
+  std::vector<CPoint3d> points;
+  points.reserve(triangles.size() * 3);
+  for (size_t i = 0; i < triangles.size(); ++i) {
+    const XmlFaceInfo& face = faces_[triangles[i].face_];
+    for (uint32_t j = 0; j < 3; ++j) {
+      points.push_back(face.vertices_[triangles[i].vertex_ + j].vertex_);
+    }
+  }
+  // Clustering on the octree cell, rather than on the bounds, makes the
+  // geometric error halve from each level to the next
+  CXmlCoarseBuilder::SimplifyMesh(points, cell, kTileClusterCells,
+                                  content.mesh_);
+  std::vector<CPoint3d>().swap(points);
+  tile.num_triangles_ = content.mesh_.indices_.size() / 3;
+  // Vertices move by at most the diagonal of a cluster cell
+  tile.geometric_error_ = GetMaxExtent(cell) / kTileClusterCells * sqrt(3.0);
+
+  // Split the cell into octants, by triangle centroid and edge midpoint
+  CPoint3d center = (cell.min() + cell.max()) / 2.0;
+  std::vector<Triangle> child_triangles[8];
+  std::vector<uint32_t> child_edges[8];
+  std::vector<uint32_t> child_curves[8];
+  for (size_t i = 0; i < triangles.size(); ++i) {
+    const XmlFaceInfo& face = faces_[triangles[i].face_];
+    const XmlFaceVertex* vertices = &face.vertices_[triangles[i].vertex_];
+    CPoint3d centroid =
+        (vertices[0].vertex_ + vertices[1].vertex_ + vertices[2].vertex_) /
+        3.0;
+    child_triangles[GetOctant(centroid, center)].push_back(triangles[i]);
+  }
+  for (size_t i = 0; i < edges.size(); ++i) {
+    child_edges[GetOctant(GetMidPoint(edges_[edges[i]]), center)]
+        .push_back(edges[i]);
+  }
+  // Curves stay whole, in the octant of their first edge
+  for (size_t i = 0; i < curves.size(); ++i) {
+    const XmlCurveInfo& curve = curves_[curves[i]];
+    int octant = curve.edges_.empty() ? 0 :
+                 GetOctant(GetMidPoint(curve.edges_[0]), center);
+    child_curves[octant].push_back(curves[i]);
+  }
+  std::vector<Triangle>().swap(triangles);
+  std::vector<uint32_t>().swap(edges);
+  std::vector<uint32_t>().swap(curves);
+
+  for (int octant = 0; octant < 8; ++octant) {
+    if (child_triangles[octant].empty() && child_edges[octant].empty() &&
+        child_curves[octant].empty()) {
+      continue;
+    }
+    CBoundingBox3d child_cell;
+    child_cell.Add(CPoint3d(
+        (octant & 1) ? center.x() : cell.min().x(),
+        (octant & 2) ? center.y() : cell.min().y(),
+        (octant & 4) ? center.z() : cell.min().z()));
+    child_cell.Add(CPoint3d(
+        (octant & 1) ? cell.max().x() : center.x(),
+        (octant & 2) ? cell.max().y() : center.y(),
+        (octant & 4) ? cell.max().z() : center.z()));
+    AddTile(index, prefix, path + static_cast<char>('0' + octant), child_cell,
+            depth + 1, child_triangles[octant], child_edges[octant],
+            child_curves[octant]);
+  }
+}
+
+void CXmlTiler::WriteTile(size_t index, const std::string& directory) const {
+  const XmlTileInfo& tile = tile_set_.tiles_[index];
+  const TileContent& content = contents_[index];
+
+  CXmlFile file;
+  file.SetOptions(options_);
+  if (!file.Open(directory + tile.filename_, true))
+    return;
+  file.WriteHeader(major_ver_, minor_ver_, build_no_);
+
+  // Quantized tiles are quantized against the bounds of what they hold
+  if (options_.export_quantized()) {
+    CBoundingBox3d bounds;
+    CBoundingBox3d uv_bounds;
+    for (size_t i = 0; i < content.triangles_.size(); ++i) {
+      const XmlFaceInfo& face = faces_[content.triangles_[i].face_];
+      const XmlFaceVertex* vertices =
+          &face.vertices_[content.triangles_[i].vertex_];
+      for (int j = 0; j < 3; ++j) {
+        bounds.Add(vertices[j].vertex_);
+        if (face.has_front_texture_)
+          uv_bounds.Add(vertices[j].front_texture_coord_);
+        if (face.has_back_texture_)
+          uv_bounds.Add(vertices[j].back_texture_coord_);
+      }
+    }
+    for (size_t i = 0; i < content.mesh_.points_.size(); ++i) {
+      bounds.Add(content.mesh_.points_[i]);
+    }
+    file.SetQuantizationBounds(bounds, uv_bounds);
+  }
+  file.StartGeometry();
+
+  // Full detail triangles, regrouped into their faces. Triangles of a face
+  // are always consecutive.
+  for (size_t i = 0; i < content.triangles_.size();) {
+    const XmlFaceInfo& face = faces_[content.triangles_[i].face_];
+    XmlFaceInfo info;
+    info.layer_name_ = face.layer_name_;
+    info.front_mat_name_ = face.front_mat_name_;
+    info.back_mat_name_ = face.back_mat_name_;
+    info.has_front_texture_ = face.has_front_texture_;
+    info.has_back_texture_ = face.has_back_texture_;
+    uint32_t face_index = content.triangles_[i].face_;
+    for (; i < content.triangles_.size() &&
+           content.triangles_[i].face_ == face_index; ++i) {
+      const XmlFaceVertex* vertices =
+          &face.vertices_[content.triangles_[i].vertex_];
+      info.vertices_.insert(info.vertices_.end(), vertices, vertices + 3);
+    }
+    file.WriteFaceInfo(info);
+  }
+
+  // The clustered mesh, as a single face without materials
+  const XmlCoarseMeshInfo& mesh = content.mesh_;
+  if (!mesh.indices_.empty()) {
+    XmlFaceInfo info;
+    for (size_t i = 0; i + 2 < mesh.indices_.size(); i += 3) {
+      const CPoint3d& pt1 = mesh.points_[mesh.indices_[i]];
+      const CPoint3d& pt2 = mesh.points_[mesh.indices_[i + 1]];
+      const CPoint3d& pt3 = mesh.points_[mesh.indices_[i + 2]];
+      CVector3d normal = Cross(pt2 - pt1, pt3 - pt1);
+      double length = sqrt(Dot(normal, normal));
+      if (length > 0.0)
+        normal /= length;
+      XmlFaceVertex vertex;
+      vertex.normal_ = normal;
+      vertex.vertex_ = pt1;
+      info.vertices_.push_back(vertex);
+      vertex.vertex_ = pt2;
+      info.vertices_.push_back(vertex);
+      vertex.vertex_ = pt3;
+      info.vertices_.push_back(vertex);
+    }
+    file.WriteFaceInfo(info);
+  }
+
+  if (options_.export_line_lists()) {
+    std::vector<XmlEdgeInfo> edges;
+    for (size_t i = 0; i < content.edges_.size(); ++i) {
+      edges.push_back(edges_[content.edges_[i]]);
+    }
+    if (!edges.empty())
+      file.WriteLineListInfo(edges);
+  } else {
+    for (size_t i = 0; i < content.edges_.size(); ++i) {
+      file.WriteEdgeInfo(edges_[content.edges_[i]]);
+    }
+  }
+  for (size_t i = 0; i < content.curves_.size(); ++i) {
+    file.WriteCurveInfo(curves_[content.curves_[i]]);
+  }
+
+  file.PopParentNode(); // Geometry
+  file.Close(false);
+}
+
+bool CXmlTiler::Write(const XmlModelInfo& model,
+                      const std::string& xml_filename) {
+  faces_.clear();
+  edges_.clear();
+  curves_.clear();
+  tile_set_ = XmlTileSetInfo();
+  contents_.clear();
+
+  // Flatten the model into world coordinates
+  DefinitionMap definitions;
+  for (size_t i = 0; i < model.definitions_.size(); ++i) {
+    definitions[model.definitions_[i].name_] = &model.definitions_[i];
+  }
+  std::vector<std::string> definition_stack;
+  AddEntities(definitions, model.entities_, GetIdentityTransform(),
+              std::string(), definition_stack);
+
+  std::vector<Triangle> triangles;
+  CBoundingBox3d bounds;
+  for (size_t i = 0; i < faces_.size(); ++i) {
+    for (size_t j = 0; j < faces_[i].vertices_.size(); j += 3) {
+      Triangle triangle;
+      triangle.face_ = static_cast<uint32_t>(i);
+      triangle.vertex_ = static_cast<uint32_t>(j);
+      triangles.push_back(triangle);
+      for (size_t k = 0; k < 3; ++k) {
+        bounds.Add(faces_[i].vertices_[j + k].vertex_);
+      }
+    }
+  }
+  std::vector<uint32_t> edges(edges_.size());
+  for (size_t i = 0; i < edges.size(); ++i) {
+    edges[i] = static_cast<uint32_t>(i);
+    bounds.Add(edges_[i].start_);
+    bounds.Add(edges_[i].end_);
+  }
+  std::vector<uint32_t> curves(curves_.size());
+  for (size_t i = 0; i < curves.size(); ++i) {
+    curves[i] = static_cast<uint32_t>(i);
+    for (size_t j = 0; j < curves_[i].edges_.size(); ++j) {
+      bounds.Add(curves_[i].edges_[j].start_);
+      bounds.Add(curves_[i].edges_[j].end_);
+    }
+  }
+
+  // The octree root is the cube around the bounds
+  CBoundingBox3d cell;
+  if (!bounds.IsEmpty()) {
+    CPoint3d center = (bounds.min() + bounds.max()) / 2.0;
+    double half = GetMaxExtent(bounds) / 2.0;
+    CVector3d diagonal(half, half, half);
+    cell.Add(center - diagonal);
+    cell.Add(center + diagonal);
+  }
+
+  size_t slash = FindLastSlash(xml_filename);
+  std::string directory = slash == std::string::npos ?
+      std::string() : xml_filename.substr(0, slash + 1);
+  std::string prefix = xml_filename.substr(directory.size()) + kTileInfix;
+  AddTile(-1, prefix, kRootPath, cell, 0, triangles, edges, curves);
+
+  // Each tile is a separate document, so tiles can be written in parallel
+  size_t num_tiles = tile_set_.tiles_.size();
+  size_t num_threads = num_threads_ > 0 ?
+      static_cast<size_t>(num_threads_) : std::thread::hardware_concurrency();
+  num_threads = std::max<size_t>(1, std::min(num_threads, num_tiles));
+  std::atomic<size_t> next_tile(0);
+  std::vector<std::thread> threads;
+  for (size_t i = 1; i < num_threads; ++i) {
+    threads.push_back(std::thread([this, &next_tile, &directory, num_tiles] {
+      for (size_t tile = next_tile++; tile < num_tiles; tile = next_tile++)
+        WriteTile(tile, directory);
+    }));
+  }
+  for (size_t tile = next_tile++; tile < num_tiles; tile = next_tile++)
+    WriteTile(tile, directory);
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  contents_.clear();
+
+  // Tile set
+  tinyxml2::XMLDocument doc;
+  doc.InsertEndChild(doc.NewDeclaration());
+  tinyxml2::XMLElement* root = doc.NewElement(kTileSetTag.c_str());
+  root->SetAttribute(kXMLVersionTag.c_str(), kTileSetVersion);
+  root->SetAttribute(kMaxTrianglesTag.c_str(),
+                     static_cast<int64_t>(max_triangles_));
+  doc.InsertEndChild(root);
+  WriteTileElement(doc, root, tile_set_, 0);
+  return doc.SaveFile(GetTileSetFilename(xml_filename).c_str()) ==
+         tinyxml2::XML_NO_ERROR;
+}
+
+bool CXmlTiler::ReadTileSet(const std::string& filename,
+                            XmlTileSetInfo& info) {
+  info = XmlTileSetInfo();
+  tinyxml2::XMLDocument doc;
+  if (doc.LoadFile(filename.c_str()) != tinyxml2::XML_NO_ERROR)
+    return false;
+  const tinyxml2::XMLElement* root = doc.FirstChildElement(kTileSetTag.c_str());
+  int version = 0;
+  if (root == NULL ||
+      root->QueryIntAttribute(kXMLVersionTag.c_str(), &version) !=
+          tinyxml2::XML_NO_ERROR ||
+      version != kTileSetVersion) {
+    return false;
+  }
+  const tinyxml2::XMLElement* tile = root->FirstChildElement(kTileTag.c_str());
+  return tile != NULL && ReadTileElement(tile, -1, info);
+}